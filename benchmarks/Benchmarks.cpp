@@ -0,0 +1,288 @@
+/* BENCHMARKS.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 18:02:15
+ * Last edited:
+ *   18/10/2021, 18:02:15
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Entrypoint of the benchmark executable, which sets up a headless
+ *   Device and runs the scenes that are named on the command line (or all
+ *   of them). Usage:
+ *
+ *     makma3D_benchmarks [<scene>...] [--frames <n>] [--objects <n>]
+ *                        [--shaders <dir>] [--cpu]
+ *
+ *   where --objects is the number of objects (or draws) per frame, and
+ *   --cpu prefers a CPU device (e.g., lavapipe) over a GPU.
+**/
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Makma3D.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "Benchmarks.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* A scene that can be run. */
+struct Scene {
+    /* The name of the scene on the command line. */
+    const char* name;
+    /* The function that runs it. */
+    void (*run)(const Device&, const Benchmarks::Settings&);
+};
+
+/* The scenes that can be run, in the order in which they run. */
+static const Scene scenes[] = {
+    { "cull", Benchmarks::cull_scene },
+    { "bindless", Benchmarks::bindless_scene },
+    { "recording", Benchmarks::recording_scene }
+};
+/* The number of scenes. */
+static constexpr const uint32_t n_scenes = sizeof(scenes) / sizeof(Scene);
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Reads the compiled SPIR-V shader at the given path and creates a shader module from it. Stops the program if the shader could not be read. */
+VkShaderModule Benchmarks::load_shader(const Device& device, const std::string& path) {
+    // Read the code in words, as Vulkan wants it
+    std::ifstream h(path, std::ios::binary | std::ios::ate);
+    if (!h.is_open()) {
+        logger.fatal("Could not open shader '", path, "'");
+    }
+    std::streamsize size = h.tellg();
+    uint32_t n_words = static_cast<uint32_t>(size / sizeof(uint32_t));
+    Tools::Array<uint32_t> code(n_words);
+    h.seekg(0);
+    if (size % sizeof(uint32_t) != 0 || !h.read((char*) code.wdata(n_words), size)) {
+        logger.fatal("Could not read shader '", path, "'");
+    }
+
+    // Create the module
+    VkShaderModuleCreateInfo module_info = {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = static_cast<size_t>(size);
+    module_info.pCode = code.rdata();
+    VkShaderModule vk_module;
+    VkResult vk_result;
+    if ((vk_result = vkCreateShaderModule(device, &module_info, nullptr, &vk_module)) != VK_SUCCESS) {
+        logger.fatal("Could not create shader module for '", path, "': ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    return vk_module;
+}
+
+/* Creates a render pass with a single colour attachment of the given format, which is cleared at the start and kept at the end. */
+VkRenderPass Benchmarks::create_render_pass(const Device& device, VkFormat vk_format) {
+    VkAttachmentDescription attachment = {};
+    attachment.format = vk_format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &reference;
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+
+    VkRenderPass vk_render_pass;
+    VkResult vk_result;
+    if ((vk_result = vkCreateRenderPass(device, &render_pass_info, nullptr, &vk_render_pass)) != VK_SUCCESS) {
+        logger.fatal("Could not create render pass: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    return vk_render_pass;
+}
+
+/* Creates a framebuffer for every image of the given target. */
+Tools::Array<VkFramebuffer> Benchmarks::create_framebuffers(const Device& device, VkRenderPass vk_render_pass, const Vulkanic::OffscreenTarget& target) {
+    Tools::Array<VkFramebuffer> vk_framebuffers(target.views().size());
+    for (uint32_t i = 0; i < target.views().size(); i++) {
+        VkFramebufferCreateInfo framebuffer_info = {};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = vk_render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = &target.views()[i];
+        framebuffer_info.width = target.extent().width;
+        framebuffer_info.height = target.extent().height;
+        framebuffer_info.layers = 1;
+
+        VkFramebuffer vk_framebuffer;
+        VkResult vk_result;
+        if ((vk_result = vkCreateFramebuffer(device, &framebuffer_info, nullptr, &vk_framebuffer)) != VK_SUCCESS) {
+            logger.fatal("Could not create framebuffer ", i, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        vk_framebuffers.push_back(vk_framebuffer);
+    }
+    return vk_framebuffers;
+}
+
+/* Creates a pipeline layout with the given set layout (if any) and, if push_size is non-zero, a push constant range of that size for the fragment stage. */
+VkPipelineLayout Benchmarks::create_pipeline_layout(const Device& device, VkDescriptorSetLayout vk_set_layout, uint32_t push_size) {
+    VkPushConstantRange range = { VK_SHADER_STAGE_FRAGMENT_BIT, 0, push_size };
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = vk_set_layout != VK_NULL_HANDLE ? 1 : 0;
+    layout_info.pSetLayouts = vk_set_layout != VK_NULL_HANDLE ? &vk_set_layout : nullptr;
+    layout_info.pushConstantRangeCount = push_size > 0 ? 1 : 0;
+    layout_info.pPushConstantRanges = push_size > 0 ? &range : nullptr;
+
+    VkPipelineLayout vk_pipeline_layout;
+    VkResult vk_result;
+    if ((vk_result = vkCreatePipelineLayout(device, &layout_info, nullptr, &vk_pipeline_layout)) != VK_SUCCESS) {
+        logger.fatal("Could not create pipeline layout: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    return vk_pipeline_layout;
+}
+
+/* Creates a graphics pipeline that draws the triangle of triangle.vert with the given fragment shader over the whole target. */
+VkPipeline Benchmarks::create_pipeline(const Device& device, VkRenderPass vk_render_pass, VkPipelineLayout vk_pipeline_layout, const std::string& shader_dir, const std::string& fragment_shader, const VkExtent2D& extent) {
+    VkShaderModule vk_vertex_module = load_shader(device, shader_dir + "/triangle.vert.spv");
+    VkShaderModule vk_fragment_module = load_shader(device, shader_dir + "/" + fragment_shader);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vk_vertex_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = vk_fragment_module;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, extent };
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.pViewports = &viewport;
+    viewport_state.scissorCount = 1;
+    viewport_state.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blend_attachment;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterization;
+    pipeline_info.pMultisampleState = &multisample;
+    pipeline_info.pColorBlendState = &blend;
+    pipeline_info.layout = vk_pipeline_layout;
+    pipeline_info.renderPass = vk_render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipeline vk_pipeline;
+    VkResult vk_result;
+    if ((vk_result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &vk_pipeline)) != VK_SUCCESS) {
+        logger.fatal("Could not create pipeline for '", fragment_shader, "': ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // The modules aren't needed anymore once the pipeline exists
+    vkDestroyShaderModule(device, vk_fragment_module, nullptr);
+    vkDestroyShaderModule(device, vk_vertex_module, nullptr);
+    return vk_pipeline;
+}
+
+
+
+
+
+/***** ENTRY POINT *****/
+int main(int argc, char** argv) {
+    // Parse the arguments
+    Benchmarks::Settings settings = { MAKMA3D_SHADER_DIR, 200, 50000 };
+    PhysicalDeviceType preferred_type = PhysicalDeviceType::discrete;
+    Tools::Array<const Scene*> to_run;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            settings.n_frames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            settings.n_objects = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc) {
+            settings.shader_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cpu") == 0) {
+            preferred_type = PhysicalDeviceType::cpu;
+        } else {
+            uint32_t s;
+            for (s = 0; s < n_scenes; s++) {
+                if (strcmp(argv[i], scenes[s].name) == 0) { break; }
+            }
+            if (s == n_scenes) {
+                cerr << "Unknown scene '" << argv[i] << "'; expected one of:";
+                for (uint32_t j = 0; j < n_scenes; j++) { cerr << ' ' << scenes[j].name; }
+                cerr << endl;
+                return EXIT_FAILURE;
+            }
+            to_run.push_back(&scenes[s]);
+        }
+    }
+    if (to_run.empty()) {
+        for (uint32_t s = 0; s < n_scenes; s++) { to_run.push_back(&scenes[s]); }
+    }
+
+    // Set up a headless device
+    logger.set_verbosity(Verbosity::important);
+    Instance instance("Makma3D benchmarks", Version(1, 0, 0), { Extension::headless });
+    PhysicalDevice physical_device = instance.get_preferred_headless_physical_device(preferred_type);
+    Device device(instance, physical_device, nullptr);
+    cout << "Running " << to_run.size() << " scene(s) on " << physical_device.name() << " for " << settings.n_frames << " frames with " << settings.n_objects << " objects." << endl;
+
+    // Run the scenes
+    for (uint32_t i = 0; i < to_run.size(); i++) {
+        cout << endl << "=== " << to_run[i]->name << " ===" << endl;
+        to_run[i]->run(device, settings);
+        device.get_dispatch().vkDeviceWaitIdle(device);
+    }
+
+    // Done
+    return EXIT_SUCCESS;
+}
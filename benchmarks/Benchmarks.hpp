@@ -0,0 +1,84 @@
+/* BENCHMARKS.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 18:02:11
+ * Last edited:
+ *   18/10/2021, 18:02:11
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Declares the benchmark scenes. Each scene runs a workload on a
+ *   headless Device for a number of frames, and prints what it measured
+ *   to stdout.
+**/
+
+#ifndef BENCHMARKS_BENCHMARKS_HPP
+#define BENCHMARKS_BENCHMARKS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "gpu/Device.hpp"
+#include "vulkanic/swapchain/OffscreenTarget.hpp"
+
+namespace Makma3D::Benchmarks {
+    /* Settings shared by all scenes. */
+    struct Settings {
+        /* The directory with the compiled shaders of the library and the scenes. */
+        std::string shader_dir;
+        /* The number of frames each scene runs for (per mode it measures). */
+        uint32_t n_frames;
+        /* The number of objects in the scene. */
+        uint32_t n_objects;
+    };
+
+    /* Reads the compiled SPIR-V shader at the given path and creates a shader module from it. Stops the program if the shader could not be read.
+     * @param device The Device to create the module on.
+     * @param path The path to the .spv file.
+     * @returns The new module, which the caller destroys. */
+    VkShaderModule load_shader(const Makma3D::Device& device, const std::string& path);
+    /* Creates a render pass with a single colour attachment of the given format, which is cleared at the start and kept at the end.
+     * @param device The Device to create the render pass on.
+     * @param vk_format The format of the colour attachment.
+     * @returns The new render pass, which the caller destroys. */
+    VkRenderPass create_render_pass(const Makma3D::Device& device, VkFormat vk_format);
+    /* Creates a framebuffer for every image of the given target.
+     * @param device The Device to create the framebuffers on.
+     * @param vk_render_pass The render pass the framebuffers are used with.
+     * @param target The target whose images the framebuffers render to.
+     * @returns The new framebuffers, in the order of the target's images, which the caller destroys. */
+    Tools::Array<VkFramebuffer> create_framebuffers(const Makma3D::Device& device, VkRenderPass vk_render_pass, const Makma3D::Vulkanic::OffscreenTarget& target);
+    /* Creates a pipeline layout with the given set layout and, if push_size is non-zero, a push constant range of that size for the fragment stage.
+     * @param device The Device to create the layout on.
+     * @param vk_set_layout The layout of the only descriptor set, or VK_NULL_HANDLE if the pipeline doesn't use any.
+     * @param push_size The size of the fragment push constants, or 0 if there are none.
+     * @returns The new pipeline layout, which the caller destroys. */
+    VkPipelineLayout create_pipeline_layout(const Makma3D::Device& device, VkDescriptorSetLayout vk_set_layout, uint32_t push_size);
+    /* Creates a graphics pipeline that draws the small triangle of triangle.vert with the given fragment shader, with a fixed viewport over the given extent.
+     * @param device The Device to create the pipeline on.
+     * @param vk_render_pass The render pass in whose first subpass the pipeline is used.
+     * @param vk_pipeline_layout The layout of the pipeline.
+     * @param shader_dir The directory with the compiled shaders.
+     * @param fragment_shader The file name of the compiled fragment shader in that directory.
+     * @param extent The extent of the viewport.
+     * @returns The new pipeline, which the caller destroys. */
+    VkPipeline create_pipeline(const Makma3D::Device& device, VkRenderPass vk_render_pass, VkPipelineLayout vk_pipeline_layout, const std::string& shader_dir, const std::string& fragment_shader, const VkExtent2D& extent);
+
+    /* Culls and draws a field of objects with the IndirectRenderer, once with the culling shader and once on the CPU, and prints the time per frame and the number of draw calls of both.
+     * @param device The Device to run on.
+     * @param settings The settings of the run. */
+    void cull_scene(const Makma3D::Device& device, const Settings& settings);
+    /* Records many small draws with their own material each, once with a descriptor set per draw and once with the BindlessHeap, and prints the draws per second of both.
+     * @param device The Device to run on.
+     * @param settings The settings of the run; n_objects is the number of draws per frame. */
+    void bindless_scene(const Makma3D::Device& device, const Settings& settings);
+    /* Records many small draws with the ParallelRecorder, once for every number of threads from one up to the number of hardware threads, and prints the recording time of each.
+     * @param device The Device to run on.
+     * @param settings The settings of the run; n_objects is the number of draws per frame. */
+    void recording_scene(const Makma3D::Device& device, const Settings& settings);
+
+}
+
+#endif
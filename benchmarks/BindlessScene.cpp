@@ -0,0 +1,248 @@
+/* BINDLESS SCENE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:10:27
+ * Last edited:
+ *   18/10/2021, 19:10:27
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The bindless scene, which records a lot of small draws that each use
+ *   their own material. In the classic mode, every draw allocates, writes
+ *   and binds a descriptor set for its material; in the bindless mode, the
+ *   BindlessHeap is bound once and every draw only pushes the index of its
+ *   material.
+**/
+
+#include <chrono>
+#include <iostream>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "vulkanic/swapchain/OffscreenTarget.hpp"
+
+#include "Benchmarks.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* The number of different materials that the draws cycle through. */
+static constexpr const uint32_t n_materials = 256;
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* The materials of the scene: a single buffer with a small colour region per material. */
+struct Materials {
+    /* The buffer with the colours. */
+    VkBuffer vk_buffer;
+    /* The memory that backs the buffer. */
+    VkDeviceMemory vk_memory;
+    /* The memory type of the memory. */
+    uint32_t memory_type;
+    /* The size of the memory. */
+    VkDeviceSize memory_size;
+    /* The distance between two materials in the buffer, which respects the device's storage buffer alignment. */
+    VkDeviceSize stride;
+};
+
+/* Creates the buffer with the materials, each with their own colour. */
+static Materials create_materials(const Device& device) {
+    Materials materials;
+    VkDeviceSize alignment = device.get_physical_device().properties().limits.minStorageBufferOffsetAlignment;
+    materials.stride = ((4 * sizeof(float) + alignment - 1) / alignment) * alignment;
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = n_materials * materials.stride;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(device, &buffer_info, nullptr, &materials.vk_buffer)) != VK_SUCCESS) {
+        logger.fatal("Could not create material buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Back it with host-visible memory, so the colours can be written directly
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, materials.vk_buffer, &requirements);
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = device.get_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if ((vk_result = device.get_memory_budget().allocate(allocate_info, materials.vk_memory)) != VK_SUCCESS) {
+        logger.fatal("Could not allocate material buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    materials.memory_type = allocate_info.memoryTypeIndex;
+    materials.memory_size = allocate_info.allocationSize;
+    if ((vk_result = vkBindBufferMemory(device, materials.vk_buffer, materials.vk_memory, 0)) != VK_SUCCESS) {
+        logger.fatal("Could not bind material buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Write a different colour for every material
+    void* mapped;
+    if ((vk_result = device.get_dispatch().vkMapMemory(device, materials.vk_memory, 0, VK_WHOLE_SIZE, 0, &mapped)) != VK_SUCCESS) {
+        logger.fatal("Could not map material buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    for (uint32_t m = 0; m < n_materials; m++) {
+        float* color = reinterpret_cast<float*>(static_cast<char*>(mapped) + m * materials.stride);
+        color[0] = static_cast<float>(m % 16) / 15.0f;
+        color[1] = static_cast<float>(m / 16) / 15.0f;
+        color[2] = 0.5f;
+        color[3] = 1.0f;
+    }
+    device.get_dispatch().vkUnmapMemory(device, materials.vk_memory);
+
+    return materials;
+}
+
+/* Destroys the given materials again. Assumes the device is idle. */
+static void destroy_materials(const Device& device, const Materials& materials) {
+    vkDestroyBuffer(device, materials.vk_buffer, nullptr);
+    device.get_memory_budget().free(materials.vk_memory, materials.memory_type, materials.memory_size);
+}
+
+
+
+/* Records the given number of draws per frame for the given number of frames, and prints how many draws were recorded per second.
+ * @param device The Device to run on.
+ * @param target The target that paces the frames.
+ * @param vk_render_pass The render pass to draw in.
+ * @param vk_framebuffers The framebuffers of the target's images.
+ * @param vk_pipeline The pipeline to draw with.
+ * @param bind Binds whatever all draws in the command buffer share, after the pipeline is bound.
+ * @param record_draw Records the binding of the given material for a single draw.
+ * @param name The name of the mode, for the report.
+ * @param n_draws The number of draws per frame.
+ * @param n_frames The number of frames to run for. */
+template <class BIND, class RECORD_DRAW>
+static void run(const Device& device, Vulkanic::OffscreenTarget& target, VkRenderPass vk_render_pass, const Tools::Array<VkFramebuffer>& vk_framebuffers, VkPipeline vk_pipeline, BIND bind, RECORD_DRAW record_draw, const char* name, uint32_t n_draws, uint32_t n_frames) {
+    const DeviceDispatch& dispatch = device.get_dispatch();
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkClearValue clear_value = {};
+    VkRenderPassBeginInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = vk_render_pass;
+    render_pass_info.renderArea = { { 0, 0 }, target.extent() };
+    render_pass_info.clearValueCount = 1;
+    render_pass_info.pClearValues = &clear_value;
+
+    double record_time = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t f = 0; f < n_frames; f++) {
+        // Wait for the frame and start it
+        uint32_t image_index;
+        target.acquire(image_index);
+
+        // Record the draws
+        VkCommandBuffer vk_command_buffer = device.get_command_pool_manager().allocate(Vulkanic::QueueType::graphics);
+        VkResult vk_result;
+        if ((vk_result = dispatch.vkBeginCommandBuffer(vk_command_buffer, &begin_info)) != VK_SUCCESS) {
+            logger.fatal("Could not begin command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        std::chrono::steady_clock::time_point record_start = std::chrono::steady_clock::now();
+        render_pass_info.framebuffer = vk_framebuffers[image_index];
+        dispatch.vkCmdBeginRenderPass(vk_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+        dispatch.vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+        bind(vk_command_buffer);
+        for (uint32_t d = 0; d < n_draws; d++) {
+            record_draw(vk_command_buffer, d % n_materials);
+            dispatch.vkCmdDraw(vk_command_buffer, 3, 1, 0, 0);
+        }
+        dispatch.vkCmdEndRenderPass(vk_command_buffer);
+        record_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - record_start).count();
+        if ((vk_result = dispatch.vkEndCommandBuffer(vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatal("Could not end command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // Submit it and move to the next frame
+        device.get_submitter(Vulkanic::QueueType::graphics).enqueue(vk_command_buffer);
+        device.get_submitter(Vulkanic::QueueType::graphics).flush(target.in_flight());
+        target.present(image_index);
+    }
+    dispatch.vkDeviceWaitIdle(device);
+    double total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Report
+    double n_total = static_cast<double>(n_draws) * n_frames;
+    cout << "  " << name << ": " << (n_total / record_time) << " draws per second recorded, " << (n_total / total_time) << " draws per second overall (" << (total_time * 1000.0 / n_frames) << " ms per frame)" << endl;
+}
+
+
+
+
+
+/***** SCENE *****/
+/* Records many small draws with a material each, once with a descriptor set per draw and once with the BindlessHeap. */
+void Benchmarks::bindless_scene(const Device& device, const Settings& settings) {
+    Vulkanic::OffscreenTarget target(device, { 1280, 720 });
+    VkRenderPass vk_render_pass = Benchmarks::create_render_pass(device, target.format());
+    Tools::Array<VkFramebuffer> vk_framebuffers = Benchmarks::create_framebuffers(device, vk_render_pass, target);
+    Materials materials = create_materials(device);
+
+    // Classic: a storage buffer descriptor per draw, which is allocated and written while recording
+    {
+        Tools::Array<VkDescriptorSetLayoutBinding> bindings(1);
+        bindings.push_back({ 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+        const DescriptorLayout& set_layout = device.get_descriptor_allocator().get_layout(bindings);
+        VkPipelineLayout vk_pipeline_layout = Benchmarks::create_pipeline_layout(device, set_layout, 0);
+        VkPipeline vk_pipeline = Benchmarks::create_pipeline(device, vk_render_pass, vk_pipeline_layout, settings.shader_dir, "classic.frag.spv", target.extent());
+
+        run(device, target, vk_render_pass, vk_framebuffers, vk_pipeline, [](VkCommandBuffer) {}, [&](VkCommandBuffer vk_command_buffer, uint32_t material) {
+            VkDescriptorSet vk_set = device.get_descriptor_allocator().allocate(set_layout);
+            VkDescriptorBufferInfo buffer_info = { materials.vk_buffer, material * materials.stride, 4 * sizeof(float) };
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = vk_set;
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &buffer_info;
+            device.get_dispatch().vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+            device.get_dispatch().vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_set, 0, nullptr);
+        }, "classic", settings.n_objects, settings.n_frames);
+
+        vkDestroyPipeline(device, vk_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, vk_pipeline_layout, nullptr);
+    }
+
+    // Bindless: every material in the heap once, which is bound once per frame
+    if (device.has_bindless_heap()) {
+        BindlessHeap& heap = device.get_bindless_heap();
+        Tools::Array<BindlessHandle> handles(n_materials);
+        for (uint32_t m = 0; m < n_materials; m++) {
+            handles.push_back(heap.add_buffer(materials.vk_buffer, m * materials.stride, 4 * sizeof(float)));
+        }
+        VkPipelineLayout vk_pipeline_layout = Benchmarks::create_pipeline_layout(device, heap.layout(), sizeof(uint32_t));
+        VkPipeline vk_pipeline = Benchmarks::create_pipeline(device, vk_render_pass, vk_pipeline_layout, settings.shader_dir, "bindless.frag.spv", target.extent());
+
+        run(device, target, vk_render_pass, vk_framebuffers, vk_pipeline, [&](VkCommandBuffer vk_command_buffer) {
+            heap.bind(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout);
+        }, [&](VkCommandBuffer vk_command_buffer, uint32_t material) {
+            device.get_dispatch().vkCmdPushConstants(vk_command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &handles[material].index);
+        }, "bindless", settings.n_objects, settings.n_frames);
+
+        vkDestroyPipeline(device, vk_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, vk_pipeline_layout, nullptr);
+        for (uint32_t m = 0; m < n_materials; m++) {
+            heap.remove(handles[m]);
+        }
+    } else {
+        cout << "  bindless: not supported by this device" << endl;
+    }
+
+    // Clean up
+    destroy_materials(device, materials);
+    for (uint32_t i = 0; i < vk_framebuffers.size(); i++) {
+        vkDestroyFramebuffer(device, vk_framebuffers[i], nullptr);
+    }
+    vkDestroyRenderPass(device, vk_render_pass, nullptr);
+}
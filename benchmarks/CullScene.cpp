@@ -0,0 +1,247 @@
+/* CULL SCENE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 18:05:40
+ * Last edited:
+ *   18/10/2021, 18:05:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The culling scene, which spins a camera in the middle of a field of
+ *   objects and culls and draws them with the IndirectRenderer every
+ *   frame, both with the culling shader and on the CPU.
+**/
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/ext/matrix_clip_space.hpp"
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "vulkanic/swapchain/OffscreenTarget.hpp"
+#include "rendering/IndirectRenderer.hpp"
+
+#include "Benchmarks.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* The number of different meshes in the field. Mesh m has 36 * (m + 1) indices, which directly follow those of mesh m - 1. */
+static constexpr const uint32_t n_meshes = 16;
+/* The number of indices of all meshes together. */
+static constexpr const uint32_t n_indices = 36 * n_meshes * (n_meshes + 1) / 2;
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Fills the given renderer with objects that are scattered randomly (but reproducibly) through a cube around the origin. */
+static void fill_field(IndirectRenderer& renderer, uint32_t n_objects) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+    std::uniform_int_distribution<uint32_t> mesh(0, n_meshes - 1);
+    for (uint32_t i = 0; i < n_objects; i++) {
+        uint32_t m = mesh(rng);
+        renderer.add_object(IndirectObject{ glm::vec3(position(rng), position(rng), position(rng)), radius(rng), 36 * (m + 1), 36 * m * (m + 1) / 2, 0, 0 });
+    }
+}
+
+/* Returns the view-projection matrix of the camera in the given frame, which turns around the y-axis in the middle of the field. */
+static glm::mat4 camera(uint32_t frame, const VkExtent2D& extent) {
+    float angle = glm::radians(static_cast<float>(frame % 360));
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(glm::sin(angle), 0.0f, -glm::cos(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), static_cast<float>(extent.width) / static_cast<float>(extent.height), 0.1f, 1000.0f);
+    projection[1][1] *= -1.0f;
+    return projection * view;
+}
+
+
+
+/* Everything the objects are drawn with: every index refers to a corner of the small triangle of triangle.vert, so each object draws a few of those. */
+struct Pass {
+    /* The render pass to draw in. */
+    VkRenderPass vk_render_pass;
+    /* The framebuffers of the target's images. */
+    Tools::Array<VkFramebuffer> vk_framebuffers;
+    /* The layout of the pipeline, which has the colour as fragment push constant. */
+    VkPipelineLayout vk_pipeline_layout;
+    /* The pipeline to draw with. */
+    VkPipeline vk_pipeline;
+    /* The index buffer with the indices of all meshes. */
+    VkBuffer vk_index_buffer;
+    /* The memory that backs the index buffer. */
+    VkDeviceMemory vk_memory;
+    /* The memory type of the memory. */
+    uint32_t memory_type;
+    /* The size of the memory. */
+    VkDeviceSize memory_size;
+};
+
+/* Creates everything the objects are drawn with for the given target. */
+static Pass create_pass(const Device& device, const Vulkanic::OffscreenTarget& target, const std::string& shader_dir) {
+    Pass pass;
+    pass.vk_render_pass = Benchmarks::create_render_pass(device, target.format());
+    pass.vk_framebuffers = Benchmarks::create_framebuffers(device, pass.vk_render_pass, target);
+    pass.vk_pipeline_layout = Benchmarks::create_pipeline_layout(device, VK_NULL_HANDLE, 4 * sizeof(float));
+    pass.vk_pipeline = Benchmarks::create_pipeline(device, pass.vk_render_pass, pass.vk_pipeline_layout, shader_dir, "push.frag.spv", target.extent());
+
+    // Create the index buffer
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = n_indices * sizeof(uint32_t);
+    buffer_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(device, &buffer_info, nullptr, &pass.vk_index_buffer)) != VK_SUCCESS) {
+        logger.fatal("Could not create index buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Back it with host-visible memory, so the indices can be written directly
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, pass.vk_index_buffer, &requirements);
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = device.get_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if ((vk_result = device.get_memory_budget().allocate(allocate_info, pass.vk_memory)) != VK_SUCCESS) {
+        logger.fatal("Could not allocate index buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    pass.memory_type = allocate_info.memoryTypeIndex;
+    pass.memory_size = allocate_info.allocationSize;
+    if ((vk_result = vkBindBufferMemory(device, pass.vk_index_buffer, pass.vk_memory, 0)) != VK_SUCCESS) {
+        logger.fatal("Could not bind index buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Every mesh is a list of triangles
+    void* mapped;
+    if ((vk_result = device.get_dispatch().vkMapMemory(device, pass.vk_memory, 0, VK_WHOLE_SIZE, 0, &mapped)) != VK_SUCCESS) {
+        logger.fatal("Could not map index buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    uint32_t* indices = static_cast<uint32_t*>(mapped);
+    for (uint32_t i = 0; i < n_indices; i++) {
+        indices[i] = i % 3;
+    }
+    device.get_dispatch().vkUnmapMemory(device, pass.vk_memory);
+
+    return pass;
+}
+
+/* Destroys the given pass again. Assumes the device is idle. */
+static void destroy_pass(const Device& device, const Pass& pass) {
+    vkDestroyBuffer(device, pass.vk_index_buffer, nullptr);
+    device.get_memory_budget().free(pass.vk_memory, pass.memory_type, pass.memory_size);
+    vkDestroyPipeline(device, pass.vk_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pass.vk_pipeline_layout, nullptr);
+    for (uint32_t i = 0; i < pass.vk_framebuffers.size(); i++) {
+        vkDestroyFramebuffer(device, pass.vk_framebuffers[i], nullptr);
+    }
+    vkDestroyRenderPass(device, pass.vk_render_pass, nullptr);
+}
+
+
+
+/* Culls and draws the field for the given number of frames with the given renderer, and prints how long it took and how many draw calls it needed.
+ * @param device The Device to run on.
+ * @param target The target that paces the frames.
+ * @param pass What the objects are drawn with.
+ * @param renderer The renderer with the field in it.
+ * @param n_frames The number of frames to run for. */
+static void run(const Device& device, Vulkanic::OffscreenTarget& target, const Pass& pass, IndirectRenderer& renderer, uint32_t n_frames) {
+    const DeviceDispatch& dispatch = device.get_dispatch();
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkClearValue clear_value = {};
+    VkRenderPassBeginInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = pass.vk_render_pass;
+    render_pass_info.renderArea = { { 0, 0 }, target.extent() };
+    render_pass_info.clearValueCount = 1;
+    render_pass_info.pClearValues = &clear_value;
+    float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    double record_time = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t f = 0; f < n_frames; f++) {
+        // Wait for the frame and start it
+        uint32_t image_index;
+        target.acquire(image_index);
+        renderer.begin_frame(target.current_frame());
+
+        // Record the culling (on the CPU, this is where all the work happens) and then the draws of the visible objects
+        VkCommandBuffer vk_command_buffer = device.get_command_pool_manager().allocate(Vulkanic::QueueType::graphics);
+        VkResult vk_result;
+        if ((vk_result = dispatch.vkBeginCommandBuffer(vk_command_buffer, &begin_info)) != VK_SUCCESS) {
+            logger.fatal("Could not begin command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        std::chrono::steady_clock::time_point record_start = std::chrono::steady_clock::now();
+        renderer.cull(vk_command_buffer, camera(f, target.extent()));
+        render_pass_info.framebuffer = pass.vk_framebuffers[image_index];
+        dispatch.vkCmdBeginRenderPass(vk_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+        dispatch.vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.vk_pipeline);
+        dispatch.vkCmdPushConstants(vk_command_buffer, pass.vk_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(color), color);
+        dispatch.vkCmdBindIndexBuffer(vk_command_buffer, pass.vk_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+        renderer.draw(vk_command_buffer);
+        dispatch.vkCmdEndRenderPass(vk_command_buffer);
+        record_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - record_start).count();
+        if ((vk_result = dispatch.vkEndCommandBuffer(vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatal("Could not end command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // Submit it and move to the next frame
+        device.get_submitter(Vulkanic::QueueType::graphics).enqueue(vk_command_buffer);
+        device.get_submitter(Vulkanic::QueueType::graphics).flush(target.in_flight());
+        target.present(image_index);
+    }
+    dispatch.vkDeviceWaitIdle(device);
+    double total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Report
+    const IndirectStatistics& statistics = renderer.statistics();
+    cout << "  " << (renderer.gpu_culling() ? "GPU" : "CPU") << " culling: " << (total_time * 1000.0 / n_frames) << " ms per frame (" << (record_time * 1000.0 / n_frames) << " ms recording), " << (statistics.n_draw_calls / n_frames) << " draw calls per frame";
+    if (!renderer.gpu_culling() && statistics.n_cpu_frames > 0) {
+        cout << ", " << (statistics.n_cpu_visible / statistics.n_cpu_frames) << "/" << renderer.size() << " objects visible";
+    }
+    cout << endl;
+}
+
+
+
+
+
+/***** SCENE *****/
+/* Culls and draws a field of objects with the IndirectRenderer, once with the culling shader and once on the CPU. */
+void Benchmarks::cull_scene(const Device& device, const Settings& settings) {
+    Vulkanic::OffscreenTarget target(device, { 1280, 720 });
+    Pass pass = create_pass(device, target, settings.shader_dir);
+
+    // Cull on the GPU first, if the device can
+    {
+        IndirectRenderer renderer(device, settings.n_objects, target.n_frames(), settings.shader_dir + "/cull.comp.spv");
+        if (renderer.gpu_culling()) {
+            fill_field(renderer, settings.n_objects);
+            run(device, target, pass, renderer, settings.n_frames);
+        } else {
+            cout << "  GPU culling: not supported by this device" << endl;
+        }
+    }
+
+    // Then on the CPU
+    {
+        IndirectRenderer renderer(device, settings.n_objects, target.n_frames(), "");
+        fill_field(renderer, settings.n_objects);
+        run(device, target, pass, renderer, settings.n_frames);
+    }
+
+    // Clean up
+    destroy_pass(device, pass);
+}
@@ -0,0 +1,136 @@
+/* RECORDING SCENE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 20:01:13
+ * Last edited:
+ *   18/10/2021, 20:01:13
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The recording scene, which records a lot of small draws with the
+ *   ParallelRecorder every frame, once for every number of threads from
+ *   one up to the number of hardware threads, and prints how long the
+ *   recording took for each.
+**/
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "rendering/ParallelRecorder.hpp"
+
+#include "Benchmarks.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** HELPER FUNCTIONS *****/
+/* Records the given number of draws per frame with the given recorder for the given number of frames, and prints how long the recording took.
+ * @param device The Device to run on.
+ * @param target The target that paces the frames.
+ * @param recorder The recorder to record with.
+ * @param vk_render_pass The render pass to draw in.
+ * @param vk_framebuffers The framebuffers of the target's images.
+ * @param vk_pipeline The pipeline to draw with.
+ * @param vk_pipeline_layout The layout of the pipeline, which has the colour of each draw as fragment push constant.
+ * @param n_draws The number of draws per frame.
+ * @param n_frames The number of frames to run for. */
+static void run(const Device& device, Vulkanic::OffscreenTarget& target, ParallelRecorder& recorder, VkRenderPass vk_render_pass, const Tools::Array<VkFramebuffer>& vk_framebuffers, VkPipeline vk_pipeline, VkPipelineLayout vk_pipeline_layout, uint32_t n_draws, uint32_t n_frames) {
+    const DeviceDispatch& dispatch = device.get_dispatch();
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkClearValue clear_value = {};
+    VkRenderPassBeginInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = vk_render_pass;
+    render_pass_info.renderArea = { { 0, 0 }, target.extent() };
+    render_pass_info.clearValueCount = 1;
+    render_pass_info.pClearValues = &clear_value;
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = vk_render_pass;
+    inheritance.subpass = 0;
+
+    // Every chunk binds the pipeline itself, and then draws its part of the list with a colour each
+    ParallelRecorder::record_t record_chunk = [&](VkCommandBuffer vk_command_buffer, uint32_t first, uint32_t count) {
+        dispatch.vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+        for (uint32_t d = first; d < first + count; d++) {
+            float color[4] = { static_cast<float>(d % 16) / 15.0f, static_cast<float>((d / 16) % 16) / 15.0f, 0.5f, 1.0f };
+            dispatch.vkCmdPushConstants(vk_command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(color), color);
+            dispatch.vkCmdDraw(vk_command_buffer, 3, 1, 0, 0);
+        }
+    };
+
+    RecorderStatistics before = recorder.statistics();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t f = 0; f < n_frames; f++) {
+        // Wait for the frame and start it
+        uint32_t image_index;
+        target.acquire(image_index);
+
+        // Record the draws in the secondary command buffers of the recorder
+        VkCommandBuffer vk_command_buffer = device.get_command_pool_manager().allocate(Vulkanic::QueueType::graphics);
+        VkResult vk_result;
+        if ((vk_result = dispatch.vkBeginCommandBuffer(vk_command_buffer, &begin_info)) != VK_SUCCESS) {
+            logger.fatal("Could not begin command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        render_pass_info.framebuffer = vk_framebuffers[image_index];
+        inheritance.framebuffer = vk_framebuffers[image_index];
+        dispatch.vkCmdBeginRenderPass(vk_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recorder.record(vk_command_buffer, Vulkanic::QueueType::graphics, &inheritance, n_draws, record_chunk);
+        dispatch.vkCmdEndRenderPass(vk_command_buffer);
+        if ((vk_result = dispatch.vkEndCommandBuffer(vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatal("Could not end command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // Submit it and move to the next frame
+        device.get_submitter(Vulkanic::QueueType::graphics).enqueue(vk_command_buffer);
+        device.get_submitter(Vulkanic::QueueType::graphics).flush(target.in_flight());
+        target.present(image_index);
+    }
+    dispatch.vkDeviceWaitIdle(device);
+    double total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Report, only counting the frames of this run
+    const RecorderStatistics& after = recorder.statistics();
+    double record_time = static_cast<double>(after.record_time - before.record_time) / 1000000000.0;
+    uint64_t n_chunks = after.n_chunks - before.n_chunks;
+    uint64_t n_worker_chunks = after.n_worker_chunks - before.n_worker_chunks;
+    cout << "  " << (recorder.n_workers() + 1) << " thread(s): " << (record_time * 1000.0 / n_frames) << " ms recording per frame, " << (total_time * 1000.0 / n_frames) << " ms per frame (" << n_worker_chunks << "/" << n_chunks << " chunks on the workers)" << endl;
+}
+
+
+
+
+
+/***** SCENE *****/
+/* Records many small draws with the ParallelRecorder, once for every number of threads. */
+void Benchmarks::recording_scene(const Device& device, const Settings& settings) {
+    Vulkanic::OffscreenTarget target(device, { 1280, 720 });
+    VkRenderPass vk_render_pass = Benchmarks::create_render_pass(device, target.format());
+    Tools::Array<VkFramebuffer> vk_framebuffers = Benchmarks::create_framebuffers(device, vk_render_pass, target);
+    VkPipelineLayout vk_pipeline_layout = Benchmarks::create_pipeline_layout(device, VK_NULL_HANDLE, 4 * sizeof(float));
+    VkPipeline vk_pipeline = Benchmarks::create_pipeline(device, vk_render_pass, vk_pipeline_layout, settings.shader_dir, "push.frag.spv", target.extent());
+
+    // Sweep from only the calling thread to all hardware threads
+    uint32_t n_threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    for (uint32_t n_workers = 0; n_workers < n_threads; n_workers++) {
+        ParallelRecorder recorder(device, n_workers);
+        run(device, target, recorder, vk_render_pass, vk_framebuffers, vk_pipeline, vk_pipeline_layout, settings.n_objects, settings.n_frames);
+    }
+
+    // Clean up
+    vkDestroyPipeline(device, vk_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, vk_pipeline_layout, nullptr);
+    for (uint32_t i = 0; i < vk_framebuffers.size(); i++) {
+        vkDestroyFramebuffer(device, vk_framebuffers[i], nullptr);
+    }
+    vkDestroyRenderPass(device, vk_render_pass, nullptr);
+}
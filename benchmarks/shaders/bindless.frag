@@ -0,0 +1,43 @@
+/* BINDLESS.frag
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:14:22
+ * Last edited:
+ *   18/10/2021, 19:14:22
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The fragment shader of the bindless mode of the bindless scene. Reads
+ *   the colour of the draw from the buffer binding of the BindlessHeap,
+ *   at the index that is pushed for every draw.
+**/
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+
+
+/***** INPUT *****/
+/* All materials, in the buffer binding of the BindlessHeap. */
+layout(std430, set = 0, binding = 1) readonly buffer Material {
+    vec4 color;
+} materials[];
+
+/* The index of the material of this draw, as returned by BindlessHeap::add_buffer(). */
+layout(push_constant) uniform Constants {
+    uint material;
+} constants;
+
+
+
+/***** OUTPUT *****/
+layout(location = 0) out vec4 out_color;
+
+
+
+/***** ENTRY POINT *****/
+void main() {
+    out_color = materials[constants.material].color;
+}
@@ -0,0 +1,37 @@
+/* CLASSIC.frag
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:13:40
+ * Last edited:
+ *   18/10/2021, 19:13:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The fragment shader of the classic mode of the bindless scene. Reads
+ *   the colour of the draw from a storage buffer in its own descriptor
+ *   set, which is bound anew for every draw.
+**/
+
+#version 450
+
+
+
+/***** INPUT *****/
+/* The material of this draw. */
+layout(std430, set = 0, binding = 0) readonly buffer Material {
+    vec4 color;
+} material;
+
+
+
+/***** OUTPUT *****/
+layout(location = 0) out vec4 out_color;
+
+
+
+/***** ENTRY POINT *****/
+void main() {
+    out_color = material.color;
+}
@@ -0,0 +1,37 @@
+/* PUSH.frag
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 20:02:48
+ * Last edited:
+ *   18/10/2021, 20:02:48
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The fragment shader of the recording scene. Takes the colour of each
+ *   draw from the push constants, so that the draws don't need any
+ *   descriptor sets.
+**/
+
+#version 450
+
+
+
+/***** INPUT *****/
+/* The colour of this draw. */
+layout(push_constant) uniform Constants {
+    vec4 color;
+} constants;
+
+
+
+/***** OUTPUT *****/
+layout(location = 0) out vec4 out_color;
+
+
+
+/***** ENTRY POINT *****/
+void main() {
+    out_color = constants.color;
+}
@@ -0,0 +1,34 @@
+/* TRIANGLE.vert
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:12:03
+ * Last edited:
+ *   18/10/2021, 19:12:03
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   The vertex shader of the draw scenes. Draws a single small triangle
+ *   in the middle of the screen without any vertex buffer, so that the
+ *   scene measures the cost of the draws themselves.
+**/
+
+#version 450
+
+
+
+/***** CONSTANTS *****/
+/* The corners of the triangle, in clip space. */
+const vec2 positions[3] = vec2[](
+    vec2( 0.00, -0.05),
+    vec2( 0.05,  0.05),
+    vec2(-0.05,  0.05)
+);
+
+
+
+/***** ENTRY POINT *****/
+void main() {
+    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+}
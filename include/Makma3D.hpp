@@ -23,7 +23,18 @@
 #include "window/Window.hpp"
 #include "window/Monitor.hpp"
 
+#include "vulkanic/swapchain/OffscreenTarget.hpp"
+
 #include "gpu/PhysicalDeviceType.hpp"
 #include "gpu/PhysicalDevice.hpp"
+#include "gpu/Device.hpp"
+#include "gpu/AsyncCompute.hpp"
+
+#include "memory/UploadManager.hpp"
+
+#include "rendering/ResourceUsage.hpp"
+#include "rendering/RenderGraph.hpp"
+#include "rendering/IndirectRenderer.hpp"
+#include "rendering/ParallelRecorder.hpp"
 
 #endif
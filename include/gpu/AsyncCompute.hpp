@@ -0,0 +1,72 @@
+/* ASYNC COMPUTE.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 16:02:09
+ * Last edited:
+ *   17/10/2021, 16:02:09
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the AsyncCompute class, which schedules compute work on the
+ *   compute queues of a Device so that it overlaps with graphics work,
+ *   and lets graphics submissions wait for it where needed.
+**/
+
+#ifndef GPU_ASYNC_COMPUTE_HPP
+#define GPU_ASYNC_COMPUTE_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "Device.hpp"
+#include "Timeline.hpp"
+#include "SubmitCoalescer.hpp"
+
+namespace Makma3D {
+    /* The AsyncCompute class, which runs compute work alongside the graphics work of a Device. */
+    class AsyncCompute {
+    public:
+        /* Channel name for the AsyncCompute class. */
+        static constexpr const char* channel = "AsyncCompute";
+
+        /* The Device on which we schedule the work. */
+        const Makma3D::Device& device;
+
+    private:
+        /* The point at which the last kicked-off batch of compute work is done. */
+        SyncPoint _last;
+        /* Whether the compute work runs on other queues than the graphics work, i.e., whether it can actually overlap. */
+        bool _overlaps;
+
+    public:
+        /* Constructor for the AsyncCompute class.
+         * @param device The Device on which to schedule the work. */
+        AsyncCompute(const Makma3D::Device& device);
+
+        /* Schedules the given compute submission for the next kick(). Can be called from any thread.
+         * @param submission The submission to schedule. Its command buffers must be allocated for the compute queue family. */
+        inline void schedule(Submission&& submission) { this->device.get_submitter(Vulkanic::QueueType::compute).enqueue(std::move(submission)); }
+        /* Schedules a single compute command buffer for the next kick(). Can be called from any thread.
+         * @param vk_command_buffer The command buffer to execute. Must be allocated for the compute queue family.
+         * @param after A point on another queue that must be reached before the compute work starts, e.g., the graphics work that produces its input.
+         * @param stage The pipeline stage at which to wait for that point. */
+        void schedule(VkCommandBuffer vk_command_buffer, const SyncPoint& after = null_sync_point, VkPipelineStageFlags stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        /* Submits all scheduled compute work. Should be called once per frame, from one thread at a time, before the graphics work that depends on it is flushed.
+         * @param vk_fence A fence to signal once the work is done, or nullptr.
+         * @returns The SyncPoint that is reached once the work is done. */
+        SyncPoint kick(VkFence vk_fence = nullptr);
+        /* Makes the given graphics submission wait for the last kicked-off compute work, if it isn't done already.
+         * @param submission The submission that consumes the results of the compute work.
+         * @param stage The pipeline stage at which the results are needed, so earlier stages can still overlap with the compute work. */
+        void depend(Submission& submission, VkPipelineStageFlags stage) const;
+
+        /* Returns the point at which the last kicked-off compute work is done. */
+        inline const SyncPoint& last() const { return this->_last; }
+        /* Returns whether the compute work runs on other queues than the graphics work. If not, it is still correct, but runs in series with it. */
+        inline bool overlaps() const { return this->_overlaps; }
+
+    };
+}
+
+#endif
@@ -0,0 +1,183 @@
+/* BINDLESS HEAP.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 11:52:04
+ * Last edited:
+ *   18/10/2021, 11:52:04
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the BindlessHeap class, which keeps all sampled images,
+ *   storage buffers and samplers of a Device in one large
+ *   update-after-bind descriptor set. Shaders index into it with the
+ *   integer of a generational handle, so a frame only binds one set.
+**/
+
+#ifndef GPU_BINDLESS_HEAP_HPP
+#define GPU_BINDLESS_HEAP_HPP
+
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "DeviceDispatch.hpp"
+#include "DeletionQueue.hpp"
+
+namespace Makma3D {
+    /* The kinds of resources that can be stored in the BindlessHeap. Their values are also the binding indices in the set. */
+    enum class BindlessType {
+        /* Sampled images (binding 0). */
+        image = 0,
+        /* Storage buffers (binding 1). */
+        buffer = 1,
+        /* Samplers (binding 2). */
+        sampler = 2
+    };
+    /* The number of BindlessTypes. */
+    static constexpr const uint32_t n_bindless_types = 3;
+    /* Maps BindlessType enum values to readable strings. */
+    static const char* bindless_type_names[] = {
+        "image",
+        "buffer",
+        "sampler"
+    };
+
+    /* A handle to a resource in the BindlessHeap. */
+    struct BindlessHandle {
+        /* The index of the resource in its binding, which is what shaders use to access it. */
+        uint32_t index;
+        /* The generation of the slot when the handle was given out, used to detect stale handles. Zero for the null handle. */
+        uint32_t generation;
+        /* The kind of resource. */
+        BindlessType type;
+
+        /* Returns whether this handle was ever given out, i.e., whether it isn't the null handle. */
+        inline bool valid() const { return this->generation != 0; }
+    };
+    /* A handle that never refers to any resource. */
+    static constexpr const BindlessHandle null_bindless_handle = { 0, 0, BindlessType::image };
+
+    /* Counts what the BindlessHeap did. */
+    struct BindlessStatistics {
+        /* The number of descriptors that were written. */
+        uint64_t n_writes;
+        /* The number of slots that were reused after the GPU was done with them. */
+        uint64_t n_recycled;
+        /* The highest number of slots in use at the same time, per BindlessType. */
+        uint32_t peak[n_bindless_types];
+    };
+
+
+
+    /* The BindlessHeap class, which manages one big descriptor set with all resources of a Device. */
+    class BindlessHeap {
+    public:
+        /* Channel name for the BindlessHeap class. */
+        static constexpr const char* channel = "BindlessHeap";
+        /* The default number of slots per BindlessType, before clamping them to the device limits. */
+        static constexpr const uint32_t default_capacities[n_bindless_types] = { 16384, 16384, 1024 };
+
+    private:
+        /* The slots of a single BindlessType. */
+        struct Slots {
+            /* The current generation of each slot that was ever used. */
+            Tools::Array<uint32_t> generations;
+            /* The slots that can be handed out again. */
+            Tools::Array<uint32_t> free;
+            /* The maximum number of slots. */
+            uint32_t capacity;
+            /* The number of slots currently in use. */
+            uint32_t n_used;
+        };
+
+        /* The VkDevice on which the heap lives. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The DeletionQueue in which removed slots wait for the GPU. */
+        DeletionQueue& deletion_queue;
+
+        /* The layout of the set. */
+        VkDescriptorSetLayout vk_descriptor_set_layout;
+        /* The pool from which the set is allocated. */
+        VkDescriptorPool vk_descriptor_pool;
+        /* The one descriptor set. */
+        VkDescriptorSet vk_descriptor_set;
+
+        /* The slots of each BindlessType. */
+        Tools::Array<Slots> slots;
+        /* The statistics of this heap. */
+        BindlessStatistics _statistics;
+        /* Lock for the slots and for writing the set. */
+        std::mutex lock;
+
+
+        /* Takes a free slot of the given type. Assumes the lock is taken.
+         * @param type The kind of resource to allocate a slot for.
+         * @returns A handle to the new slot. */
+        BindlessHandle allocate(BindlessType type);
+
+    public:
+        /* Constructor for the BindlessHeap class. The Device should have the descriptor_indexing feature enabled.
+         * @param vk_device The VkDevice on which to create the heap.
+         * @param dispatch The functions of the device. Has to outlive the BindlessHeap.
+         * @param deletion_queue The DeletionQueue in which removed slots wait for the GPU. Has to outlive the heap.
+         * @param limits The limits of the physical device, which cap the capacities.
+         * @param capacities The requested number of slots per BindlessType. */
+        BindlessHeap(VkDevice vk_device, const DeviceDispatch& dispatch, DeletionQueue& deletion_queue, const VkPhysicalDeviceLimits& limits, const uint32_t capacities[n_bindless_types] = BindlessHeap::default_capacities);
+        /* Copy constructor for the BindlessHeap class, which is deleted. */
+        BindlessHeap(const BindlessHeap& other) = delete;
+        /* Move constructor for the BindlessHeap class, which is deleted. */
+        BindlessHeap(BindlessHeap&& other) = delete;
+        /* Destructor for the BindlessHeap class. Assumes the device is idle. */
+        ~BindlessHeap();
+
+        /* Adds a sampled image to the heap. Can be called from any thread.
+         * @param vk_image_view The view of the image.
+         * @param vk_image_layout The layout the image will be in when shaders access it.
+         * @returns The handle of the image, whose index the shaders use. */
+        BindlessHandle add_image(VkImageView vk_image_view, VkImageLayout vk_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        /* Adds (a region of) a storage buffer to the heap. Can be called from any thread.
+         * @param vk_buffer The buffer.
+         * @param offset The offset of the region in the buffer.
+         * @param range The size of the region, or VK_WHOLE_SIZE for the rest of the buffer.
+         * @returns The handle of the buffer, whose index the shaders use. */
+        BindlessHandle add_buffer(VkBuffer vk_buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        /* Adds a sampler to the heap. Can be called from any thread.
+         * @param vk_sampler The sampler.
+         * @returns The handle of the sampler, whose index the shaders use. */
+        BindlessHandle add_sampler(VkSampler vk_sampler);
+        /* Removes the resource with the given handle from the heap. The handle becomes stale immediately, but its slot is only reused once the DeletionQueue sees that all work submitted so far is done. Can be called from any thread.
+         * @param handle The handle of the resource to remove. */
+        void remove(const BindlessHandle& handle);
+        /* Returns whether the given handle still refers to a resource in the heap. */
+        bool is_live(const BindlessHandle& handle);
+
+        /* Binds the heap's set to the given command buffer. This is the only descriptor set bind a pass needs.
+         * @param vk_command_buffer The command buffer to bind it on.
+         * @param vk_bind_point Whether to bind it for graphics or compute pipelines.
+         * @param vk_pipeline_layout The layout of the pipeline, which should include the heap's layout at the given set index.
+         * @param set_index The index of the set in the pipeline layout. */
+        void bind(VkCommandBuffer vk_command_buffer, VkPipelineBindPoint vk_bind_point, VkPipelineLayout vk_pipeline_layout, uint32_t set_index = 0) const;
+
+        /* Returns the number of slots for the given BindlessType. */
+        inline uint32_t capacity(BindlessType type) const { return this->slots[(uint32_t) type].capacity; }
+        /* Returns the statistics of this heap. */
+        inline const BindlessStatistics& statistics() const { return this->_statistics; }
+        /* Returns the layout of the heap's set, for use in pipeline layouts. */
+        inline VkDescriptorSetLayout layout() const { return this->vk_descriptor_set_layout; }
+        /* Returns the heap's set. */
+        inline VkDescriptorSet set() const { return this->vk_descriptor_set; }
+
+        /* Copy assignment operator for the BindlessHeap class, which is deleted. */
+        BindlessHeap& operator=(const BindlessHeap& other) = delete;
+        /* Move assignment operator for the BindlessHeap class, which is deleted. */
+        BindlessHeap& operator=(BindlessHeap&& other) = delete;
+
+    };
+}
+
+#endif
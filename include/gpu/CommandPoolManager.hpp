@@ -0,0 +1,117 @@
+/* COMMAND POOL MANAGER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   15/10/2021, 14:21:50
+ * Last edited:
+ *   15/10/2021, 14:21:50
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the CommandPoolManager class, which manages one command pool
+ *   per thread, per queue family and per frame-in-flight, so that
+ *   threads can record command buffers without locking.
+**/
+
+#ifndef GPU_COMMAND_POOL_MANAGER_HPP
+#define GPU_COMMAND_POOL_MANAGER_HPP
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "arrays/StackArray.hpp"
+
+#include "QueueType.hpp"
+#include "DeviceDispatch.hpp"
+
+namespace Makma3D {
+    /* The CommandPoolManager class, which hands out command buffers from per-thread, per-family, per-frame command pools and recycles them in bulk. */
+    class CommandPoolManager {
+    public:
+        /* Channel name for the CommandPoolManager class. */
+        static constexpr const char* channel = "CommandPoolManager";
+
+    private:
+        /* A single command pool with the command buffers allocated from it. */
+        struct Pool {
+            /* The Vulkan command pool. */
+            VkCommandPool vk_command_pool;
+            /* The primary command buffers that are ready to be handed out. */
+            Tools::Array<VkCommandBuffer> free_primary;
+            /* The secondary command buffers that are ready to be handed out. */
+            Tools::Array<VkCommandBuffer> free_secondary;
+            /* The primary command buffers that have been handed out this frame. */
+            Tools::Array<VkCommandBuffer> used_primary;
+            /* The secondary command buffers that have been handed out this frame. */
+            Tools::Array<VkCommandBuffer> used_secondary;
+        };
+        /* The pools of a single thread, indexed by frame first and then by queue family slot. */
+        using ThreadPools = Tools::Array<Pool>;
+
+        /* The VkDevice on which we allocate the pools. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The unique ID of this manager, used to find the calling thread's pools. */
+        uint64_t id;
+        /* The unique queue families for which we create pools. */
+        Tools::Array<uint32_t> families;
+        /* Maps each QueueType to the index of its family in the list of unique families. */
+        Tools::StackArray<uint32_t, Vulkanic::n_queue_types> type_slots;
+        /* The number of frames that can be in flight. */
+        uint32_t _n_frames;
+        /* The frame that is currently being recorded. */
+        uint32_t _current_frame;
+
+        /* The pools of each thread that has allocated from us. Kept by pointer rather than by thread ID, since the OS may reuse the ID of a thread that exited while we still have to reset and destroy its pools. */
+        Tools::Array<ThreadPools*> threads;
+        /* Lock that protects the threads map. Only taken the first time a thread allocates, and when a frame is reset. */
+        std::mutex threads_lock;
+
+
+        /* Returns the pools of the calling thread, creating them if this is the first time the thread allocates. */
+        ThreadPools& get_thread_pools();
+
+    public:
+        /* Constructor for the CommandPoolManager class.
+         * @param vk_device The VkDevice on which we allocate the pools.
+         * @param dispatch The functions of the device. Has to outlive the CommandPoolManager.
+         * @param queue_families The queue family that is used for each QueueType.
+         * @param n_frames The number of frames that can be in flight. */
+        CommandPoolManager(VkDevice vk_device, const DeviceDispatch& dispatch, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, uint32_t n_frames);
+        /* Copy constructor for the CommandPoolManager class, which is deleted. */
+        CommandPoolManager(const CommandPoolManager& other) = delete;
+        /* Move constructor for the CommandPoolManager class, which is deleted. */
+        CommandPoolManager(CommandPoolManager&& other) = delete;
+        /* Destructor for the CommandPoolManager class. */
+        ~CommandPoolManager();
+
+        /* Returns a command buffer for the current frame from the calling thread's pool for the given queue type. Recycled buffers are reused before new ones are allocated.
+         * The command buffer is valid until the next time this frame is reset, and does not have to be freed.
+         * @param queue_type The type of queue on which the command buffer will be submitted.
+         * @param level The level of the command buffer (primary or secondary).
+         * @returns A command buffer that is in the initial state. */
+        VkCommandBuffer allocate(Vulkanic::QueueType queue_type, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        /* Moves to the given frame, resetting all of its pools (of all threads) in bulk and making their command buffers available again.
+         * Should only be called once the fence of that frame's last submission has been signalled, and while no thread is recording.
+         * @param frame The index of the frame to start. */
+        void begin_frame(uint32_t frame);
+
+        /* Returns the number of frames that can be in flight. */
+        inline uint32_t n_frames() const { return this->_n_frames; }
+        /* Returns the frame that is currently being recorded. */
+        inline uint32_t current_frame() const { return this->_current_frame; }
+
+        /* Copy assignment operator for the CommandPoolManager class, which is deleted. */
+        CommandPoolManager& operator=(const CommandPoolManager& other) = delete;
+        /* Move assignment operator for the CommandPoolManager class, which is deleted. */
+        CommandPoolManager& operator=(CommandPoolManager&& other) = delete;
+
+    };
+}
+
+#endif
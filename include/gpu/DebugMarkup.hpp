@@ -0,0 +1,111 @@
+/* DEBUG MARKUP.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 22:03:40
+ * Last edited:
+ *   18/10/2021, 22:03:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DebugMarkup class, which gives the Vulkan objects of a
+ *   Device readable names and wraps regions of command buffers in
+ *   labels, so that validation messages and GPU captures refer to engine
+ *   concepts instead of raw handles. Compiles to nothing in release
+ *   builds.
+**/
+
+#ifndef GPU_DEBUG_MARKUP_HPP
+#define GPU_DEBUG_MARKUP_HPP
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "vulkanic/instance/Instance.hpp"
+
+namespace Makma3D {
+    /* The DebugMarkup class, which names the objects of a device and labels its command buffers if VK_EXT_debug_utils is enabled. */
+    class DebugMarkup {
+    public:
+        /* Channel name for the DebugMarkup class. */
+        static constexpr const char* channel = "DebugMarkup";
+
+    private:
+        /* The VkDevice whose objects we name. */
+        VkDevice vk_device;
+        /* The debug utils functions, or all nullptrs if the extension isn't enabled. */
+        Vulkanic::DebugUtilsFunctions functions;
+
+        #ifndef NDEBUG
+        /* Gives the object with the given type and handle the given name. */
+        void set_name(VkObjectType object_type, uint64_t handle, const std::string& name) const;
+        #else
+        /* Gives the object with the given type and handle the given name; a no-op in release builds. */
+        inline void set_name(VkObjectType, uint64_t, const std::string&) const {}
+        #endif
+
+    public:
+        /* Constructor for the DebugMarkup class.
+         * @param vk_device The VkDevice whose objects we name.
+         * @param functions The debug utils functions of the instance, or nullptr if the extension isn't enabled, in which case nothing is named or labelled. */
+        DebugMarkup(VkDevice vk_device, const Vulkanic::DebugUtilsFunctions* functions);
+
+        /* Names the given device. */
+        inline void name(VkDevice vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_DEVICE, (uint64_t) vk_handle, name); }
+        /* Names the given queue. */
+        inline void name(VkQueue vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_QUEUE, (uint64_t) vk_handle, name); }
+        /* Names the given command buffer. */
+        inline void name(VkCommandBuffer vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t) vk_handle, name); }
+        /* Names the given buffer. */
+        inline void name(VkBuffer vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_BUFFER, (uint64_t) vk_handle, name); }
+        /* Names the given image. */
+        inline void name(VkImage vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_IMAGE, (uint64_t) vk_handle, name); }
+        /* Names the given image view. */
+        inline void name(VkImageView vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t) vk_handle, name); }
+        /* Names the given device memory. */
+        inline void name(VkDeviceMemory vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t) vk_handle, name); }
+        /* Names the given pipeline. */
+        inline void name(VkPipeline vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_PIPELINE, (uint64_t) vk_handle, name); }
+        /* Names the given pipeline cache. */
+        inline void name(VkPipelineCache vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_PIPELINE_CACHE, (uint64_t) vk_handle, name); }
+        /* Names the given shader module. */
+        inline void name(VkShaderModule vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t) vk_handle, name); }
+        /* Names the given pipeline layout. */
+        inline void name(VkPipelineLayout vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t) vk_handle, name); }
+        /* Names the given descriptor set layout. */
+        inline void name(VkDescriptorSetLayout vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t) vk_handle, name); }
+        /* Names the given descriptor pool. */
+        inline void name(VkDescriptorPool vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t) vk_handle, name); }
+        /* Names the given query pool. */
+        inline void name(VkQueryPool vk_handle, const std::string& name) const { this->set_name(VK_OBJECT_TYPE_QUERY_POOL, (uint64_t) vk_handle, name); }
+
+        #ifndef NDEBUG
+        /* Opens a labelled region on the given command buffer, which has to be closed with end_label() on the same command buffer.
+         * @param vk_command_buffer The command buffer to record the label on.
+         * @param label The name of the region.
+         * @param color The color of the region in capture tools, as RGBA. All zeroes lets the tool decide. */
+        void begin_label(VkCommandBuffer vk_command_buffer, const std::string& label, const float color[4] = nullptr) const;
+        /* Closes the last opened labelled region on the given command buffer. */
+        void end_label(VkCommandBuffer vk_command_buffer) const;
+        /* Inserts a single label on the given command buffer.
+         * @param vk_command_buffer The command buffer to record the label on.
+         * @param label The label.
+         * @param color The color of the label in capture tools, as RGBA. All zeroes lets the tool decide. */
+        void insert_label(VkCommandBuffer vk_command_buffer, const std::string& label, const float color[4] = nullptr) const;
+        #else
+        /* Opens a labelled region on the given command buffer; a no-op in release builds. */
+        inline void begin_label(VkCommandBuffer, const std::string&, const float* = nullptr) const {}
+        /* Closes the last opened labelled region on the given command buffer; a no-op in release builds. */
+        inline void end_label(VkCommandBuffer) const {}
+        /* Inserts a single label on the given command buffer; a no-op in release builds. */
+        inline void insert_label(VkCommandBuffer, const std::string&, const float* = nullptr) const {}
+        #endif
+
+        /* Returns whether objects are actually named and command buffers labelled. */
+        inline bool enabled() const { return this->functions.set_object_name != nullptr; }
+
+    };
+}
+
+#endif
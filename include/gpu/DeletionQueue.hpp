@@ -0,0 +1,108 @@
+/* DELETION QUEUE.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 13:41:07
+ * Last edited:
+ *   19/10/2021, 13:41:07
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DeletionQueue class, which postpones destroying Vulkan
+ *   objects until the GPU is done with the work that may still use them.
+ *   This way, resources can be replaced while frames are in flight
+ *   without idling the device.
+**/
+
+#ifndef GPU_DELETION_QUEUE_HPP
+#define GPU_DELETION_QUEUE_HPP
+
+#include <functional>
+#include <mutex>
+
+#include "arrays/Array.hpp"
+
+#include "Queue.hpp"
+#include "Timeline.hpp"
+
+namespace Makma3D {
+    /* Counts what the DeletionQueue did. */
+    struct DeletionStatistics {
+        /* The number of objects that were retired. */
+        uint64_t n_retired;
+        /* The number of retired objects that were destroyed while the device was still running. */
+        uint64_t n_destroyed;
+        /* The highest number of retired objects that waited for the GPU at the same time. */
+        uint32_t peak;
+    };
+
+
+
+    /* The DeletionQueue class, which destroys retired objects of a Device once the queues are done with them. */
+    class DeletionQueue {
+    public:
+        /* Channel name for the DeletionQueue class. */
+        static constexpr const char* channel = "DeletionQueue";
+
+        /* The function that destroys a retired object. */
+        using destroy_t = std::function<void()>;
+
+    private:
+        /* A retired object that waits for the queues. */
+        struct Retirement {
+            /* The function that destroys the object. */
+            destroy_t destroy;
+            /* For each queue, the value its timeline has to reach before the object can be destroyed. */
+            Tools::Array<uint64_t> values;
+        };
+
+        /* The queues of the device, whose progress tells us when retired objects are unused. */
+        Tools::Array<Queue*> queues;
+        /* The retired objects, oldest first. */
+        Tools::Array<Retirement> retiring;
+        /* The statistics of this queue. */
+        DeletionStatistics _statistics;
+        /* Lock for the retired objects. */
+        std::mutex lock;
+
+
+        /* Queues the given retirement. Assumes the lock is taken. */
+        void push(Retirement&& retirement);
+
+    public:
+        /* Constructor for the DeletionQueue class.
+         * @param queues The queues of the device. They have to outlive the deletion queue. */
+        DeletionQueue(const Tools::Array<Queue*>& queues);
+        /* Copy constructor for the DeletionQueue class, which is deleted. */
+        DeletionQueue(const DeletionQueue& other) = delete;
+        /* Move constructor for the DeletionQueue class, which is deleted. */
+        DeletionQueue(DeletionQueue&& other) = delete;
+        /* Destructor for the DeletionQueue class. Destroys everything that is still retired, so the device has to be idle. */
+        ~DeletionQueue();
+
+        /* Retires an object that may be used by any work submitted so far, on any queue. Can be called from any thread.
+         * @param destroy The function that destroys the object once all of that work is done. */
+        void retire(destroy_t&& destroy);
+        /* Retires an object that was last used by the submission of the given SyncPoint. Can be called from any thread.
+         * Objects are destroyed in the order in which they were retired, so an object never outlives one that was retired before it.
+         * @param last_use The SyncPoint of the last submission that uses the object.
+         * @param destroy The function that destroys the object once that submission is done. */
+        void retire(const SyncPoint& last_use, destroy_t&& destroy);
+        /* Destroys the retired objects that the GPU is done with. Never waits, and should be called once per frame (e.g., when acquiring a swapchain image). */
+        void collect();
+
+        /* Returns the number of retired objects that are waiting for the GPU. */
+        inline uint32_t pending() const { return this->retiring.size(); }
+        /* Returns the statistics of this queue. */
+        inline const DeletionStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the DeletionQueue class, which is deleted. */
+        DeletionQueue& operator=(const DeletionQueue& other) = delete;
+        /* Move assignment operator for the DeletionQueue class, which is deleted. */
+        DeletionQueue& operator=(DeletionQueue&& other) = delete;
+
+    };
+}
+
+#endif
@@ -0,0 +1,179 @@
+/* DESCRIPTOR ALLOCATOR.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 14:05:31
+ * Last edited:
+ *   18/10/2021, 14:05:31
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DescriptorAllocator class, which hands out descriptor
+ *   sets from per-thread, per-frame chains of descriptor pools that grow
+ *   with the observed demand and are reset as a whole. Also caches
+ *   descriptor set layouts by their bindings.
+**/
+
+#ifndef GPU_DESCRIPTOR_ALLOCATOR_HPP
+#define GPU_DESCRIPTOR_ALLOCATOR_HPP
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "DeviceDispatch.hpp"
+
+namespace Makma3D {
+    /* The number of descriptor types the DescriptorAllocator can size its pools for (all types of Vulkan 1.0). */
+    static constexpr const uint32_t n_descriptor_types = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1;
+
+    /* A cached descriptor set layout, as handed out by the DescriptorAllocator. */
+    struct DescriptorLayout {
+        /* The Vulkan layout. */
+        VkDescriptorSetLayout vk_descriptor_set_layout;
+        /* The bindings of the layout, sorted by binding index. */
+        Tools::Array<VkDescriptorSetLayoutBinding> bindings;
+        /* The flags the layout was created with. */
+        VkDescriptorSetLayoutCreateFlags flags;
+        /* The number of descriptors of each type in a set with this layout. */
+        uint32_t descriptor_counts[n_descriptor_types];
+
+        /* Implicitly returns the internal VkDescriptorSetLayout object. */
+        inline operator VkDescriptorSetLayout() const { return this->vk_descriptor_set_layout; }
+    };
+
+    /* Counts what the DescriptorAllocator did. */
+    struct DescriptorStatistics {
+        /* The number of descriptor sets that were allocated. */
+        uint64_t n_sets;
+        /* The number of descriptor pools that were created. */
+        uint64_t n_pools;
+        /* The number of pool resets. */
+        uint64_t n_resets;
+        /* The number of layouts that were created, i.e., the number of cache misses. */
+        uint64_t n_layouts;
+    };
+
+
+
+    /* The DescriptorAllocator class, which hands out short-lived descriptor sets from growable, per-thread pools. It's the classic descriptor path for when the BindlessHeap isn't available. */
+    class DescriptorAllocator {
+    public:
+        /* Channel name for the DescriptorAllocator class. */
+        static constexpr const char* channel = "DescriptorAllocator";
+        /* The number of sets in the first pool of a thread that hasn't allocated anything yet. */
+        static constexpr const uint32_t min_pool_sets = 64;
+        /* The number of sets beyond which a pool chain stops doubling its pool sizes within a frame. */
+        static constexpr const uint32_t max_pool_growth = 4096;
+
+    private:
+        /* A single descriptor pool. */
+        struct Pool {
+            /* The Vulkan descriptor pool. */
+            VkDescriptorPool vk_descriptor_pool;
+            /* The number of sets the pool was created for. */
+            uint32_t max_sets;
+        };
+        /* The number of sets and descriptors that were allocated in a frame. */
+        struct Demand {
+            /* The number of sets. */
+            uint32_t sets;
+            /* The number of descriptors of each type. */
+            uint32_t descriptors[n_descriptor_types];
+        };
+        /* The chain of pools of a single thread in a single frame. */
+        struct FramePools {
+            /* The pools, in the order in which they are used. */
+            Tools::Array<Pool> pools;
+            /* The index of the pool we currently allocate from. */
+            uint32_t current;
+            /* What was allocated since the last reset. */
+            Demand demand;
+            /* What was allocated in the frame before the last reset, which sizes new pools. */
+            Demand last_demand;
+            /* The number of pools created since the last reset. */
+            uint32_t n_created;
+        };
+        /* The pools of a single thread, indexed by frame. */
+        using ThreadPools = Tools::Array<FramePools>;
+
+        /* The VkDevice on which we allocate the pools. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The unique ID of this allocator, used to find the calling thread's pools. */
+        uint64_t id;
+        /* The number of frames that can be in flight. */
+        uint32_t _n_frames;
+        /* The frame that is currently being recorded. */
+        uint32_t _current_frame;
+
+        /* The pools of each thread that has allocated from us. Kept by pointer rather than by thread ID, since the OS may reuse the ID of a thread that exited while we still have to reset and destroy its pools. */
+        Tools::Array<ThreadPools*> threads;
+        /* Lock that protects the threads map. Only taken the first time a thread allocates, and when a frame is reset. */
+        std::mutex threads_lock;
+
+        /* The cached layouts, by the hash of their bindings. Several layouts may share a hash. */
+        std::unordered_map<uint64_t, Tools::Array<DescriptorLayout*>> layouts;
+        /* Lock that protects the layout cache. */
+        std::mutex layouts_lock;
+
+        /* The statistics of this allocator. */
+        DescriptorStatistics _statistics;
+
+
+        /* Returns the pools of the calling thread, creating them if this is the first time the thread allocates. */
+        ThreadPools& get_thread_pools();
+        /* Adds a new pool to the end of the given chain, sized after the chain's demand.
+         * @param frame The chain to add a pool to.
+         * @param layout The layout of the set that didn't fit, which the new pool should fit at least once. */
+        void grow(FramePools& frame, const DescriptorLayout& layout);
+
+    public:
+        /* Constructor for the DescriptorAllocator class.
+         * @param vk_device The VkDevice on which we allocate the pools.
+         * @param dispatch The functions of the device. Has to outlive the DescriptorAllocator.
+         * @param n_frames The number of frames that can be in flight. */
+        DescriptorAllocator(VkDevice vk_device, const DeviceDispatch& dispatch, uint32_t n_frames);
+        /* Copy constructor for the DescriptorAllocator class, which is deleted. */
+        DescriptorAllocator(const DescriptorAllocator& other) = delete;
+        /* Move constructor for the DescriptorAllocator class, which is deleted. */
+        DescriptorAllocator(DescriptorAllocator&& other) = delete;
+        /* Destructor for the DescriptorAllocator class. */
+        ~DescriptorAllocator();
+
+        /* Returns the layout with the given bindings, creating it only if no layout with the same bindings was requested before. Can be called from any thread.
+         * @param bindings The bindings of the layout. Their order doesn't matter.
+         * @param flags The creation flags of the layout.
+         * @returns A reference to the cached layout, which lives as long as the allocator. */
+        const DescriptorLayout& get_layout(const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+        /* Returns a descriptor set for the current frame with the given layout, from the calling thread's pools. Never takes a lock once the thread has allocated before.
+         * The descriptor set is valid until the next time this frame is reset, and does not have to be freed.
+         * @param layout The layout of the set, as returned by get_layout().
+         * @returns A descriptor set that still has to be written. */
+        VkDescriptorSet allocate(const DescriptorLayout& layout);
+        /* Moves to the given frame, resetting all of its pools (of all threads) in bulk. Chains that needed more than one pool are replaced by a single pool that fits the whole frame.
+         * Should only be called once the fence of that frame's last submission has been signalled, and while no thread is allocating.
+         * @param frame The index of the frame to start. */
+        void begin_frame(uint32_t frame);
+
+        /* Returns the number of frames that can be in flight. */
+        inline uint32_t n_frames() const { return this->_n_frames; }
+        /* Returns the frame that is currently being recorded. */
+        inline uint32_t current_frame() const { return this->_current_frame; }
+        /* Returns the statistics of this allocator. The threads' sets and pools are only counted when their frame is reset. */
+        inline const DescriptorStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the DescriptorAllocator class, which is deleted. */
+        DescriptorAllocator& operator=(const DescriptorAllocator& other) = delete;
+        /* Move assignment operator for the DescriptorAllocator class, which is deleted. */
+        DescriptorAllocator& operator=(DescriptorAllocator&& other) = delete;
+
+    };
+}
+
+#endif
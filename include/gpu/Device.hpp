@@ -19,9 +19,23 @@
 #include <vulkan/vulkan.h>
 
 #include "instance/Instance.hpp"
+#include "arrays/StackArray.hpp"
 
 #include "QueueType.hpp"
+#include "DeviceDispatch.hpp"
 #include "PhysicalDevice.hpp"
+#include "Queue.hpp"
+#include "Timeline.hpp"
+#include "SubmitCoalescer.hpp"
+#include "DeletionQueue.hpp"
+#include "MemoryBudget.hpp"
+#include "BindlessHeap.hpp"
+#include "CommandPoolManager.hpp"
+#include "DescriptorAllocator.hpp"
+#include "GpuProfiler.hpp"
+#include "GeometryPool.hpp"
+#include "FrameRing.hpp"
+#include "DebugMarkup.hpp"
 
 namespace Makma3D {
     /* The Device class, which wraps around a PhysicalDevice to create an instantiated conceptual version of a GPU. */
@@ -29,6 +43,8 @@ namespace Makma3D {
     public:
         /* Logging channel name for the Device class. */
         static constexpr const char* channel = "Device";
+        /* The number of frames that may be in flight at the same time. */
+        static constexpr const uint32_t max_frames_in_flight = 2;
 
         /* The Instance around which this Device is build. */
         const Makma3D::Instance& instance;
@@ -39,14 +55,45 @@ namespace Makma3D {
 
         /* The Vulkan VkDevice object. */
         VkDevice vk_device;
-        /* Lists the queues for each QueueType. */
-        Tools::Array<Tools::Array<VkQueue>> queues;
+        /* All queues created on the device, each exactly once. */
+        Tools::Array<Queue*> all_queues;
+        /* Lists the queues that each QueueType may use. Types can share queues. */
+        Tools::Array<Tools::Array<Queue*>> queues;
+        /* Lists the queue family index used for each QueueType. */
+        Tools::StackArray<uint32_t, Vulkanic::n_queue_types> queue_families;
+        /* Whether this Device was created for a surface (true) or for headless rendering (false). */
+        bool _can_present;
+        /* The Makma3D DeviceFeatures that are enabled on this device, which are the ones required by the Instance plus every supported fast path. */
+        Tools::Array<Vulkanic::DeviceFeature> enabled_features;
+        /* The functions of the device, which are called directly instead of through the loader. */
+        DeviceDispatch* dispatch;
+        /* The submission coalescer for each QueueType. */
+        Tools::Array<SubmitCoalescer*> submitters;
+        /* The DeletionQueue that destroys retired objects once the queues are done with them. */
+        DeletionQueue* deletion_queue;
+        /* The MemoryBudget that tracks the usage of each memory heap of this device. */
+        MemoryBudget* memory_budget;
+
+        /* The CommandPoolManager that hands out command buffers for this device. */
+        CommandPoolManager* command_pool_manager;
+        /* The DescriptorAllocator that hands out classic descriptor sets for this device. */
+        DescriptorAllocator* descriptor_allocator;
+        /* The BindlessHeap with all resources of this device, or nullptr if descriptor indexing isn't supported. */
+        BindlessHeap* bindless_heap;
+        /* The GpuProfiler that measures scopes on the graphics and compute queues of this device. */
+        GpuProfiler* profiler;
+        /* The GeometryPool from which the vertex and index data of meshes is allocated. */
+        GeometryPool* geometry_pool;
+        /* The FrameRing from which per-frame uniform and storage data is allocated. */
+        FrameRing* frame_ring;
+        /* The DebugMarkup that names the objects of this device and labels its command buffers in debug builds. */
+        DebugMarkup* debug_markup;
 
     public:
         /* Constructor for the Device class.
          * @param instance The Makma3D instance where we will allocate the GPU.
          * @param physical_device The PhysicalDevice object which we want to wrap around/instantiate.
-         * @param vk_surface The VkSurfaceKHR object used to map the physical device's queues to type of operations we want to perform (and specifically, to determine present capabilities of a queue. */
+         * @param vk_surface The VkSurfaceKHR object used to map the physical device's queues to type of operations we want to perform (and specifically, to determine present capabilities of a queue. Pass a nullptr to create a headless Device, whose present queue aliases a graphics queue and cannot be presented on. */
         Device(const Makma3D::Instance& instance, const PhysicalDevice& physical_device, VkSurfaceKHR vk_surface);
         /* Copy constructor for the Device class, which is deleted. */
         Device(const Device& other) = delete;
@@ -60,10 +107,80 @@ namespace Makma3D {
          * @returns The number of queues used for the given operation type. */
         inline uint32_t get_queue_count(Vulkanic::QueueType queue_type) const { return this->queues[(uint32_t) queue_type].size(); }
         /* Returns the i'th queue of the given queue type. There's guaranteed to be at least one.
+         * Note that access to the queue is not synchronized; if multiple threads may submit, use lease_queue() instead.
          * @param queue_type The type of operation of the queue list where we want to get a queue from.
          * @param index The index of the desired queue in the list of queues.
          * @returns The desired queue as a VkQueue object. */
-        inline const VkQueue& get_queue(Vulkanic::QueueType queue_type, uint32_t index) const { return this->queues[(uint32_t) queue_type][index]; }
+        inline const VkQueue& get_queue(Vulkanic::QueueType queue_type, uint32_t index) const { return this->queues[(uint32_t) queue_type][index]->vk(); }
+        /* Leases one of the queues of the given type, blocking until one is available. The calling thread has exclusive access to the queue for as long as the lease lives, so keep it short (e.g., around a submit) or dedicate it to a single thread.
+         * Different threads prefer different queues, so they can submit to distinct hardware queues in parallel if the type has more than one.
+         * @param queue_type The type of operation for which we want a queue.
+         * @returns A QueueLease for the leased queue. */
+        QueueLease lease_queue(Vulkanic::QueueType queue_type) const;
+        /* Tries to lease one of the queues of the given type without blocking.
+         * @param queue_type The type of operation for which we want a queue.
+         * @returns A QueueLease for the leased queue, or an empty one if they are all leased already. */
+        QueueLease try_lease_queue(Vulkanic::QueueType queue_type) const;
+        /* Returns the index of the queue family that is used for the given queue type.
+         * @param queue_type The type of operation for which we want to know the queue family.
+         * @returns The index of the queue family used for that operation. */
+        inline uint32_t get_queue_family(Vulkanic::QueueType queue_type) const { return this->queue_families[(uint32_t) queue_type]; }
+
+        /* Returns all queues created on this device, each exactly once. Their Timelines tell how far the GPU has progressed on each of them. */
+        inline const Tools::Array<Queue*>& get_queues() const { return this->all_queues; }
+        /* Returns whether the queues' Timelines use timeline semaphores (true), or fall back to fences and binary semaphores (false). */
+        inline bool supports_timeline_semaphores() const { return this->has_feature(Vulkanic::DeviceFeature::timeline_semaphores); }
+
+        /* Returns whether the given DeviceFeature is enabled on this device, i.e., whether the fast path that relies on it is live.
+         * @param feature The feature to check.
+         * @returns Whether it's enabled (true) or not (false). */
+        bool has_feature(Vulkanic::DeviceFeature feature) const;
+        /* Returns all DeviceFeatures that are enabled on this device. */
+        inline const Tools::Array<Vulkanic::DeviceFeature>& get_features() const { return this->enabled_features; }
+        /* Returns the Vulkan version used on this device, as given by VK_MAKE_API_VERSION(). */
+        inline uint32_t api_version() const { return this->physical_device.api_version(); }
+
+        /* Returns the SubmitCoalescer for the given queue type. Any thread can enqueue work in it, which is then submitted in one go when it's flushed (typically once per frame).
+         * @param queue_type The type of operation for which we want to submit work.
+         * @returns A reference to the SubmitCoalescer for that type. */
+        inline SubmitCoalescer& get_submitter(Vulkanic::QueueType queue_type) const { return *this->submitters[(uint32_t) queue_type]; }
+
+        /* Returns the DeletionQueue in which objects that may still be in use by the GPU can be retired, from any thread. They are destroyed during collect() once the work that uses them is done, so replacing resources never has to idle the device. */
+        inline DeletionQueue& get_deletion_queue() const { return *this->deletion_queue; }
+        /* Returns the MemoryBudget with which the usage of each memory heap can be watched, from any thread. Evictors registered with it are asked to give memory back before allocations run out of it. */
+        inline MemoryBudget& get_memory_budget() const { return *this->memory_budget; }
+
+        /* Returns whether this Device has a queue that can present (true), or whether it was created for headless rendering (false). */
+        inline bool can_present() const { return this->_can_present; }
+
+        /* Returns the index of a memory type on this device that is allowed by the given filter and that has at least the given properties. Throws errors if no such type exists.
+         * @param type_filter Bitmask of memory types that are allowed (as returned in VkMemoryRequirements::memoryTypeBits).
+         * @param properties The memory properties that the memory type should at least have.
+         * @returns The index of the first memory type that matches. */
+        uint32_t get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+
+        /* Returns the functions of this Device, loaded once with vkGetDeviceProcAddr(). Calling through them skips the loader's trampoline, so prefer them for anything that's called often. Extension functions are nullptr if their extension isn't enabled. */
+        inline const DeviceDispatch& get_dispatch() const { return *this->dispatch; }
+
+        /* Returns the CommandPoolManager from which command buffers for this Device can be allocated, from any thread. */
+        inline CommandPoolManager& get_command_pool_manager() const { return *this->command_pool_manager; }
+        /* Returns the DescriptorAllocator from which per-frame descriptor sets for this Device can be allocated, from any thread. This is the classic path for when there's no BindlessHeap. */
+        inline DescriptorAllocator& get_descriptor_allocator() const { return *this->descriptor_allocator; }
+        /* Returns whether this Device has a BindlessHeap, i.e., whether descriptor indexing is enabled. If not, resources have to be bound with classic descriptor sets instead. */
+        inline bool has_bindless_heap() const { return this->bindless_heap != nullptr; }
+        /* Returns the BindlessHeap in which images, buffers and samplers can be registered for shaders to index. Only valid if has_bindless_heap() returns true. */
+        inline BindlessHeap& get_bindless_heap() const { return *this->bindless_heap; }
+        /* Returns the GpuProfiler with which scopes on the graphics and compute queues can be timed, from any thread. */
+        inline GpuProfiler& get_profiler() const { return *this->profiler; }
+        /* Returns the GeometryPool in which the vertices and indices of meshes can be allocated, from any thread. Meshes in the same block share one vertex and index buffer, so they can all be drawn after a single bind. */
+        inline GeometryPool& get_geometry_pool() const { return *this->geometry_pool; }
+        /* Returns the FrameRing in which data that only lives for a single frame can be allocated, from any thread, and bound with dynamic offsets. */
+        inline FrameRing& get_frame_ring() const { return *this->frame_ring; }
+        /* Returns the DebugMarkup with which objects of this Device can be named and its command buffers labelled. Does nothing in release builds or if the debug extension isn't enabled. */
+        inline const DebugMarkup& get_debug_markup() const { return *this->debug_markup; }
+
+        /* Returns the PhysicalDevice around which this Device is build. */
+        inline const PhysicalDevice& get_physical_device() const { return this->physical_device; }
 
         /* Explicitly returns the internal VkDevice object. */
         inline const VkDevice& vk() const { return this->vk_device; }
@@ -0,0 +1,109 @@
+/* DEVICE DISPATCH.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 10:12:31
+ * Last edited:
+ *   19/10/2021, 10:12:31
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DeviceDispatch struct, which holds the Vulkan functions
+ *   of a single VkDevice as loaded by vkGetDeviceProcAddr(). Calling
+ *   through it skips the loader's trampoline and dispatch on every call,
+ *   and resolves extension functions once when the device is created.
+**/
+
+#ifndef GPU_DEVICE_DISPATCH_HPP
+#define GPU_DEVICE_DISPATCH_HPP
+
+#include <vulkan/vulkan.h>
+
+/* Lists the device functions that every device has. Expands X(name) for each of them. */
+#define MAKMA3D_DEVICE_FUNCTIONS(X) \
+    X(vkDeviceWaitIdle) \
+    X(vkQueueSubmit) \
+    X(vkQueueWaitIdle) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkGetFenceStatus) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkGetQueryPoolResults) \
+    X(vkResetCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkResetDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdNextSubpass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkCmdBindVertexBuffers) \
+    X(vkCmdBindIndexBuffer) \
+    X(vkCmdDraw) \
+    X(vkCmdDrawIndexed) \
+    X(vkCmdDrawIndexedIndirect) \
+    X(vkCmdDispatch) \
+    X(vkCmdFillBuffer) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdCopyBufferToImage) \
+    X(vkCmdCopyImage) \
+    X(vkCmdBlitImage) \
+    X(vkCmdExecuteCommands) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp) \
+    X(vkCmdBeginQuery) \
+    X(vkCmdEndQuery)
+
+/* Lists the device functions that come from extensions, and that are thus nullptr if the extension isn't enabled. Expands X(name) for each of them. */
+#define MAKMA3D_DEVICE_EXTENSION_FUNCTIONS(X) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR)
+
+/* Lists the device functions that were promoted to core in Vulkan 1.2, and that are nullptr if neither the core version nor the extension is available. Expands X(name, core_name) for each of them. */
+#define MAKMA3D_DEVICE_PROMOTED_FUNCTIONS(X) \
+    X(vkGetSemaphoreCounterValueKHR, "vkGetSemaphoreCounterValue") \
+    X(vkWaitSemaphoresKHR, "vkWaitSemaphores") \
+    X(vkCmdDrawIndexedIndirectCountKHR, "vkCmdDrawIndexedIndirectCount")
+
+
+
+namespace Makma3D {
+    /* The DeviceDispatch struct, which holds the functions of a single VkDevice. Members are named after the function they point to. */
+    struct DeviceDispatch {
+    public:
+        /* Channel name for the DeviceDispatch struct. */
+        static constexpr const char* channel = "DeviceDispatch";
+
+        #define MAKMA3D_DECLARE_FUNCTION(NAME) PFN_##NAME NAME;
+        #define MAKMA3D_DECLARE_PROMOTED_FUNCTION(NAME, CORE_NAME) PFN_##NAME NAME;
+        MAKMA3D_DEVICE_FUNCTIONS(MAKMA3D_DECLARE_FUNCTION)
+        MAKMA3D_DEVICE_EXTENSION_FUNCTIONS(MAKMA3D_DECLARE_FUNCTION)
+        MAKMA3D_DEVICE_PROMOTED_FUNCTIONS(MAKMA3D_DECLARE_PROMOTED_FUNCTION)
+        #undef MAKMA3D_DECLARE_PROMOTED_FUNCTION
+        #undef MAKMA3D_DECLARE_FUNCTION
+
+        /* Constructor for the DeviceDispatch struct, which loads all functions at once.
+         * @param get_device_proc_addr The vkGetDeviceProcAddr() of the instance that created the device.
+         * @param vk_device The VkDevice whose functions to load.
+         * @param api_version The Vulkan version of the device, as given by VK_MAKE_API_VERSION(), which decides whether the core or the extension version of promoted functions is loaded.
+         * @param present Whether the device presents to a surface, in which case the swapchain functions are required rather than optional. */
+        DeviceDispatch(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice vk_device, uint32_t api_version, bool present);
+
+    };
+}
+
+#endif
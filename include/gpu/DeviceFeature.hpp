@@ -24,14 +24,49 @@ namespace Makma3D::Vulkanic {
         undefined = 0,
 
         /* if enabled, the device supports anisotropic filtering. */
-        anisotropy = 1
+        anisotropy = 1,
+        /* If enabled, the device supports non-uniform indexing into large, partially bound and update-after-bind descriptor arrays (Vulkan 1.2 or VK_EXT_descriptor_indexing). */
+        descriptor_indexing = 2,
+        /* If enabled, the device can give buffers a GPU address that shaders can use (Vulkan 1.2 or VK_KHR_buffer_device_address). */
+        buffer_device_address = 3,
+        /* If enabled, the device supports timeline semaphores (Vulkan 1.2 or VK_KHR_timeline_semaphore). */
+        timeline_semaphores = 4,
+        /* If enabled, the device can render without render passes or framebuffers (Vulkan 1.3 or VK_KHR_dynamic_rendering). */
+        dynamic_rendering = 5,
+        /* If enabled, the device supports the simplified barrier and submit API (Vulkan 1.3 or VK_KHR_synchronization2). */
+        synchronization2 = 6,
+        /* If enabled, shaders can use 8-bit types in storage and uniform buffers (Vulkan 1.2 or VK_KHR_8bit_storage). */
+        storage_8bit = 7,
+        /* If enabled, shaders can use 16-bit types in storage and uniform buffers (Vulkan 1.1 or VK_KHR_16bit_storage). */
+        storage_16bit = 8,
+        /* If enabled, the device can do more than one indirect draw per call and pass a firstInstance through indirect draws. */
+        multi_draw_indirect = 9,
+        /* If enabled, the device can read the number of indirect draws from a buffer (VK_KHR_draw_indirect_count). */
+        draw_indirect_count = 10,
+        /* If enabled, the device can count the vertices, primitives and shader invocations of a range of commands with a query. */
+        pipeline_statistics = 11,
+        /* If enabled, the device reports how much of each memory heap the process uses and may use (VK_EXT_memory_budget). */
+        memory_budget = 12
     };
+    /* The number of DeviceFeatures, including undefined. */
+    static constexpr const uint32_t n_device_features = 13;
 
     /* Maps DeviceFeature enum values to readable strings. */
     static const std::string device_feature_names[] = {
         "undefined",
 
-        "anisotropy"
+        "anisotropy",
+        "descriptor_indexing",
+        "buffer_device_address",
+        "timeline_semaphores",
+        "dynamic_rendering",
+        "synchronization2",
+        "storage_8bit",
+        "storage_16bit",
+        "multi_draw_indirect",
+        "draw_indirect_count",
+        "pipeline_statistics",
+        "memory_budget"
     };
 }
 
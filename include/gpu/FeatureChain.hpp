@@ -0,0 +1,100 @@
+/* FEATURE CHAIN.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 09:41:26
+ * Last edited:
+ *   18/10/2021, 09:41:26
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the FeatureChain class, which builds the
+ *   VkPhysicalDeviceFeatures2 pNext-chain for a set of Makma3D
+ *   DeviceFeatures, both to query and to enable them. Also knows in which
+ *   Vulkan version or through which extensions each feature is available.
+**/
+
+#ifndef GPU_FEATURE_CHAIN_HPP
+#define GPU_FEATURE_CHAIN_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "DeviceFeature.hpp"
+
+namespace Makma3D {
+    /* The FeatureChain class, which wraps a VkPhysicalDeviceFeatures2 struct and the extension feature structs chained to it. */
+    class FeatureChain {
+    public:
+        /* Channel name for the FeatureChain class. */
+        static constexpr const char* channel = "FeatureChain";
+
+    private:
+        /* The head of the chain, which also carries the Vulkan 1.0 features. */
+        VkPhysicalDeviceFeatures2 features2;
+        /* The descriptor indexing features. */
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing;
+        /* The buffer device address features. */
+        VkPhysicalDeviceBufferDeviceAddressFeatures buffer_device_address;
+        /* The timeline semaphore features. */
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphores;
+        /* The dynamic rendering features. */
+        VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering;
+        /* The synchronization2 features. */
+        VkPhysicalDeviceSynchronization2Features synchronization2;
+        /* The 8-bit storage features. */
+        VkPhysicalDevice8BitStorageFeatures storage_8bit;
+        /* The 16-bit storage features. */
+        VkPhysicalDevice16BitStorageFeatures storage_16bit;
+
+
+        /* Returns the struct in the chain that carries the given feature, or nullptr if it lives in the head of the chain. */
+        VkBaseOutStructure* get_struct(Vulkanic::DeviceFeature feature);
+
+    public:
+        /* Constructor for the FeatureChain class, which initializes all structs to zero and links none of them. */
+        FeatureChain();
+        /* Copy constructor for the FeatureChain class, which is deleted since the chain points into itself. */
+        FeatureChain(const FeatureChain& other) = delete;
+        /* Move constructor for the FeatureChain class, which is deleted since the chain points into itself. */
+        FeatureChain(FeatureChain&& other) = delete;
+
+        /* Links the structs needed for the given features into the chain, replacing any previous chain. Only link features the device can provide (see is_available()), since chaining unknown structs is invalid.
+         * @param features The features whose structs to link. */
+        void link(const Tools::Array<Vulkanic::DeviceFeature>& features);
+        /* Marks the given features as enabled in their structs. They should be linked already.
+         * @param features The features to enable. */
+        void enable(const Tools::Array<Vulkanic::DeviceFeature>& features);
+        /* Returns whether the given feature is marked as supported in the (queried) chain. */
+        bool supports(Vulkanic::DeviceFeature feature) const;
+
+        /* Returns whether the given feature can only be queried through vkGetPhysicalDeviceFeatures2(), i.e., whether it isn't a Vulkan 1.0 feature or one that only needs an extension. */
+        static bool needs_features2(Vulkanic::DeviceFeature feature);
+        /* Returns whether the given feature can be queried or enabled on a device, i.e., whether it's core in the given version or the device supports the extensions that provide it.
+         * @param feature The feature to check.
+         * @param api_version The negotiated Vulkan version of the device.
+         * @param device_extensions The device extensions supported by the device.
+         * @returns Whether the feature is available (true) or not (false). */
+        static bool is_available(Vulkanic::DeviceFeature feature, uint32_t api_version, const Tools::Array<VkExtensionProperties>& device_extensions);
+        /* Adds the device extensions needed to enable the given feature on a device with the given version to the list, if they aren't in there already.
+         * @param extensions The list of extensions to add to.
+         * @param feature The feature to enable.
+         * @param api_version The negotiated Vulkan version of the device. */
+        static void add_extensions(Tools::Array<const char*>& extensions, Vulkanic::DeviceFeature feature, uint32_t api_version);
+
+        /* Returns the head of the chain, to pass to vkGetPhysicalDeviceFeatures2() or as the pNext of VkDeviceCreateInfo. */
+        inline VkPhysicalDeviceFeatures2& head() { return this->features2; }
+        /* Returns the Vulkan 1.0 features in the chain, for pEnabledFeatures if the chain itself cannot be used. */
+        inline const VkPhysicalDeviceFeatures& core() const { return this->features2.features; }
+
+        /* Copy assignment operator for the FeatureChain class, which is deleted. */
+        FeatureChain& operator=(const FeatureChain& other) = delete;
+        /* Move assignment operator for the FeatureChain class, which is deleted. */
+        FeatureChain& operator=(FeatureChain&& other) = delete;
+
+    };
+}
+
+#endif
@@ -0,0 +1,177 @@
+/* FRAME RING.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 19:04:26
+ * Last edited:
+ *   19/10/2021, 19:04:26
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the FrameRing class, which hands out short-lived uniform and
+ *   storage data from one persistently mapped buffer, split in a region
+ *   per frame in flight. Allocating is a bump of a pointer, and shaders
+ *   find the data through dynamic offsets, so per-object constants need
+ *   neither their own buffers nor descriptor updates.
+**/
+
+#ifndef GPU_FRAME_RING_HPP
+#define GPU_FRAME_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vulkan/vulkan.h>
+
+#include "DeviceDispatch.hpp"
+#include "PhysicalDevice.hpp"
+#include "MemoryBudget.hpp"
+#include "DebugMarkup.hpp"
+
+namespace Makma3D {
+    /* A single allocation in the FrameRing, which is valid until the same frame comes around again. */
+    struct FrameAllocation {
+        /* Pointer to the mapped memory of the allocation, or nullptr if the frame's region overflowed. */
+        void* data;
+        /* The offset of the allocation in the ring's buffer, which is the dynamic offset to bind it with. */
+        uint32_t offset;
+        /* The size of the allocation, in bytes. */
+        uint32_t size;
+
+        /* Returns whether the allocation succeeded (true) or the frame's region overflowed (false). */
+        inline bool valid() const { return this->data != nullptr; }
+    };
+
+    /* Counts what the FrameRing did. */
+    struct FrameRingStatistics {
+        /* The number of frames that were started. */
+        uint64_t n_frames;
+        /* The number of allocations that were handed out. */
+        uint64_t n_allocations;
+        /* The number of allocations that didn't fit in their frame's region. */
+        uint64_t n_overflows;
+        /* The total number of bytes (including alignment padding) that were handed out. */
+        uint64_t total_bytes;
+        /* The highest number of bytes (including alignment padding) used by a single frame. */
+        VkDeviceSize high_water;
+
+        /* Returns the average number of bytes used per frame. */
+        inline double bytes_per_frame() const { return this->n_frames > 0 ? static_cast<double>(this->total_bytes) / this->n_frames : 0.0; }
+    };
+
+
+
+    /* The FrameRing class, which linearly allocates per-frame uniform and storage data from a host-visible buffer with a region per frame in flight. */
+    class FrameRing {
+    public:
+        /* Channel name for the FrameRing class. */
+        static constexpr const char* channel = "FrameRing";
+        /* The default size (in bytes) of the region of each frame. */
+        static constexpr const VkDeviceSize default_frame_size = 4 * 1024 * 1024;
+        /* The largest range (in bytes) that descriptors into the ring may cover, before clamping it to the device limits. */
+        static constexpr const uint32_t default_max_range = 64 * 1024;
+
+    private:
+        /* The VkDevice on which the ring lives. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The MemoryBudget through which we allocate the ring. */
+        MemoryBudget& memory_budget;
+
+        /* The buffer with the regions of all frames. */
+        VkBuffer vk_buffer;
+        /* The memory of the buffer. */
+        VkDeviceMemory vk_memory;
+        /* The memory type of the buffer's memory. */
+        uint32_t memory_type;
+        /* The size of the buffer's memory. */
+        VkDeviceSize memory_size;
+        /* The host pointer to the persistently mapped memory. */
+        uint8_t* map;
+        /* Whether the memory is device-local as well as host-visible. */
+        bool _device_local;
+
+        /* The alignment of each allocation, which satisfies both the uniform and storage buffer offset alignment of the device. */
+        VkDeviceSize _alignment;
+        /* The size of the region of each frame. */
+        VkDeviceSize _frame_size;
+        /* The largest range that descriptors into the ring may cover. */
+        uint32_t _max_range;
+        /* The number of frames that can be in flight. */
+        uint32_t _n_frames;
+        /* The frame that is currently being recorded. */
+        uint32_t _current_frame;
+        /* The offset of the first free byte in the current frame's region, relative to that region. */
+        std::atomic<VkDeviceSize> head;
+        /* Whether an overflow was already reported for the current frame. */
+        std::atomic<bool> overflowed;
+
+        /* The number of allocations in the current frame. */
+        std::atomic<uint64_t> n_allocations;
+        /* The number of overflows in the current frame. */
+        std::atomic<uint64_t> n_overflows;
+        /* The statistics of this ring, up to the previous frame. */
+        FrameRingStatistics _statistics;
+
+    public:
+        /* Constructor for the FrameRing class.
+         * @param vk_device The VkDevice on which to create the ring.
+         * @param dispatch The functions of the device. Has to outlive the ring.
+         * @param physical_device The physical device of the VkDevice, whose limits decide the alignment and whose memory types decide where the ring lives.
+         * @param memory_budget The MemoryBudget through which to allocate the ring. Has to outlive the ring.
+         * @param n_frames The number of frames that can be in flight.
+         * @param debug_markup The DebugMarkup with which to name the buffer.
+         * @param frame_size The size (in bytes) of the region of each frame. */
+        FrameRing(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, MemoryBudget& memory_budget, uint32_t n_frames, const DebugMarkup& debug_markup, VkDeviceSize frame_size = FrameRing::default_frame_size);
+        /* Copy constructor for the FrameRing class, which is deleted. */
+        FrameRing(const FrameRing& other) = delete;
+        /* Move constructor for the FrameRing class, which is deleted. */
+        FrameRing(FrameRing&& other) = delete;
+        /* Destructor for the FrameRing class. Assumes the device is idle. */
+        ~FrameRing();
+
+        /* Allocates the given number of bytes in the current frame's region. Can be called from any thread without locking.
+         * If the region is full, an invalid allocation is returned and the overflow is counted in the statistics; the caller should then skip whatever needed the data.
+         * @param size The number of bytes to allocate. Should not be larger than max_range() if the data is bound with a descriptor.
+         * @returns The FrameAllocation, whose data can be written until the frame is submitted. */
+        FrameAllocation allocate(uint32_t size);
+        /* Allocates room for the given value in the current frame's region and copies it there. Can be called from any thread without locking.
+         * @param value The value to copy.
+         * @returns The FrameAllocation, which is invalid if the region is full. */
+        template <typename T>
+        inline FrameAllocation push(const T& value) { FrameAllocation allocation = this->allocate(sizeof(T)); if (allocation.valid()) { memcpy(allocation.data, &value, sizeof(T)); } return allocation; }
+        /* Moves to the given frame, making its whole region available again.
+         * Should only be called once the fence of that frame's last submission has been signalled, and while no thread is allocating.
+         * @param frame The index of the frame to start. */
+        void begin_frame(uint32_t frame);
+
+        /* Returns the buffer info for a dynamic uniform or storage buffer descriptor into the ring. Such a descriptor only has to be written once; each draw then passes the offset of its FrameAllocation as dynamic offset.
+         * @param range The range (in bytes) the descriptor covers, which should be at least the size of what the shader reads. Is clamped to max_range(). */
+        VkDescriptorBufferInfo descriptor_info(uint32_t range) const;
+
+        /* Returns the alignment of each allocation, which is also the alignment of the dynamic offsets. */
+        inline VkDeviceSize alignment() const { return this->_alignment; }
+        /* Returns the size of the region of each frame. */
+        inline VkDeviceSize frame_size() const { return this->_frame_size; }
+        /* Returns the largest range that descriptors into the ring may cover. */
+        inline uint32_t max_range() const { return this->_max_range; }
+        /* Returns the number of bytes (including alignment padding) that have been allocated in the current frame. */
+        inline VkDeviceSize size() const { return std::min(this->head.load(), this->_frame_size); }
+        /* Returns whether the ring lives in device-local memory (true), or in plain host memory that the GPU reads over the bus (false). */
+        inline bool device_local() const { return this->_device_local; }
+        /* Returns the statistics of this ring, up to the previous frame. */
+        inline const FrameRingStatistics& statistics() const { return this->_statistics; }
+        /* Explicitly returns the internal VkBuffer object. */
+        inline VkBuffer vk() const { return this->vk_buffer; }
+
+        /* Copy assignment operator for the FrameRing class, which is deleted. */
+        FrameRing& operator=(const FrameRing& other) = delete;
+        /* Move assignment operator for the FrameRing class, which is deleted. */
+        FrameRing& operator=(FrameRing&& other) = delete;
+
+    };
+}
+
+#endif
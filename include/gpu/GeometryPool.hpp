@@ -0,0 +1,325 @@
+/* GEOMETRY POOL.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 16:20:48
+ * Last edited:
+ *   19/10/2021, 16:20:48
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the GeometryPool class, which sub-allocates the vertex and
+ *   index data of all meshes of a Device from a few large device-local
+ *   buffers. Meshes are addressed by their vertexOffset and firstIndex
+ *   in those buffers, so drawing thousands of them only takes one bind
+ *   per block.
+**/
+
+#ifndef GPU_GEOMETRY_POOL_HPP
+#define GPU_GEOMETRY_POOL_HPP
+
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "arrays/StackArray.hpp"
+
+#include "QueueType.hpp"
+#include "DeviceDispatch.hpp"
+#include "PhysicalDevice.hpp"
+#include "SubmitCoalescer.hpp"
+#include "DeletionQueue.hpp"
+#include "MemoryBudget.hpp"
+#include "DebugMarkup.hpp"
+
+namespace Makma3D {
+    /* A handle to a mesh in the GeometryPool. */
+    struct GeometryHandle {
+        /* The index of the mesh in the pool. */
+        uint32_t index;
+        /* The generation of the mesh's slot when the handle was given out, used to detect stale handles. Zero for the null handle. */
+        uint32_t generation;
+
+        /* Returns whether this handle was ever given out, i.e., whether it isn't the null handle. */
+        inline bool valid() const { return this->generation != 0; }
+    };
+    /* A handle that never refers to any mesh. */
+    static constexpr const GeometryHandle null_geometry_handle = { 0, 0 };
+
+    /* Describes where the data of a single mesh lives in the GeometryPool. */
+    struct GeometryRange {
+        /* The block whose buffers contain the mesh. */
+        uint32_t block;
+        /* The size (in bytes) of a single vertex of the mesh. */
+        uint32_t vertex_stride;
+        /* The number of vertices of the mesh. */
+        uint32_t vertex_count;
+        /* The number of indices of the mesh. */
+        uint32_t index_count;
+        /* The index of the mesh's first vertex in the block's vertex buffer, as used for vertexOffset in (indirect) indexed draws. */
+        int32_t vertex_offset;
+        /* The index of the mesh's first index in the block's index buffer, as used for firstIndex in (indirect) indexed draws. */
+        uint32_t first_index;
+
+        /* Returns the offset (in bytes) of the mesh's vertices in the block's vertex buffer, e.g. to upload them. */
+        inline VkDeviceSize vertex_byte_offset() const { return static_cast<VkDeviceSize>(this->vertex_offset) * this->vertex_stride; }
+        /* Returns the offset (in bytes) of the mesh's indices in the block's index buffer, e.g. to upload them. */
+        inline VkDeviceSize index_byte_offset() const { return static_cast<VkDeviceSize>(this->first_index) * sizeof(uint32_t); }
+    };
+
+    /* Counts what the GeometryPool holds and what it did. */
+    struct GeometryStatistics {
+        /* The number of meshes in the pool. */
+        uint32_t n_meshes;
+        /* The highest number of meshes in the pool at the same time. */
+        uint32_t peak_meshes;
+        /* The total size (in bytes) of the vertex buffers. */
+        VkDeviceSize vertex_capacity;
+        /* The number of vertex bytes that are in use by meshes. */
+        VkDeviceSize vertex_used;
+        /* The total size (in bytes) of the index buffers. */
+        VkDeviceSize index_capacity;
+        /* The number of index bytes that are in use by meshes. */
+        VkDeviceSize index_used;
+        /* The number of blocks that were compacted. */
+        uint64_t n_compactions;
+        /* The number of vertex or index ranges that were moved by defragment(). */
+        uint64_t n_relocations;
+        /* The number of bytes copied by compactions and defragmentation. */
+        VkDeviceSize bytes_moved;
+
+        /* Returns the fraction of the vertex and index buffers that is in use by meshes. */
+        inline double occupancy() const { return this->vertex_capacity + this->index_capacity > 0 ? static_cast<double>(this->vertex_used + this->index_used) / (this->vertex_capacity + this->index_capacity) : 0.0; }
+    };
+
+
+
+    /* The GeometryPool class, which sub-allocates the vertices and indices of meshes from a few large vertex and index buffers of a Device. */
+    class GeometryPool {
+    public:
+        /* Channel name for the GeometryPool class. */
+        static constexpr const char* channel = "GeometryPool";
+        /* The size (in bytes) of the vertex buffer of each block. */
+        static constexpr const VkDeviceSize vertex_block_size = 64 * 1024 * 1024;
+        /* The size (in bytes) of the index buffer of each block. */
+        static constexpr const VkDeviceSize index_block_size = 32 * 1024 * 1024;
+        /* The type of the indices in the pool. */
+        static constexpr const VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        /* The fragmentation at which compact() moves the meshes of a block by default. */
+        static constexpr const double default_compaction_threshold = 0.25;
+        /* The number of bytes that defragment() moves per call by default. */
+        static constexpr const VkDeviceSize default_defragment_budget = 4 * 1024 * 1024;
+
+    private:
+        /* A range of free bytes in one of the buffers of a block. */
+        struct FreeRange {
+            /* The offset of the range. */
+            VkDeviceSize offset;
+            /* The size of the range. */
+            VkDeviceSize size;
+        };
+
+        /* The memory of a single buffer, as allocated through the MemoryBudget. */
+        struct Allocation {
+            /* The memory itself. */
+            VkDeviceMemory vk_memory;
+            /* The memory type it was allocated from. */
+            uint32_t memory_type;
+            /* The size it was allocated with. */
+            VkDeviceSize size;
+        };
+
+        /* A single vertex and index buffer pair, with the free lists that sub-allocate them. */
+        struct Block {
+            /* The vertex buffer. */
+            VkBuffer vk_vertex_buffer;
+            /* The memory of the vertex buffer. */
+            Allocation vertex_memory;
+            /* The index buffer. */
+            VkBuffer vk_index_buffer;
+            /* The memory of the index buffer. */
+            Allocation index_memory;
+            /* The free ranges in the vertex buffer, sorted by offset. */
+            Tools::Array<FreeRange> free_vertices;
+            /* The free ranges in the index buffer, sorted by offset. */
+            Tools::Array<FreeRange> free_indices;
+            /* Increased every time the block is compacted, so that ranges freed before it aren't returned to the new buffers. */
+            uint32_t generation;
+        };
+
+        /* A single mesh in the pool. */
+        struct Mesh {
+            /* The current generation of the mesh's slot. */
+            uint32_t generation;
+            /* Whether the slot holds a mesh. */
+            bool live;
+            /* Where the mesh lives. */
+            GeometryRange range;
+        };
+
+        /* A compaction or defragmentation whose copies may still be running. */
+        struct Compaction {
+            /* The command buffer with the copies. */
+            VkCommandBuffer vk_command_buffer;
+            /* The point at which the copies are done. */
+            SyncPoint done;
+        };
+
+        /* The VkDevice on which the buffers live. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The memory properties of the physical device, to find device-local memory in. */
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        /* The unique queue families that share the buffers. */
+        Tools::Array<uint32_t> queue_families;
+        /* The coalescer of the memory queue, on which compactions copy. */
+        SubmitCoalescer& submitter;
+        /* The DeletionQueue in which old buffers and freed ranges wait for the GPU. */
+        DeletionQueue& deletion_queue;
+        /* The MemoryBudget through which the buffers are allocated. */
+        MemoryBudget& memory_budget;
+        /* The DebugMarkup with which the buffers are named. */
+        const DebugMarkup& debug_markup;
+
+        /* The command pool on the memory queue's family from which compactions allocate. */
+        VkCommandPool vk_command_pool;
+        /* The compactions that were submitted, oldest first. */
+        Tools::Array<Compaction> compactions;
+
+        /* The blocks of the pool. */
+        Tools::Array<Block> blocks;
+        /* The meshes of the pool. */
+        Tools::Array<Mesh> meshes;
+        /* The mesh slots that can be handed out again. */
+        Tools::Array<uint32_t> free_meshes;
+        /* Increased every time meshes move, so that users know when to refresh the ranges they copied. */
+        uint64_t _generation;
+        /* The statistics of this pool. */
+        GeometryStatistics _statistics;
+        /* Lock for the blocks and meshes. */
+        std::mutex lock;
+
+
+        /* Takes a range of the given size and alignment from the given free list, using the first one that fits.
+         * @param free_list The free list to allocate from.
+         * @param size The number of bytes to take.
+         * @param alignment The alignment of the range's offset.
+         * @param offset Will be set to the offset of the range.
+         * @returns Whether a range was found (true) or not (false). */
+        static bool take_range(Tools::Array<FreeRange>& free_list, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+        /* Returns the given range to the given free list, merging it with its neighbours.
+         * @param free_list The free list to return the range to.
+         * @param offset The offset of the range.
+         * @param size The number of bytes of the range. */
+        static void return_range(Tools::Array<FreeRange>& free_list, VkDeviceSize offset, VkDeviceSize size);
+        /* Returns the fraction of free space of the given free list that is not in its largest range, i.e., 0 if all free space is contiguous.
+         * @param free_list The free list to inspect. */
+        static double fragmentation(const Tools::Array<FreeRange>& free_list);
+
+        /* Creates the buffers of a new, empty block. Should be called without the lock, since the MemoryBudget may free meshes to make room.
+         * @param block The block to initialize. */
+        void create_block(Block& block);
+        /* Names the buffers of the given block in debug builds.
+         * @param block The block to name.
+         * @param name The name to give the buffers. */
+        void name_block(const Block& block, const std::string& name) const;
+        /* Creates a buffer with memory of its own.
+         * @param size The size of the buffer.
+         * @param usage The usage of the buffer.
+         * @param vk_buffer Will be set to the new buffer.
+         * @param memory Will be set to the memory bound to it. */
+        void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& vk_buffer, Allocation& memory);
+        /* Destroys the buffers of the given block. Doesn't need the lock.
+         * @param vk_device The VkDevice on which the buffers live.
+         * @param memory_budget The MemoryBudget through which their memory was allocated.
+         * @param block The block to destroy. */
+        static void destroy_block(VkDevice vk_device, MemoryBudget& memory_budget, const Block& block);
+        /* Allocates and begins a command buffer for copies on the memory queue, starting with a barrier that orders them after the copies of earlier command buffers. Assumes the lock is taken.
+         * @param label The label to give the copies in debug builds.
+         * @returns The command buffer, which should be finished with end_copies(). */
+        VkCommandBuffer begin_copies(const char* label);
+        /* Ends a command buffer started with begin_copies().
+         * @param vk_command_buffer The command buffer to end. */
+        void end_copies(VkCommandBuffer vk_command_buffer);
+        /* Frees the command buffers of compactions that are done. Assumes the lock is taken. */
+        void recycle_compactions();
+
+    public:
+        /* Constructor for the GeometryPool class. Blocks are only created once the first mesh is allocated.
+         * @param vk_device The VkDevice on which to create the buffers.
+         * @param dispatch The functions of the device. Has to outlive the pool.
+         * @param physical_device The physical device of the VkDevice, to find device-local memory on.
+         * @param queue_families The queue family index used for each QueueType. The buffers are shared by all of them, so they never need ownership transfers.
+         * @param submitter The SubmitCoalescer of the memory queue, on which compactions copy. Has to outlive the pool.
+         * @param deletion_queue The DeletionQueue in which old buffers and freed ranges wait for the GPU. Has to outlive the pool.
+         * @param memory_budget The MemoryBudget through which to allocate the buffers, so evictors can make room for new blocks. Has to outlive the pool.
+         * @param debug_markup The DebugMarkup with which to name the buffers. Has to outlive the pool. */
+        GeometryPool(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, SubmitCoalescer& submitter, DeletionQueue& deletion_queue, MemoryBudget& memory_budget, const DebugMarkup& debug_markup);
+        /* Copy constructor for the GeometryPool class, which is deleted. */
+        GeometryPool(const GeometryPool& other) = delete;
+        /* Move constructor for the GeometryPool class, which is deleted. */
+        GeometryPool(GeometryPool&& other) = delete;
+        /* Destructor for the GeometryPool class. Assumes the device is idle. */
+        ~GeometryPool();
+
+        /* Reserves room for a mesh in the pool. Can be called from any thread.
+         * The data itself should be uploaded to the ranges' byte offsets in vertex_buffer() and index_buffer() (e.g., with the UploadManager, targeting the memory queue, since the buffers are shared by all queue families).
+         * @param vertex_count The number of vertices of the mesh.
+         * @param vertex_stride The size (in bytes) of a single vertex.
+         * @param index_count The number of (32-bit) indices of the mesh.
+         * @returns The handle of the mesh. */
+        GeometryHandle allocate(uint32_t vertex_count, uint32_t vertex_stride, uint32_t index_count);
+        /* Removes the mesh with the given handle from the pool. The handle becomes stale immediately, but its room is only reused once all work submitted so far is done. Can be called from any thread.
+         * @param handle The handle of the mesh to remove. */
+        void free(const GeometryHandle& handle);
+        /* Returns whether the given handle still refers to a mesh in the pool. */
+        bool is_live(const GeometryHandle& handle);
+        /* Returns where the mesh with the given handle lives. The range stays the same until the mesh is moved by compact(), which increases generation().
+         * @param handle The handle of the mesh.
+         * @returns The GeometryRange of the mesh. */
+        GeometryRange range(const GeometryHandle& handle);
+
+        /* Moves the meshes of every block whose free space is fragmented more than the given threshold into fresh, tightly packed buffers, by copying them on the memory queue. Never waits; the old buffers are retired once all work submitted so far is done.
+         * Meshes get new ranges, and the pool's generation() is increased. Should not be called while uploads to the pool are still running.
+         * @param threshold The minimal fragmentation (see fragmentation()) of a block before it is compacted. Use 0 to compact every block whose free space is split up at all.
+         * @returns The SyncPoint at which the copies are done, which submissions that use the new ranges should wait for; or the null_sync_point if nothing was moved. */
+        SyncPoint compact(double threshold = GeometryPool::default_compaction_threshold);
+
+        /* Moves a bounded number of vertex and index ranges into free room closer to the front of their buffers, by copying them on the memory queue. Meant to be called once per frame, so fragmentation is undone a little at a time instead of by compacting whole blocks; the buffers themselves stay the same, so descriptors that refer to them stay valid. Never waits; the old ranges are only given back once all work submitted so far is done.
+         * Moved meshes get new ranges (their handles stay valid), and the pool's generation() is increased. Should not be called while uploads to the pool are still running.
+         * @param max_bytes The maximum number of bytes to move in this call. The ranges that lie furthest back are moved first, and a range larger than what is left of this is skipped.
+         * @returns The SyncPoint at which the copies are done, which submissions that use the new ranges should wait for; or the null_sync_point if nothing was moved. */
+        SyncPoint defragment(VkDeviceSize max_bytes = GeometryPool::default_defragment_budget);
+
+        /* Binds the vertex and index buffer of the given block to the given command buffer. This is the only geometry bind that the meshes of a block need.
+         * @param vk_command_buffer The command buffer to bind them on.
+         * @param block The index of the block to bind.
+         * @param binding The vertex input binding to bind the vertex buffer to. */
+        void bind(VkCommandBuffer vk_command_buffer, uint32_t block, uint32_t binding = 0) const;
+
+        /* Returns the fraction of the given block's free space that can't be used for a single allocation, i.e., 0 if all free space is contiguous and close to 1 if it's scattered. */
+        double fragmentation(uint32_t block) const;
+        /* Returns the fraction of the pool's free space that can't be used for a single allocation in its block, i.e., the fragmentation of all blocks weighted by their free space. */
+        double fragmentation() const;
+        /* Returns the number of blocks in the pool. */
+        inline uint32_t n_blocks() const { return this->blocks.size(); }
+        /* Returns the vertex buffer of the given block. Changes when the block is compacted. */
+        inline VkBuffer vertex_buffer(uint32_t block) const { return this->blocks[block].vk_vertex_buffer; }
+        /* Returns the index buffer of the given block. Changes when the block is compacted. */
+        inline VkBuffer index_buffer(uint32_t block) const { return this->blocks[block].vk_index_buffer; }
+        /* Returns a number that is increased every time meshes move, so that copies of their ranges (e.g., in an IndirectRenderer) can be refreshed. */
+        inline uint64_t generation() const { return this->_generation; }
+        /* Returns the statistics of this pool. */
+        inline const GeometryStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the GeometryPool class, which is deleted. */
+        GeometryPool& operator=(const GeometryPool& other) = delete;
+        /* Move assignment operator for the GeometryPool class, which is deleted. */
+        GeometryPool& operator=(GeometryPool&& other) = delete;
+
+    };
+}
+
+#endif
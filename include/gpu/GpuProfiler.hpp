@@ -0,0 +1,200 @@
+/* GPU PROFILER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 20:44:17
+ * Last edited:
+ *   18/10/2021, 20:44:17
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the GpuProfiler class, which measures labeled scopes of
+ *   command buffers on the graphics and compute queues with timestamp
+ *   and pipeline statistics queries. The results of a frame are read
+ *   back once that frame's slot comes around again, so profiling never
+ *   stalls the GPU.
+**/
+
+#ifndef GPU_GPU_PROFILER_HPP
+#define GPU_GPU_PROFILER_HPP
+
+#include <atomic>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "arrays/StackArray.hpp"
+
+#include "QueueType.hpp"
+#include "PhysicalDevice.hpp"
+#include "DeviceDispatch.hpp"
+
+namespace Makma3D {
+    /* Handle to a scope that is being measured. */
+    using gpu_scope_t = uint32_t;
+    /* Handle that is returned for scopes that aren't measured, e.g., because the queue doesn't support timestamps. */
+    static constexpr const gpu_scope_t null_gpu_scope = std::numeric_limits<uint32_t>::max();
+
+    /* The number of pipeline statistics a scope counts. */
+    static constexpr const uint32_t n_pipeline_statistics = 6;
+    /* The pipeline statistics a scope counts, in the order in which Vulkan returns them. */
+    static constexpr const VkQueryPipelineStatisticFlagBits pipeline_statistics[] = {
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+    };
+    /* Names for the pipeline statistics. */
+    static const std::string pipeline_statistic_names[] = {
+        "vertices",
+        "primitives",
+        "vertex_invocations",
+        "clipped_primitives",
+        "fragment_invocations",
+        "compute_invocations"
+    };
+
+    /* The measurements of a single scope. */
+    struct GpuScope {
+        /* The label of the scope. */
+        std::string name;
+        /* The type of queue the scope was recorded for. */
+        Vulkanic::QueueType queue_type;
+        /* The time at which the scope started, in nanoseconds on the device's clock. */
+        double begin;
+        /* The time at which the scope ended, in nanoseconds on the device's clock. */
+        double end;
+        /* Whether the pipeline statistics were counted. */
+        bool has_statistics;
+        /* The pipeline statistics of the scope, in the order of pipeline_statistics. Statistics the queue cannot count are zero. */
+        uint64_t statistics[n_pipeline_statistics];
+
+        /* Returns the duration of the scope, in nanoseconds. */
+        inline double duration() const { return this->end - this->begin; }
+    };
+
+
+
+    /* The GpuProfiler class, which measures labeled scopes on the graphics and compute queues. */
+    class GpuProfiler {
+    public:
+        /* Channel name for the GpuProfiler class. */
+        static constexpr const char* channel = "GpuProfiler";
+        /* The number of queue types that can be profiled (graphics and compute). */
+        static constexpr const uint32_t n_profiled_types = 2;
+
+    private:
+        /* The queries of a single queue type in a single frame. */
+        struct QueryPools {
+            /* The pool with two timestamps for each scope. */
+            VkQueryPool vk_timestamps;
+            /* The pool with the pipeline statistics of each scope, or nullptr if they aren't counted. */
+            VkQueryPool vk_statistics;
+            /* The number of scopes that were begun this frame. */
+            std::atomic<uint32_t> n_scopes;
+            /* The name of each scope. */
+            Tools::Array<std::string> names;
+        };
+        /* What we know about each profiled queue type. */
+        struct TypeInfo {
+            /* Whether the queue type can be profiled at all. */
+            bool enabled;
+            /* The mask of the valid bits of the timestamps. */
+            uint64_t timestamp_mask;
+            /* The pipeline statistics that the queue's family can count. */
+            VkQueryPipelineStatisticFlags statistics;
+        };
+
+        /* The VkDevice on which we create the query pools. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The number of nanoseconds per timestamp tick. */
+        double timestamp_period;
+        /* The maximum number of scopes per queue type per frame. */
+        uint32_t _max_scopes;
+        /* The number of frames that can be in flight. */
+        uint32_t _n_frames;
+        /* The frame that is currently being recorded. */
+        uint32_t _current_frame;
+
+        /* What we know about each profiled queue type. */
+        TypeInfo types[n_profiled_types];
+        /* The pools of each frame and then each profiled queue type. */
+        Tools::Array<QueryPools*> pools;
+
+        /* The scopes that were read back during the last begin_frame(). */
+        Tools::Array<GpuScope> _results;
+        /* Whether the results are also collected for a trace. */
+        bool _tracing;
+        /* The scopes collected for the trace. */
+        Tools::Array<GpuScope> trace;
+
+
+        /* Returns the index of the given queue type among the profiled types, or n_profiled_types if it isn't profiled. */
+        static uint32_t get_slot(Vulkanic::QueueType queue_type);
+        /* Reads back the scopes of the given pools into the results, and empties them. */
+        void read_back(QueryPools& pools, uint32_t slot);
+
+    public:
+        /* Constructor for the GpuProfiler class.
+         * @param vk_device The VkDevice on which we create the query pools.
+         * @param dispatch The functions of the device. Has to outlive the GpuProfiler.
+         * @param physical_device The PhysicalDevice of the device, for its timestamp period and queue family properties.
+         * @param queue_families The queue family that is used for each QueueType.
+         * @param n_frames The number of frames that can be in flight.
+         * @param pipeline_statistics Whether the pipeline_statistics feature is enabled, and thus whether scopes count pipeline statistics.
+         * @param max_scopes The maximum number of scopes per queue type per frame. Scopes beyond that aren't measured. */
+        GpuProfiler(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, uint32_t n_frames, bool pipeline_statistics, uint32_t max_scopes = 256);
+        /* Copy constructor for the GpuProfiler class, which is deleted. */
+        GpuProfiler(const GpuProfiler& other) = delete;
+        /* Move constructor for the GpuProfiler class, which is deleted. */
+        GpuProfiler(GpuProfiler&& other) = delete;
+        /* Destructor for the GpuProfiler class. */
+        ~GpuProfiler();
+
+        /* Begins measuring a scope on the given command buffer. Must be recorded outside of a render pass, and can be called from any thread.
+         * @param vk_command_buffer The command buffer to record the scope's start on.
+         * @param queue_type The type of queue the command buffer will be submitted to. Only graphics and compute are profiled.
+         * @param name The label of the scope.
+         * @returns A handle to pass to end_scope(), which is null_gpu_scope if the scope isn't measured. */
+        gpu_scope_t begin_scope(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, const std::string& name);
+        /* Ends measuring a scope on the given command buffer. Must be recorded outside of a render pass, on the same command buffer as begin_scope().
+         * @param vk_command_buffer The command buffer to record the scope's end on.
+         * @param queue_type The type of queue given to begin_scope().
+         * @param scope The handle returned by begin_scope(). */
+        void end_scope(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, gpu_scope_t scope);
+        /* Moves to the given frame, reading back the scopes that were measured the last time it was recorded.
+         * Should only be called once the fence of that frame's last submission has been signalled, so the read back never waits.
+         * @param frame The index of the frame to start. */
+        void begin_frame(uint32_t frame);
+
+        /* Sets whether the results of each frame are also collected for write_trace(). */
+        inline void set_tracing(bool tracing) { this->_tracing = tracing; }
+        /* Writes the scopes collected since the last call as a trace in the Chrome trace event format, with a thread per queue type, and then forgets them.
+         * @param os The stream to write the JSON to. */
+        void write_trace(std::ostream& os);
+
+        /* Returns the scopes that were read back during the last begin_frame(). Scopes that never completed are left out. */
+        inline const Tools::Array<GpuScope>& results() const { return this->_results; }
+        /* Returns whether the given queue type is measured. */
+        inline bool is_profiled(Vulkanic::QueueType queue_type) const { uint32_t slot = get_slot(queue_type); return slot < n_profiled_types && this->types[slot].enabled; }
+        /* Returns the maximum number of scopes per queue type per frame. */
+        inline uint32_t max_scopes() const { return this->_max_scopes; }
+        /* Returns the frame that is currently being recorded. */
+        inline uint32_t current_frame() const { return this->_current_frame; }
+
+        /* Copy assignment operator for the GpuProfiler class, which is deleted. */
+        GpuProfiler& operator=(const GpuProfiler& other) = delete;
+        /* Move assignment operator for the GpuProfiler class, which is deleted. */
+        GpuProfiler& operator=(GpuProfiler&& other) = delete;
+
+    };
+}
+
+#endif
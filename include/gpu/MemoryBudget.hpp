@@ -0,0 +1,207 @@
+/* MEMORY BUDGET.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 20:12:48
+ * Last edited:
+ *   19/10/2021, 20:12:48
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the MemoryBudget class, which keeps track of how much of each
+ *   memory heap of a Device is in use and how much it may use. It reports
+ *   when usage crosses thresholds, and asks registered evictors to give
+ *   memory back before an allocation would run out of device memory.
+**/
+
+#ifndef GPU_MEMORY_BUDGET_HPP
+#define GPU_MEMORY_BUDGET_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "DeviceDispatch.hpp"
+#include "PhysicalDevice.hpp"
+#include "DeletionQueue.hpp"
+
+namespace Makma3D {
+    /* The usage and budget of a single memory heap. */
+    struct HeapBudget {
+        /* The size of the heap, in bytes. */
+        VkDeviceSize size;
+        /* The number of bytes the process may use before allocations start failing or slowing down. */
+        VkDeviceSize budget;
+        /* The number of bytes the process uses. */
+        VkDeviceSize usage;
+        /* The highest usage seen so far. */
+        VkDeviceSize high_water;
+        /* Whether the heap is device-local. */
+        bool device_local;
+
+        /* Returns the fraction of the budget that is in use. */
+        inline double pressure() const { return this->budget > 0 ? static_cast<double>(this->usage) / this->budget : 0.0; }
+    };
+
+    /* Counts what the MemoryBudget did. */
+    struct MemoryBudgetStatistics {
+        /* The number of times the usage was refreshed. */
+        uint64_t n_updates;
+        /* The number of times a threshold was crossed upwards. */
+        uint64_t n_crossings;
+        /* The number of times the evictors were asked for memory. */
+        uint64_t n_evictions;
+        /* The number of bytes the evictors gave back. */
+        VkDeviceSize bytes_evicted;
+        /* The number of allocations that ran out of device memory, even after evicting. */
+        uint64_t n_failures;
+    };
+
+
+
+    /* The MemoryBudget class, which tracks the usage and budget of each memory heap of a Device, either through VK_EXT_memory_budget or by counting its own allocations. */
+    class MemoryBudget {
+    public:
+        /* Channel name for the MemoryBudget class. */
+        static constexpr const char* channel = "MemoryBudget";
+        /* The fraction of a heap that is used as budget if the device cannot report one, leaving room for other processes and the driver. */
+        static constexpr const double fallback_budget = 0.8;
+
+        /* Function that is called when the usage of a heap crosses a threshold. Gets the index of the heap, its budget, the threshold and whether it was crossed upwards (true) or downwards (false). */
+        using threshold_callback_t = std::function<void(uint32_t, const HeapBudget&, double, bool)>;
+        /* Function that is asked to give back memory from a heap, e.g., by dropping the highest mips of streamed textures or unloading meshes that are out of view. Gets the index of the heap and the number of bytes needed, and returns the number of bytes it released (or retired). */
+        using evictor_t = std::function<VkDeviceSize(uint32_t, VkDeviceSize)>;
+        /* Identifies a registered callback or evictor. */
+        using callback_id_t = uint32_t;
+
+    private:
+        /* A registered threshold. */
+        struct Threshold {
+            /* The identifier of the threshold. */
+            callback_id_t id;
+            /* The fraction of the budget at which the callback is called. */
+            double fraction;
+            /* The function to call. */
+            threshold_callback_t callback;
+            /* For each heap, whether its usage is currently above the threshold. */
+            Tools::Array<bool> above;
+        };
+
+        /* A registered evictor. */
+        struct Evictor {
+            /* The identifier of the evictor. */
+            callback_id_t id;
+            /* The function to call. */
+            evictor_t evict;
+        };
+
+        /* The VkDevice on which we allocate. */
+        VkDevice vk_device;
+        /* The functions of the device. */
+        const DeviceDispatch& dispatch;
+        /* The physical device whose budget we query. */
+        VkPhysicalDevice vk_physical_device;
+        /* The function to query the budget with, or nullptr if VK_EXT_memory_budget isn't enabled. */
+        PFN_vkGetPhysicalDeviceMemoryProperties2 vk_get_memory_properties2;
+        /* The DeletionQueue to collect after evicting, so retired memory is given back as soon as the GPU allows. */
+        DeletionQueue& deletion_queue;
+        /* The memory properties of the physical device, to map memory types to heaps. */
+        VkPhysicalDeviceMemoryProperties memory_properties;
+
+        /* The budget of each heap, as of the last update(). */
+        Tools::Array<HeapBudget> heaps;
+        /* For each heap, the number of bytes allocated through this class. */
+        std::atomic<VkDeviceSize> tracked[VK_MAX_MEMORY_HEAPS];
+        /* For each heap, the number of bytes allocated through this class at the last update(), so the usage can be estimated in between. */
+        VkDeviceSize tracked_at_update[VK_MAX_MEMORY_HEAPS];
+
+        /* The registered thresholds, in ascending order of fraction. */
+        Tools::Array<Threshold> thresholds;
+        /* The registered evictors, in the order they are asked. */
+        Tools::Array<Evictor> evictors;
+        /* The identifier given to the next threshold or evictor. */
+        callback_id_t next_id;
+        /* The statistics of this budget. */
+        MemoryBudgetStatistics _statistics;
+        /* Lock for the heaps, thresholds and evictors. */
+        mutable std::mutex lock;
+
+
+        /* Returns the estimated usage of the given heap, i.e., the usage of the last update() plus what we allocated since. Assumes the lock is taken. */
+        VkDeviceSize estimate(uint32_t heap) const;
+        /* Asks the evictors to give back the given number of bytes from the given heap. Assumes the lock is taken.
+         * @returns The number of bytes they gave back. */
+        VkDeviceSize evict(uint32_t heap, VkDeviceSize bytes);
+
+    public:
+        /* Constructor for the MemoryBudget class.
+         * @param vk_device The VkDevice on which allocations are made.
+         * @param dispatch The functions of the device. Has to outlive the budget.
+         * @param physical_device The physical device of the VkDevice.
+         * @param get_memory_properties2 The vkGetPhysicalDeviceMemoryProperties2 function of the instance if VK_EXT_memory_budget is enabled, or nullptr to count our own allocations against a fixed fraction of each heap instead.
+         * @param deletion_queue The DeletionQueue of the device. Has to outlive the budget. */
+        MemoryBudget(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, PFN_vkGetPhysicalDeviceMemoryProperties2 get_memory_properties2, DeletionQueue& deletion_queue);
+        /* Copy constructor for the MemoryBudget class, which is deleted. */
+        MemoryBudget(const MemoryBudget& other) = delete;
+        /* Move constructor for the MemoryBudget class, which is deleted. */
+        MemoryBudget(MemoryBudget&& other) = delete;
+        /* Destructor for the MemoryBudget class. */
+        ~MemoryBudget();
+
+        /* Refreshes the usage and budget of each heap, and calls the callbacks of the thresholds that were crossed. Should be called once per frame (e.g., when acquiring a swapchain image), since the device only updates its budget that often. */
+        void update();
+
+        /* Registers a function that is called from update() when the usage of any heap crosses the given fraction of its budget, in either direction. Can be called from any thread.
+         * @param fraction The fraction of the budget (e.g., 0.9 for 90%).
+         * @param callback The function to call. May not register or remove callbacks itself.
+         * @returns The identifier with which the threshold can be removed again. */
+        callback_id_t add_threshold(double fraction, threshold_callback_t&& callback);
+        /* Removes the threshold with the given identifier. Can be called from any thread. */
+        void remove_threshold(callback_id_t id);
+        /* Registers a function that is asked to give memory back when a heap runs over its budget. Evictors are asked in the order they were added, until enough memory is given back. Can be called from any thread.
+         * @param evictor The function to call. May not register or remove evictors itself, nor allocate through this budget.
+         * @returns The identifier with which the evictor can be removed again. */
+        callback_id_t add_evictor(evictor_t&& evictor);
+        /* Removes the evictor with the given identifier. Can be called from any thread. */
+        void remove_evictor(callback_id_t id);
+
+        /* Makes sure the given number of bytes fits in the budget of the heap of the given memory type, evicting if it doesn't. Can be called from any thread.
+         * @param memory_type The memory type that will be allocated from.
+         * @param size The number of bytes that will be allocated.
+         * @returns Whether the bytes fit in the budget (true), or still don't after evicting (false). Allocating may still succeed in the latter case, but at the risk of slowing down or failing. */
+        bool reserve(uint32_t memory_type, VkDeviceSize size);
+        /* Allocates memory through the budget: it first makes room with reserve(), and if the device still runs out of memory, evicts and tries once more. Can be called from any thread.
+         * @param allocate_info The VkMemoryAllocateInfo that describes the allocation.
+         * @param vk_memory Will be set to the new memory.
+         * @returns The result of vkAllocateMemory(). */
+        VkResult allocate(const VkMemoryAllocateInfo& allocate_info, VkDeviceMemory& vk_memory);
+        /* Frees memory that was allocated with allocate(). Can be called from any thread.
+         * @param vk_memory The memory to free.
+         * @param memory_type The memory type it was allocated from.
+         * @param size The size it was allocated with. */
+        void free(VkDeviceMemory vk_memory, uint32_t memory_type, VkDeviceSize size);
+
+        /* Returns the budget of the given heap, with its usage estimated from the last update() and the allocations made through this class since. */
+        HeapBudget heap(uint32_t heap) const;
+        /* Returns the number of memory heaps. */
+        inline uint32_t n_heaps() const { return this->heaps.size(); }
+        /* Returns the index of the heap of the given memory type. */
+        inline uint32_t heap_of(uint32_t memory_type) const { return this->memory_properties.memoryTypes[memory_type].heapIndex; }
+        /* Returns whether the budget comes from the device (true), or is estimated from our own allocations (false). */
+        inline bool from_device() const { return this->vk_get_memory_properties2 != nullptr; }
+        /* Returns the statistics of this budget. */
+        inline const MemoryBudgetStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the MemoryBudget class, which is deleted. */
+        MemoryBudget& operator=(const MemoryBudget& other) = delete;
+        /* Move assignment operator for the MemoryBudget class, which is deleted. */
+        MemoryBudget& operator=(MemoryBudget&& other) = delete;
+
+    };
+}
+
+#endif
@@ -16,6 +16,7 @@
 #ifndef GPU_PHYSICAL_DEVICE_HPP
 #define GPU_PHYSICAL_DEVICE_HPP
 
+#include <memory>
 #include <vulkan/vulkan.h>
 #include "arrays/Array.hpp"
 
@@ -23,6 +24,26 @@
 #include "DeviceFeature.hpp"
 
 namespace Makma3D {
+    /* Everything we query once about a physical device. Shared (immutably) between all copies of the same PhysicalDevice. */
+    struct PhysicalDeviceInfo {
+        /* The general properties (name, type, limits, ...) of the device. */
+        VkPhysicalDeviceProperties properties;
+        /* The features supported by the device. */
+        VkPhysicalDeviceFeatures features;
+        /* The memory heaps and types of the device. */
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        /* The queue families of the device. */
+        Tools::Array<VkQueueFamilyProperties> queue_families;
+        /* The device extensions supported by the device. */
+        Tools::Array<VkExtensionProperties> extensions;
+        /* The Vulkan version we can use on the device, i.e., the lowest of the instance's and the device's version. */
+        uint32_t api_version;
+        /* The Makma3D DeviceFeatures that the device supports, through its version or through extensions. */
+        Tools::Array<Vulkanic::DeviceFeature> supported_features;
+    };
+
+
+
     /* The PhysicalDevice class, which represents a single GPU registered in the Vulkan instance. */
     class PhysicalDevice {
     public:
@@ -32,8 +53,8 @@ namespace Makma3D {
     private:
         /* The VkPhysicalDevice we wrap. */
         VkPhysicalDevice vk_physical_device;
-        /* The properties of the physical device. */
-        VkPhysicalDeviceProperties* vk_physical_device_properties;
+        /* The cached information about the physical device. */
+        std::shared_ptr<const PhysicalDeviceInfo> _info;
 
         /* The index of the physical device in the list. */
         uint32_t _index;
@@ -41,31 +62,50 @@ namespace Makma3D {
         PhysicalDeviceType _type;
 
     public:
-        /* Constructor for the PhysicalDevice class.
+        /* Constructor for the PhysicalDevice class, which queries all information about the device once.
          * @param vk_physical_device The Vulkan physical device we wrap. Will be automatically deallocated when this class is.
-         * @param index The index of the physical device in the list of devices. */
-        PhysicalDevice(VkPhysicalDevice vk_physical_device, uint32_t index);
-        /* Copy constructor for the PhysicalDevice class. */
+         * @param index The index of the physical device in the list of devices.
+         * @param instance_version The Vulkan version of the instance, which caps the version we use on the device.
+         * @param get_features2 The vkGetPhysicalDeviceFeatures2 function (or its KHR variant) of the instance, or nullptr if it's unavailable. In that case, only Vulkan 1.0 features are queried. */
+        PhysicalDevice(VkPhysicalDevice vk_physical_device, uint32_t index, uint32_t instance_version, PFN_vkGetPhysicalDeviceFeatures2 get_features2);
+        /* Copy constructor for the PhysicalDevice class. Cheap, since the cached information is shared. */
         PhysicalDevice(const PhysicalDevice& other);
         /* Move constructor for the PhysicalDevice class. */
         PhysicalDevice(PhysicalDevice&& other);
         /* Destructor for the PhysicalDevice class. */
         ~PhysicalDevice();
 
-        /* Static function that determines if the given physical device is supported.
-         * @param vk_physical_device The Vulkan physical device that we're gonna check out.
-         * @param vk_surface The VkSurface object used to check if this device can present to that Surface.
+        /* Determines if this physical device is supported, using the cached information wherever possible.
+         * @param vk_surface The VkSurface object used to check if this device can present to that Surface. If nullptr, presentation support is not required (headless mode).
          * @param vk_device_extensions The list of Vulkan GPU extensions that the device should at least support.
          * @param vk_device_features The list of Vulkan GPU features (as Vulkanic::DeviceFeatures enums) that the device should at least support.
          * @returns Whether or not this device is suitable for the Makma3D engine (true) or not (false). */
-        static bool is_suitable(VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features);
+        bool is_suitable(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const;
+        /* Returns whether the device supports the given device extension. */
+        bool supports_extension(const char* extension) const;
+        /* Returns whether the device supports the given Makma3D DeviceFeature. */
+        bool supports_feature(Vulkanic::DeviceFeature feature) const;
 
         /* Returns the index of the GPU in Vulkan's list. */
         inline uint32_t index() const { return this->_index; }
         /* Returns the name of the GPU. */
-        inline const char* name() const { return this->vk_physical_device_properties->deviceName; }
+        inline const char* name() const { return this->_info->properties.deviceName; }
         /* Returns the Vulkan-assigned type of the GPU. */
         inline PhysicalDeviceType type() const { return this->_type; }
+        /* Returns the cached properties of the GPU. */
+        inline const VkPhysicalDeviceProperties& properties() const { return this->_info->properties; }
+        /* Returns the cached supported features of the GPU. */
+        inline const VkPhysicalDeviceFeatures& features() const { return this->_info->features; }
+        /* Returns the cached memory properties of the GPU. */
+        inline const VkPhysicalDeviceMemoryProperties& memory_properties() const { return this->_info->memory_properties; }
+        /* Returns the cached queue families of the GPU. */
+        inline const Tools::Array<VkQueueFamilyProperties>& queue_families() const { return this->_info->queue_families; }
+        /* Returns the cached supported device extensions of the GPU. */
+        inline const Tools::Array<VkExtensionProperties>& extensions() const { return this->_info->extensions; }
+        /* Returns the Vulkan version we can use on the GPU, as given by VK_MAKE_API_VERSION(). */
+        inline uint32_t api_version() const { return this->_info->api_version; }
+        /* Returns the Makma3D DeviceFeatures that the GPU supports. */
+        inline const Tools::Array<Vulkanic::DeviceFeature>& supported_features() const { return this->_info->supported_features; }
         /* Explicitly returns the internal VkPhysicalDevice object. */
         inline const VkPhysicalDevice& vk() const { return this->vk_physical_device; }
         /* Implicitly returns the internal VkPhysicalDevice object. */
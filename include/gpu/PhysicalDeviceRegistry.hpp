@@ -0,0 +1,88 @@
+/* PHYSICAL DEVICE REGISTRY.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 17:12:04
+ * Last edited:
+ *   16/10/2021, 17:12:04
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the PhysicalDeviceRegistry class, which enumerates the
+ *   physical devices of an instance once, caches them and scores them to
+ *   select the most suitable one.
+**/
+
+#ifndef GPU_PHYSICAL_DEVICE_REGISTRY_HPP
+#define GPU_PHYSICAL_DEVICE_REGISTRY_HPP
+
+#include <vulkan/vulkan.h>
+#include "arrays/Array.hpp"
+
+#include "PhysicalDeviceType.hpp"
+#include "PhysicalDevice.hpp"
+
+namespace Makma3D {
+    /* The PhysicalDeviceRegistry class, which keeps a cached list of all physical devices in a Vulkan instance. */
+    class PhysicalDeviceRegistry {
+    public:
+        /* Channel name for the PhysicalDeviceRegistry class. */
+        static constexpr const char* channel = "PhysicalDeviceRegistry";
+
+    private:
+        /* All physical devices known to the instance, whether they're suitable or not. */
+        Tools::Array<PhysicalDevice> _devices;
+
+    public:
+        /* Constructor for the PhysicalDeviceRegistry class, which initializes it to empty. Use enumerate() to fill it. */
+        PhysicalDeviceRegistry();
+        /* Copy constructor for the PhysicalDeviceRegistry class, which is deleted. */
+        PhysicalDeviceRegistry(const PhysicalDeviceRegistry& other) = delete;
+        /* Move constructor for the PhysicalDeviceRegistry class. */
+        PhysicalDeviceRegistry(PhysicalDeviceRegistry&& other);
+        /* Destructor for the PhysicalDeviceRegistry class. */
+        ~PhysicalDeviceRegistry();
+
+        /* Enumerates the physical devices in the given instance and queries everything about them, replacing any previously cached devices.
+         * @param vk_instance The VkInstance whose devices to enumerate.
+         * @param instance_version The negotiated Vulkan version of the instance.
+         * @param get_features2 The vkGetPhysicalDeviceFeatures2 function (or its KHR variant) of the instance, or nullptr if it's unavailable. */
+        void enumerate(VkInstance vk_instance, uint32_t instance_version, PFN_vkGetPhysicalDeviceFeatures2 get_features2);
+
+        /* Returns the (cached) physical devices that are suitable for the Makma3D engine.
+         * @param vk_surface The VkSurface object used to check if a device can present to that Surface. If nullptr, presentation support is not required (headless mode).
+         * @param vk_device_extensions The list of Vulkan GPU extensions that the device should at least support.
+         * @param vk_device_features The list of Vulkan GPU features (as Vulkanic::DeviceFeatures enums) that the device should at least support.
+         * @returns The list of suitable physical devices. Empty if no such devices are present. */
+        Tools::Array<PhysicalDevice> get_suitable(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const;
+
+        /* Scores the given physical device on its type, the size of its device-local memory, its queue topology and its limits. Higher is better.
+         * @param physical_device The physical device to score.
+         * @param preferred_type The type of device to prefer. A device of this type always outscores a device of another type.
+         * @returns The score of the device. */
+        static double score(const PhysicalDevice& physical_device, PhysicalDeviceType preferred_type);
+        /* Selects the physical device with the highest score from the given list.
+         * @param candidates The non-empty list of physical devices to choose from.
+         * @param preferred_type The type of device to prefer.
+         * @returns A reference to the best device in the given list. */
+        static const PhysicalDevice& select(const Tools::Array<PhysicalDevice>& candidates, PhysicalDeviceType preferred_type);
+
+        /* Returns all physical devices known to the instance, whether they're suitable or not. */
+        inline const Tools::Array<PhysicalDevice>& devices() const { return this->_devices; }
+
+        /* Copy assignment operator for the PhysicalDeviceRegistry class, which is deleted. */
+        PhysicalDeviceRegistry& operator=(const PhysicalDeviceRegistry& other) = delete;
+        /* Move assignment operator for the PhysicalDeviceRegistry class. */
+        inline PhysicalDeviceRegistry& operator=(PhysicalDeviceRegistry&& other) { if (this != &other) { swap(*this, other); } return *this; }
+        /* Swap operator for the PhysicalDeviceRegistry class. */
+        friend void swap(PhysicalDeviceRegistry& pdr1, PhysicalDeviceRegistry& pdr2);
+
+    };
+
+    /* Swap operator for the PhysicalDeviceRegistry class. */
+    void swap(PhysicalDeviceRegistry& pdr1, PhysicalDeviceRegistry& pdr2);
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/* QUEUE.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 10:31:12
+ * Last edited:
+ *   17/10/2021, 10:31:12
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Queue class, which wraps a single VkQueue together with
+ *   the lock that guards submissions to it, and the QueueLease class,
+ *   which gives a thread exclusive access to a Queue for as long as it
+ *   lives.
+**/
+
+#ifndef GPU_QUEUE_HPP
+#define GPU_QUEUE_HPP
+
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "Timeline.hpp"
+
+namespace Makma3D {
+    /* The Queue class, which wraps a single hardware queue of a Device. */
+    class Queue {
+    public:
+        /* Channel name for the Queue class. */
+        static constexpr const char* channel = "Queue";
+
+    private:
+        /* The VkQueue we wrap. */
+        VkQueue vk_queue;
+        /* The queue family of the queue. */
+        uint32_t _family;
+        /* The index of the queue within its family. */
+        uint32_t _index;
+        /* The Timeline that counts the submissions on this queue. */
+        Timeline* _timeline;
+        /* The lock that guards access to the queue. Recursive, since multiple QueueTypes may share a queue and a thread may lease it for both. */
+        std::recursive_mutex lock;
+
+        /* Declare the QueueLease as a friend, so it can take the lock. */
+        friend class QueueLease;
+
+    public:
+        /* Constructor for the Queue class.
+         * @param vk_queue The VkQueue to wrap.
+         * @param family The queue family of the queue.
+         * @param index The index of the queue within its family.
+         * @param timeline The Timeline that counts the submissions on this queue. The Queue takes ownership of it. */
+        Queue(VkQueue vk_queue, uint32_t family, uint32_t index, Timeline* timeline);
+        /* Copy constructor for the Queue class, which is deleted. */
+        Queue(const Queue& other) = delete;
+        /* Move constructor for the Queue class, which is deleted since leases point to it. */
+        Queue(Queue&& other) = delete;
+        /* Destructor for the Queue class. */
+        ~Queue();
+
+        /* Returns the queue family of the queue. */
+        inline uint32_t family() const { return this->_family; }
+        /* Returns the index of the queue within its family. */
+        inline uint32_t index() const { return this->_index; }
+        /* Returns the Timeline that counts the submissions on this queue, i.e., its progress on the GPU. */
+        inline Timeline& timeline() const { return *this->_timeline; }
+        /* Explicitly returns the internal VkQueue object. Only use it while holding a QueueLease on this queue. */
+        inline const VkQueue& vk() const { return this->vk_queue; }
+
+        /* Copy assignment operator for the Queue class, which is deleted. */
+        Queue& operator=(const Queue& other) = delete;
+        /* Move assignment operator for the Queue class, which is deleted. */
+        Queue& operator=(Queue&& other) = delete;
+
+    };
+
+
+
+    /* The QueueLease class, which holds exclusive access to a Queue until it is destroyed. */
+    class QueueLease {
+    private:
+        /* The leased queue, or nullptr if the lease is empty. */
+        Queue* queue;
+        /* The lock on the queue. */
+        std::unique_lock<std::recursive_mutex> lock;
+
+    public:
+        /* Default constructor for the QueueLease class, which creates an empty lease. */
+        QueueLease() : queue(nullptr) {}
+        /* Constructor for the QueueLease class, which blocks until the given queue is available. */
+        QueueLease(Queue& queue) : queue(&queue), lock(queue.lock) {}
+        /* Constructor for the QueueLease class, which only leases the given queue if it's immediately available. Otherwise, the lease is empty. */
+        QueueLease(Queue& queue, std::try_to_lock_t) : queue(&queue), lock(queue.lock, std::try_to_lock) { if (!this->lock.owns_lock()) { this->queue = nullptr; } }
+        /* Copy constructor for the QueueLease class, which is deleted. */
+        QueueLease(const QueueLease& other) = delete;
+        /* Move constructor for the QueueLease class. */
+        QueueLease(QueueLease&& other) : queue(other.queue), lock(std::move(other.lock)) { other.queue = nullptr; }
+
+        /* Leases one of the given queues, blocking until one is available. Threads start looking at different offsets, so they tend to stick to different queues.
+         * @param candidates The non-empty list of queues to choose from.
+         * @returns A QueueLease for the leased queue. */
+        static QueueLease lease_any(const Tools::Array<Queue*>& candidates);
+        /* Tries to lease one of the given queues without blocking.
+         * @param candidates The list of queues to choose from.
+         * @returns A QueueLease for the leased queue, or an empty one if they are all leased already. */
+        static QueueLease try_lease_any(const Tools::Array<Queue*>& candidates);
+
+        /* Returns whether this lease holds a queue. */
+        inline bool valid() const { return this->queue != nullptr; }
+        /* Returns whether this lease holds a queue. */
+        inline explicit operator bool() const { return this->queue != nullptr; }
+        /* Returns the queue family of the leased queue. */
+        inline uint32_t family() const { return this->queue->family(); }
+        /* Returns the index of the leased queue within its family. */
+        inline uint32_t index() const { return this->queue->index(); }
+        /* Returns the Timeline of the leased queue. */
+        inline Timeline& timeline() const { return this->queue->timeline(); }
+        /* Explicitly returns the leased VkQueue object. */
+        inline const VkQueue& vk() const { return this->queue->vk(); }
+        /* Implicitly returns the leased VkQueue object. */
+        inline operator const VkQueue&() const { return this->queue->vk(); }
+
+        /* Copy assignment operator for the QueueLease class, which is deleted. */
+        QueueLease& operator=(const QueueLease& other) = delete;
+        /* Move assignment operator for the QueueLease class. */
+        inline QueueLease& operator=(QueueLease&& other) { if (this != &other) { this->lock = std::move(other.lock); this->queue = other.queue; other.queue = nullptr; } return *this; }
+
+    };
+}
+
+#endif
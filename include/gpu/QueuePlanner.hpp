@@ -0,0 +1,69 @@
+/* QUEUE PLANNER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 10:04:31
+ * Last edited:
+ *   17/10/2021, 10:04:31
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the QueuePlanner class, which decides which queue families
+ *   are used for which QueueType, how many queues to create of each
+ *   family and which of those queues each QueueType may submit to.
+**/
+
+#ifndef GPU_QUEUE_PLANNER_HPP
+#define GPU_QUEUE_PLANNER_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "arrays/StackArray.hpp"
+
+#include "QueueType.hpp"
+#include "PhysicalDevice.hpp"
+
+namespace Makma3D {
+    /* The QueuePlanner class, which plans the queue topology of a Device before it is created. */
+    class QueuePlanner {
+    public:
+        /* Channel name for the QueuePlanner class. */
+        static constexpr const char* channel = "QueuePlanner";
+        /* The number of queues we'd like for each QueueType. Graphics and compute get more than one so multiple threads can submit to them in parallel. */
+        static constexpr const uint32_t desired_queues[Vulkanic::n_queue_types] = { 1, 2, 2, 1 };
+
+        /* Identifies a single queue on the device. */
+        struct Slot {
+            /* The queue family of the queue. */
+            uint32_t family;
+            /* The index of the queue within its family. */
+            uint32_t index;
+        };
+
+    private:
+        /* The unique queue families to create, each with the number of queues to create of them. */
+        Tools::Array<std::pair<uint32_t, uint32_t>> _families;
+        /* The queue family used for each QueueType. */
+        Tools::StackArray<uint32_t, Vulkanic::n_queue_types> _type_families;
+        /* The queues that each QueueType may use. Queues are shared between types if their family doesn't have enough of them. */
+        Tools::Array<Tools::Array<Slot>> _type_slots;
+
+    public:
+        /* Constructor for the QueuePlanner class, which computes the plan.
+         * @param physical_device The PhysicalDevice whose queues to plan.
+         * @param vk_surface The VkSurfaceKHR used to determine which families can present. If nullptr, the present type aliases the graphics queue (headless mode). */
+        QueuePlanner(const PhysicalDevice& physical_device, VkSurfaceKHR vk_surface);
+
+        /* Returns the unique queue families to create, as <family index, queue count> pairs. Every family appears exactly once. */
+        inline const Tools::Array<std::pair<uint32_t, uint32_t>>& families() const { return this->_families; }
+        /* Returns the queue family used for each QueueType. */
+        inline const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& type_families() const { return this->_type_families; }
+        /* Returns the queues that the given QueueType may use. There's always at least one. */
+        inline const Tools::Array<Slot>& slots(Vulkanic::QueueType queue_type) const { return this->_type_slots[(uint32_t) queue_type]; }
+
+    };
+}
+
+#endif
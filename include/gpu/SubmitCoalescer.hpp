@@ -0,0 +1,134 @@
+/* SUBMIT COALESCER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 13:20:18
+ * Last edited:
+ *   17/10/2021, 13:20:18
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the SubmitCoalescer class, which collects submissions from
+ *   any number of threads in a lock-free queue and submits them to the
+ *   GPU in a single vkQueueSubmit() call per flush.
+**/
+
+#ifndef GPU_SUBMIT_COALESCER_HPP
+#define GPU_SUBMIT_COALESCER_HPP
+
+#include <atomic>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "QueueType.hpp"
+#include "Queue.hpp"
+#include "Timeline.hpp"
+#include "DeviceDispatch.hpp"
+
+namespace Makma3D {
+    /* A single batch of work to submit, which becomes a single VkSubmitInfo. */
+    struct Submission {
+        /* The command buffers to execute, in order. */
+        Tools::Array<VkCommandBuffer> command_buffers;
+        /* The semaphores to wait on before executing. */
+        Tools::Array<VkSemaphore> wait_semaphores;
+        /* For each wait semaphore, the pipeline stage at which to wait for it. */
+        Tools::Array<VkPipelineStageFlags> wait_stages;
+        /* Points on other queues' timelines to wait for before executing, e.g., as returned by another coalescer's flush(). */
+        Tools::Array<SyncPoint> wait_points;
+        /* For each wait point, the pipeline stage at which to wait for it. */
+        Tools::Array<VkPipelineStageFlags> wait_point_stages;
+        /* The semaphores to signal once the command buffers are done. */
+        Tools::Array<VkSemaphore> signal_semaphores;
+    };
+
+    /* Counts the submissions that went through a SubmitCoalescer. */
+    struct SubmitStatistics {
+        /* The number of flushes, i.e., frames. */
+        uint64_t n_flushes;
+        /* The number of vkQueueSubmit() calls. */
+        uint64_t n_submits;
+        /* The number of submissions (VkSubmitInfos) that were submitted, excluding the ones that only signal the timeline. */
+        uint64_t n_submissions;
+
+        /* Returns the average number of vkQueueSubmit() calls per frame. */
+        inline double submits_per_frame() const { return this->n_flushes > 0 ? static_cast<double>(this->n_submits) / this->n_flushes : 0.0; }
+        /* Returns the average number of submissions batched in a single vkQueueSubmit() call. */
+        inline double submissions_per_submit() const { return this->n_submits > 0 ? static_cast<double>(this->n_submissions) / this->n_submits : 0.0; }
+    };
+
+
+
+    /* The SubmitCoalescer class, which batches the submissions of many threads to the queues of one QueueType. */
+    class SubmitCoalescer {
+    public:
+        /* Channel name for the SubmitCoalescer class. */
+        static constexpr const char* channel = "SubmitCoalescer";
+
+    private:
+        /* A node in the lock-free list of pending submissions. */
+        struct Node {
+            /* The submission itself. */
+            Submission submission;
+            /* The node that was pushed before this one. */
+            Node* next;
+        };
+
+        /* The functions of the device, with which we submit. */
+        const DeviceDispatch& dispatch;
+        /* The type of the queues we submit to. */
+        Vulkanic::QueueType queue_type;
+        /* The queues we submit to. */
+        Tools::Array<Queue*> queues;
+        /* The most recently pushed pending submission. The list runs backwards, from newest to oldest. */
+        std::atomic<Node*> head;
+
+        /* The statistics of this coalescer. */
+        SubmitStatistics _statistics;
+
+    public:
+        /* Constructor for the SubmitCoalescer class.
+         * @param dispatch The functions of the device, with which we submit. Has to outlive the coalescer.
+         * @param queue_type The type of the queues we submit to, for logging purposes.
+         * @param queues The queues we submit to. They have to outlive the coalescer. */
+        SubmitCoalescer(const DeviceDispatch& dispatch, Vulkanic::QueueType queue_type, const Tools::Array<Queue*>& queues);
+        /* Copy constructor for the SubmitCoalescer class, which is deleted. */
+        SubmitCoalescer(const SubmitCoalescer& other) = delete;
+        /* Move constructor for the SubmitCoalescer class, which is deleted. */
+        SubmitCoalescer(SubmitCoalescer&& other) = delete;
+        /* Destructor for the SubmitCoalescer class. */
+        ~SubmitCoalescer();
+
+        /* Queues the given submission for the next flush. Can be called from any thread without locking.
+         * @param submission The submission to queue. */
+        void enqueue(const Submission& submission);
+        /* Queues the given submission for the next flush. Can be called from any thread without locking.
+         * @param submission The submission to queue. Will be moved into the queue. */
+        void enqueue(Submission&& submission);
+        /* Queues a single command buffer for the next flush, with optional semaphores. Can be called from any thread without locking.
+         * @param vk_command_buffer The command buffer to execute.
+         * @param vk_wait_semaphore A semaphore to wait on first, or nullptr to not wait.
+         * @param wait_stage The pipeline stage at which to wait for the semaphore.
+         * @param vk_signal_semaphore A semaphore to signal afterwards, or nullptr to not signal anything. */
+        void enqueue(VkCommandBuffer vk_command_buffer, VkSemaphore vk_wait_semaphore = nullptr, VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkSemaphore vk_signal_semaphore = nullptr);
+
+        /* Submits all pending submissions, in the order in which they were queued, with a single vkQueueSubmit() call. Should be called once per frame, from one thread at a time.
+         * The submit also signals the used queue's Timeline, so other queues and the CPU can wait for it.
+         * @param vk_fence A fence to signal once all submissions are done, or nullptr. The fence is signalled even if nothing was pending.
+         * @returns The SyncPoint that is reached once all submissions are done, or the null_sync_point if nothing was submitted. */
+        SyncPoint flush(VkFence vk_fence = nullptr);
+
+        /* Returns the statistics of this coalescer. */
+        inline const SubmitStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the SubmitCoalescer class, which is deleted. */
+        SubmitCoalescer& operator=(const SubmitCoalescer& other) = delete;
+        /* Move assignment operator for the SubmitCoalescer class, which is deleted. */
+        SubmitCoalescer& operator=(SubmitCoalescer&& other) = delete;
+
+    };
+}
+
+#endif
@@ -0,0 +1,162 @@
+/* TIMELINE.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 15:11:40
+ * Last edited:
+ *   17/10/2021, 15:11:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Timeline class, which tracks the progress of a single
+ *   queue as an ever-increasing counter. Uses a timeline semaphore if the
+ *   device supports them, and falls back to fences and binary semaphores
+ *   otherwise.
+**/
+
+#ifndef GPU_TIMELINE_HPP
+#define GPU_TIMELINE_HPP
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+
+#include "DeviceDispatch.hpp"
+
+namespace Makma3D {
+    /* Describes how a submission should signal a Timeline. */
+    struct TimelineSignal {
+        /* The semaphore to signal. */
+        VkSemaphore vk_semaphore;
+        /* The value to signal it with (only relevant for timeline semaphores). */
+        uint64_t value;
+        /* The fence to signal with the submission, or nullptr if none is needed. */
+        VkFence vk_fence;
+    };
+
+
+
+    /* The Timeline class, which counts the submissions that are done on a single queue. */
+    class Timeline {
+    public:
+        /* Channel name for the Timeline class. */
+        static constexpr const char* channel = "Timeline";
+
+    private:
+        /* A pending signal in the binary fallback. */
+        struct Signal {
+            /* The value that is reached once the signal fires. */
+            uint64_t value;
+            /* The fence that fires with the signal, for CPU waits. */
+            VkFence vk_fence;
+            /* The binary semaphore that fires with the signal, for a single GPU wait. */
+            VkSemaphore vk_semaphore;
+            /* Whether a GPU wait on the semaphore has been submitted already, in which case the semaphore belongs to the waiting timeline. */
+            bool waited;
+            /* Semaphores of other timelines that were waited on by this signal's submission. They belong to this timeline, and are free again once it is done. */
+            Tools::Array<VkSemaphore> consumed;
+        };
+
+        /* The VkDevice on which the timeline lives. */
+        VkDevice vk_device;
+        /* The functions of the device, which include the timeline semaphore ones if they are supported. */
+        const DeviceDispatch& dispatch;
+        /* Whether we use a timeline semaphore (true) or the binary fallback (false). */
+        bool _is_timeline;
+        /* The timeline semaphore, if we use one. */
+        VkSemaphore vk_semaphore;
+
+        /* The value of the last signal that was handed out. */
+        std::atomic<uint64_t> _submitted;
+        /* The value of the last signal that is known to be done. */
+        std::atomic<uint64_t> _completed;
+
+        /* The pending signals of the binary fallback, oldest first. */
+        Tools::Array<Signal> signals;
+        /* Fences that can be reused by the binary fallback. */
+        Tools::Array<VkFence> free_fences;
+        /* Unsignalled binary semaphores that can be reused by the binary fallback. */
+        Tools::Array<VkSemaphore> free_semaphores;
+        /* Lock for the binary fallback's state. */
+        std::mutex lock;
+
+
+        /* Retires the pending signals of the binary fallback that are done. Assumes the lock is taken. */
+        void retire_signals();
+
+    public:
+        /* Constructor for the Timeline class.
+         * @param vk_device The VkDevice on which the timeline lives.
+         * @param dispatch The functions of the device. Has to outlive the timeline.
+         * @param is_timeline Whether to use a timeline semaphore (true) or the binary fallback (false). Requires the timeline semaphore functions to be loaded. */
+        Timeline(VkDevice vk_device, const DeviceDispatch& dispatch, bool is_timeline);
+        /* Copy constructor for the Timeline class, which is deleted. */
+        Timeline(const Timeline& other) = delete;
+        /* Move constructor for the Timeline class, which is deleted. */
+        Timeline(Timeline&& other) = delete;
+        /* Destructor for the Timeline class. Assumes the queue is idle. */
+        ~Timeline();
+
+        /* Reserves the next value on the timeline, and returns how a submission should signal it.
+         * Must be called while holding a lease on the timeline's queue, and the signal must be submitted to it before the lease is released.
+         * @param consumed Binary semaphores of other timelines that the submission waits on (see prepare_wait()). This timeline takes them over, and recycles them once the signal fires.
+         * @returns A TimelineSignal that should be added to the submission. */
+        TimelineSignal prepare_signal(const Tools::Array<VkSemaphore>& consumed = {});
+        /* Returns how a submission on another queue can wait until the given value is reached.
+         * In the binary fallback, only the first waiter for a value can wait on the GPU; later ones are waited for on the CPU instead.
+         * @param value The value to wait for.
+         * @param vk_semaphore Will be set to the semaphore to wait on.
+         * @param wait_value Will be set to the value to wait for (only relevant for timeline semaphores).
+         * @param consumed In the binary fallback, the semaphore to wait on is added to this list; pass it to the waiting timeline's prepare_signal().
+         * @returns Whether the submission should wait (true), or whether the value has been reached already (false). */
+        bool prepare_wait(uint64_t value, VkSemaphore& vk_semaphore, uint64_t& wait_value, Tools::Array<VkSemaphore>& consumed);
+
+        /* Returns the value of the last submission that is known to be done, i.e., the GPU's progress on this queue. */
+        uint64_t completed();
+        /* Returns whether the given value has been reached. */
+        inline bool is_complete(uint64_t value) { return value <= this->_completed.load() || value <= this->completed(); }
+        /* Waits on the CPU until the given value is reached.
+         * @param value The value to wait for.
+         * @param timeout The maximum number of nanoseconds to wait.
+         * @returns Whether the value was reached (true) or the wait timed out (false). */
+        bool wait(uint64_t value, uint64_t timeout = std::numeric_limits<uint64_t>::max());
+
+        /* Returns the value of the last submission that signals this timeline. */
+        inline uint64_t submitted() const { return this->_submitted.load(); }
+        /* Returns whether the timeline uses a timeline semaphore (true) or the binary fallback (false). */
+        inline bool is_timeline() const { return this->_is_timeline; }
+
+        /* Copy assignment operator for the Timeline class, which is deleted. */
+        Timeline& operator=(const Timeline& other) = delete;
+        /* Move assignment operator for the Timeline class, which is deleted. */
+        Timeline& operator=(Timeline&& other) = delete;
+
+    };
+
+
+
+    /* A point on a Timeline, i.e., the completion of a specific submission on a specific queue. */
+    struct SyncPoint {
+        /* The timeline of the queue, or nullptr for a point that is always complete. */
+        Timeline* timeline;
+        /* The value on the timeline. */
+        uint64_t value;
+
+        /* Returns whether the GPU has reached this point. */
+        inline bool is_complete() const { return this->timeline == nullptr || this->timeline->is_complete(this->value); }
+        /* Waits on the CPU until the GPU has reached this point.
+         * @param timeout The maximum number of nanoseconds to wait.
+         * @returns Whether the point was reached (true) or the wait timed out (false). */
+        inline bool wait(uint64_t timeout = std::numeric_limits<uint64_t>::max()) const { return this->timeline == nullptr || this->timeline->wait(this->value, timeout); }
+    };
+
+    /* A SyncPoint that is always complete. */
+    static constexpr const SyncPoint null_sync_point = { nullptr, 0 };
+
+}
+
+#endif
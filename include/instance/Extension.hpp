@@ -23,7 +23,9 @@ namespace Makma3D {
         undefined = 0,
 
         /* When enabled, lets the backend print extra debug information and enabled Vulkan validation layers. */
-        debug = 1
+        debug = 1,
+        /* When enabled, runs without a display: GLFW is not initialized, devices are selected without presentation support, and output goes to offscreen images or to a VK_EXT_headless_surface (if supported). */
+        headless = 2
 
     };
 
@@ -31,7 +33,8 @@ namespace Makma3D {
     static const char* extension_names[] = {
         "undefined",
 
-        "debug"
+        "debug",
+        "headless"
     };
 }
 
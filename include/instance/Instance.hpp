@@ -43,6 +43,8 @@ namespace Makma3D {
         GLFW::Instance glfw_instance;
         /* The Vulkan instance that handles the Vulkan side of instancing. */
         Vulkanic::Instance vk_instance;
+        /* Whether VK_EXT_headless_surface is enabled, which is only the case in headless mode and if the driver supports it. */
+        bool _headless_surface;
 
 
         /* Declare the Window class a friend of ours. */
@@ -68,14 +70,42 @@ namespace Makma3D {
         inline bool extension_enabled(Extension ext) const { return this->extensions.find(ext) != this->extensions.end(); }
         /* Returns a list of enabled Extensions that can be iterated through. */
         Tools::Array<Extension> get_extensions() const;
-        /* Returns a list of Vulkan device extensions, based on the enabled Makma3D extensions + the ones we always require. */
-        Tools::Array<const char*> get_device_extensions() const;
+        /* Returns a list of Vulkan device extensions, based on the enabled Makma3D extensions + the ones we always require.
+         * @param present Whether the device will present to a surface, in which case the swapchain extension is added as well.
+         */
+        Tools::Array<const char*> get_device_extensions(bool present = false) const;
         /* Returns a list of Vulkan device featyres, based on the enabled Makma3D extensions + the ones we always require. */
         Tools::Array<Vulkanic::DeviceFeature> get_device_features() const;
 
-        /* Returns the primary monitor as given by GLFW. */
+        /* Returns the Vulkan version that was negotiated for this Instance, as given by VK_MAKE_API_VERSION(). */
+        inline uint32_t api_version() const { return this->vk_instance.api_version(); }
+        /* Returns the instance functions that are called directly instead of through the loader, among which vkGetDeviceProcAddr(). */
+        inline const Vulkanic::InstanceDispatch& dispatch() const { return this->vk_instance.dispatch(); }
+        /* Returns the functions to name Vulkan objects and label command buffers with, or nullptr if the debug extension isn't enabled. */
+        inline const Vulkanic::DebugUtilsFunctions* debug_utils() const { return this->vk_instance.debug_utils(); }
+        /* Returns whether extension features can be queried and enabled on devices, i.e., whether Vulkan 1.1 or VK_KHR_get_physical_device_properties2 is available. */
+        inline bool supports_features2() const { return this->vk_instance.supports_features2(); }
+
+        /* Returns whether this Instance runs without a display, i.e., whether the headless extension is enabled. */
+        inline bool headless() const { return this->extension_enabled(Extension::headless); }
+        /* Returns whether this Instance can create headless surfaces (see create_headless_surface()). If not, headless rendering should go to offscreen images instead. */
+        inline bool supports_headless_surface() const { return this->_headless_surface; }
+        /* Creates a new VkSurfaceKHR that is not backed by any display. Requires supports_headless_surface() to be true.
+         * @returns The new VkSurfaceKHR, which can be wrapped in a Vulkanic::Surface to present to with a Swapchain. */
+        VkSurfaceKHR create_headless_surface() const;
+
+        /* Returns the physical device that the library thinks is most suited for headless rendering, i.e., without presentation support.
+         * If you want to have more control, get all the available devices with ```get_headless_physical_devices()``` and choose one yourself.
+         * Devices are scored on their type, device-local memory, queue topology and limits (see PhysicalDeviceRegistry::score()).
+         * @param preferred_type The type of device to prefer. A device of this type always wins if there is one.
+         * @returns The PhysicalDevice with (hopefully) the preferred type. */
+        PhysicalDevice get_preferred_headless_physical_device(PhysicalDeviceType preferred_type = PhysicalDeviceType::discrete) const;
+        /* Returns the list of (supported) PhysicalDevices that can render without a display. Pass a nullptr surface when creating a Device for them. */
+        Tools::Array<PhysicalDevice> get_headless_physical_devices() const;
+
+        /* Returns the primary monitor as given by GLFW. Always a nullptr in headless mode. */
         inline const Monitor* get_primary_monitor() const { return this->glfw_instance.get_primary_monitor(); }
-        /* Returns the list of available monitors as given by GLFW. */
+        /* Returns the list of available monitors as given by GLFW. Always empty in headless mode. */
         inline const Tools::Array<const Monitor*>& get_monitors() const { return this->glfw_instance.get_monitors(); }
 
         /* Explicitly returns the internal VkInstance object. */
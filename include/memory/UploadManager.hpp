@@ -0,0 +1,186 @@
+/* UPLOAD MANAGER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   15/10/2021, 10:02:11
+ * Last edited:
+ *   15/10/2021, 10:02:11
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the UploadManager class, which uses a persistently mapped
+ *   staging ring buffer and the Device's memory queue to upload buffers
+ *   and images asynchronously to device-local memory.
+**/
+
+#ifndef MEMORY_UPLOAD_MANAGER_HPP
+#define MEMORY_UPLOAD_MANAGER_HPP
+
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+namespace Makma3D {
+    /* Token returned by the UploadManager for each upload, which can be used to check if it has completed. */
+    using upload_token_t = uint64_t;
+    /* Token that is never returned by the UploadManager, and thus can be used to indicate 'no upload'. */
+    static constexpr const upload_token_t null_upload_token = 0;
+
+    /* The UploadManager class, which batches copies from a host-visible staging ring to device-local buffers and images on the memory queue. */
+    class UploadManager {
+    public:
+        /* Channel name for the UploadManager class. */
+        static constexpr const char* channel = "UploadManager";
+        /* The number of batches that can be in flight simultaneously. */
+        static constexpr const uint32_t n_batches = 3;
+        /* The alignment of each staged region in the ring. Satisfies the texel-size and multiple-of-four requirements for all formats we use. */
+        static constexpr const VkDeviceSize staging_alignment = 16;
+
+        /* The Device on which this UploadManager lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* A single batch of copies, which is submitted in one go. */
+        struct Batch {
+            /* The command buffer on which the copies are recorded. */
+            VkCommandBuffer vk_command_buffer;
+            /* The fence that is signalled when the batch is done. */
+            VkFence vk_fence;
+            /* The token of the uploads in this batch. */
+            upload_token_t token;
+            /* The end of the batch's region in the staging ring, which becomes the new ring tail once the batch is done. */
+            VkDeviceSize ring_end;
+            /* The number of ring bytes (including padding) that are freed once the batch is done. */
+            VkDeviceSize ring_bytes;
+            /* Whether the batch is currently being recorded. */
+            bool recording;
+            /* Whether the batch is currently submitted and running on the GPU. */
+            bool in_flight;
+        };
+
+        /* The acquire halves of the ownership transfers of a batch, which must be recorded on the receiving queue. */
+        struct Acquires {
+            /* The buffer barriers to record. */
+            Tools::Array<VkBufferMemoryBarrier> buffers;
+            /* The image barriers to record. */
+            Tools::Array<VkImageMemoryBarrier> images;
+        };
+
+        /* The staging buffer that acts as the ring. */
+        VkBuffer vk_staging_buffer;
+        /* The memory that backs the staging buffer. */
+        VkDeviceMemory vk_staging_memory;
+        /* The memory type of the staging memory. */
+        uint32_t staging_memory_type;
+        /* The size of the staging memory. */
+        VkDeviceSize staging_memory_size;
+        /* The host pointer to the persistently mapped staging memory. */
+        uint8_t* staging_map;
+        /* The total size of the staging ring. */
+        VkDeviceSize ring_size;
+        /* The offset of the first byte in the ring that is still in use. */
+        VkDeviceSize ring_tail;
+        /* The offset of the first free byte in the ring. */
+        VkDeviceSize ring_head;
+        /* The number of bytes currently in use in the ring. */
+        VkDeviceSize ring_used;
+
+        /* The command pool from which we allocate the batch command buffers. */
+        VkCommandPool vk_command_pool;
+        /* The batches that we cycle through. */
+        Tools::Array<Batch> batches;
+        /* The index of the batch that is currently (or next) recorded. */
+        uint32_t current_batch;
+        /* The index of the oldest batch that might still be in flight. */
+        uint32_t oldest_batch;
+        /* The token that will be given to the next batch. */
+        upload_token_t next_token;
+        /* The highest token of which we know that it is completed. */
+        upload_token_t completed_token;
+
+        /* The release barriers for the batch currently recorded, which will be recorded just before it is submitted. */
+        Acquires releases;
+        /* The acquire barriers that still have to be recorded by the receiving queues, per upload token and then per QueueType. */
+        std::unordered_map<upload_token_t, Tools::Array<Acquires>> acquires;
+
+
+        /* Allocates space in the staging ring, flushing and waiting for older batches if it's full.
+         * @param size The number of bytes to allocate.
+         * @returns The offset of the allocated region in the staging ring. */
+        VkDeviceSize allocate_staging(VkDeviceSize size);
+        /* Makes sure the current batch is being recorded, beginning it if it isn't.
+         * @returns A reference to the current batch. */
+        Batch& begin_batch();
+        /* Checks the oldest in-flight batches for completion, freeing their staging regions.
+         * @param wait If true, blocks until the oldest in-flight batch is done, even if none are done yet. */
+        void retire_batches(bool wait);
+
+    public:
+        /* Constructor for the UploadManager class.
+         * @param device The Device on which we upload. Its memory queue is used for the copies.
+         * @param ring_size The size (in bytes) of the staging ring. Any single upload cannot be larger than this. */
+        UploadManager(const Makma3D::Device& device, VkDeviceSize ring_size = 64 * 1024 * 1024);
+        /* Copy constructor for the UploadManager class, which is deleted. */
+        UploadManager(const UploadManager& other) = delete;
+        /* Move constructor for the UploadManager class. */
+        UploadManager(UploadManager&& other);
+        /* Destructor for the UploadManager class. Waits until all uploads are done. */
+        ~UploadManager();
+
+        /* Schedules a copy of the given data to the given (device-local) buffer. The copy is only submitted on the next flush().
+         * @param vk_buffer The destination buffer. Must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+         * @param offset The offset in the destination buffer to write to.
+         * @param data Pointer to the data to upload. Is copied to the staging ring immediately, so may be freed after this call.
+         * @param size The number of bytes to upload.
+         * @param target_queue The type of the queue that will use the buffer after the upload. Ownership of the buffer is transferred to it.
+         * @returns A token that can be used to check if the upload is done. */
+        upload_token_t upload(VkBuffer vk_buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, Vulkanic::QueueType target_queue = Vulkanic::QueueType::graphics);
+        /* Schedules a copy of the given tightly-packed pixel data to the given (device-local) image. The copy is only submitted on the next flush().
+         * @param vk_image The destination image. Must have been created with VK_IMAGE_USAGE_TRANSFER_DST_BIT. Its previous contents are discarded.
+         * @param subresource The image subresource (aspect, mip level and layers) to write to.
+         * @param extent The size of the region to write, in texels.
+         * @param data Pointer to the data to upload. Is copied to the staging ring immediately, so may be freed after this call.
+         * @param size The number of bytes to upload.
+         * @param final_layout The layout that the image will be in after the upload.
+         * @param target_queue The type of the queue that will use the image after the upload. Ownership of the image is transferred to it.
+         * @returns A token that can be used to check if the upload is done. */
+        upload_token_t upload(VkImage vk_image, const VkImageSubresourceLayers& subresource, const VkExtent3D& extent, const void* data, VkDeviceSize size, VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, Vulkanic::QueueType target_queue = Vulkanic::QueueType::graphics);
+        /* Submits all scheduled copies to the memory queue.
+         * @returns The token of the submitted batch, or the token of the last batch if nothing was scheduled. */
+        upload_token_t flush();
+
+        /* Returns whether the upload(s) with the given token are done. Does not block. */
+        bool is_done(upload_token_t token);
+        /* Blocks until the upload(s) with the given token are done, flushing them first if they weren't submitted yet. */
+        void wait(upload_token_t token);
+        /* Records the acquire half of the ownership transfers of the given upload(s) on the given command buffer. Must be called (once) before the uploaded resources are used on their target queue, and the command buffer may only be submitted once is_done() returns true for the token.
+         * @param vk_command_buffer The command buffer to record the barriers on. Must belong to the target queue's family.
+         * @param token The token of the upload(s) to acquire.
+         * @param target_queue The type of the queue that the uploads were targeted at. Only their barriers are recorded.
+         * @param dst_stage The pipeline stage(s) that will use the resources.
+         * @param dst_access The type of access that will be performed on the resources. */
+        void acquire(VkCommandBuffer vk_command_buffer, upload_token_t token, Vulkanic::QueueType target_queue = Vulkanic::QueueType::graphics, VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkAccessFlags dst_access = VK_ACCESS_MEMORY_READ_BIT);
+
+        /* Returns the size of the staging ring. */
+        inline VkDeviceSize capacity() const { return this->ring_size; }
+        /* Returns the number of bytes that are currently in use in the staging ring. */
+        inline VkDeviceSize size() const { return this->ring_used; }
+
+        /* Copy assignment operator for the UploadManager class, which is deleted. */
+        UploadManager& operator=(const UploadManager& other) = delete;
+        /* Move assignment operator for the UploadManager class. */
+        inline UploadManager& operator=(UploadManager&& other) { if (this != &other) { swap(*this, other); } return *this; }
+        /* Swap operator for the UploadManager class. */
+        friend void swap(UploadManager& um1, UploadManager& um2);
+
+    };
+
+    /* Swap operator for the UploadManager class. */
+    void swap(UploadManager& um1, UploadManager& um2);
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+/* INDIRECT RENDERER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 17:31:48
+ * Last edited:
+ *   18/10/2021, 17:31:48
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the IndirectRenderer class, which keeps the objects of a
+ *   scene in a storage buffer and draws all of them that survive frustum
+ *   culling with a single indirect draw. The culling and compaction is
+ *   done by a compute shader if the device can read the draw count from
+ *   a buffer, and on the CPU otherwise.
+**/
+
+#ifndef RENDERING_INDIRECT_RENDERER_HPP
+#define RENDERING_INDIRECT_RENDERER_HPP
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "glm/glm.hpp"
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+#include "gpu/DescriptorAllocator.hpp"
+
+namespace Makma3D {
+    /* A single object as it's stored in the object buffer. Matches the std430 layout the culling shader reads. */
+    struct IndirectObject {
+        /* The center of the object's bounding sphere, in world space. */
+        glm::vec3 center;
+        /* The radius of the object's bounding sphere. */
+        float radius;
+        /* The number of indices of the object's mesh. */
+        uint32_t index_count;
+        /* The first index of the object's mesh in the bound index buffer. */
+        uint32_t first_index;
+        /* The value added to each index of the object's mesh. */
+        int32_t vertex_offset;
+        /* Padding to keep the struct at 32 bytes. */
+        uint32_t _padding;
+    };
+
+    /* The push constants of the culling shader. */
+    struct CullConstants {
+        /* The six planes of the view frustum, as (normal, distance) with the normals pointing inwards. */
+        glm::vec4 planes[6];
+        /* The number of objects to cull. */
+        uint32_t n_objects;
+        /* Padding to keep the struct at a multiple of 16 bytes. */
+        uint32_t _padding[3];
+    };
+
+    /* Counts what the IndirectRenderer did. */
+    struct IndirectStatistics {
+        /* The number of frames that were culled on the GPU. */
+        uint64_t n_gpu_frames;
+        /* The number of frames that were culled on the CPU. */
+        uint64_t n_cpu_frames;
+        /* The number of objects that were culled on the CPU and found to be visible. */
+        uint64_t n_cpu_visible;
+        /* The number of objects that were culled on the CPU in total. */
+        uint64_t n_cpu_objects;
+        /* The number of draw calls that were recorded. */
+        uint64_t n_draw_calls;
+    };
+
+
+
+    /* The IndirectRenderer class, which culls a set of objects and draws the visible ones with as few indirect draws as the device allows. */
+    class IndirectRenderer {
+    public:
+        /* Channel name for the IndirectRenderer class. */
+        static constexpr const char* channel = "IndirectRenderer";
+        /* The local workgroup size (in x) that the culling shader uses. */
+        static constexpr const uint32_t cull_group_size = 64;
+
+        /* The Device on which this IndirectRenderer lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* The offsets of a single frame's regions in the buffer. */
+        struct FrameRegions {
+            /* The offset of the objects, which are copied here at the start of each frame. */
+            VkDeviceSize objects;
+            /* The offset of the compacted VkDrawIndexedIndirectCommands. */
+            VkDeviceSize draws;
+            /* The offset of the draw count. */
+            VkDeviceSize count;
+        };
+
+        /* The buffer with the objects, draws and draw count of every frame. */
+        VkBuffer vk_buffer;
+        /* The memory that backs the buffer. */
+        VkDeviceMemory vk_memory;
+        /* The memory type of the memory that backs the buffer. */
+        uint32_t memory_type;
+        /* The size of the memory that backs the buffer. */
+        VkDeviceSize memory_size;
+        /* The host pointer to the persistently mapped buffer. */
+        uint8_t* map;
+        /* The regions of each frame. */
+        Tools::Array<FrameRegions> frames;
+        /* The frame that is currently being recorded. */
+        uint32_t current_frame;
+
+        /* The objects to draw. */
+        Tools::Array<IndirectObject> objects;
+        /* The maximum number of objects. */
+        uint32_t _max_objects;
+        /* The number of draws the CPU wrote for the current frame, if it culled on the CPU. */
+        uint32_t n_cpu_draws;
+        /* The layout of the descriptor set the culling shader uses. */
+        const DescriptorLayout* layout;
+        /* The layout of the culling pipeline, or nullptr if we cull on the CPU. */
+        VkPipelineLayout vk_pipeline_layout;
+        /* The culling compute pipeline, or nullptr if we cull on the CPU. */
+        VkPipeline vk_pipeline;
+        /* Whether we cull on the GPU (true) or on the CPU (false). */
+        bool _gpu_culling;
+
+        /* The statistics of this renderer. */
+        IndirectStatistics _statistics;
+
+
+        /* Creates the culling pipeline from the SPIR-V file at the given path.
+         * @param cull_shader The path of the compiled culling shader.
+         * @returns Whether the pipeline was created (true) or the file could not be read (false). */
+        bool create_pipeline(const std::string& cull_shader);
+
+    public:
+        /* Constructor for the IndirectRenderer class.
+         * @param device The Device on which we render.
+         * @param max_objects The maximum number of objects the renderer can hold.
+         * @param n_frames The number of frames that can be in flight, each of which gets its own copy of the buffers.
+         * @param cull_shader The path of the compiled culling shader, which is built along with the library as shaders/cull.comp.spv (e.g., Tools::get_executable_path() + "/shaders/cull.comp.spv"). If it's empty or can't be read, the renderer culls on the CPU. */
+        IndirectRenderer(const Makma3D::Device& device, uint32_t max_objects, uint32_t n_frames, const std::string& cull_shader);
+        /* Copy constructor for the IndirectRenderer class, which is deleted. */
+        IndirectRenderer(const IndirectRenderer& other) = delete;
+        /* Move constructor for the IndirectRenderer class. */
+        IndirectRenderer(IndirectRenderer&& other);
+        /* Destructor for the IndirectRenderer class. */
+        ~IndirectRenderer();
+
+        /* Adds an object to the renderer. It's drawn from the next frame onwards.
+         * @param object The object to add.
+         * @returns The index of the object, which is also passed as firstInstance to its draw. */
+        uint32_t add_object(const IndirectObject& object);
+        /* Changes an object in the renderer. The change is visible from the next frame onwards.
+         * @param index The index of the object, as returned by add_object().
+         * @param object The new data of the object. */
+        void set_object(uint32_t index, const IndirectObject& object);
+        /* Removes all objects from the renderer. */
+        void clear();
+
+        /* Moves to the given frame, and copies the objects into its buffers. Should only be called once that frame's last submission is done.
+         * @param frame The index of the frame to start. */
+        void begin_frame(uint32_t frame);
+        /* Culls the objects against the given frustum and writes the draws of the visible ones for the current frame. Must be recorded outside of a render pass.
+         * If gpu_culling() is true, this dispatches the culling shader, which writes a VkDrawIndexedIndirectCommand with an instanceCount of 1 and the object index as firstInstance for each visible object. Otherwise, the culling is done on the CPU right away and nothing is recorded.
+         * @param vk_command_buffer The command buffer to record the culling on. Must belong to a queue family that supports compute.
+         * @param view_projection The view-projection matrix of the camera. */
+        void cull(VkCommandBuffer vk_command_buffer, const glm::mat4& view_projection);
+        /* Draws the visible objects with the currently bound graphics pipeline, vertex buffers and index buffer. Must be recorded inside a render pass, after cull() was recorded for this frame.
+         * @param vk_command_buffer The command buffer to record the draws on. */
+        void draw(VkCommandBuffer vk_command_buffer);
+
+        /* Extracts the six planes of the frustum from the given view-projection matrix, normalized and with their normals pointing inwards.
+         * @param view_projection The view-projection matrix, with Vulkan's [0, 1] depth range.
+         * @param planes The array of six planes to write to. */
+        static void extract_frustum(const glm::mat4& view_projection, glm::vec4 planes[6]);
+
+        /* Returns whether the objects are culled on the GPU (true) or on the CPU (false). */
+        inline bool gpu_culling() const { return this->_gpu_culling; }
+        /* Returns the layout of the descriptor set that the culling shader uses: binding 0 is the readonly object buffer, binding 1 the draw buffer and binding 2 the draw count, all storage buffers. Its push constants are CullConstants. */
+        inline const DescriptorLayout& descriptor_layout() const { return *this->layout; }
+        /* Returns the number of objects in the renderer. */
+        inline uint32_t size() const { return this->objects.size(); }
+        /* Returns the maximum number of objects in the renderer. */
+        inline uint32_t capacity() const { return this->_max_objects; }
+        /* Returns the statistics of this renderer. */
+        inline const IndirectStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the IndirectRenderer class, which is deleted. */
+        IndirectRenderer& operator=(const IndirectRenderer& other) = delete;
+        /* Move assignment operator for the IndirectRenderer class. */
+        inline IndirectRenderer& operator=(IndirectRenderer&& other) { if (this != &other) { swap(*this, other); } return *this; }
+        /* Swap operator for the IndirectRenderer class. */
+        friend void swap(IndirectRenderer& ir1, IndirectRenderer& ir2);
+
+    };
+
+    /* Swap operator for the IndirectRenderer class. */
+    void swap(IndirectRenderer& ir1, IndirectRenderer& ir2);
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+/* PARALLEL RECORDER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:12:05
+ * Last edited:
+ *   18/10/2021, 19:12:05
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the ParallelRecorder class, which splits a list of draws
+ *   into fixed-size chunks, records each chunk into a secondary command
+ *   buffer on a pool of worker threads and executes them from the
+ *   primary command buffer in the order of the list.
+**/
+
+#ifndef RENDERING_PARALLEL_RECORDER_HPP
+#define RENDERING_PARALLEL_RECORDER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+namespace Makma3D {
+    /* Counts what the ParallelRecorder did. */
+    struct RecorderStatistics {
+        /* The number of calls to record(). */
+        uint64_t n_records;
+        /* The number of chunks (and thus secondary command buffers) that were recorded. */
+        uint64_t n_chunks;
+        /* The number of chunks that were recorded by the worker threads instead of the calling thread. */
+        uint64_t n_worker_chunks;
+        /* The total wall-clock time spent in record(), in nanoseconds. */
+        uint64_t record_time;
+    };
+
+
+
+    /* The ParallelRecorder class, which records a list of draws into secondary command buffers on several threads. */
+    class ParallelRecorder {
+    public:
+        /* Channel name for the ParallelRecorder class. */
+        static constexpr const char* channel = "ParallelRecorder";
+
+        /* Function that records a chunk of the list, i.e., the items [first, first + count), into the given (begun) command buffer. Called from several threads at once. */
+        using record_t = std::function<void(VkCommandBuffer, uint32_t, uint32_t)>;
+
+        /* The Device on which this ParallelRecorder lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* The work of a single call to record(). */
+        struct Job {
+            /* The function that records a chunk. */
+            const record_t* record_chunk;
+            /* The type of queue the command buffers are for. */
+            Vulkanic::QueueType queue_type;
+            /* The begin info for each secondary command buffer. */
+            VkCommandBufferBeginInfo begin_info;
+            /* The number of items in the list. */
+            uint32_t n_items;
+            /* The secondary command buffer of each chunk, in the order of the list. */
+            Tools::Array<VkCommandBuffer> chunks;
+            /* The index of the next chunk to record. */
+            std::atomic<uint32_t> next_chunk;
+            /* The number of chunks that were recorded by the workers. */
+            std::atomic<uint32_t> worker_chunks;
+        };
+
+        /* The number of items per chunk. Fixed, so the chunks (and thus the commands) don't depend on the number of threads. */
+        uint32_t _chunk_size;
+        /* The worker threads. */
+        Tools::Array<std::thread> workers;
+
+        /* The job that is currently being recorded. */
+        Job job;
+        /* Whether the job is open for workers to join. */
+        bool job_active;
+        /* Incremented for each new job, so workers can tell they haven't seen it yet. */
+        uint64_t job_generation;
+        /* The number of workers that are currently working on the job. */
+        uint32_t n_busy;
+        /* Whether the workers should stop. */
+        bool stop;
+        /* Lock that protects the job state. */
+        std::mutex lock;
+        /* Signals the workers that there's a new job or that they should stop. */
+        std::condition_variable job_cv;
+        /* Signals the recording thread that a worker left the job. */
+        std::condition_variable done_cv;
+
+        /* The statistics of this recorder. */
+        RecorderStatistics _statistics;
+
+
+        /* Records chunks of the current job until there are none left.
+         * @returns The number of chunks the calling thread recorded. */
+        uint32_t record_chunks();
+        /* The main loop of each worker thread. */
+        void worker_main();
+
+    public:
+        /* Constructor for the ParallelRecorder class.
+         * @param device The Device on which we record. Its CommandPoolManager provides each thread's command buffers.
+         * @param n_workers The number of worker threads besides the calling thread. With 0, everything is recorded on the calling thread.
+         * @param chunk_size The number of items recorded in each secondary command buffer. */
+        ParallelRecorder(const Makma3D::Device& device, uint32_t n_workers = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0, uint32_t chunk_size = 256);
+        /* Copy constructor for the ParallelRecorder class, which is deleted. */
+        ParallelRecorder(const ParallelRecorder& other) = delete;
+        /* Move constructor for the ParallelRecorder class, which is deleted since the workers refer to it. */
+        ParallelRecorder(ParallelRecorder&& other) = delete;
+        /* Destructor for the ParallelRecorder class. Stops the workers. */
+        ~ParallelRecorder();
+
+        /* Records the given list of items in chunks of chunk_size() on the workers and the calling thread, and then executes the chunks from the primary command buffer in the order of the list. Returns once everything is recorded.
+         * The commands, and their order, are the same no matter how many workers there are.
+         * @param vk_command_buffer The primary command buffer to execute the chunks from. If a render pass is inherited, it must be inside it with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+         * @param queue_type The type of queue the primary command buffer will be submitted to.
+         * @param inheritance What the secondary command buffers inherit from the primary, or nullptr if they are recorded outside of a render pass. Its pNext may carry a VkCommandBufferInheritanceRenderingInfo for dynamic rendering.
+         * @param n_items The number of items in the list.
+         * @param record_chunk The function that records the items [first, first + count) into a command buffer. It's called from several threads at once, and since each command buffer starts without any bound state, it must bind its pipeline, descriptor sets and buffers itself. */
+        void record(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, const VkCommandBufferInheritanceInfo* inheritance, uint32_t n_items, const record_t& record_chunk);
+
+        /* Returns the number of worker threads. */
+        inline uint32_t n_workers() const { return this->workers.size(); }
+        /* Returns the number of items recorded in each secondary command buffer. */
+        inline uint32_t chunk_size() const { return this->_chunk_size; }
+        /* Returns the statistics of this recorder. */
+        inline const RecorderStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the ParallelRecorder class, which is deleted. */
+        ParallelRecorder& operator=(const ParallelRecorder& other) = delete;
+        /* Move assignment operator for the ParallelRecorder class, which is deleted. */
+        ParallelRecorder& operator=(ParallelRecorder&& other) = delete;
+
+    };
+}
+
+#endif
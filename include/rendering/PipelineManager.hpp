@@ -0,0 +1,243 @@
+/* PIPELINE MANAGER.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   20/10/2021, 10:21:37
+ * Last edited:
+ *   20/10/2021, 10:21:37
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the PipelineManager class, which compiles pipelines on
+ *   worker threads against a shared VkPipelineCache. Pipelines are known
+ *   by a key that describes their state, so asking twice for the same
+ *   pipeline compiles it only once, and a fallback pipeline can be drawn
+ *   with until the real one is ready.
+**/
+
+#ifndef RENDERING_PIPELINE_MANAGER_HPP
+#define RENDERING_PIPELINE_MANAGER_HPP
+
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+namespace Makma3D {
+    /* Describes the state of a pipeline as a string of bytes, so that requests for the same pipeline can be recognised. */
+    class PipelineKey {
+    private:
+        /* The bytes of the state. */
+        std::string data;
+        /* The FNV-1a hash of the bytes. */
+        size_t _hash;
+
+    public:
+        /* Constructor for the PipelineKey class, which creates an empty key. */
+        PipelineKey() : _hash(14695981039346656037ULL) {}
+
+        /* Appends the bytes of the given value to the key. Only add plain values (formats, flags, zero-initialized structs without pointers, ...), since pointers differ between otherwise identical states.
+         * @param value The value to add.
+         * @returns A reference to the key, so calls can be chained. */
+        template <typename T>
+        PipelineKey& add(const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be added to a PipelineKey");
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+            for (size_t i = 0; i < sizeof(T); i++) { this->_hash = (this->_hash ^ bytes[i]) * 1099511628211ULL; }
+            this->data.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+            return *this;
+        }
+        /* Appends the given string (e.g., a shader path or entry point) to the key.
+         * @param value The string to add.
+         * @returns A reference to the key, so calls can be chained. */
+        inline PipelineKey& add(const std::string& value) { this->add(value.size()); for (size_t i = 0; i < value.size(); i++) { this->add(value[i]); } return *this; }
+
+        /* Returns the hash of the key. */
+        inline size_t hash() const { return this->_hash; }
+        /* Returns whether two keys describe the same state. */
+        inline bool operator==(const PipelineKey& other) const { return this->_hash == other._hash && this->data == other.data; }
+        /* Returns whether two keys describe a different state. */
+        inline bool operator!=(const PipelineKey& other) const { return !(*this == other); }
+
+    };
+}
+
+namespace std {
+    /* Hashes a PipelineKey, so it can be used in unordered containers. */
+    template <>
+    struct hash<Makma3D::PipelineKey> {
+        inline size_t operator()(const Makma3D::PipelineKey& key) const { return key.hash(); }
+    };
+}
+
+namespace Makma3D {
+    /* Identifies a pipeline in the PipelineManager. */
+    using pipeline_id_t = uint32_t;
+    /* Identifier that never refers to any pipeline, and thus can be used to indicate 'no pipeline'. */
+    static constexpr const pipeline_id_t null_pipeline_id = std::numeric_limits<pipeline_id_t>::max();
+
+    /* Counts what happened to a single pipeline. */
+    struct PipelineStatistics {
+        /* The number of times the pipeline was requested, including the first time. */
+        uint64_t n_requests;
+        /* The number of times get() returned its fallback (or nothing) because the pipeline wasn't ready yet. */
+        uint64_t n_fallbacks;
+        /* The time the request waited for a worker, in nanoseconds. */
+        uint64_t queue_time;
+        /* The time it took to create the pipeline, in nanoseconds. */
+        uint64_t compile_time;
+    };
+
+    /* Counts what the PipelineManager did. */
+    struct PipelineManagerStatistics {
+        /* The number of requests for a pipeline that was already known, and thus wasn't compiled again. */
+        uint64_t n_deduplicated;
+        /* The number of pipelines that were created. */
+        uint64_t n_compiled;
+        /* The number of pipelines that could not be created. */
+        uint64_t n_failed;
+        /* The total time spent creating pipelines, in nanoseconds. */
+        uint64_t total_compile_time;
+        /* The longest time spent creating a single pipeline, in nanoseconds. */
+        uint64_t max_compile_time;
+    };
+
+
+
+    /* The PipelineManager class, which creates pipelines asynchronously on worker threads and deduplicates requests for the same state. */
+    class PipelineManager {
+    public:
+        /* Channel name for the PipelineManager class. */
+        static constexpr const char* channel = "PipelineManager";
+        /* The maximum number of fallbacks get() follows, so fallback cycles cannot hang it. */
+        static constexpr const uint32_t max_fallback_depth = 8;
+
+        /* Function that creates a pipeline with the given VkPipelineCache on the given VkDevice. Called from a worker thread. Returns nullptr if the pipeline could not be created. */
+        using create_t = std::function<VkPipeline(VkDevice, VkPipelineCache)>;
+
+        /* The Device on which this PipelineManager lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* The states a pipeline goes through. */
+        enum class State {
+            /* The request waits for a worker. */
+            pending,
+            /* A thread is creating the pipeline. */
+            compiling,
+            /* The pipeline is ready to use. */
+            ready,
+            /* The pipeline could not be created. */
+            failed
+        };
+
+        /* A single requested pipeline. */
+        struct Entry {
+            /* The name of the pipeline, for debugging. */
+            std::string name;
+            /* The function that creates it, which is cleared once it ran. */
+            create_t create;
+            /* The pipeline to use while this one isn't ready, or null_pipeline_id for none. */
+            pipeline_id_t fallback;
+            /* The state of the request. */
+            State state;
+            /* The pipeline, once it's ready. */
+            VkPipeline vk_pipeline;
+            /* The moment it was requested. */
+            std::chrono::steady_clock::time_point requested;
+            /* The statistics of the pipeline. */
+            PipelineStatistics statistics;
+        };
+
+        /* The cache shared by all pipelines. */
+        VkPipelineCache vk_pipeline_cache;
+        /* The worker threads. */
+        Tools::Array<std::thread> workers;
+
+        /* The pipelines, by identifier. */
+        Tools::Array<Entry> entries;
+        /* Maps the key of each pipeline to its identifier. */
+        std::unordered_map<PipelineKey, pipeline_id_t> ids;
+        /* The requests that wait for a worker, oldest first. */
+        Tools::Array<pipeline_id_t> queue;
+        /* Whether the workers should stop. */
+        bool stop;
+        /* Lock for the entries, the queue and the statistics. */
+        mutable std::mutex lock;
+        /* Signals the workers that there's a new request or that they should stop. */
+        std::condition_variable work_cv;
+        /* Signals waiting threads that a pipeline is done. */
+        std::condition_variable done_cv;
+
+        /* The statistics of this manager. */
+        PipelineManagerStatistics _statistics;
+
+
+        /* Creates the pipeline with the given identifier. Assumes the lock is taken, and releases it while the pipeline is created.
+         * @param id The identifier of the pipeline, which must be pending.
+         * @param local_lock The taken lock. */
+        void compile(pipeline_id_t id, std::unique_lock<std::mutex>& local_lock);
+        /* The main loop of each worker thread. */
+        void worker_main();
+
+    public:
+        /* Constructor for the PipelineManager class.
+         * @param device The Device on which we create pipelines.
+         * @param n_workers The number of worker threads. With 0, pipelines are only created once wait() is called for them.
+         * @param initial_data Data from an earlier cache_data() call to warm the cache with, if any. The driver ignores it if it comes from another device or driver version. */
+        PipelineManager(const Makma3D::Device& device, uint32_t n_workers = std::thread::hardware_concurrency() > 2 ? std::thread::hardware_concurrency() / 2 : 1, const Tools::Array<uint8_t>& initial_data = {});
+        /* Copy constructor for the PipelineManager class, which is deleted. */
+        PipelineManager(const PipelineManager& other) = delete;
+        /* Move constructor for the PipelineManager class, which is deleted since the workers refer to it. */
+        PipelineManager(PipelineManager&& other) = delete;
+        /* Destructor for the PipelineManager class. Stops the workers, dropping the requests they haven't started, and destroys all pipelines, so none of them may be in use anymore. */
+        ~PipelineManager();
+
+        /* Requests the pipeline with the given state. If the same state was requested before, nothing is compiled and the existing pipeline is returned. Can be called from any thread.
+         * @param key The key that describes the state of the pipeline.
+         * @param create The function that creates the pipeline. It's only called if the state is new, from a worker thread, and should pass the given VkPipelineCache on.
+         * @param fallback The pipeline that get() returns while this one isn't ready yet, e.g., a generic placeholder or an older variant of the same pipeline. Only used if the state is new.
+         * @param name The name of the pipeline, which is used in the log and given to the VkPipeline in debug builds.
+         * @returns The identifier of the pipeline. */
+        pipeline_id_t request(const PipelineKey& key, create_t&& create, pipeline_id_t fallback = null_pipeline_id, const std::string& name = "pipeline");
+        /* Returns the pipeline with the given identifier if it's ready. If it isn't, its fallback is returned instead (or the fallback's fallback, and so on), or nullptr if none of them are ready; in that case, the draws that need it should be skipped this frame. Never waits, and can be called from any thread. */
+        VkPipeline get(pipeline_id_t id);
+        /* Returns whether the pipeline with the given identifier is done, i.e., ready or failed. Never waits, and can be called from any thread. */
+        bool is_done(pipeline_id_t id) const;
+        /* Blocks until the pipeline with the given identifier is done. If no worker has started on it yet, it's created on the calling thread instead. Can be called from any thread.
+         * @returns The pipeline, or nullptr if it could not be created. */
+        VkPipeline wait(pipeline_id_t id);
+
+        /* Returns the contents of the shared VkPipelineCache, which can be saved and passed to the constructor next time to skip most compilation. */
+        Tools::Array<uint8_t> cache_data() const;
+
+        /* Returns the statistics of the pipeline with the given identifier. */
+        PipelineStatistics statistics(pipeline_id_t id) const;
+        /* Returns the statistics of this manager. */
+        PipelineManagerStatistics statistics() const;
+        /* Returns the number of requests that still wait for a worker. */
+        uint32_t pending() const;
+        /* Returns the number of worker threads. */
+        inline uint32_t n_workers() const { return this->workers.size(); }
+        /* Explicitly returns the internal VkPipelineCache object. */
+        inline VkPipelineCache vk() const { return this->vk_pipeline_cache; }
+
+        /* Copy assignment operator for the PipelineManager class, which is deleted. */
+        PipelineManager& operator=(const PipelineManager& other) = delete;
+        /* Move assignment operator for the PipelineManager class, which is deleted. */
+        PipelineManager& operator=(PipelineManager&& other) = delete;
+
+    };
+}
+
+#endif
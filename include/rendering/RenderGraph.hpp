@@ -0,0 +1,295 @@
+/* RENDER GRAPH.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 16:10:40
+ * Last edited:
+ *   18/10/2021, 16:10:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the RenderGraph class, which describes a frame as passes
+ *   that declare how they use images and buffers. Compiling the graph
+ *   culls unused passes, orders the rest, derives batched pipeline
+ *   barriers and layout transitions, and lets transient resources with
+ *   disjoint lifetimes share memory.
+**/
+
+#ifndef RENDERING_RENDER_GRAPH_HPP
+#define RENDERING_RENDER_GRAPH_HPP
+
+#include <string>
+#include <functional>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+#include "ResourceUsage.hpp"
+
+namespace Makma3D {
+    /* Refers to an image or buffer in a RenderGraph. */
+    using resource_t = uint32_t;
+    /* Refers to a pass in a RenderGraph. */
+    using pass_t = uint32_t;
+
+    /* Describes a transient image, which only lives within the RenderGraph. */
+    struct ImageDescription {
+        /* The format of the image. */
+        VkFormat format;
+        /* The size of the image. */
+        VkExtent2D extent;
+        /* The aspects of the image (color, depth and/or stencil). */
+        VkImageAspectFlags aspect;
+    };
+
+    /* Counts what compiling the RenderGraph did. */
+    struct RenderGraphStatistics {
+        /* The number of passes that will be executed. */
+        uint32_t n_passes;
+        /* The number of passes that were culled because nothing uses their results. */
+        uint32_t n_culled;
+        /* The number of vkCmdPipelineBarrier() calls per execution. */
+        uint32_t n_barriers;
+        /* The number of image layout transitions per execution. */
+        uint32_t n_transitions;
+        /* The total size of the transient resources. */
+        VkDeviceSize transient_size;
+        /* The memory actually allocated for them, after aliasing. */
+        VkDeviceSize allocated_size;
+    };
+
+
+
+    /* The RenderGraph class, which derives the synchronization and transient memory of a frame from the passes that make it up. */
+    class RenderGraph {
+    public:
+        /* Channel name for the RenderGraph class. */
+        static constexpr const char* channel = "RenderGraph";
+
+        /* The Device on which the graph runs. */
+        const Makma3D::Device& device;
+
+        /* The function that records a pass. It gets the command buffer to record on and the graph, from which it can get the resources it uses. */
+        using execute_t = std::function<void(VkCommandBuffer, const RenderGraph&)>;
+
+    private:
+        /* A single image or buffer in the graph. */
+        struct Resource {
+            /* The name of the resource, for debugging. */
+            std::string name;
+            /* Whether the resource is an image (true) or a buffer (false). */
+            bool is_image;
+            /* Whether the resource lives outside the graph (true) or only within it (false). */
+            bool imported;
+            /* Whether the resource is a result of the frame, which keeps the passes that write it alive. */
+            bool output;
+
+            /* For transient images, what the image looks like. */
+            ImageDescription description;
+            /* For transient buffers, the size of the buffer. */
+            VkDeviceSize size;
+            /* For images, the aspects of the image. */
+            VkImageAspectFlags aspect;
+            /* For imported images, the layout they're in when the graph starts. */
+            VkImageLayout initial_layout;
+            /* For imported images, the layout they should be in when the graph ends, or VK_IMAGE_LAYOUT_UNDEFINED if it doesn't matter. */
+            VkImageLayout final_layout;
+            /* For imported resources, the stages that have to be done before the graph may touch them (e.g., the stage at which the frame waits on the image-available semaphore). */
+            VkPipelineStageFlags wait_stages;
+
+            /* The image, if the resource is an image. */
+            VkImage vk_image;
+            /* The view of the image, if the resource is an image. */
+            VkImageView vk_image_view;
+            /* The buffer, if the resource is a buffer. */
+            VkBuffer vk_buffer;
+
+            /* The usage flags the transient image needs, as derived from its uses. */
+            VkImageUsageFlags image_usage;
+            /* The usage flags the transient buffer needs, as derived from its uses. */
+            VkBufferUsageFlags buffer_usage;
+            /* The position in the execution order of the first pass that uses the resource. */
+            uint32_t first_use;
+            /* The position in the execution order of the last pass that uses the resource. */
+            uint32_t last_use;
+            /* For transient resources, the memory block it lives in. */
+            uint32_t block;
+        };
+
+        /* A single use of a resource by a pass. */
+        struct Use {
+            /* The resource that's used. */
+            resource_t resource;
+            /* How it's used. */
+            ResourceUsage usage;
+        };
+
+        /* The barriers that have to be recorded before a pass, batched into a single vkCmdPipelineBarrier() call. */
+        struct Barriers {
+            /* The stages that have to finish before the barrier. */
+            VkPipelineStageFlags src_stages;
+            /* The stages that wait for the barrier. */
+            VkPipelineStageFlags dst_stages;
+            /* The writes that have to be made available, for the global memory barrier. */
+            VkAccessFlags src_access;
+            /* The accesses they have to be made visible to, for the global memory barrier. */
+            VkAccessFlags dst_access;
+            /* The image barriers, for layout transitions. */
+            Tools::Array<VkImageMemoryBarrier> images;
+            /* For each image barrier, the resource it transitions, so imported images can be filled in when executing. */
+            Tools::Array<resource_t> image_resources;
+        };
+
+        /* A single pass in the graph. */
+        struct Pass {
+            /* The name of the pass, for debugging. */
+            std::string name;
+            /* The function that records the pass. */
+            execute_t execute;
+            /* Whether the pass has effects outside the graph, which keeps it alive even if nothing uses its results. */
+            bool side_effects;
+            /* The resources the pass uses, in order. */
+            Tools::Array<Use> uses;
+
+            /* Whether the pass survived culling. */
+            bool live;
+            /* The passes that have to run before this one. */
+            Tools::Array<pass_t> dependencies;
+            /* The barriers to record before the pass. */
+            Barriers barriers;
+        };
+
+        /* A piece of device memory that is shared by transient resources with disjoint lifetimes. */
+        struct MemoryBlock {
+            /* The memory. */
+            VkDeviceMemory vk_memory;
+            /* The size of the memory, i.e., the size of the largest resource in it. */
+            VkDeviceSize size;
+            /* The memory type the memory was allocated from. */
+            uint32_t memory_type;
+            /* The memory types that every resource in the block allows. */
+            uint32_t type_bits;
+            /* The resources that live in the block. */
+            Tools::Array<resource_t> resources;
+        };
+
+        /* The resources in the graph. */
+        Tools::Array<Resource> resources;
+        /* The passes in the graph, in the order in which they were added. */
+        Tools::Array<Pass> passes;
+        /* The live passes in the order in which they're executed. */
+        Tools::Array<pass_t> order;
+        /* The memory blocks of the transient resources. */
+        Tools::Array<MemoryBlock> blocks;
+        /* The barriers to record after the last pass, to move imported images to their final layouts. */
+        Barriers final_barriers;
+        /* Whether the graph has been compiled since it last changed. */
+        bool compiled;
+        /* The statistics of the last compilation. */
+        RenderGraphStatistics _statistics;
+
+
+        /* Culls the passes that don't contribute to an output, and computes the dependencies of the others. */
+        void cull();
+        /* Orders the live passes, preferring to put distance between passes and the passes they depend on. */
+        void schedule();
+        /* Derives the barriers of every pass by simulating the state of each resource through the order. Transients start from where the previous frame left their memory, since they are shared between frames in flight. */
+        void derive_barriers();
+        /* Creates the transient resources, sharing memory between those whose lifetimes don't overlap. */
+        void allocate_transients();
+        /* Retires the transient resources and their memory in the Device's DeletionQueue, since frames in flight may still use them. */
+        void retire_transients();
+        /* Records the given batch of barriers, if it isn't empty.
+         * @param vk_command_buffer The command buffer to record on.
+         * @param barriers The barriers to record. */
+        void record_barriers(VkCommandBuffer vk_command_buffer, const Barriers& barriers) const;
+
+    public:
+        /* Constructor for the RenderGraph class.
+         * @param device The Device on which the graph runs. */
+        RenderGraph(const Makma3D::Device& device);
+        /* Copy constructor for the RenderGraph class, which is deleted. */
+        RenderGraph(const RenderGraph& other) = delete;
+        /* Move constructor for the RenderGraph class. */
+        RenderGraph(RenderGraph&& other);
+        /* Destructor for the RenderGraph class. Assumes the graph isn't executing on the GPU anymore. */
+        ~RenderGraph();
+
+        /* Adds a transient image to the graph, which is created by compile() and only lives within the graph. Its usage flags are derived from how the passes use it.
+         * @param name The name of the image, for debugging.
+         * @param description What the image looks like.
+         * @returns The handle of the image. */
+        resource_t create_image(const std::string& name, const ImageDescription& description);
+        /* Adds an image that lives outside the graph, like a swapchain image.
+         * @param name The name of the image, for debugging.
+         * @param aspect The aspects of the image.
+         * @param initial_layout The layout the image is in when the graph starts.
+         * @param final_layout The layout the image should be in when the graph ends, or VK_IMAGE_LAYOUT_UNDEFINED if it doesn't matter.
+         * @param wait_stages The stages that have to be done before the graph may touch the image, like the stage at which the frame waits for the image to be acquired.
+         * @returns The handle of the image. Bind the actual image with bind_image() before executing. */
+        resource_t import_image(const std::string& name, VkImageAspectFlags aspect, VkImageLayout initial_layout, VkImageLayout final_layout, VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        /* Adds a transient buffer to the graph, which is created by compile() and only lives within the graph. Its usage flags are derived from how the passes use it.
+         * @param name The name of the buffer, for debugging.
+         * @param size The size of the buffer, in bytes.
+         * @returns The handle of the buffer. */
+        resource_t create_buffer(const std::string& name, VkDeviceSize size);
+        /* Adds a buffer that lives outside the graph.
+         * @param name The name of the buffer, for debugging.
+         * @param wait_stages The stages that have to be done before the graph may touch the buffer.
+         * @returns The handle of the buffer. Bind the actual buffer with bind_buffer() before executing. */
+        resource_t import_buffer(const std::string& name, VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        /* Marks the given resource as a result of the frame, which keeps the passes that produce it from being culled. Writes to imported resources are always results. */
+        void mark_output(resource_t resource);
+
+        /* Adds a pass to the graph. Passes that depend on each other run in the order in which they're added.
+         * @param name The name of the pass, for debugging.
+         * @param execute The function that records the pass.
+         * @param side_effects If true, the pass is never culled, even if nothing uses what it writes.
+         * @returns The handle of the pass. */
+        pass_t add_pass(const std::string& name, const execute_t& execute, bool side_effects = false);
+        /* Declares that the given pass uses the given resource in the given way. A pass that reads and writes a resource declares both uses.
+         * @param pass The pass that uses the resource.
+         * @param resource The resource it uses.
+         * @param usage How it uses the resource. */
+        void use(pass_t pass, resource_t resource, ResourceUsage usage);
+
+        /* Compiles the graph: culls unused passes, orders the rest, derives their barriers and creates the transient resources. Only has to be called again when the graph changes. */
+        void compile();
+        /* Records the whole graph on the given command buffer, with a single batch of barriers before each pass that needs any. Each pass is timed as a scope of the Device's GpuProfiler and wrapped in a debug label, both under its name.
+         * @param vk_command_buffer The command buffer to record on.
+         * @param queue_type The type of queue the command buffer is submitted to, which decides the query pool and timestamp period the passes are timed with. */
+        void execute(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type = Vulkanic::QueueType::graphics) const;
+
+        /* Sets the actual image of an imported image, e.g. the swapchain image of this frame. Doesn't require recompiling the graph. */
+        void bind_image(resource_t resource, VkImage vk_image, VkImageView vk_image_view);
+        /* Sets the actual buffer of an imported buffer. Doesn't require recompiling the graph. */
+        void bind_buffer(resource_t resource, VkBuffer vk_buffer);
+
+        /* Returns the image of the given resource, for use in a pass. */
+        inline VkImage get_image(resource_t resource) const { return this->resources[resource].vk_image; }
+        /* Returns the view of the image of the given resource, for use in a pass. */
+        inline VkImageView get_image_view(resource_t resource) const { return this->resources[resource].vk_image_view; }
+        /* Returns the buffer of the given resource, for use in a pass. */
+        inline VkBuffer get_buffer(resource_t resource) const { return this->resources[resource].vk_buffer; }
+        /* Returns whether the given pass survived culling. Only valid after compile(). */
+        inline bool is_live(pass_t pass) const { return this->passes[pass].live; }
+        /* Returns the statistics of the last compilation. */
+        inline const RenderGraphStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the RenderGraph class, which is deleted. */
+        RenderGraph& operator=(const RenderGraph& other) = delete;
+        /* Move assignment operator for the RenderGraph class. */
+        inline RenderGraph& operator=(RenderGraph&& other) { if (this != &other) { swap(*this, other); } return *this; }
+        /* Swap operator for the RenderGraph class. */
+        friend void swap(RenderGraph& rg1, RenderGraph& rg2);
+
+    };
+
+    /* Swap operator for the RenderGraph class. */
+    void swap(RenderGraph& rg1, RenderGraph& rg2);
+
+}
+
+#endif
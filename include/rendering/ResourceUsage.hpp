@@ -0,0 +1,80 @@
+/* RESOURCE USAGE.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 16:10:12
+ * Last edited:
+ *   18/10/2021, 16:10:12
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains an enum that lists the ways in which a pass of the
+ *   RenderGraph can use an image or a buffer. Each usage implies the
+ *   pipeline stages, access flags and image layout of the access.
+**/
+
+#ifndef RENDERING_RESOURCE_USAGE_HPP
+#define RENDERING_RESOURCE_USAGE_HPP
+
+#include <string>
+
+namespace Makma3D {
+    /* Lists the ways in which a RenderGraph pass can use a resource. */
+    enum class ResourceUsage {
+        /* The image is rendered to as a color attachment. */
+        color_attachment = 0,
+        /* The image is rendered to (and tested against) as a depth/stencil attachment. */
+        depth_attachment = 1,
+        /* The image is only tested against as a depth/stencil attachment. */
+        depth_read = 2,
+        /* The image is sampled in a fragment shader. */
+        fragment_sampled = 3,
+        /* The image is sampled in a compute shader. */
+        compute_sampled = 4,
+        /* The image is read as a storage image in a compute shader. */
+        storage_read = 5,
+        /* The image is written as a storage image in a compute shader. */
+        storage_write = 6,
+        /* The image or buffer is the source of a copy or blit. */
+        transfer_src = 7,
+        /* The image or buffer is the destination of a copy, blit or clear. */
+        transfer_dst = 8,
+        /* The buffer is read as vertex data. */
+        vertex_buffer = 9,
+        /* The buffer is read as index data. */
+        index_buffer = 10,
+        /* The buffer is read as indirect draw or dispatch arguments. */
+        indirect_buffer = 11,
+        /* The buffer is read as a uniform buffer in any shader. */
+        uniform_buffer = 12,
+        /* The buffer is read as a storage buffer in any shader. */
+        buffer_read = 13,
+        /* The buffer is written as a storage buffer in a compute shader. */
+        buffer_write = 14
+    };
+
+    /* The number of different resource usages. */
+    static constexpr const uint32_t n_resource_usages = 15;
+
+    /* Names for the ResourceUsage enum. */
+    static const std::string resource_usage_names[] = {
+        "color_attachment",
+        "depth_attachment",
+        "depth_read",
+        "fragment_sampled",
+        "compute_sampled",
+        "storage_read",
+        "storage_write",
+        "transfer_src",
+        "transfer_dst",
+        "vertex_buffer",
+        "index_buffer",
+        "indirect_buffer",
+        "uniform_buffer",
+        "buffer_read",
+        "buffer_write"
+    };
+}
+
+#endif
@@ -0,0 +1,207 @@
+/* SHADER LIBRARY.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   20/10/2021, 14:47:03
+ * Last edited:
+ *   20/10/2021, 14:47:03
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the ShaderLibrary class, which maps compiled SPIR-V files
+ *   into memory, shares one VkShaderModule between files with the same
+ *   contents and expresses shader variants as specialization constants.
+ *   A manifest lists the variants that are used, so they can all be
+ *   compiled through the PipelineManager before the first frame.
+**/
+
+#ifndef RENDERING_SHADER_LIBRARY_HPP
+#define RENDERING_SHADER_LIBRARY_HPP
+
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+#include "PipelineManager.hpp"
+
+namespace Makma3D {
+    /* The values of the specialization constants of a shader variant. */
+    class SpecializationConstants {
+    private:
+        /* Describes where each constant lives in the data. */
+        Tools::Array<VkSpecializationMapEntry> entries;
+        /* The values of the constants, each four bytes large. */
+        Tools::Array<uint32_t> data;
+
+    public:
+        /* Constructor for the SpecializationConstants class, which creates a set without any constants. */
+        SpecializationConstants() {}
+
+        /* Sets the constant with the given identifier to the given value, which must be four bytes large (e.g., an int, uint, float or VkBool32).
+         * @param constant_id The identifier of the constant, as given with layout(constant_id = ...) in the shader.
+         * @param value The value of the constant.
+         * @returns A reference to the set, so calls can be chained. */
+        template <typename T>
+        SpecializationConstants& set(uint32_t constant_id, const T& value) {
+            static_assert(sizeof(T) == sizeof(uint32_t), "Only four-byte values can be used as specialization constants");
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(uint32_t));
+            return this->set_bits(constant_id, bits);
+        }
+        /* Sets the constant with the given identifier to the given raw bits.
+         * @param constant_id The identifier of the constant.
+         * @param bits The bits of the value of the constant.
+         * @returns A reference to the set, so calls can be chained. */
+        SpecializationConstants& set_bits(uint32_t constant_id, uint32_t bits);
+
+        /* Adds the constants to the given PipelineKey, so variants with different values get different pipelines. */
+        void add_to(PipelineKey& key) const;
+        /* Returns a VkSpecializationInfo that refers to the constants. Only valid as long as the set isn't changed or destroyed. */
+        VkSpecializationInfo info() const;
+
+        /* Returns the number of constants that are set. */
+        inline uint32_t size() const { return this->entries.size(); }
+        /* Returns whether there are no constants set. */
+        inline bool empty() const { return this->entries.empty(); }
+
+    };
+
+
+
+    /* A single stage of a shader variant. */
+    struct ShaderStage {
+        /* The stage that the module is used for. */
+        VkShaderStageFlagBits stage;
+        /* The module with the code. */
+        VkShaderModule vk_module;
+        /* The function in the module where the stage begins. */
+        std::string entry_point;
+    };
+
+    /* Counts what the ShaderLibrary did. */
+    struct ShaderLibraryStatistics {
+        /* The number of files that were mapped into memory. */
+        uint64_t n_files;
+        /* The number of bytes of SPIR-V that were mapped. */
+        uint64_t bytes_mapped;
+        /* The number of VkShaderModules that were created. */
+        uint64_t n_modules;
+        /* The number of files whose contents matched an existing module, and thus didn't get one of their own. */
+        uint64_t n_deduplicated;
+        /* The number of variants that were requested from the PipelineManager. */
+        uint64_t n_variants;
+    };
+
+
+
+    /* The ShaderLibrary class, which loads SPIR-V files into shared VkShaderModules and builds the pipelines of the shader variants in a manifest ahead of time. */
+    class ShaderLibrary {
+    public:
+        /* Channel name for the ShaderLibrary class. */
+        static constexpr const char* channel = "ShaderLibrary";
+
+        /* Function that creates the pipeline for a shader variant on the given VkDevice, with the given VkPipelineCache and shader stages. The stages already carry the specialization info of the variant. Called from a PipelineManager worker, and returns nullptr if the pipeline could not be created. */
+        using builder_t = std::function<VkPipeline(VkDevice, VkPipelineCache, const Tools::Array<VkPipelineShaderStageCreateInfo>&)>;
+
+        /* The Device on which this ShaderLibrary lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* A registered builder. */
+        struct Builder {
+            /* The function that builds the pipelines. */
+            builder_t build;
+            /* Identifies the layout, render pass and fixed-function state the builder uses, so it ends up in the key of each pipeline. */
+            PipelineKey key;
+        };
+        /* A module together with the code it was created from, so files whose hashes collide can be told apart. */
+        struct Module {
+            /* The SPIR-V code of the module. */
+            Tools::Array<uint32_t> code;
+            /* The module itself. */
+            VkShaderModule vk_module;
+        };
+
+        /* The PipelineManager that compiles the variants. */
+        PipelineManager& pipeline_manager;
+        /* The directory relative to which shader files are found. */
+        std::string shader_dir;
+
+        /* The modules, by the hash and size of their contents. Modules whose hashes collide share a bucket, and are told apart by their code. */
+        std::unordered_map<PipelineKey, Tools::Array<Module>> modules;
+        /* The modules, by the path of the file they were loaded from. */
+        std::unordered_map<std::string, VkShaderModule> paths;
+        /* The registered builders, by name. */
+        std::unordered_map<std::string, Builder> builders;
+        /* The pipelines of the variants, by name. */
+        std::unordered_map<std::string, pipeline_id_t> variants;
+        /* The statistics of this library. */
+        ShaderLibraryStatistics _statistics;
+        /* Lock for the maps and the statistics. */
+        mutable std::mutex lock;
+
+    public:
+        /* Constructor for the ShaderLibrary class.
+         * @param device The Device on which we create shader modules.
+         * @param pipeline_manager The PipelineManager that compiles the pipelines of the variants. Has to outlive the library.
+         * @param shader_dir The directory relative to which shader files and manifests are found (e.g., Tools::get_executable_path() + "/shaders"). */
+        ShaderLibrary(const Makma3D::Device& device, PipelineManager& pipeline_manager, const std::string& shader_dir);
+        /* Copy constructor for the ShaderLibrary class, which is deleted. */
+        ShaderLibrary(const ShaderLibrary& other) = delete;
+        /* Move constructor for the ShaderLibrary class, which is deleted. */
+        ShaderLibrary(ShaderLibrary&& other) = delete;
+        /* Destructor for the ShaderLibrary class. Destroys all modules, so no pipeline that uses them may still be compiling. */
+        ~ShaderLibrary();
+
+        /* Returns the VkShaderModule with the code of the given SPIR-V file. The file is mapped into memory rather than read, and if its contents are byte-for-byte the same as those of a module that was created before, that module is returned instead of creating a new one. Can be called from any thread.
+         * @param path The path of the file, relative to the shader directory.
+         * @returns The module, which the library owns. */
+        VkShaderModule load(const std::string& path);
+
+        /* Registers a function that builds pipelines for the variants that name it in a manifest, e.g., one per combination of pipeline layout, render pass and vertex layout. Can be called from any thread.
+         * @param name The name of the builder, as used in manifests.
+         * @param key Describes everything the builder puts in its pipelines besides the shader stages.
+         * @param builder The function that builds the pipelines. */
+        void add_builder(const std::string& name, const PipelineKey& key, builder_t&& builder);
+        /* Requests the pipeline of a single shader variant from the PipelineManager. Variants with the same builder, stages and constants share one pipeline. Can be called from any thread.
+         * @param name The name of the variant.
+         * @param builder The name of a registered builder.
+         * @param stages The stages of the variant.
+         * @param constants The specialization constants of the variant, which are given to every stage.
+         * @returns The identifier of the pipeline. */
+        pipeline_id_t add_variant(const std::string& name, const std::string& builder, const Tools::Array<ShaderStage>& stages, const SpecializationConstants& constants);
+        /* Loads the manifest at the given path, which lists the shader variants that are used, and compiles all of them before returning. Each line that isn't empty or a comment (starting with '#') describes one variant:
+         *
+         *     <name> <builder> <stage>:<file>[:<entry point>]... [<constant id>=<value>]...
+         *
+         * where the stage is one of vertex, tessellation_control, tessellation_evaluation, geometry, fragment or compute, and a value with a '.' in it is a float. For example:
+         *
+         *     textured_lit  mesh  vertex:mesh.vert.spv  fragment:mesh.frag.spv  0=2 1=1
+         *
+         * @param path The path of the manifest, relative to the shader directory.
+         * @returns The number of variants in the manifest. */
+        uint32_t load_manifest(const std::string& path);
+
+        /* Returns the pipeline of the variant with the given name. Never compiles anything, so variants that aren't in a manifest have to be added with add_variant() first. Can be called from any thread.
+         * @returns The identifier of the pipeline, which can be passed to PipelineManager::get(), or null_pipeline_id if there is no such variant. */
+        pipeline_id_t find(const std::string& name) const;
+
+        /* Returns the statistics of this library. */
+        inline const ShaderLibraryStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the ShaderLibrary class, which is deleted. */
+        ShaderLibrary& operator=(const ShaderLibrary& other) = delete;
+        /* Move assignment operator for the ShaderLibrary class, which is deleted. */
+        ShaderLibrary& operator=(ShaderLibrary&& other) = delete;
+
+    };
+}
+
+#endif
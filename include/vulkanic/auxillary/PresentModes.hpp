@@ -0,0 +1,36 @@
+/* PRESENT MODES.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 11:04:27
+ * Last edited:
+ *   16/10/2021, 11:04:27
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains mappings from vulkan VkPresentModeKHR to readable names.
+**/
+
+#ifndef VULKANIC_PRESENT_MODES_HPP
+#define VULKANIC_PRESENT_MODES_HPP
+
+#include <unordered_map>
+#include <string>
+#include <vulkan/vulkan.h>
+
+/* Simple macro that sets the given enum to its string representation. */
+#define MAP_VK_PRESENT_MODE(MODE) \
+    { (MODE), (#MODE) }
+
+namespace Makma3D::Vulkanic {
+    /* Static map of VkPresentModeKHRs to their respective string representations. */
+    static std::unordered_map<VkPresentModeKHR, std::string> vk_present_mode_map({
+        MAP_VK_PRESENT_MODE(VK_PRESENT_MODE_IMMEDIATE_KHR),
+        MAP_VK_PRESENT_MODE(VK_PRESENT_MODE_MAILBOX_KHR),
+        MAP_VK_PRESENT_MODE(VK_PRESENT_MODE_FIFO_KHR),
+        MAP_VK_PRESENT_MODE(VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+    });
+}
+
+#endif
@@ -20,6 +20,7 @@
 
 #include "arrays/Array.hpp"
 #include "gpu/PhysicalDevice.hpp"
+#include "gpu/PhysicalDeviceRegistry.hpp"
 
 namespace Makma3D::Vulkanic {
     /* The Vulkan instance extensions we want to be enabled. */
@@ -37,20 +38,62 @@ namespace Makma3D::Vulkanic {
 
 
 
+    /* The VK_EXT_debug_utils functions that name objects and label command buffers. */
+    struct DebugUtilsFunctions {
+        /* The vkSetDebugUtilsObjectNameEXT function. */
+        PFN_vkSetDebugUtilsObjectNameEXT set_object_name;
+        /* The vkCmdBeginDebugUtilsLabelEXT function. */
+        PFN_vkCmdBeginDebugUtilsLabelEXT cmd_begin_label;
+        /* The vkCmdEndDebugUtilsLabelEXT function. */
+        PFN_vkCmdEndDebugUtilsLabelEXT cmd_end_label;
+        /* The vkCmdInsertDebugUtilsLabelEXT function. */
+        PFN_vkCmdInsertDebugUtilsLabelEXT cmd_insert_label;
+    };
+
+    /* Lists the instance functions that are used after initialization, e.g., to load device functions or to recreate a swapchain. Expands X(name, required) for each of them. */
+    #define MAKMA3D_INSTANCE_FUNCTIONS(X) \
+        X(vkGetDeviceProcAddr, true) \
+        X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, false) \
+        X(vkGetPhysicalDeviceSurfaceFormatsKHR, false) \
+        X(vkGetPhysicalDeviceSurfacePresentModesKHR, false) \
+        X(vkGetPhysicalDeviceMemoryProperties2, false)
+
+    /* The functions of the instance that are called without going through the loader's trampoline. Members are named after the function they point to, and optional ones are nullptr if their extension isn't enabled. */
+    struct InstanceDispatch {
+        #define MAKMA3D_DECLARE_FUNCTION(NAME, REQUIRED) PFN_##NAME NAME;
+        MAKMA3D_INSTANCE_FUNCTIONS(MAKMA3D_DECLARE_FUNCTION)
+        #undef MAKMA3D_DECLARE_FUNCTION
+    };
+
+
+
     /* The Instance class, which wraps and manages the Vulkan instance and the Vulkan debug logger. */
     class Instance {
     public:
         /* The channel used for the Instance class. */
         static constexpr const char* channel = "VulkanicInstance";
+        /* The highest Vulkan version that we know how to use. */
+        static constexpr const uint32_t max_api_version = VK_API_VERSION_1_3;
 
     private:
         /* The VkInstance that we use, among other things. */
         VkInstance vk_instance;
+        /* The Vulkan version that we negotiated for the instance. */
+        uint32_t _api_version;
+        /* The function to query extension features of physical devices (vkGetPhysicalDeviceFeatures2 or its KHR variant), or nullptr if neither Vulkan 1.1 nor VK_KHR_get_physical_device_properties2 is available. */
+        PFN_vkGetPhysicalDeviceFeatures2 vk_get_physical_device_features2_method;
+        /* The instance functions that we call directly, which are loaded during the init() stage. */
+        InstanceDispatch dispatch_functions;
 
         /* The debug messenger of Vulkan. */
         VkDebugUtilsMessengerEXT vk_debugger;
         /* The function needed to destroy the Vulkan debug messenger. */
         PFN_vkDestroyDebugUtilsMessengerEXT vk_destroy_debug_utils_messenger_method;
+        /* The functions to name objects and label command buffers with, which are loaded together with the debug messenger. */
+        DebugUtilsFunctions debug_utils_functions;
+
+        /* The cached list of physical devices in this instance. */
+        PhysicalDeviceRegistry physical_device_registry;
     
     public:
         /* Constructor for the Instance class.
@@ -63,6 +106,10 @@ namespace Makma3D::Vulkanic {
         /* Destructor for the Instance class. */
         ~Instance();
 
+        /* Returns the highest Vulkan version that both the loader and the engine support, which is the version init() requests.
+         * @returns The version, as given by VK_MAKE_API_VERSION(). */
+        static uint32_t negotiate_api_version();
+
         /* Initializes the instance.
          * @param application_name The name of the application.
          * @param application_version The version of the application, as given by VK_MAKE_VERSION().
@@ -74,12 +121,28 @@ namespace Makma3D::Vulkanic {
          * Requires the appropriate extensions and layers already to be defined during the init() stage. */
         void init_debug();
 
-        /* Returns the list of (supported) PhysicalDevices that are currently registered to the Vulkan backend.
-         * @param vk_surface The VkSurface object used to check if this device can present to that Surface.
+        /* Returns the list of (supported) PhysicalDevices that are currently registered to the Vulkan backend. Uses the cached devices in the registry, so only presentation support is queried.
+         * @param vk_surface The VkSurface object used to check if this device can present to that Surface. If nullptr, presentation support is not required (headless mode).
          * @param vk_device_extensions The list of Vulkan GPU extensions that the device should at least support.
          * @param vk_device_features The list of Vulkan GPU features (as Vulkanic::DeviceFeatures enums) that the device should at least support.
          * @returns The list of Makma3D-suitable physical devices that we found. Empty if no such devices are present. */
         Tools::Array<PhysicalDevice> get_physical_devices(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const;
+        /* Creates a new VkSurfaceKHR that is not backed by any display, using VK_EXT_headless_surface.
+         * Requires the extension to be enabled during the init() stage.
+         * @returns The new VkSurfaceKHR, which should be destroyed by the caller (e.g., by wrapping it in a Surface). */
+        VkSurfaceKHR create_headless_surface() const;
+
+        /* Returns the Vulkan version that was negotiated for the instance, as given by VK_MAKE_API_VERSION(). Devices may still use a lower version. */
+        inline uint32_t api_version() const { return this->_api_version; }
+        /* Returns the instance functions that are called directly instead of through the loader. Only valid after the init() stage. */
+        inline const InstanceDispatch& dispatch() const { return this->dispatch_functions; }
+        /* Returns the functions to name objects and label command buffers with, or nullptr if the debugging part isn't initialized. */
+        inline const DebugUtilsFunctions* debug_utils() const { return this->vk_debugger != nullptr ? &this->debug_utils_functions : nullptr; }
+        /* Returns whether extension features of physical devices can be queried and enabled (through Vulkan 1.1 or VK_KHR_get_physical_device_properties2). */
+        inline bool supports_features2() const { return this->vk_get_physical_device_features2_method != nullptr; }
+
+        /* Returns the registry with all physical devices in this instance, which is filled during the init() stage. */
+        inline const PhysicalDeviceRegistry& get_physical_device_registry() const { return this->physical_device_registry; }
 
         /* Explicitly returns the internal VkInstance object. */
         inline const VkInstance& vk() const { return this->vk_instance; }
@@ -17,6 +17,7 @@
 #define VULKANIC_SURFACE_HPP
 
 #include "instance/Instance.hpp"
+#include "gpu/DeletionQueue.hpp"
 
 namespace Makma3D::Vulkanic {
     /* The Surface class, which wraps a VkSurfaceKHR object that comes from a window library. */
@@ -47,8 +48,14 @@ namespace Makma3D::Vulkanic {
         /* Destructor for the Surface class. */
         ~Surface();
 
-        /* "Re-creates" the Surface by destroying the internal one and replacing it with the given VkSurfaceKHR. The extent is the new size of the surface. */
-        void recreate(const VkSurfaceKHR& vk_surface, const VkExtent2D& extent);
+        /* "Re-creates" the Surface by destroying the internal one and replacing it with the given VkSurfaceKHR.
+         * @param vk_surface The new VkSurfaceKHR, which will be automatically destroyed when this class is destructed.
+         * @param extent The new size (in pixels) of the surface's framebuffer.
+         * @param deletion_queue If given, the old surface is retired in it instead of destroyed immediately, so that a swapchain that was retired there before it (see Swapchain::reset()) is always destroyed first. */
+        void recreate(const VkSurfaceKHR& vk_surface, const VkExtent2D& extent, DeletionQueue* deletion_queue = nullptr);
+        /* Updates the size of the Surface after its window has been resized. The VkSurfaceKHR stays valid for as long as its window lives, so a resize never needs a new one.
+         * @param extent The new size (in pixels) of the surface's framebuffer. */
+        inline void resize(const VkExtent2D& extent) { this->_extent = extent; }
 
         /* Returns the size (in pixels) of framebuffers rendering to this surface. */
         inline const VkExtent2D& extent() const { return this->_extent; }
@@ -0,0 +1,135 @@
+/* OFFSCREEN TARGET.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 15:40:12
+ * Last edited:
+ *   16/10/2021, 15:40:12
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the OffscreenTarget class, which replaces the Swapchain when
+ *   rendering headless by rendering the frames in flight to images that
+ *   are never presented.
+**/
+
+#ifndef VULKANIC_OFFSCREEN_TARGET_HPP
+#define VULKANIC_OFFSCREEN_TARGET_HPP
+
+#include <chrono>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+
+#include "Swapchain.hpp"
+
+namespace Makma3D::Vulkanic {
+    /* The OffscreenTarget class, which owns one image per frame in flight and mimics the Swapchain's acquire/present cycle without a display. */
+    class OffscreenTarget {
+    public:
+        /* Channel name for the OffscreenTarget class. */
+        static constexpr const char* channel = "VulkanicOffscreenTarget";
+
+        /* The Device on which the target lives. */
+        const Makma3D::Device& device;
+
+    private:
+        /* A single frame in flight with the image it renders to. */
+        struct Frame {
+            /* The image that the frame renders to. */
+            VkImage vk_image;
+            /* The memory backing the image. */
+            VkDeviceMemory vk_memory;
+            /* The memory type of the memory backing the image. */
+            uint32_t memory_type;
+            /* The size of the memory backing the image. */
+            VkDeviceSize memory_size;
+            /* The view for the image. */
+            VkImageView vk_view;
+            /* Fence that is signalled when the frame's submission is done. */
+            VkFence vk_in_flight;
+        };
+
+        /* The format of the images. */
+        VkFormat vk_format;
+        /* The size of the images. */
+        VkExtent2D vk_extent;
+
+        /* The frames in flight. */
+        Tools::Array<Frame> frames;
+        /* The images of all frames, in frame order. */
+        Tools::Array<VkImage> vk_images;
+        /* The views of all frames, in frame order. */
+        Tools::Array<VkImageView> vk_views;
+        /* The index of the current frame in flight. */
+        uint32_t _current_frame;
+
+        /* The statistics of the rendered frames. Since nothing throttles offscreen rendering, the present mode is reported as immediate. */
+        FrameStatistics _statistics;
+        /* The time of the last present. */
+        std::chrono::steady_clock::time_point last_present;
+
+
+        /* Creates the images, their memory and their views for all frames. */
+        void create_images();
+        /* Destroys the images, their memory and their views for all frames. */
+        void destroy_images();
+        /* Waits until all frames in flight are done. */
+        void wait_frames();
+        /* Logs the statistics and resets them. */
+        void flush_statistics();
+
+    public:
+        /* Constructor for the OffscreenTarget class.
+         * @param device The Device that renders the images. Doesn't have to be able to present.
+         * @param extent The size of the images.
+         * @param format The format of the images. Defaults to the format a Swapchain would prefer. */
+        OffscreenTarget(const Makma3D::Device& device, const VkExtent2D& extent, VkFormat format = VK_FORMAT_B8G8R8A8_SRGB);
+        /* Copy constructor for the OffscreenTarget class, which is deleted. */
+        OffscreenTarget(const OffscreenTarget& other) = delete;
+        /* Move constructor for the OffscreenTarget class. */
+        OffscreenTarget(OffscreenTarget&& other);
+        /* Destructor for the OffscreenTarget class. */
+        ~OffscreenTarget();
+
+        /* Waits until the current frame in flight is available and prepares it for rendering. The frame's image starts in an undefined layout.
+         * @param image_index Will be set to the index of the image to render to, which is equal to the current frame.
+         * @returns Always true; present for compatibility with Swapchain::acquire(). */
+        bool acquire(uint32_t& image_index);
+        /* Finishes the current frame and moves to the next frame in flight. Nothing is actually presented.
+         * @param image_index The index of the rendered image, as given by acquire().
+         * @returns Always true; present for compatibility with Swapchain::present(). */
+        bool present(uint32_t image_index);
+        /* Resizes the images, waiting until all frames in flight are done first.
+         * @param extent The new size of the images. */
+        void resize(const VkExtent2D& extent);
+
+        /* Returns the fence that should be signalled by the last submission of the current frame. */
+        inline VkFence in_flight() const { return this->frames[this->_current_frame].vk_in_flight; }
+        /* Returns the index of the current frame in flight. */
+        inline uint32_t current_frame() const { return this->_current_frame; }
+        /* Returns the number of frames in flight. */
+        inline uint32_t n_frames() const { return this->frames.size(); }
+
+        /* Returns the images, one per frame in flight. */
+        inline const Tools::Array<VkImage>& images() const { return this->vk_images; }
+        /* Returns the views for the images. */
+        inline const Tools::Array<VkImageView>& views() const { return this->vk_views; }
+        /* Returns the format of the images. */
+        inline VkFormat format() const { return this->vk_format; }
+        /* Returns the size of the images. */
+        inline const VkExtent2D& extent() const { return this->vk_extent; }
+        /* Returns the frame timing statistics. */
+        inline const FrameStatistics& statistics() const { return this->_statistics; }
+
+        /* Copy assignment operator for the OffscreenTarget class, which is deleted. */
+        OffscreenTarget& operator=(const OffscreenTarget& other) = delete;
+        /* Move assignment operator for the OffscreenTarget class, which is deleted since the OffscreenTarget contains references. */
+        OffscreenTarget& operator=(OffscreenTarget&& other) = delete;
+
+    };
+}
+
+#endif
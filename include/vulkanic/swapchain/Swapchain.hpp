@@ -0,0 +1,201 @@
+/* SWAPCHAIN.hpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 11:02:40
+ * Last edited:
+ *   16/10/2021, 11:02:40
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Swapchain class, which wraps a VkSwapchainKHR for a given
+ *   Surface and manages the synchronization of the frames in flight.
+**/
+
+#ifndef VULKANIC_SWAPCHAIN_HPP
+#define VULKANIC_SWAPCHAIN_HPP
+
+#include <chrono>
+#include <vulkan/vulkan.h>
+
+#include "arrays/Array.hpp"
+#include "gpu/Device.hpp"
+#include "vulkanic/surface/Surface.hpp"
+
+namespace Makma3D::Vulkanic {
+    /* Collects timing statistics of the frames presented with a single present mode. */
+    struct FrameStatistics {
+        /* The present mode to which the statistics belong. */
+        VkPresentModeKHR present_mode;
+        /* The number of frames presented. */
+        uint64_t n_frames;
+        /* The total time (in seconds) between the first and last present. */
+        double total_frame_time;
+        /* The total time (in seconds) spent blocking in acquire(), i.e., waiting for a frame or an image to become available. */
+        double total_acquire_time;
+
+        /* Returns the average number of frames per second. */
+        inline double fps() const { return this->n_frames > 1 ? (this->n_frames - 1) / this->total_frame_time : 0.0; }
+        /* Returns the average time (in seconds) blocked in acquire() per frame. */
+        inline double acquire_latency() const { return this->n_frames > 0 ? this->total_acquire_time / this->n_frames : 0.0; }
+    };
+
+
+
+    /* The Swapchain class, which wraps a VkSwapchainKHR and runs a fixed number of frames in flight on it. */
+    class Swapchain {
+    public:
+        /* Channel name for the Swapchain class. */
+        static constexpr const char* channel = "VulkanicSwapchain";
+
+        /* The Device on which the swapchain lives. */
+        const Makma3D::Device& device;
+        /* The Surface to which the swapchain presents. */
+        const Vulkanic::Surface& surface;
+
+    private:
+        /* The synchronization primitives of a single frame in flight. */
+        struct Frame {
+            /* Semaphore that is signalled when the frame's image is acquired. */
+            VkSemaphore vk_image_available;
+            /* Fence that is signalled when the frame's submission is done. */
+            VkFence vk_in_flight;
+        };
+        /* An old swapchain that is kept alive until the frames that used it are done. */
+        struct Retired {
+            /* The retired swapchain. */
+            VkSwapchainKHR vk_swapchain;
+            /* The image views of the retired swapchain. */
+            Tools::Array<VkImageView> vk_views;
+            /* The render-finished semaphores of the retired swapchain. */
+            Tools::Array<VkSemaphore> vk_render_finished;
+            /* The frame counter after which the swapchain may be destroyed. */
+            uint64_t frame;
+        };
+
+        /* The VkSwapchainKHR object we wrap. */
+        VkSwapchainKHR vk_swapchain;
+        /* The format of the swapchain images. */
+        VkSurfaceFormatKHR vk_format;
+        /* The size of the swapchain images. */
+        VkExtent2D vk_extent;
+        /* The present mode of the swapchain. */
+        VkPresentModeKHR vk_present_mode;
+        /* Whether we're asked to sync with the vertical blank or not. */
+        bool _vsync;
+        /* Whether the last present reported that the swapchain no longer matches the surface exactly. */
+        bool _suboptimal;
+        /* Whether the last acquire or present reported that the swapchain can no longer be presented to, and is waiting for its owner to recreate it. */
+        bool _out_of_date;
+
+        /* The images of the swapchain. */
+        Tools::Array<VkImage> vk_images;
+        /* The image views for the swapchain images. */
+        Tools::Array<VkImageView> vk_views;
+        /* Semaphore per swapchain image that is signalled when rendering to it is done, and waited on by the presentation. */
+        Tools::Array<VkSemaphore> vk_render_finished;
+        /* For each swapchain image, the fence of the frame that last rendered to it (or nullptr). */
+        Tools::Array<VkFence> vk_image_fences;
+
+        /* The frames in flight. */
+        Tools::Array<Frame> frames;
+        /* The index of the current frame in flight. */
+        uint32_t _current_frame;
+        /* Counts the total number of frames presented. */
+        uint64_t frame_counter;
+        /* Old swapchains that wait to be destroyed. */
+        Tools::Array<Retired> retired;
+
+        /* The statistics for the current present mode. */
+        FrameStatistics _statistics;
+        /* The time of the last present. */
+        std::chrono::steady_clock::time_point last_present;
+
+
+        /* Creates a new VkSwapchainKHR, handing over the current one (if any) as the old swapchain. */
+        void create_swapchain();
+        /* Returns whether the surface still accepts images of the swapchain's extent, i.e., whether a recreate can wait until the surface has stopped changing. */
+        bool extent_usable() const;
+        /* Destroys the given old swapchain and the views and semaphores that come with it. */
+        static void destroy(VkDevice vk_device, const Retired& old);
+        /* Destroys the old swapchains whose frames are all done. */
+        void destroy_retired();
+        /* Logs the statistics of the current present mode and resets them. */
+        void flush_statistics();
+
+    public:
+        /* Constructor for the Swapchain class.
+         * @param device The Device that renders the images and presents them.
+         * @param surface The Surface to present to.
+         * @param vsync If true, presents in sync with the vertical blank (FIFO). Otherwise, prefers mailbox or immediate present modes for lower latency. */
+        Swapchain(const Makma3D::Device& device, const Vulkanic::Surface& surface, bool vsync = false);
+        /* Copy constructor for the Swapchain class, which is deleted. */
+        Swapchain(const Swapchain& other) = delete;
+        /* Move constructor for the Swapchain class. */
+        Swapchain(Swapchain&& other);
+        /* Destructor for the Swapchain class. */
+        ~Swapchain();
+
+        /* Waits until the current frame in flight is available, and then acquires the next swapchain image for it.
+         * If the swapchain is out-of-date, out_of_date() is set and false is returned until the owner recreates it; the caller should skip the frame. Only if the surface no longer accepts the swapchain's extent is it recreated immediately.
+         * @param image_index Will be set to the index of the acquired swapchain image.
+         * @returns Whether an image was acquired (true) or not (false). */
+        bool acquire(uint32_t& image_index);
+        /* Presents the given image on the present queue, waiting for its render_finished() semaphore, and moves to the next frame in flight.
+         * If the swapchain is out-of-date, out_of_date() is set; if it is merely suboptimal, it is kept presenting and suboptimal() is set. Either way, the owner recreates it once a burst of resizes has settled, unless the surface no longer accepts the swapchain's extent, in which case it is recreated immediately.
+         * @param image_index The index of the image to present, as given by acquire().
+         * @returns Whether the swapchain was still usable (true) or not (false). */
+        bool present(uint32_t image_index);
+        /* Recreates the swapchain, e.g. after a resize. Hands the old swapchain over to the new one and keeps it alive until its frames are done, so the device doesn't have to idle. */
+        void recreate();
+        /* Destroys the swapchain without recreating it, for when the underlying surface is about to be replaced. Never waits: the old swapchains are retired in the Device's DeletionQueue, so the old surface should be retired there too (see Surface::recreate()). */
+        void reset();
+
+        /* Changes whether the swapchain should sync with the vertical blank. Recreates it if the present mode changes. */
+        void set_vsync(bool vsync);
+
+        /* Returns the semaphore that will be signalled once the current frame's image is acquired. Any submission that writes to the image should wait on it. */
+        inline VkSemaphore image_available() const { return this->frames[this->_current_frame].vk_image_available; }
+        /* Returns the semaphore that should be signalled by the last submission that renders to the given image. */
+        inline VkSemaphore render_finished(uint32_t image_index) const { return this->vk_render_finished[image_index]; }
+        /* Returns the fence that should be signalled by the last submission of the current frame. */
+        inline VkFence in_flight() const { return this->frames[this->_current_frame].vk_in_flight; }
+        /* Returns the index of the current frame in flight. */
+        inline uint32_t current_frame() const { return this->_current_frame; }
+        /* Returns the number of frames in flight. */
+        inline uint32_t n_frames() const { return this->frames.size(); }
+
+        /* Returns the swapchain images. */
+        inline const Tools::Array<VkImage>& images() const { return this->vk_images; }
+        /* Returns the views for the swapchain images. */
+        inline const Tools::Array<VkImageView>& views() const { return this->vk_views; }
+        /* Returns the format of the swapchain images. */
+        inline VkFormat format() const { return this->vk_format.format; }
+        /* Returns the size of the swapchain images. */
+        inline const VkExtent2D& extent() const { return this->vk_extent; }
+        /* Returns the present mode of the swapchain. */
+        inline VkPresentModeKHR present_mode() const { return this->vk_present_mode; }
+        /* Returns whether the swapchain syncs with the vertical blank. */
+        inline bool vsync() const { return this->_vsync; }
+        /* Returns whether the swapchain still presents, but no longer matches the surface exactly (e.g., halfway a resize). Cleared by recreate(). */
+        inline bool suboptimal() const { return this->_suboptimal; }
+        /* Returns whether the swapchain can no longer be presented to, and acquire() skips frames until it is recreated. Cleared by recreate(). */
+        inline bool out_of_date() const { return this->_out_of_date; }
+        /* Returns the frame timing statistics for the current present mode. */
+        inline const FrameStatistics& statistics() const { return this->_statistics; }
+
+        /* Explicitly returns the internal VkSwapchainKHR object. */
+        inline const VkSwapchainKHR& vk() const { return this->vk_swapchain; }
+        /* Implicitly returns the internal VkSwapchainKHR object. */
+        inline operator const VkSwapchainKHR&() const { return this->vk_swapchain; }
+
+        /* Copy assignment operator for the Swapchain class, which is deleted. */
+        Swapchain& operator=(const Swapchain& other) = delete;
+        /* Move assignment operator for the Swapchain class, which is deleted since the Swapchain contains references. */
+        Swapchain& operator=(Swapchain&& other) = delete;
+
+    };
+}
+
+#endif
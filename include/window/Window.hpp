@@ -17,12 +17,14 @@
 #ifndef WINDOW_WINDOW_HPP
 #define WINDOW_WINDOW_HPP
 
+#include <chrono>
 #include <vulkan/vulkan.h>
 
 #include "instance/Instance.hpp"
 #include "gpu/PhysicalDevice.hpp"
+#include "gpu/Device.hpp"
 #include "vulkanic/surface/Surface.hpp"
-// #include "vulkanic/gpu/GPU.hpp"
+#include "vulkanic/swapchain/Swapchain.hpp"
 
 #include "WindowMode.hpp"
 #include "Monitor.hpp"
@@ -34,6 +36,9 @@ namespace Makma3D {
         /* Channel name for the Window class. */
         static constexpr const char* channel = "Window";
 
+        /* The time (in milliseconds) that the framebuffer size has to stay the same before a resize is applied to the swapchain. */
+        static constexpr const uint32_t resize_delay = 100;
+
         /* The Instance to which this Window is bound. */
         const Makma3D::Instance& instance;
 
@@ -53,16 +58,26 @@ namespace Makma3D {
 
         /* The Surface object used to create a Swapchain with. */
         Vulkanic::Surface* _surface;
-        /* The Swapchain object that we wrap. */
-        /* TBD */
+        /* The Swapchain object that we wrap. Is nullptr until the Window is bound to a Device. */
+        Vulkanic::Swapchain* _swapchain;
+
+        /* Whether the framebuffer was resized since the last time we resized the swapchain. */
+        bool resize_pending;
+        /* The time of the last framebuffer resize event. */
+        std::chrono::steady_clock::time_point last_resize;
+        /* The number of framebuffer resize events received. */
+        uint64_t n_resize_events;
+        /* The number of times the swapchain was actually resized. */
+        uint64_t n_resizes;
+
 
+        /* GLFW callback that records that the framebuffer of the given window was resized. The actual resize is postponed until loop() sees the size settle. */
+        static void _framebuffer_size_callback(GLFWwindow* glfw_window, int width, int height);
 
         /* Returns the nearest monitor to the current Window position. Only called if the current mode is windowed. */
         const Monitor* _find_nearest_monitor() const;
-        /* Private helper function that reconstructs the Surface. */
-        void _reconstruct_surface();
-        /* Private helper function that reconstructs the Swapchain. */
-        /* TBD */
+        /* Private helper function that resizes the Surface to the current framebuffer size and recreates the Swapchain (if there is any) for it. Keeps the VkSurfaceKHR, and hands the old swapchain over to the new one so that frames in flight can still present. */
+        void _resize_swapchain();
 
     public:
         /* Constructor for the Window class.
@@ -80,11 +95,13 @@ namespace Makma3D {
         /* Destructor for the Window class. */
         ~Window();
 
-        // /* Uses the given GPU to create the internal swapchain. Must be called before the window can be rendered to, obviously. */
-        // void bind(const Vulkanic::GPU& gpu);
+        /* Uses the given Device to create the internal swapchain. Must be called before the window can be rendered to, obviously.
+         * @param device The Device that will render to this Window. Must have been created for this Window's surface.
+         * @param vsync Whether to sync presentation with the vertical blank. Can be changed later with swapchain().set_vsync(). */
+        void bind(const Makma3D::Device& device, bool vsync = false);
 
-        /* Does a single pass of the window events for this window. Returns whether the window should stay open (true) or not (false). */
-        bool loop() const;
+        /* Does a single pass of the window events for this window. Resizes the swapchain once the framebuffer size has been stable for resize_delay milliseconds, so that a live drag-resize doesn't recreate it every frame. Returns whether the window should stay open (true) or not (false). */
+        bool loop();
 
         /* Sets the monitor of the Window, giving it a new size while at it. Only relevant when the Window is not in windowed mode (does nothing if it is).
          * @param new_monitor The new Monitor of the Window.
@@ -108,7 +125,8 @@ namespace Makma3D {
 
         /* Returns the physical device that the library thinks is most suited for this window.  
          * If you want to have more control, get all the available devices with ```get_physical_devices()``` and choose one yourself.
-         * @param preferred_type Can be overriden to let the library look for another type it most prefers. Use 'undefined' to not care, and just choose the first GPU in the list.
+         * Devices are scored on their type, device-local memory, queue topology and limits (see PhysicalDeviceRegistry::score()).
+         * @param preferred_type Can be overriden to let the library look for another type it most prefers. A device of this type always wins if there is one. Use 'undefined' to not care, and just choose the highest-scoring GPU.
          * @returns The PhysicalDevice with (hopefully) the preferred type. */
         PhysicalDevice get_preferred_physical_device(PhysicalDeviceType preferred_type = PhysicalDeviceType::discrete) const;
         /* Returns the list of (supported) PhysicalDevices that can render to this Window. */
@@ -125,6 +143,10 @@ namespace Makma3D {
 
         /* Returns a reference to the internal surface, which can coincidentally be used for an accurate size of the framebuffer. */
         inline const Vulkanic::Surface& surface() const { return *this->_surface; }
+        /* Returns a reference to the internal swapchain. Only valid once the Window is bound to a Device. */
+        inline Vulkanic::Swapchain& swapchain() const { return *this->_swapchain; }
+        /* Returns whether the Window is bound to a Device (and thus has a swapchain) or not. */
+        inline bool is_bound() const { return this->_swapchain != nullptr; }
 
         /* Copy assignment operator for the Window class, which is deleted. */
         Window& operator=(const Window& other) = delete;
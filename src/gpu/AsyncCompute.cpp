@@ -0,0 +1,75 @@
+/* ASYNC COMPUTE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 16:02:13
+ * Last edited:
+ *   17/10/2021, 16:02:13
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the AsyncCompute class, which schedules compute work on the
+ *   compute queues of a Device so that it overlaps with graphics work,
+ *   and lets graphics submissions wait for it where needed.
+**/
+
+#include "tools/Logger.hpp"
+
+#include "gpu/AsyncCompute.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** ASYNCCOMPUTE CLASS *****/
+/* Constructor for the AsyncCompute class. */
+AsyncCompute::AsyncCompute(const Makma3D::Device& device) :
+    device(device),
+    _last(null_sync_point),
+    _overlaps(true)
+{
+    // Compute only overlaps with graphics if they never end up on the same hardware queue
+    for (uint32_t i = 0; i < this->device.get_queue_count(Vulkanic::QueueType::compute) && this->_overlaps; i++) {
+        for (uint32_t j = 0; j < this->device.get_queue_count(Vulkanic::QueueType::graphics); j++) {
+            if (this->device.get_queue(Vulkanic::QueueType::compute, i) == this->device.get_queue(Vulkanic::QueueType::graphics, j)) {
+                this->_overlaps = false;
+                break;
+            }
+        }
+    }
+
+    // Let the user know what to expect
+    if (this->_overlaps) {
+        logger.logc(Verbosity::details, AsyncCompute::channel, "Compute work runs on ", this->device.get_queue_count(Vulkanic::QueueType::compute), " dedicated queue(s) of family ", this->device.get_queue_family(Vulkanic::QueueType::compute), ".");
+    } else {
+        logger.warningc(AsyncCompute::channel, "Compute work shares queues with graphics work on device '", this->device.get_physical_device().name(), "'; it will not overlap.");
+    }
+}
+
+
+
+/* Schedules a single compute command buffer for the next kick(). */
+void AsyncCompute::schedule(VkCommandBuffer vk_command_buffer, const SyncPoint& after, VkPipelineStageFlags stage) {
+    Submission submission;
+    submission.command_buffers.push_back(vk_command_buffer);
+    if (after.timeline != nullptr) {
+        submission.wait_points.push_back(after);
+        submission.wait_point_stages.push_back(stage);
+    }
+    this->schedule(std::move(submission));
+}
+
+/* Submits all scheduled compute work. */
+SyncPoint AsyncCompute::kick(VkFence vk_fence) {
+    SyncPoint point = this->device.get_submitter(Vulkanic::QueueType::compute).flush(vk_fence);
+    if (point.timeline != nullptr) { this->_last = point; }
+    return point;
+}
+
+/* Makes the given graphics submission wait for the last kicked-off compute work, if it isn't done already. */
+void AsyncCompute::depend(Submission& submission, VkPipelineStageFlags stage) const {
+    if (this->_last.is_complete()) { return; }
+    submission.wait_points.push_back(this->_last);
+    submission.wait_point_stages.push_back(stage);
+}
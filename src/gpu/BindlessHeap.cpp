@@ -0,0 +1,331 @@
+/* BINDLESS HEAP.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 11:52:08
+ * Last edited:
+ *   18/10/2021, 11:52:08
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the BindlessHeap class, which keeps all sampled images,
+ *   storage buffers and samplers of a Device in one large
+ *   update-after-bind descriptor set. Shaders index into it with the
+ *   integer of a generational handle, so a frame only binds one set.
+**/
+
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/BindlessHeap.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* Maps each BindlessType to the Vulkan descriptor type of its binding. */
+static const VkDescriptorType bindless_descriptor_types[] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER
+};
+/* The flags for every binding: slots may be empty, and may be written while the set is bound or in use by the GPU. */
+static const VkDescriptorBindingFlags bindless_binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkDescriptorSetLayoutBinding struct.
+ * @param binding The VkDescriptorSetLayoutBinding struct to populate.
+ * @param type The BindlessType whose binding we describe.
+ * @param capacity The number of descriptors in the binding. */
+static void populate_binding(VkDescriptorSetLayoutBinding& binding, BindlessType type, uint32_t capacity) {
+    // Set to default
+    binding = {};
+
+    // The type doubles as the binding index
+    binding.binding = (uint32_t) type;
+    binding.descriptorType = bindless_descriptor_types[(uint32_t) type];
+    binding.descriptorCount = capacity;
+
+    // Every stage may use any resource
+    binding.stageFlags = VK_SHADER_STAGE_ALL;
+}
+
+/* Populates the given VkDescriptorSetLayoutBindingFlagsCreateInfo struct.
+ * @param binding_flags_info The VkDescriptorSetLayoutBindingFlagsCreateInfo struct to populate.
+ * @param binding_flags The flags for each binding. Has to outlive the struct. */
+static void populate_binding_flags_info(VkDescriptorSetLayoutBindingFlagsCreateInfo& binding_flags_info, const Tools::Array<VkDescriptorBindingFlags>& binding_flags) {
+    // Set to default
+    binding_flags_info = {};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+
+    // Set the flags
+    binding_flags_info.bindingCount = binding_flags.size();
+    binding_flags_info.pBindingFlags = binding_flags.rdata();
+}
+
+/* Populates the given VkDescriptorSetLayoutCreateInfo struct.
+ * @param layout_info The VkDescriptorSetLayoutCreateInfo struct to populate.
+ * @param bindings The bindings of the layout. Has to outlive the struct.
+ * @param binding_flags_info The flags of the bindings. Has to outlive the struct. */
+static void populate_layout_info(VkDescriptorSetLayoutCreateInfo& layout_info, const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, const VkDescriptorSetLayoutBindingFlagsCreateInfo& binding_flags_info) {
+    // Set to default
+    layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
+
+    // The set has to come from an update-after-bind pool
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+
+    // Set the bindings
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.rdata();
+}
+
+/* Populates the given VkDescriptorPoolCreateInfo struct.
+ * @param pool_info The VkDescriptorPoolCreateInfo struct to populate.
+ * @param pool_sizes The number of descriptors of each type. Has to outlive the struct. */
+static void populate_pool_info(VkDescriptorPoolCreateInfo& pool_info, const Tools::Array<VkDescriptorPoolSize>& pool_sizes) {
+    // Set to default
+    pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+
+    // We only ever allocate the one set
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.rdata();
+}
+
+/* Populates the given VkDescriptorSetAllocateInfo struct.
+ * @param allocate_info The VkDescriptorSetAllocateInfo struct to populate.
+ * @param vk_descriptor_pool The pool to allocate from.
+ * @param vk_descriptor_set_layout The layout of the set. Has to outlive the struct. */
+static void populate_allocate_info(VkDescriptorSetAllocateInfo& allocate_info, VkDescriptorPool vk_descriptor_pool, const VkDescriptorSetLayout& vk_descriptor_set_layout) {
+    // Set to default
+    allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+
+    // Set the pool and the layout
+    allocate_info.descriptorPool = vk_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &vk_descriptor_set_layout;
+}
+
+/* Populates the given VkWriteDescriptorSet struct.
+ * @param write The VkWriteDescriptorSet struct to populate.
+ * @param vk_descriptor_set The set to write to.
+ * @param handle The handle of the slot to write. Its type determines which of the infos is used.
+ * @param image_info The info for images and samplers. Has to outlive the struct.
+ * @param buffer_info The info for buffers. Has to outlive the struct. */
+static void populate_write(VkWriteDescriptorSet& write, VkDescriptorSet vk_descriptor_set, const BindlessHandle& handle, const VkDescriptorImageInfo& image_info, const VkDescriptorBufferInfo& buffer_info) {
+    // Set to default
+    write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+
+    // Set where to write
+    write.dstSet = vk_descriptor_set;
+    write.dstBinding = (uint32_t) handle.type;
+    write.dstArrayElement = handle.index;
+
+    // Set what to write
+    write.descriptorCount = 1;
+    write.descriptorType = bindless_descriptor_types[(uint32_t) handle.type];
+    if (handle.type == BindlessType::buffer) { write.pBufferInfo = &buffer_info; }
+    else { write.pImageInfo = &image_info; }
+}
+
+
+
+
+
+/***** BINDLESSHEAP CLASS *****/
+/* Constructor for the BindlessHeap class. */
+BindlessHeap::BindlessHeap(VkDevice vk_device, const DeviceDispatch& dispatch, DeletionQueue& deletion_queue, const VkPhysicalDeviceLimits& limits, const uint32_t capacities[n_bindless_types]) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    deletion_queue(deletion_queue),
+    _statistics({ 0, 0, { 0, 0, 0 } })
+{
+    // Clamp the capacities to what a single stage and a single set can hold
+    uint32_t limited[n_bindless_types] = {
+        std::min({ capacities[(uint32_t) BindlessType::image], limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages }),
+        std::min({ capacities[(uint32_t) BindlessType::buffer], limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers }),
+        std::min({ capacities[(uint32_t) BindlessType::sampler], limits.maxPerStageDescriptorSamplers, limits.maxDescriptorSetSamplers })
+    };
+
+    // Prepare the bindings and the slots for each type
+    Tools::Array<VkDescriptorSetLayoutBinding> bindings({}, n_bindless_types);
+    Tools::Array<VkDescriptorBindingFlags> binding_flags(bindless_binding_flags, n_bindless_types);
+    Tools::Array<VkDescriptorPoolSize> pool_sizes(n_bindless_types);
+    for (uint32_t i = 0; i < n_bindless_types; i++) {
+        populate_binding(bindings[i], (BindlessType) i, limited[i]);
+        pool_sizes.push_back(VkDescriptorPoolSize{ bindless_descriptor_types[i], limited[i] });
+        this->slots.push_back(Slots{ Tools::Array<uint32_t>(), Tools::Array<uint32_t>(), limited[i], 0 });
+    }
+
+    // Create the layout
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info;
+    populate_binding_flags_info(binding_flags_info, binding_flags);
+    VkDescriptorSetLayoutCreateInfo layout_info;
+    populate_layout_info(layout_info, bindings, binding_flags_info);
+
+    VkResult vk_result;
+    if ((vk_result = vkCreateDescriptorSetLayout(this->vk_device, &layout_info, nullptr, &this->vk_descriptor_set_layout)) != VK_SUCCESS) {
+        logger.fatalc(BindlessHeap::channel, "Could not create descriptor set layout: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Create the pool
+    VkDescriptorPoolCreateInfo pool_info;
+    populate_pool_info(pool_info, pool_sizes);
+    if ((vk_result = vkCreateDescriptorPool(this->vk_device, &pool_info, nullptr, &this->vk_descriptor_pool)) != VK_SUCCESS) {
+        logger.fatalc(BindlessHeap::channel, "Could not create descriptor pool: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Allocate the one set
+    VkDescriptorSetAllocateInfo allocate_info;
+    populate_allocate_info(allocate_info, this->vk_descriptor_pool, this->vk_descriptor_set_layout);
+    if ((vk_result = this->dispatch.vkAllocateDescriptorSets(this->vk_device, &allocate_info, &this->vk_descriptor_set)) != VK_SUCCESS) {
+        logger.fatalc(BindlessHeap::channel, "Could not allocate descriptor set: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    logger.logc(Verbosity::details, BindlessHeap::channel, "Created bindless heap with ", limited[0], " images, ", limited[1], " buffers and ", limited[2], " samplers.");
+}
+
+/* Destructor for the BindlessHeap class. */
+BindlessHeap::~BindlessHeap() {
+    // Report the statistics
+    if (this->_statistics.n_writes > 0) {
+        logger.logc(Verbosity::details, BindlessHeap::channel, "Wrote ", this->_statistics.n_writes, " descriptors and recycled ", this->_statistics.n_recycled, " slots, with at most ", this->_statistics.peak[0], " images, ", this->_statistics.peak[1], " buffers and ", this->_statistics.peak[2], " samplers live at once.");
+    }
+
+    // The set is freed with its pool
+    if (this->vk_descriptor_pool != nullptr) {
+        vkDestroyDescriptorPool(this->vk_device, this->vk_descriptor_pool, nullptr);
+    }
+    if (this->vk_descriptor_set_layout != nullptr) {
+        vkDestroyDescriptorSetLayout(this->vk_device, this->vk_descriptor_set_layout, nullptr);
+    }
+}
+
+
+
+/* Takes a free slot of the given type. Assumes the lock is taken. */
+BindlessHandle BindlessHeap::allocate(BindlessType type) {
+    Slots& slots = this->slots[(uint32_t) type];
+
+    // Prefer recycled slots, and only touch new ones if there are none
+    uint32_t index;
+    if (!slots.free.empty()) {
+        index = slots.free.last();
+        slots.free.pop_back();
+    } else if (slots.generations.size() < slots.capacity) {
+        index = slots.generations.size();
+        slots.generations.push_back(1);
+    } else {
+        logger.fatalc(BindlessHeap::channel, "Bindless heap is out of ", bindless_type_names[(uint32_t) type], " slots (", slots.capacity, " in total).");
+    }
+
+    // Update the statistics
+    ++slots.n_used;
+    if (slots.n_used > this->_statistics.peak[(uint32_t) type]) { this->_statistics.peak[(uint32_t) type] = slots.n_used; }
+
+    return BindlessHandle{ index, slots.generations[index], type };
+}
+
+
+
+/* Adds a sampled image to the heap. */
+BindlessHandle BindlessHeap::add_image(VkImageView vk_image_view, VkImageLayout vk_image_layout) {
+    VkDescriptorImageInfo image_info = {};
+    image_info.imageView = vk_image_view;
+    image_info.imageLayout = vk_image_layout;
+    VkDescriptorBufferInfo buffer_info = {};
+
+    // Descriptor sets need external synchronization, so the write happens under the lock as well
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    BindlessHandle handle = this->allocate(BindlessType::image);
+    VkWriteDescriptorSet write;
+    populate_write(write, this->vk_descriptor_set, handle, image_info, buffer_info);
+    this->dispatch.vkUpdateDescriptorSets(this->vk_device, 1, &write, 0, nullptr);
+    ++this->_statistics.n_writes;
+    return handle;
+}
+
+/* Adds (a region of) a storage buffer to the heap. */
+BindlessHandle BindlessHeap::add_buffer(VkBuffer vk_buffer, VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorImageInfo image_info = {};
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = vk_buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+
+    // Descriptor sets need external synchronization, so the write happens under the lock as well
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    BindlessHandle handle = this->allocate(BindlessType::buffer);
+    VkWriteDescriptorSet write;
+    populate_write(write, this->vk_descriptor_set, handle, image_info, buffer_info);
+    this->dispatch.vkUpdateDescriptorSets(this->vk_device, 1, &write, 0, nullptr);
+    ++this->_statistics.n_writes;
+    return handle;
+}
+
+/* Adds a sampler to the heap. */
+BindlessHandle BindlessHeap::add_sampler(VkSampler vk_sampler) {
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler = vk_sampler;
+    VkDescriptorBufferInfo buffer_info = {};
+
+    // Descriptor sets need external synchronization, so the write happens under the lock as well
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    BindlessHandle handle = this->allocate(BindlessType::sampler);
+    VkWriteDescriptorSet write;
+    populate_write(write, this->vk_descriptor_set, handle, image_info, buffer_info);
+    this->dispatch.vkUpdateDescriptorSets(this->vk_device, 1, &write, 0, nullptr);
+    ++this->_statistics.n_writes;
+    return handle;
+}
+
+/* Removes the resource with the given handle from the heap. */
+void BindlessHeap::remove(const BindlessHandle& handle) {
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        Slots& slots = this->slots[(uint32_t) handle.type];
+        if (!handle.valid() || handle.index >= slots.generations.size() || slots.generations[handle.index] != handle.generation) {
+            logger.warningc(BindlessHeap::channel, "Ignoring removal of stale ", bindless_type_names[(uint32_t) handle.type], " handle ", handle.index, ".");
+            return;
+        }
+
+        // Bump the generation so the handle is stale from now on, skipping zero since that's the null handle
+        if (++slots.generations[handle.index] == 0) { slots.generations[handle.index] = 1; }
+        --slots.n_used;
+    }
+
+    // Frames in flight may still index the slot, so only hand it out again once they're done
+    this->deletion_queue.retire([this, handle]() {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->slots[(uint32_t) handle.type].free.push_back(handle.index);
+        ++this->_statistics.n_recycled;
+    });
+}
+
+/* Returns whether the given handle still refers to a resource in the heap. */
+bool BindlessHeap::is_live(const BindlessHandle& handle) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    const Slots& slots = this->slots[(uint32_t) handle.type];
+    return handle.valid() && handle.index < slots.generations.size() && slots.generations[handle.index] == handle.generation;
+}
+
+
+
+/* Binds the heap's set to the given command buffer. */
+void BindlessHeap::bind(VkCommandBuffer vk_command_buffer, VkPipelineBindPoint vk_bind_point, VkPipelineLayout vk_pipeline_layout, uint32_t set_index) const {
+    this->dispatch.vkCmdBindDescriptorSets(vk_command_buffer, vk_bind_point, vk_pipeline_layout, set_index, 1, &this->vk_descriptor_set, 0, nullptr);
+}
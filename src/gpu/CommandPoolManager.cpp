@@ -0,0 +1,196 @@
+/* COMMAND POOL MANAGER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   15/10/2021, 14:21:53
+ * Last edited:
+ *   15/10/2021, 14:21:53
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the CommandPoolManager class, which manages one command pool
+ *   per thread, per queue family and per frame-in-flight, so that
+ *   threads can record command buffers without locking.
+**/
+
+#include <atomic>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/CommandPoolManager.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** GLOBALS *****/
+/* Counter used to give each CommandPoolManager a unique ID. */
+static std::atomic<uint64_t> next_manager_id(0);
+/* Per-thread cache of the pools this thread owns, per manager ID. Lets a thread find its pools without taking the manager's lock. */
+static thread_local std::unordered_map<uint64_t, void*> thread_pools_cache;
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkCommandPoolCreateInfo struct.
+ * @param pool_info The VkCommandPoolCreateInfo struct to populate.
+ * @param queue_family The queue family for which the pool allocates command buffers. */
+static void populate_pool_info(VkCommandPoolCreateInfo& pool_info, uint32_t queue_family) {
+    // Set the meta info first
+    pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+
+    // The buffers are short-lived and only reset as a whole pool
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+}
+
+/* Populates the given VkCommandBufferAllocateInfo struct.
+ * @param allocate_info The VkCommandBufferAllocateInfo struct to populate.
+ * @param vk_command_pool The command pool to allocate from.
+ * @param level The level of the command buffer to allocate. */
+static void populate_allocate_info(VkCommandBufferAllocateInfo& allocate_info, VkCommandPool vk_command_pool, VkCommandBufferLevel level) {
+    // Set the meta info first
+    allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+
+    // Allocate one buffer of the given level
+    allocate_info.commandPool = vk_command_pool;
+    allocate_info.level = level;
+    allocate_info.commandBufferCount = 1;
+}
+
+
+
+
+
+/***** COMMANDPOOLMANAGER CLASS *****/
+/* Constructor for the CommandPoolManager class. */
+CommandPoolManager::CommandPoolManager(VkDevice vk_device, const DeviceDispatch& dispatch, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, uint32_t n_frames) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    id(next_manager_id++),
+    type_slots(0U, Vulkanic::n_queue_types),
+    _n_frames(n_frames),
+    _current_frame(0)
+{
+    // Collect the unique families, and map each type to its family
+    for (uint32_t i = 0; i < queue_families.size(); i++) {
+        uint32_t j;
+        for (j = 0; j < this->families.size(); j++) {
+            if (this->families[j] == queue_families[i]) { break; }
+        }
+        if (j == this->families.size()) { this->families.push_back(queue_families[i]); }
+        this->type_slots[i] = j;
+    }
+}
+
+/* Destructor for the CommandPoolManager class. */
+CommandPoolManager::~CommandPoolManager() {
+    for (uint32_t t = 0; t < this->threads.size(); t++) {
+        ThreadPools& pools = *this->threads[t];
+        for (uint32_t i = 0; i < pools.size(); i++) {
+            // The command buffers are freed with their pool
+            vkDestroyCommandPool(this->vk_device, pools[i].vk_command_pool, nullptr);
+        }
+        delete this->threads[t];
+    }
+}
+
+
+
+/* Returns the pools of the calling thread, creating them if this is the first time the thread allocates. */
+CommandPoolManager::ThreadPools& CommandPoolManager::get_thread_pools() {
+    // Try the thread's own cache first
+    std::unordered_map<uint64_t, void*>::iterator iter = thread_pools_cache.find(this->id);
+    if (iter != thread_pools_cache.end()) { return *((ThreadPools*) iter->second); }
+
+    // Otherwise, create the pools for this thread
+    ThreadPools* pools = new ThreadPools({}, this->_n_frames * this->families.size());
+    for (uint32_t f = 0; f < this->_n_frames; f++) {
+        for (uint32_t i = 0; i < this->families.size(); i++) {
+            VkCommandPoolCreateInfo pool_info;
+            populate_pool_info(pool_info, this->families[i]);
+
+            VkResult vk_result;
+            if ((vk_result = vkCreateCommandPool(this->vk_device, &pool_info, nullptr, &(*pools)[f * this->families.size() + i].vk_command_pool)) != VK_SUCCESS) {
+                logger.fatalc(CommandPoolManager::channel, "Could not create command pool for queue family ", this->families[i], ": ", Vulkanic::vk_error_map.at(vk_result));
+            }
+        }
+    }
+
+    // Register them, both globally and in the thread's cache
+    {
+        std::unique_lock<std::mutex> lock(this->threads_lock);
+        this->threads.push_back(pools);
+    }
+    thread_pools_cache.insert({ this->id, (void*) pools });
+
+    // Done
+    logger.logc(Verbosity::debug, CommandPoolManager::channel, "Created ", pools->size(), " command pools for thread ", std::this_thread::get_id(), ".");
+    return *pools;
+}
+
+
+
+/* Returns a command buffer for the current frame from the calling thread's pool for the given queue type. */
+VkCommandBuffer CommandPoolManager::allocate(Vulkanic::QueueType queue_type, VkCommandBufferLevel level) {
+    // Get the pool to allocate from
+    Pool& pool = this->get_thread_pools()[this->_current_frame * this->families.size() + this->type_slots[(uint32_t) queue_type]];
+    Tools::Array<VkCommandBuffer>& free_list = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? pool.free_primary : pool.free_secondary;
+    Tools::Array<VkCommandBuffer>& used_list = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? pool.used_primary : pool.used_secondary;
+
+    // Re-use a recycled one if we can
+    VkCommandBuffer vk_command_buffer;
+    if (!free_list.empty()) {
+        vk_command_buffer = free_list.last();
+        free_list.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo allocate_info;
+        populate_allocate_info(allocate_info, pool.vk_command_pool, level);
+
+        VkResult vk_result;
+        if ((vk_result = this->dispatch.vkAllocateCommandBuffers(this->vk_device, &allocate_info, &vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatalc(CommandPoolManager::channel, "Could not allocate command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+
+    // Mark it as used this frame
+    used_list.push_back(vk_command_buffer);
+    return vk_command_buffer;
+}
+
+/* Moves to the given frame, resetting all of its pools (of all threads) in bulk and making their command buffers available again. */
+void CommandPoolManager::begin_frame(uint32_t frame) {
+    #ifndef NDEBUG
+    if (frame >= this->_n_frames) { logger.fatalc(CommandPoolManager::channel, "Frame index ", frame, " is out of range for ", this->_n_frames, " frames in flight."); }
+    #endif
+
+    std::unique_lock<std::mutex> lock(this->threads_lock);
+    for (uint32_t t = 0; t < this->threads.size(); t++) {
+        ThreadPools& pools = *this->threads[t];
+        for (uint32_t i = 0; i < this->families.size(); i++) {
+            Pool& pool = pools[frame * this->families.size() + i];
+            if (pool.used_primary.empty() && pool.used_secondary.empty()) { continue; }
+
+            // Reset all buffers of the pool at once
+            VkResult vk_result;
+            if ((vk_result = this->dispatch.vkResetCommandPool(this->vk_device, pool.vk_command_pool, 0)) != VK_SUCCESS) {
+                logger.fatalc(CommandPoolManager::channel, "Could not reset command pool: ", Vulkanic::vk_error_map.at(vk_result));
+            }
+
+            // Make them available again
+            pool.free_primary += pool.used_primary;
+            pool.free_secondary += pool.used_secondary;
+            pool.used_primary.clear();
+            pool.used_secondary.clear();
+        }
+    }
+
+    // Done, move to it
+    this->_current_frame = frame;
+}
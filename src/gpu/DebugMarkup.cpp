@@ -0,0 +1,102 @@
+/* DEBUG MARKUP.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 22:03:44
+ * Last edited:
+ *   18/10/2021, 22:03:44
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DebugMarkup class, which gives the Vulkan objects of a
+ *   Device readable names and wraps regions of command buffers in
+ *   labels, so that validation messages and GPU captures refer to engine
+ *   concepts instead of raw handles. Compiles to nothing in release
+ *   builds.
+**/
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/DebugMarkup.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+#ifndef NDEBUG
+/* Populates the given VkDebugUtilsLabelEXT struct.
+ * @param label_info The VkDebugUtilsLabelEXT struct to populate.
+ * @param label The name of the label.
+ * @param color The color of the label, or nullptr to let the tool decide. */
+static void populate_label_info(VkDebugUtilsLabelEXT& label_info, const std::string& label, const float color[4]) {
+    // Set to default
+    label_info = {};
+    label_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+
+    // Set the name and the color
+    label_info.pLabelName = label.c_str();
+    for (uint32_t i = 0; i < 4; i++) {
+        label_info.color[i] = color != nullptr ? color[i] : 0.0f;
+    }
+}
+#endif
+
+
+
+
+
+/***** DEBUGMARKUP CLASS *****/
+/* Constructor for the DebugMarkup class. */
+DebugMarkup::DebugMarkup(VkDevice vk_device, const Vulkanic::DebugUtilsFunctions* functions) :
+    vk_device(vk_device),
+    functions(functions != nullptr ? *functions : Vulkanic::DebugUtilsFunctions({ nullptr, nullptr, nullptr, nullptr }))
+{}
+
+
+
+#ifndef NDEBUG
+/* Gives the object with the given type and handle the given name. */
+void DebugMarkup::set_name(VkObjectType object_type, uint64_t handle, const std::string& name) const {
+    if (this->functions.set_object_name == nullptr || handle == 0) { return; }
+
+    // Name it
+    VkDebugUtilsObjectNameInfoEXT name_info = {};
+    name_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    name_info.objectType = object_type;
+    name_info.objectHandle = handle;
+    name_info.pObjectName = name.c_str();
+    VkResult vk_result;
+    if ((vk_result = this->functions.set_object_name(this->vk_device, &name_info)) != VK_SUCCESS) {
+        logger.warningc(DebugMarkup::channel, "Could not name object '", name, "': ", Vulkanic::vk_error_map.at(vk_result));
+    }
+}
+
+
+
+/* Opens a labelled region on the given command buffer. */
+void DebugMarkup::begin_label(VkCommandBuffer vk_command_buffer, const std::string& label, const float color[4]) const {
+    if (this->functions.cmd_begin_label == nullptr) { return; }
+
+    VkDebugUtilsLabelEXT label_info;
+    populate_label_info(label_info, label, color);
+    this->functions.cmd_begin_label(vk_command_buffer, &label_info);
+}
+
+/* Closes the last opened labelled region on the given command buffer. */
+void DebugMarkup::end_label(VkCommandBuffer vk_command_buffer) const {
+    if (this->functions.cmd_end_label == nullptr) { return; }
+    this->functions.cmd_end_label(vk_command_buffer);
+}
+
+/* Inserts a single label on the given command buffer. */
+void DebugMarkup::insert_label(VkCommandBuffer vk_command_buffer, const std::string& label, const float color[4]) const {
+    if (this->functions.cmd_insert_label == nullptr) { return; }
+
+    VkDebugUtilsLabelEXT label_info;
+    populate_label_info(label_info, label, color);
+    this->functions.cmd_insert_label(vk_command_buffer, &label_info);
+}
+#endif
@@ -0,0 +1,109 @@
+/* DELETION QUEUE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 13:41:11
+ * Last edited:
+ *   19/10/2021, 13:41:11
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DeletionQueue class, which postpones destroying Vulkan
+ *   objects until the GPU is done with the work that may still use them.
+ *   This way, resources can be replaced while frames are in flight
+ *   without idling the device.
+**/
+
+#include "tools/Logger.hpp"
+
+#include "gpu/DeletionQueue.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** DELETIONQUEUE CLASS *****/
+/* Constructor for the DeletionQueue class. */
+DeletionQueue::DeletionQueue(const Tools::Array<Queue*>& queues) :
+    queues(queues),
+    _statistics({ 0, 0, 0 })
+{}
+
+/* Destructor for the DeletionQueue class. Destroys everything that is still retired, so the device has to be idle. */
+DeletionQueue::~DeletionQueue() {
+    for (uint32_t i = 0; i < this->retiring.size(); i++) {
+        this->retiring[i].destroy();
+    }
+
+    // Report the statistics
+    if (this->_statistics.n_retired > 0) {
+        logger.logc(Verbosity::details, DeletionQueue::channel, "Retired ", this->_statistics.n_retired, " objects, of which ", this->_statistics.n_destroyed, " were destroyed without idling the device, with at most ", this->_statistics.peak, " waiting at once.");
+    }
+}
+
+
+
+/* Queues the given retirement. Assumes the lock is taken. */
+void DeletionQueue::push(Retirement&& retirement) {
+    this->retiring.push_back(std::move(retirement));
+    ++this->_statistics.n_retired;
+    if (this->retiring.size() > this->_statistics.peak) { this->_statistics.peak = this->retiring.size(); }
+}
+
+
+
+/* Retires an object that may be used by any work submitted so far, on any queue. */
+void DeletionQueue::retire(destroy_t&& destroy) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Remember how far each queue has to get
+    Tools::Array<uint64_t> values(this->queues.size());
+    for (uint32_t i = 0; i < this->queues.size(); i++) {
+        values.push_back(this->queues[i]->timeline().submitted());
+    }
+    this->push(Retirement{ std::move(destroy), std::move(values) });
+}
+
+/* Retires an object that was last used by the submission of the given SyncPoint. */
+void DeletionQueue::retire(const SyncPoint& last_use, destroy_t&& destroy) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Only the queue of the SyncPoint has to get somewhere
+    Tools::Array<uint64_t> values((uint64_t) 0, this->queues.size());
+    for (uint32_t i = 0; i < this->queues.size(); i++) {
+        if (&this->queues[i]->timeline() == last_use.timeline) {
+            values[i] = last_use.value;
+            break;
+        }
+    }
+    this->push(Retirement{ std::move(destroy), std::move(values) });
+}
+
+/* Destroys the retired objects that the GPU is done with. */
+void DeletionQueue::collect() {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // The objects are destroyed in order, so we can stop at the first one that isn't done
+    uint32_t n_destroyed = 0;
+    while (n_destroyed < this->retiring.size()) {
+        Retirement& retirement = this->retiring[n_destroyed];
+        bool done = true;
+        for (uint32_t i = 0; i < this->queues.size(); i++) {
+            if (!this->queues[i]->timeline().is_complete(retirement.values[i])) {
+                done = false;
+                break;
+            }
+        }
+        if (!done) { break; }
+
+        retirement.destroy();
+        ++n_destroyed;
+    }
+
+    // Remove the destroyed objects from the front of the list
+    if (n_destroyed > 0) {
+        this->retiring.erase(0, n_destroyed - 1);
+        this->_statistics.n_destroyed += n_destroyed;
+    }
+}
@@ -0,0 +1,343 @@
+/* DESCRIPTOR ALLOCATOR.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 14:05:35
+ * Last edited:
+ *   18/10/2021, 14:05:35
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DescriptorAllocator class, which hands out descriptor
+ *   sets from per-thread, per-frame chains of descriptor pools that grow
+ *   with the observed demand and are reset as a whole. Also caches
+ *   descriptor set layouts by their bindings.
+**/
+
+#include <atomic>
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/DescriptorAllocator.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** GLOBALS *****/
+/* Counter used to give each DescriptorAllocator a unique ID. */
+static std::atomic<uint64_t> next_allocator_id(0);
+/* Per-thread cache of the pools this thread owns, per allocator ID. Lets a thread find its pools without taking the allocator's lock. */
+static thread_local std::unordered_map<uint64_t, void*> thread_pools_cache;
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Hashes the given layout description with FNV-1a.
+ * @param bindings The bindings of the layout, sorted by binding index.
+ * @param flags The creation flags of the layout.
+ * @returns The hash of the layout. */
+static uint64_t hash_layout(const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+
+    mix(flags);
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        mix(bindings[i].binding);
+        mix(bindings[i].descriptorType);
+        mix(bindings[i].descriptorCount);
+        mix(bindings[i].stageFlags);
+        mix((uint64_t) bindings[i].pImmutableSamplers);
+    }
+    return hash;
+}
+
+/* Returns whether the given cached layout was created with the given description.
+ * @param layout The cached layout.
+ * @param bindings The bindings of the layout, sorted by binding index.
+ * @param flags The creation flags of the layout.
+ * @returns Whether they match (true) or not (false). */
+static bool layout_matches(const DescriptorLayout& layout, const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+    if (layout.flags != flags || layout.bindings.size() != bindings.size()) { return false; }
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& b1 = layout.bindings[i];
+        const VkDescriptorSetLayoutBinding& b2 = bindings[i];
+        if (b1.binding != b2.binding || b1.descriptorType != b2.descriptorType || b1.descriptorCount != b2.descriptorCount || b1.stageFlags != b2.stageFlags || b1.pImmutableSamplers != b2.pImmutableSamplers) { return false; }
+    }
+    return true;
+}
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkDescriptorSetLayoutCreateInfo struct.
+ * @param layout_info The VkDescriptorSetLayoutCreateInfo struct to populate.
+ * @param bindings The bindings of the layout. Has to outlive the struct.
+ * @param flags The creation flags of the layout. */
+static void populate_layout_info(VkDescriptorSetLayoutCreateInfo& layout_info, const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+    // Set to default
+    layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.flags = flags;
+
+    // Set the bindings
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.rdata();
+}
+
+/* Populates the given VkDescriptorPoolCreateInfo struct.
+ * @param pool_info The VkDescriptorPoolCreateInfo struct to populate.
+ * @param max_sets The number of sets the pool can hold.
+ * @param pool_sizes The number of descriptors of each type. Has to outlive the struct. */
+static void populate_pool_info(VkDescriptorPoolCreateInfo& pool_info, uint32_t max_sets, const Tools::Array<VkDescriptorPoolSize>& pool_sizes) {
+    // Set to default; the sets are only ever freed by resetting the whole pool
+    pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+
+    // Set the sizes
+    pool_info.maxSets = max_sets;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.rdata();
+}
+
+/* Populates the given VkDescriptorSetAllocateInfo struct.
+ * @param allocate_info The VkDescriptorSetAllocateInfo struct to populate.
+ * @param vk_descriptor_pool The pool to allocate from.
+ * @param vk_descriptor_set_layout The layout of the set. Has to outlive the struct. */
+static void populate_allocate_info(VkDescriptorSetAllocateInfo& allocate_info, VkDescriptorPool vk_descriptor_pool, const VkDescriptorSetLayout& vk_descriptor_set_layout) {
+    // Set to default
+    allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+
+    // Set the pool and the layout
+    allocate_info.descriptorPool = vk_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &vk_descriptor_set_layout;
+}
+
+
+
+
+
+/***** DESCRIPTORALLOCATOR CLASS *****/
+/* Constructor for the DescriptorAllocator class. */
+DescriptorAllocator::DescriptorAllocator(VkDevice vk_device, const DeviceDispatch& dispatch, uint32_t n_frames) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    id(next_allocator_id++),
+    _n_frames(n_frames),
+    _current_frame(0),
+    _statistics({ 0, 0, 0, 0 })
+{}
+
+/* Destructor for the DescriptorAllocator class. */
+DescriptorAllocator::~DescriptorAllocator() {
+    for (uint32_t t = 0; t < this->threads.size(); t++) {
+        ThreadPools& frames = *this->threads[t];
+        for (uint32_t f = 0; f < frames.size(); f++) {
+            // Count what wasn't counted yet
+            this->_statistics.n_sets += frames[f].demand.sets;
+            this->_statistics.n_pools += frames[f].n_created;
+
+            // The sets are freed with their pool
+            for (uint32_t i = 0; i < frames[f].pools.size(); i++) {
+                vkDestroyDescriptorPool(this->vk_device, frames[f].pools[i].vk_descriptor_pool, nullptr);
+            }
+        }
+        delete this->threads[t];
+    }
+
+    for (std::pair<const uint64_t, Tools::Array<DescriptorLayout*>>& bucket : this->layouts) {
+        for (uint32_t i = 0; i < bucket.second.size(); i++) {
+            vkDestroyDescriptorSetLayout(this->vk_device, bucket.second[i]->vk_descriptor_set_layout, nullptr);
+            delete bucket.second[i];
+        }
+    }
+
+    // Report the statistics
+    if (this->_statistics.n_sets > 0) {
+        logger.logc(Verbosity::details, DescriptorAllocator::channel, "Allocated ", this->_statistics.n_sets, " descriptor sets from ", this->_statistics.n_pools, " pools over ", this->_statistics.n_resets, " pool resets, using ", this->_statistics.n_layouts, " layouts.");
+    }
+}
+
+
+
+/* Returns the pools of the calling thread, creating them if this is the first time the thread allocates. */
+DescriptorAllocator::ThreadPools& DescriptorAllocator::get_thread_pools() {
+    // Try the thread's own cache first
+    std::unordered_map<uint64_t, void*>::iterator iter = thread_pools_cache.find(this->id);
+    if (iter != thread_pools_cache.end()) { return *((ThreadPools*) iter->second); }
+
+    // Otherwise, prepare an empty chain per frame; the pools themselves are created on demand
+    FramePools empty;
+    empty.current = 0;
+    empty.demand = {};
+    empty.last_demand = {};
+    empty.n_created = 0;
+    ThreadPools* frames = new ThreadPools(empty, this->_n_frames);
+
+    // Register them, both globally and in the thread's cache
+    {
+        std::unique_lock<std::mutex> lock(this->threads_lock);
+        this->threads.push_back(frames);
+    }
+    thread_pools_cache.insert({ this->id, (void*) frames });
+
+    // Done
+    return *frames;
+}
+
+/* Adds a new pool to the end of the given chain, sized after the chain's demand. */
+void DescriptorAllocator::grow(FramePools& frame, const DescriptorLayout& layout) {
+    // The first pool of a frame is sized for the whole of the last frame; later ones double until they hit the growth limit
+    uint32_t max_sets;
+    if (frame.pools.empty()) { max_sets = std::max(DescriptorAllocator::min_pool_sets, frame.last_demand.sets); }
+    else { max_sets = std::max(frame.pools.last().max_sets, std::min(2 * frame.pools.last().max_sets, DescriptorAllocator::max_pool_growth)); }
+
+    // Size each type after the most descriptors per set we've seen of it, in this frame or the last, and make sure the set that didn't fit does
+    Tools::Array<VkDescriptorPoolSize> pool_sizes(n_descriptor_types);
+    for (uint32_t i = 0; i < n_descriptor_types; i++) {
+        double ratio = 0.0;
+        if (frame.demand.sets > 0) { ratio = std::max(ratio, (double) frame.demand.descriptors[i] / frame.demand.sets); }
+        if (frame.last_demand.sets > 0) { ratio = std::max(ratio, (double) frame.last_demand.descriptors[i] / frame.last_demand.sets); }
+        uint32_t count = std::max((uint32_t) (ratio * max_sets + 0.5), layout.descriptor_counts[i]);
+        if (count > 0) { pool_sizes.push_back(VkDescriptorPoolSize{ (VkDescriptorType) i, count }); }
+    }
+
+    // Create it
+    VkDescriptorPoolCreateInfo pool_info;
+    populate_pool_info(pool_info, max_sets, pool_sizes);
+    Pool pool;
+    pool.max_sets = max_sets;
+    VkResult vk_result;
+    if ((vk_result = vkCreateDescriptorPool(this->vk_device, &pool_info, nullptr, &pool.vk_descriptor_pool)) != VK_SUCCESS) {
+        logger.fatalc(DescriptorAllocator::channel, "Could not create descriptor pool for ", max_sets, " sets: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    frame.pools.push_back(pool);
+    ++frame.n_created;
+    logger.logc(Verbosity::debug, DescriptorAllocator::channel, "Created descriptor pool for ", max_sets, " sets for thread ", std::this_thread::get_id(), ".");
+}
+
+
+
+/* Returns the layout with the given bindings, creating it only if no layout with the same bindings was requested before. */
+const DescriptorLayout& DescriptorAllocator::get_layout(const Tools::Array<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+    // Sort the bindings so their order doesn't influence the hash
+    Tools::Array<VkDescriptorSetLayoutBinding> sorted = bindings;
+    VkDescriptorSetLayoutBinding* data = sorted.wdata();
+    std::sort(data, data + sorted.size(), [](const VkDescriptorSetLayoutBinding& b1, const VkDescriptorSetLayoutBinding& b2) { return b1.binding < b2.binding; });
+    uint64_t hash = hash_layout(sorted, flags);
+
+    // See if we have it already
+    std::unique_lock<std::mutex> lock(this->layouts_lock);
+    Tools::Array<DescriptorLayout*>& bucket = this->layouts[hash];
+    for (uint32_t i = 0; i < bucket.size(); i++) {
+        if (layout_matches(*bucket[i], sorted, flags)) { return *bucket[i]; }
+    }
+
+    // Otherwise, create it
+    DescriptorLayout* layout = new DescriptorLayout();
+    layout->bindings = sorted;
+    layout->flags = flags;
+    for (uint32_t i = 0; i < n_descriptor_types; i++) { layout->descriptor_counts[i] = 0; }
+    for (uint32_t i = 0; i < sorted.size(); i++) {
+        if ((uint32_t) sorted[i].descriptorType >= n_descriptor_types) {
+            logger.fatalc(DescriptorAllocator::channel, "Descriptor type ", (uint32_t) sorted[i].descriptorType, " of binding ", sorted[i].binding, " is not supported by the descriptor allocator.");
+        }
+        layout->descriptor_counts[sorted[i].descriptorType] += sorted[i].descriptorCount;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info;
+    populate_layout_info(layout_info, layout->bindings, flags);
+    VkResult vk_result;
+    if ((vk_result = vkCreateDescriptorSetLayout(this->vk_device, &layout_info, nullptr, &layout->vk_descriptor_set_layout)) != VK_SUCCESS) {
+        logger.fatalc(DescriptorAllocator::channel, "Could not create descriptor set layout: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Store it
+    bucket.push_back(layout);
+    ++this->_statistics.n_layouts;
+    return *layout;
+}
+
+/* Returns a descriptor set for the current frame with the given layout, from the calling thread's pools. */
+VkDescriptorSet DescriptorAllocator::allocate(const DescriptorLayout& layout) {
+    FramePools& frame = this->get_thread_pools()[this->_current_frame];
+
+    // Count the demand first, so a new pool takes this set into account
+    ++frame.demand.sets;
+    for (uint32_t i = 0; i < n_descriptor_types; i++) {
+        frame.demand.descriptors[i] += layout.descriptor_counts[i];
+    }
+
+    // Walk the chain until a pool fits the set, adding pools as we need them
+    while (true) {
+        bool fresh = false;
+        if (frame.current == frame.pools.size()) {
+            this->grow(frame, layout);
+            fresh = true;
+        }
+
+        VkDescriptorSetAllocateInfo allocate_info;
+        populate_allocate_info(allocate_info, frame.pools[frame.current].vk_descriptor_pool, layout.vk_descriptor_set_layout);
+        VkDescriptorSet vk_descriptor_set;
+        VkResult vk_result = this->dispatch.vkAllocateDescriptorSets(this->vk_device, &allocate_info, &vk_descriptor_set);
+        if (vk_result == VK_SUCCESS) { return vk_descriptor_set; }
+
+        // A full pool simply means we move on to the next one, but a new pool should always fit
+        if ((vk_result != VK_ERROR_OUT_OF_POOL_MEMORY && vk_result != VK_ERROR_FRAGMENTED_POOL) || fresh) {
+            logger.fatalc(DescriptorAllocator::channel, "Could not allocate descriptor set: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        ++frame.current;
+    }
+}
+
+/* Moves to the given frame, resetting all of its pools (of all threads) in bulk. */
+void DescriptorAllocator::begin_frame(uint32_t frame) {
+    #ifndef NDEBUG
+    if (frame >= this->_n_frames) { logger.fatalc(DescriptorAllocator::channel, "Frame index ", frame, " is out of range for ", this->_n_frames, " frames in flight."); }
+    #endif
+
+    std::unique_lock<std::mutex> lock(this->threads_lock);
+    for (uint32_t t = 0; t < this->threads.size(); t++) {
+        FramePools& pools = (*this->threads[t])[frame];
+        if (pools.demand.sets == 0) { continue; }
+
+        // A chain of pools means the frame outgrew its first one, so replace them by a single pool sized for the whole frame
+        VkResult vk_result;
+        if (pools.pools.size() > 1) {
+            for (uint32_t i = 0; i < pools.pools.size(); i++) {
+                vkDestroyDescriptorPool(this->vk_device, pools.pools[i].vk_descriptor_pool, nullptr);
+            }
+            pools.pools.clear();
+        } else {
+            for (uint32_t i = 0; i < pools.pools.size(); i++) {
+                if ((vk_result = this->dispatch.vkResetDescriptorPool(this->vk_device, pools.pools[i].vk_descriptor_pool, 0)) != VK_SUCCESS) {
+                    logger.fatalc(DescriptorAllocator::channel, "Could not reset descriptor pool: ", Vulkanic::vk_error_map.at(vk_result));
+                }
+                ++this->_statistics.n_resets;
+            }
+        }
+
+        // Remember the demand to size the next pools, and start over
+        this->_statistics.n_sets += pools.demand.sets;
+        this->_statistics.n_pools += pools.n_created;
+        pools.last_demand = pools.demand;
+        pools.demand = {};
+        pools.n_created = 0;
+        pools.current = 0;
+    }
+
+    // Done, move to it
+    this->_current_frame = frame;
+}
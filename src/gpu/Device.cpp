@@ -17,95 +17,29 @@
 #include "arrays/StackArray.hpp"
 #include "vulkanic/auxillary/ErrorCodes.hpp"
 
+#include "gpu/QueuePlanner.hpp"
+#include "gpu/FeatureChain.hpp"
 #include "gpu/Device.hpp"
 
 using namespace std;
 using namespace Makma3D;
 
 
-/***** HELPER FUNCTIONS *****/
-/* Maps the different kind of Device operations to queue families. Tries to select families which are least used and have the most specific capabilities.
- * @param physical_device The PhysicalDevice who's queues we'd like to map. 
- * @param vk_surface The VkSurfaceKHR we'll use to check presentability of a queue family.
- * @returns A static array with as elements a pair of the queue family index and the queue count, for each of the queue types / queue operations. */
-static Tools::StackArray<std::pair<uint32_t, uint32_t>, Vulkanic::n_queue_types> map_queue_families(const PhysicalDevice& physical_device, VkSurfaceKHR vk_surface) {
-    // Prepare the result list
-    Tools::StackArray<std::pair<uint32_t, uint32_t>, Vulkanic::n_queue_types> result;
-
-    // Collect a list of queue families
-    uint32_t n_queue_families;
-    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &n_queue_families, nullptr);
-    Tools::Array<VkQueueFamilyProperties> queue_families(n_queue_families);
-    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &n_queue_families, queue_families.wdata(n_queue_families));
-
-    // Next, loop through all the family infos to count how many capabilities they have
-    Tools::Array<Tools::StackArray<bool, Vulkanic::n_queue_types>> capabilities(Tools::StackArray<bool, Vulkanic::n_queue_types>(false, Vulkanic::n_queue_types), queue_families.size());
-    Tools::Array<uint32_t> capabilities_count(0U, queue_families.size());
-    for (uint32_t i = 0; i < queue_families.size(); i++) {
-        // Check if the queue can present
-        VkBool32 can_present;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, vk_surface, &can_present);
-
-        // Count the capabilities, immediately noting this queue's support in the capabilities list
-        capabilities_count[i] += (capabilities[i][0] = !!(queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT));
-        capabilities_count[i] += (capabilities[i][1] = !!(queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT));
-        capabilities_count[i] += (capabilities[i][2] = !!(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT));
-        capabilities_count[i] += (capabilities[i][3] = !!can_present);
-    }
-
-    // Finally, loop through all types to find a queue family for them
-    Tools::Array<uint32_t> used_count(0U, queue_families.size());
-    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
-        // Loop through the queues to find the best one
-        uint32_t best_used_count = std::numeric_limits<uint32_t>::max(), best_capability_count = std::numeric_limits<uint32_t>::max(), best_queue_family;
-        for (uint32_t j = 0; j < queue_families.size(); j++) {
-            // If it doesn't support this capability, then we're immediately done with it
-            const VkQueueFamilyProperties& family = queue_families[j];
-            if (!capabilities[j][i]) { continue; }
-
-            // Otherwise, don't used this queue if it's used more than the current queue
-            if (used_count[j] > best_used_count) { continue; }
-            // Next, skip if this queue has more (or the same) capabilities than the best one
-            if (capabilities_count[j] >= best_capability_count) { continue; }
-
-            // Otherwise, it's better, so store it!
-            best_used_count = used_count[j];
-            best_capability_count = capabilities_count[j];
-            best_queue_family = j;
-        }
-
-        // If the best used count is still 'infinite', then we didn't find any that supported this operation
-        if (best_used_count == std::numeric_limits<uint32_t>::max()) {
-            logger.fatalc(Device::channel, "Physical device '", physical_device.name(), "' doesn't support ", Vulkanic::queue_type_names[i], "-operations; cannot map it.");
-        }
-
-        // Mark the selected queue as the actually used one
-        ++used_count[best_queue_family];
-        result.push_back({ best_queue_family, queue_families[best_queue_family].queueCount });
-    }
-
-    // Done!
-    return result;
-}
-
-/* Given a StackArray that is a queue map, returns an equivalent Array that contains only unique entries.
- * @param queue_family_map The StackArray that is the queue map from which we want to extract the unique entries.
- * @returns A new Array that has one <index, count> pair for each unique queue family. */
-static Tools::Array<std::pair<uint32_t, uint32_t>> uniqueify_queue_map(const Tools::StackArray<std::pair<uint32_t, uint32_t>, Vulkanic::n_queue_types>& queue_family_map) {
-    // Loop through all queue mappings to get their unique count
-    Tools::Array<std::pair<uint32_t, uint32_t>> result(queue_family_map.size());
-    for (uint32_t i = 0; i < queue_family_map.size(); i++) {
-        // Check if we already added this index
-        for (uint32_t j = 0; j < result.size(); j++) {
-            if (queue_family_map[i].first == result[j].first) { continue; }
-        }
-
-        // Otherwise, add it
-        result.push_back(queue_family_map[i]);
-    }
-    // Done, return
-    return result;
-}
+/***** CONSTANTS *****/
+/* The optional DeviceFeatures that we enable whenever the device supports them, so the code that benefits from them can take its fast path. */
+static const Vulkanic::DeviceFeature fast_paths[] = {
+    Vulkanic::DeviceFeature::descriptor_indexing,
+    Vulkanic::DeviceFeature::buffer_device_address,
+    Vulkanic::DeviceFeature::timeline_semaphores,
+    Vulkanic::DeviceFeature::dynamic_rendering,
+    Vulkanic::DeviceFeature::synchronization2,
+    Vulkanic::DeviceFeature::storage_8bit,
+    Vulkanic::DeviceFeature::storage_16bit,
+    Vulkanic::DeviceFeature::multi_draw_indirect,
+    Vulkanic::DeviceFeature::draw_indirect_count,
+    Vulkanic::DeviceFeature::pipeline_statistics,
+    Vulkanic::DeviceFeature::memory_budget
+};
 
 
 
@@ -130,38 +64,17 @@ static void populate_queue_info(VkDeviceQueueCreateInfo& queue_info, uint32_t qu
     queue_info.pQueuePriorities = queue_priorities.rdata();
 }
 
-/* Populates the given VkPhysicalDeviceFeatures struct.
- * @param device_features The VkPhysicalDeviceFeatures struct to populate.
- * @param makma_device_features The DeviceFeatures as specified by the Makma library to enable. */
-static void populate_device_features(VkPhysicalDeviceFeatures& device_features, const Tools::Array<Vulkanic::DeviceFeature>& makma_device_features) {
-    // Initialize the struct to default
-    device_features = {};
-
-    // Enable those we want to enable
-    for (uint32_t i = 0; i < makma_device_features.size(); i++) {
-        switch(makma_device_features[i]) {
-        case Vulkanic::DeviceFeature::anisotropy:
-            device_features.samplerAnisotropy = VK_TRUE;
-            break;
-
-        default:
-            logger.warningc(Device::channel, "Unknown Makma3D device feature '", Vulkanic::device_feature_names[(int) makma_device_features[i]], "' encountered; skipping.");
-
-        }
-    }
-
-    // Done
-}
-
 /* Populates the given VkDeviceCreateInfo struct. 
  * @param device_info The VkDeviceCreateInfo struct to populate.
  * @param queue_infos The list of VkDeviceQueueCreateInfo that specify how many queues to create and from which family.
  * @param device_extensions The list of device extensions to enable for this device.
- * @param device_features The VkPhysicalDeviceFeatures struct listing which features to enable for this device. */
-static void populate_device_info(VkDeviceCreateInfo& device_info, const Tools::Array<VkDeviceQueueCreateInfo>& queue_infos, const Tools::Array<const char*>& device_extensions, const VkPhysicalDeviceFeatures& device_features) {
+ * @param device_features The VkPhysicalDeviceFeatures struct listing which features to enable for this device, or nullptr if they're passed in the pNext-chain instead.
+ * @param next The VkPhysicalDeviceFeatures2 chain of features to enable, or nullptr. */
+static void populate_device_info(VkDeviceCreateInfo& device_info, const Tools::Array<VkDeviceQueueCreateInfo>& queue_infos, const Tools::Array<const char*>& device_extensions, const VkPhysicalDeviceFeatures* device_features, const void* next) {
     // Set the meta info first
     device_info = {};
     device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.pNext = next;
 
     // Next, pass the queue infos
     device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
@@ -172,7 +85,7 @@ static void populate_device_info(VkDeviceCreateInfo& device_info, const Tools::A
     device_info.ppEnabledExtensionNames = device_extensions.rdata();
 
     // Finally, pass the device features
-    device_info.pEnabledFeatures = &device_features;
+    device_info.pEnabledFeatures = device_features;
 }
 
 
@@ -185,13 +98,24 @@ Device::Device(const Makma3D::Instance& instance, const PhysicalDevice& physical
     instance(instance),
 
     physical_device(physical_device),
-    queues({}, Vulkanic::n_queue_types)
+    queues({}, Vulkanic::n_queue_types),
+    queue_families(0U, Vulkanic::n_queue_types),
+    _can_present(vk_surface != nullptr),
+    dispatch(nullptr),
+    deletion_queue(nullptr),
+    memory_budget(nullptr),
+    command_pool_manager(nullptr),
+    descriptor_allocator(nullptr),
+    bindless_heap(nullptr),
+    profiler(nullptr),
+    geometry_pool(nullptr),
+    frame_ring(nullptr),
+    debug_markup(nullptr)
 {
-    // First, map the queue families
-    Tools::StackArray<std::pair<uint32_t, uint32_t>, Vulkanic::n_queue_types> queue_family_map = map_queue_families(physical_device, vk_surface);
-    // Extract the list of unique queue families from it
-    Tools::Array<std::pair<uint32_t, uint32_t>> unique_queue_family_map = uniqueify_queue_map(queue_family_map);
-    // Finally, construct a list of priorities that is large enough for all queue families
+    // First, plan which queues to create and who uses them
+    QueuePlanner planner(physical_device, vk_surface);
+    const Tools::Array<std::pair<uint32_t, uint32_t>>& unique_queue_family_map = planner.families();
+    // Construct a list of priorities that is large enough for all queue families
     Tools::Array<float> priorities;
     for (uint32_t i = 0; i < unique_queue_family_map.size(); i++) {
         priorities.resize(1.0f, unique_queue_family_map[i].second);
@@ -203,33 +127,118 @@ Device::Device(const Makma3D::Instance& instance, const PhysicalDevice& physical
         populate_queue_info(queue_infos[i], unique_queue_family_map[i].first, unique_queue_family_map[i].second, priorities);
     }
 
-    // Next, compile a list of device extensions & features to enable
-    Tools::Array<const char*> vk_device_extensions           = this->instance.get_device_extensions();
-    Tools::Array<Vulkanic::DeviceFeature> device_features = this->instance.get_device_features();
+    // Next, compile a list of device extensions & features to enable, starting with the ones we need
+    Tools::Array<const char*> vk_device_extensions = this->instance.get_device_extensions(vk_surface != nullptr);
+    this->enabled_features = this->instance.get_device_features();
+    // Add every fast path the device supports, as long as we can enable extension features at all
+    if (this->instance.supports_features2()) {
+        for (uint32_t i = 0; i < sizeof(fast_paths) / sizeof(Vulkanic::DeviceFeature); i++) {
+            if (physical_device.supports_feature(fast_paths[i]) && !this->has_feature(fast_paths[i])) {
+                this->enabled_features.push_back(fast_paths[i]);
+            }
+        }
+    }
+    // Add the extensions that provide the features on older versions
+    for (uint32_t i = 0; i < this->enabled_features.size(); i++) {
+        FeatureChain::add_extensions(vk_device_extensions, this->enabled_features[i], physical_device.api_version());
+    }
+
     // Convert the features to Vulkan features
-    VkPhysicalDeviceFeatures vk_device_features;
-    populate_device_features(vk_device_features, device_features);
+    FeatureChain vk_device_features;
+    vk_device_features.link(this->enabled_features);
+    vk_device_features.enable(this->enabled_features);
 
-    // Now we can populate the create info for the device itself
+    // Now we can populate the create info for the device itself. The features go in the chain if we can use one
     VkDeviceCreateInfo device_info;
-    populate_device_info(device_info, queue_infos, vk_device_extensions, vk_device_features);
+    if (this->instance.supports_features2()) {
+        populate_device_info(device_info, queue_infos, vk_device_extensions, nullptr, &vk_device_features.head());
+    } else {
+        populate_device_info(device_info, queue_infos, vk_device_extensions, &vk_device_features.core(), nullptr);
+    }
 
     // Create the Device
     VkResult vk_result;
     if ((vk_result = vkCreateDevice(physical_device, &device_info, nullptr, &this->vk_device)) != VK_SUCCESS) {
         logger.fatalc(Device::channel, "Cannot create Vulkan device: ", Vulkanic::vk_error_map.at(vk_result));
     }
+    this->dispatch = new DeviceDispatch(this->instance.dispatch().vkGetDeviceProcAddr, this->vk_device, physical_device.api_version(), this->_can_present);
+    this->debug_markup = new DebugMarkup(this->vk_device, this->instance.debug_utils());
+    this->debug_markup->name(this->vk_device, physical_device.name());
+    if (logger.get_verbosity() >= Verbosity::details) {
+        for (uint32_t i = 0; i < this->enabled_features.size(); i++) {
+            logger.logc(Verbosity::details, Device::channel, "Enabled device feature '", Vulkanic::device_feature_names[(int) this->enabled_features[i]], "'.");
+        }
+    }
+
+    // The timeline semaphore functions are loaded with the rest, but we cannot do without them if we use them
+    if (this->supports_timeline_semaphores() && (this->dispatch->vkGetSemaphoreCounterValueKHR == nullptr || this->dispatch->vkWaitSemaphoresKHR == nullptr)) {
+        logger.fatalc(Device::channel, "Could not load timeline semaphore functions.");
+    }
+
+    // With the device created, pull every queue we created from it
+    for (uint32_t i = 0; i < unique_queue_family_map.size(); i++) {
+        for (uint32_t j = 0; j < unique_queue_family_map[i].second; j++) {
+            VkQueue vk_queue;
+            vkGetDeviceQueue(this->vk_device, unique_queue_family_map[i].first, j, &vk_queue);
+            Timeline* timeline = new Timeline(this->vk_device, *this->dispatch, this->supports_timeline_semaphores());
+            this->all_queues.push_back(new Queue(vk_queue, unique_queue_family_map[i].first, j, timeline));
+        }
+    }
+    // Then give each type the queues it may use
+    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+        this->queue_families[i] = planner.type_families()[i];
+
+        const Tools::Array<QueuePlanner::Slot>& slots = planner.slots((Vulkanic::QueueType) i);
+        for (uint32_t j = 0; j < slots.size(); j++) {
+            for (uint32_t k = 0; k < this->all_queues.size(); k++) {
+                if (this->all_queues[k]->family() == slots[j].family && this->all_queues[k]->index() == slots[j].index) {
+                    this->queues[i].push_back(this->all_queues[k]);
+                    break;
+                }
+            }
+        }
+    }
 
-    // With the device created, pull the queues from it
-    for (uint32_t i = 0; i < queue_family_map.size(); i++) {
-        // Make sure there's enough space in the queue list first
-        this->queues[i].resize(queue_family_map[i].second);
-        // Loop through the queue count to retrieve each of them
-        for (uint32_t j = 0; j < queue_family_map[i].second; j++) {
-            vkGetDeviceQueue(this->vk_device, queue_family_map[i].first, j, &this->queues[i][j]);
+    // Name each queue after the types that use it
+    if (this->debug_markup->enabled()) {
+        for (uint32_t i = 0; i < this->all_queues.size(); i++) {
+            std::string name = "queue " + std::to_string(this->all_queues[i]->family()) + "." + std::to_string(this->all_queues[i]->index()) + " (";
+            bool first = true;
+            for (uint32_t j = 0; j < Vulkanic::n_queue_types; j++) {
+                for (uint32_t k = 0; k < this->queues[j].size(); k++) {
+                    if (this->queues[j][k] != this->all_queues[i]) { continue; }
+                    name += (first ? "" : ", ") + Vulkanic::queue_type_names[j];
+                    first = false;
+                    break;
+                }
+            }
+            this->debug_markup->name(this->all_queues[i]->vk(), name + ")");
         }
     }
 
+    // Prepare a submission coalescer for each type
+    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+        this->submitters.push_back(new SubmitCoalescer(*this->dispatch, (Vulkanic::QueueType) i, this->queues[i]));
+    }
+    // Objects are retired until all queues are done with them
+    this->deletion_queue = new DeletionQueue(this->all_queues);
+    // Watch the memory heaps, with the device's own budget if it can report one
+    this->memory_budget = new MemoryBudget(this->vk_device, *this->dispatch, this->physical_device, this->has_feature(Vulkanic::DeviceFeature::memory_budget) ? this->instance.dispatch().vkGetPhysicalDeviceMemoryProperties2 : nullptr, *this->deletion_queue);
+
+    // Finally, prepare the command pools and the descriptors
+    this->command_pool_manager = new CommandPoolManager(this->vk_device, *this->dispatch, this->queue_families, Device::max_frames_in_flight);
+    this->descriptor_allocator = new DescriptorAllocator(this->vk_device, *this->dispatch, Device::max_frames_in_flight);
+    // If we can index descriptors, put all resources in one bindless heap
+    if (this->has_feature(Vulkanic::DeviceFeature::descriptor_indexing)) {
+        this->bindless_heap = new BindlessHeap(this->vk_device, *this->dispatch, *this->deletion_queue, physical_device.properties().limits);
+    }
+    // Prepare the queries to profile with
+    this->profiler = new GpuProfiler(this->vk_device, *this->dispatch, this->physical_device, this->queue_families, Device::max_frames_in_flight, this->has_feature(Vulkanic::DeviceFeature::pipeline_statistics));
+    // Meshes share a few large buffers, which are compacted on the memory queue
+    this->geometry_pool = new GeometryPool(this->vk_device, *this->dispatch, this->physical_device, this->queue_families, *this->submitters[(uint32_t) Vulkanic::QueueType::memory], *this->deletion_queue, *this->memory_budget, *this->debug_markup);
+    // Per-frame constants are bump-allocated from a ring with a region per frame in flight
+    this->frame_ring = new FrameRing(this->vk_device, *this->dispatch, this->physical_device, *this->memory_budget, Device::max_frames_in_flight, *this->debug_markup);
+
     // Done!
 }
 
@@ -240,16 +249,125 @@ Device::Device(Device&& other) :
     physical_device(std::move(other.physical_device)),
 
     vk_device(other.vk_device),
-    queues(std::move(other.queues))
+    all_queues(std::move(other.all_queues)),
+    queues(std::move(other.queues)),
+    queue_families(other.queue_families),
+    _can_present(other._can_present),
+    enabled_features(std::move(other.enabled_features)),
+    dispatch(other.dispatch),
+    submitters(std::move(other.submitters)),
+    deletion_queue(other.deletion_queue),
+    memory_budget(other.memory_budget),
+
+    command_pool_manager(other.command_pool_manager),
+    descriptor_allocator(other.descriptor_allocator),
+    bindless_heap(other.bindless_heap),
+    profiler(other.profiler),
+    geometry_pool(other.geometry_pool),
+    frame_ring(other.frame_ring),
+    debug_markup(other.debug_markup)
 {
     other.vk_device = nullptr;
+    other.dispatch = nullptr;
+    other.deletion_queue = nullptr;
+    other.memory_budget = nullptr;
+    other.command_pool_manager = nullptr;
+    other.descriptor_allocator = nullptr;
+    other.bindless_heap = nullptr;
+    other.profiler = nullptr;
+    other.geometry_pool = nullptr;
+    other.frame_ring = nullptr;
+    other.debug_markup = nullptr;
 }
 
 /* Destructor for the Device class. */
 Device::~Device() {
+    // Let the GPU finish first, so the Timelines can safely destroy their semaphores and fences
+    if (this->vk_device != nullptr) {
+        this->dispatch->vkDeviceWaitIdle(this->vk_device);
+    }
+    // With the device idle, everything that's still retired can go (which may still give room back to the GeometryPool)
+    if (this->deletion_queue != nullptr) {
+        delete this->deletion_queue;
+    }
+
+    if (this->frame_ring != nullptr) {
+        delete this->frame_ring;
+    }
+    if (this->geometry_pool != nullptr) {
+        delete this->geometry_pool;
+    }
+    if (this->profiler != nullptr) {
+        delete this->profiler;
+    }
+    if (this->bindless_heap != nullptr) {
+        delete this->bindless_heap;
+    }
+    if (this->descriptor_allocator != nullptr) {
+        delete this->descriptor_allocator;
+    }
+    // Only now that nothing allocates through it anymore
+    if (this->memory_budget != nullptr) {
+        delete this->memory_budget;
+    }
+    if (this->command_pool_manager != nullptr) {
+        delete this->command_pool_manager;
+    }
+    for (uint32_t i = 0; i < this->submitters.size(); i++) {
+        delete this->submitters[i];
+    }
+    for (uint32_t i = 0; i < this->all_queues.size(); i++) {
+        delete this->all_queues[i];
+    }
+    if (this->debug_markup != nullptr) {
+        delete this->debug_markup;
+    }
     if (this->vk_device != nullptr) {
         vkDestroyDevice(this->vk_device, nullptr);
     }
+    if (this->dispatch != nullptr) {
+        delete this->dispatch;
+    }
+}
+
+
+
+/* Leases one of the queues of the given type, blocking until one is available. */
+QueueLease Device::lease_queue(Vulkanic::QueueType queue_type) const {
+    return QueueLease::lease_any(this->queues[(uint32_t) queue_type]);
+}
+
+/* Tries to lease one of the queues of the given type without blocking. */
+QueueLease Device::try_lease_queue(Vulkanic::QueueType queue_type) const {
+    return QueueLease::try_lease_any(this->queues[(uint32_t) queue_type]);
+}
+
+
+
+/* Returns whether the given DeviceFeature is enabled on this device. */
+bool Device::has_feature(Vulkanic::DeviceFeature feature) const {
+    for (uint32_t i = 0; i < this->enabled_features.size(); i++) {
+        if (this->enabled_features[i] == feature) { return true; }
+    }
+    return false;
+}
+
+
+
+/* Returns the index of a memory type on this device that is allowed by the given filter and that has at least the given properties. Throws errors if no such type exists. */
+uint32_t Device::get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+    // Get the (cached) memory types on the physical device
+    const VkPhysicalDeviceMemoryProperties& memory_properties = this->physical_device.memory_properties();
+
+    // Return the first one that is in the filter and has all of the required properties
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    // Didn't find any
+    logger.fatalc(Device::channel, "Physical device '", this->physical_device.name(), "' has no memory type that matches the given filter and properties.");
 }
 
 
@@ -265,5 +383,21 @@ void Makma3D::swap(Device& d1, Device& d2) {
     swap(d1.physical_device, d2.physical_device);
 
     swap(d1.vk_device, d2.vk_device);
+    swap(d1.all_queues, d2.all_queues);
     swap(d1.queues, d2.queues);
+    swap(d1.queue_families, d2.queue_families);
+    swap(d1._can_present, d2._can_present);
+    swap(d1.enabled_features, d2.enabled_features);
+    swap(d1.dispatch, d2.dispatch);
+    swap(d1.submitters, d2.submitters);
+    swap(d1.deletion_queue, d2.deletion_queue);
+    swap(d1.memory_budget, d2.memory_budget);
+
+    swap(d1.command_pool_manager, d2.command_pool_manager);
+    swap(d1.descriptor_allocator, d2.descriptor_allocator);
+    swap(d1.bindless_heap, d2.bindless_heap);
+    swap(d1.profiler, d2.profiler);
+    swap(d1.geometry_pool, d2.geometry_pool);
+    swap(d1.frame_ring, d2.frame_ring);
+    swap(d1.debug_markup, d2.debug_markup);
 }
@@ -0,0 +1,72 @@
+/* DEVICE DISPATCH.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 10:12:35
+ * Last edited:
+ *   19/10/2021, 10:12:35
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the DeviceDispatch struct, which holds the Vulkan functions
+ *   of a single VkDevice as loaded by vkGetDeviceProcAddr(). Calling
+ *   through it skips the loader's trampoline and dispatch on every call,
+ *   and resolves extension functions once when the device is created.
+**/
+
+#include "tools/Logger.hpp"
+
+#include "gpu/DeviceDispatch.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** HELPER FUNCTIONS *****/
+/* Loads the given function from the given device.
+ * @param get_device_proc_addr The vkGetDeviceProcAddr() to load the function with.
+ * @param vk_device The VkDevice to load the function from.
+ * @param function_name The name of the function to load.
+ * @param required Whether the device should always have the function (true), or whether it may be missing because it comes from an extension (false).
+ * @returns The function pointer, or nullptr if an optional function is missing. */
+static PFN_vkVoidFunction load_device_method(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice vk_device, const char* function_name, bool required) {
+    // Fetch the function pointer
+    PFN_vkVoidFunction to_return = get_device_proc_addr(vk_device, function_name);
+    if (to_return == nullptr) {
+        if (required) { logger.fatalc(DeviceDispatch::channel, "Could not load function '", function_name, "'."); }
+        logger.logc(Verbosity::debug, DeviceDispatch::channel, "Function '", function_name, "' is not available.");
+        return nullptr;
+    }
+
+    // Otherwise, log success and return
+    logger.logc(Verbosity::debug, DeviceDispatch::channel, "Loaded function '", function_name, "'.");
+    return to_return;
+}
+
+
+
+
+
+/***** DEVICEDISPATCH STRUCT *****/
+/* Constructor for the DeviceDispatch struct, which loads all functions at once. */
+DeviceDispatch::DeviceDispatch(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice vk_device, uint32_t api_version, bool present) {
+    // The core functions have to be there, the extension ones may be missing
+    #define MAKMA3D_LOAD_FUNCTION(NAME) this->NAME = (PFN_##NAME) load_device_method(get_device_proc_addr, vk_device, #NAME, true);
+    #define MAKMA3D_LOAD_EXTENSION_FUNCTION(NAME) this->NAME = (PFN_##NAME) load_device_method(get_device_proc_addr, vk_device, #NAME, false);
+    MAKMA3D_DEVICE_FUNCTIONS(MAKMA3D_LOAD_FUNCTION)
+    MAKMA3D_DEVICE_EXTENSION_FUNCTIONS(MAKMA3D_LOAD_EXTENSION_FUNCTION)
+    #undef MAKMA3D_LOAD_EXTENSION_FUNCTION
+    #undef MAKMA3D_LOAD_FUNCTION
+
+    // A device that presents cannot do without the swapchain functions, so don't let it fail on its first frame
+    if (present && (this->vkGetSwapchainImagesKHR == nullptr || this->vkAcquireNextImageKHR == nullptr || this->vkQueuePresentKHR == nullptr)) {
+        logger.fatalc(DeviceDispatch::channel, "Could not load the swapchain functions of a device that presents; is '", VK_KHR_SWAPCHAIN_EXTENSION_NAME, "' enabled?");
+    }
+
+    // Promoted functions are loaded under their core name if the device is new enough, and under their extension name otherwise
+    bool promoted_core = api_version >= VK_API_VERSION_1_2;
+    #define MAKMA3D_LOAD_PROMOTED_FUNCTION(NAME, CORE_NAME) this->NAME = (PFN_##NAME) load_device_method(get_device_proc_addr, vk_device, promoted_core ? CORE_NAME : #NAME, false);
+    MAKMA3D_DEVICE_PROMOTED_FUNCTIONS(MAKMA3D_LOAD_PROMOTED_FUNCTION)
+    #undef MAKMA3D_LOAD_PROMOTED_FUNCTION
+}
@@ -0,0 +1,313 @@
+/* FEATURE CHAIN.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 09:41:30
+ * Last edited:
+ *   18/10/2021, 09:41:30
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the FeatureChain class, which builds the
+ *   VkPhysicalDeviceFeatures2 pNext-chain for a set of Makma3D
+ *   DeviceFeatures, both to query and to enable them. Also knows in which
+ *   Vulkan version or through which extensions each feature is available.
+**/
+
+#include <cstring>
+
+#include "tools/Logger.hpp"
+
+#include "gpu/FeatureChain.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* Describes where a DeviceFeature comes from. */
+struct FeatureSource {
+    /* The Vulkan version in which the feature became core. */
+    uint32_t core_version;
+    /* The extension that provides the feature before that version, or nullptr if there is none. */
+    const char* extension;
+    /* The lowest Vulkan version on which we use the extension, since below it its own dependencies aren't core yet. */
+    uint32_t extension_version;
+    /* An extension the extension depends on that became core in Vulkan 1.1, or nullptr if there is none. */
+    const char* dependency;
+};
+
+/* Core version for features that we always take from their extension. */
+static constexpr const uint32_t never_core = UINT32_MAX;
+
+/* The source of each DeviceFeature, indexed by the DeviceFeature. */
+static const FeatureSource feature_sources[] = {
+    { VK_API_VERSION_1_0, nullptr, VK_API_VERSION_1_0, nullptr },                                                                   // undefined
+    { VK_API_VERSION_1_0, nullptr, VK_API_VERSION_1_0, nullptr },                                                                   // anisotropy
+    { VK_API_VERSION_1_2, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_API_VERSION_1_0, VK_KHR_MAINTENANCE3_EXTENSION_NAME },      // descriptor_indexing
+    { VK_API_VERSION_1_2, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME, VK_API_VERSION_1_1, nullptr },                               // buffer_device_address
+    { VK_API_VERSION_1_2, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, VK_API_VERSION_1_0, nullptr },                                  // timeline_semaphores
+    { VK_API_VERSION_1_3, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_API_VERSION_1_2, nullptr },                                   // dynamic_rendering
+    { VK_API_VERSION_1_3, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, VK_API_VERSION_1_0, nullptr },                                   // synchronization2
+    { VK_API_VERSION_1_2, VK_KHR_8BIT_STORAGE_EXTENSION_NAME, VK_API_VERSION_1_0, VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME }, // storage_8bit
+    { VK_API_VERSION_1_1, VK_KHR_16BIT_STORAGE_EXTENSION_NAME, VK_API_VERSION_1_0, VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME }, // storage_16bit
+    { VK_API_VERSION_1_0, nullptr, VK_API_VERSION_1_0, nullptr },                                                                   // multi_draw_indirect
+    // In Vulkan 1.2, drawIndirectCount is only exposed by VkPhysicalDeviceVulkan12Features, which may not be chained next to the other structs; so we always use the extension, which drivers keep advertising
+    { never_core, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, VK_API_VERSION_1_0, nullptr },                                         // draw_indirect_count
+    { VK_API_VERSION_1_0, nullptr, VK_API_VERSION_1_0, nullptr },                                                                   // pipeline_statistics
+    // The budget is queried with vkGetPhysicalDeviceMemoryProperties2(), so we only use the extension where that is core
+    { never_core, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, VK_API_VERSION_1_1, nullptr }                                                // memory_budget
+};
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Returns whether the given extension is in the given list of extension properties. */
+static bool has_extension(const Tools::Array<VkExtensionProperties>& device_extensions, const char* extension) {
+    for (uint32_t i = 0; i < device_extensions.size(); i++) {
+        if (strcmp(device_extensions[i].extensionName, extension) == 0) { return true; }
+    }
+    return false;
+}
+
+/* Adds the given extension to the given list if it isn't in there already. */
+static void add_unique(Tools::Array<const char*>& extensions, const char* extension) {
+    for (uint32_t i = 0; i < extensions.size(); i++) {
+        if (strcmp(extensions[i], extension) == 0) { return; }
+    }
+    extensions.push_back(extension);
+}
+
+
+
+
+
+/***** FEATURECHAIN CLASS *****/
+/* Constructor for the FeatureChain class. */
+FeatureChain::FeatureChain() :
+    features2({}),
+    descriptor_indexing({}),
+    buffer_device_address({}),
+    timeline_semaphores({}),
+    dynamic_rendering({}),
+    synchronization2({}),
+    storage_8bit({}),
+    storage_16bit({})
+{
+    this->features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    this->descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    this->buffer_device_address.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    this->timeline_semaphores.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    this->dynamic_rendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    this->synchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    this->storage_8bit.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES;
+    this->storage_16bit.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES;
+}
+
+
+
+/* Returns the struct in the chain that carries the given feature, or nullptr if it lives in the head of the chain. */
+VkBaseOutStructure* FeatureChain::get_struct(Vulkanic::DeviceFeature feature) {
+    switch(feature) {
+        case Vulkanic::DeviceFeature::descriptor_indexing:   return reinterpret_cast<VkBaseOutStructure*>(&this->descriptor_indexing);
+        case Vulkanic::DeviceFeature::buffer_device_address: return reinterpret_cast<VkBaseOutStructure*>(&this->buffer_device_address);
+        case Vulkanic::DeviceFeature::timeline_semaphores:   return reinterpret_cast<VkBaseOutStructure*>(&this->timeline_semaphores);
+        case Vulkanic::DeviceFeature::dynamic_rendering:     return reinterpret_cast<VkBaseOutStructure*>(&this->dynamic_rendering);
+        case Vulkanic::DeviceFeature::synchronization2:      return reinterpret_cast<VkBaseOutStructure*>(&this->synchronization2);
+        case Vulkanic::DeviceFeature::storage_8bit:          return reinterpret_cast<VkBaseOutStructure*>(&this->storage_8bit);
+        case Vulkanic::DeviceFeature::storage_16bit:         return reinterpret_cast<VkBaseOutStructure*>(&this->storage_16bit);
+        default:                                             return nullptr;
+    }
+}
+
+
+
+/* Links the structs needed for the given features into the chain, replacing any previous chain. */
+void FeatureChain::link(const Tools::Array<Vulkanic::DeviceFeature>& features) {
+    this->features2.pNext = nullptr;
+    VkBaseOutStructure* tail = reinterpret_cast<VkBaseOutStructure*>(&this->features2);
+    for (uint32_t i = 0; i < features.size(); i++) {
+        // Features of the head are always there
+        VkBaseOutStructure* feature_struct = this->get_struct(features[i]);
+        if (feature_struct == nullptr) { continue; }
+
+        // Don't link a struct twice
+        bool linked = false;
+        for (VkBaseOutStructure* s = reinterpret_cast<VkBaseOutStructure*>(this->features2.pNext); s != nullptr; s = s->pNext) {
+            if (s == feature_struct) { linked = true; break; }
+        }
+        if (linked) { continue; }
+
+        // Append it
+        feature_struct->pNext = nullptr;
+        tail->pNext = feature_struct;
+        tail = feature_struct;
+    }
+}
+
+/* Marks the given features as enabled in their structs. */
+void FeatureChain::enable(const Tools::Array<Vulkanic::DeviceFeature>& features) {
+    for (uint32_t i = 0; i < features.size(); i++) {
+        switch(features[i]) {
+        case Vulkanic::DeviceFeature::anisotropy:
+            this->features2.features.samplerAnisotropy = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::descriptor_indexing:
+            // Enable what's needed for bindless descriptor arrays
+            this->descriptor_indexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            this->descriptor_indexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+            this->descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            this->descriptor_indexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            this->descriptor_indexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            this->descriptor_indexing.descriptorBindingPartiallyBound = VK_TRUE;
+            this->descriptor_indexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            this->descriptor_indexing.runtimeDescriptorArray = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::buffer_device_address:
+            this->buffer_device_address.bufferDeviceAddress = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::timeline_semaphores:
+            this->timeline_semaphores.timelineSemaphore = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::dynamic_rendering:
+            this->dynamic_rendering.dynamicRendering = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::synchronization2:
+            this->synchronization2.synchronization2 = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::storage_8bit:
+            this->storage_8bit.storageBuffer8BitAccess = VK_TRUE;
+            this->storage_8bit.uniformAndStorageBuffer8BitAccess = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::storage_16bit:
+            this->storage_16bit.storageBuffer16BitAccess = VK_TRUE;
+            this->storage_16bit.uniformAndStorageBuffer16BitAccess = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::multi_draw_indirect:
+            this->features2.features.multiDrawIndirect = VK_TRUE;
+            this->features2.features.drawIndirectFirstInstance = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::draw_indirect_count:
+            // Enabling the extension is all there is to it
+            break;
+
+        case Vulkanic::DeviceFeature::pipeline_statistics:
+            this->features2.features.pipelineStatisticsQuery = VK_TRUE;
+            break;
+
+        case Vulkanic::DeviceFeature::memory_budget:
+            // Enabling the extension is all there is to it
+            break;
+
+        default:
+            logger.warningc(FeatureChain::channel, "Unknown Makma3D device feature '", Vulkanic::device_feature_names[(int) features[i]], "' encountered; skipping.");
+
+        }
+    }
+}
+
+/* Returns whether the given feature is marked as supported in the (queried) chain. */
+bool FeatureChain::supports(Vulkanic::DeviceFeature feature) const {
+    switch(feature) {
+        case Vulkanic::DeviceFeature::anisotropy:
+            return this->features2.features.samplerAnisotropy;
+
+        case Vulkanic::DeviceFeature::descriptor_indexing:
+            return this->descriptor_indexing.shaderSampledImageArrayNonUniformIndexing &&
+                   this->descriptor_indexing.shaderStorageBufferArrayNonUniformIndexing &&
+                   this->descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind &&
+                   this->descriptor_indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+                   this->descriptor_indexing.descriptorBindingUpdateUnusedWhilePending &&
+                   this->descriptor_indexing.descriptorBindingPartiallyBound &&
+                   this->descriptor_indexing.descriptorBindingVariableDescriptorCount &&
+                   this->descriptor_indexing.runtimeDescriptorArray;
+
+        case Vulkanic::DeviceFeature::buffer_device_address:
+            return this->buffer_device_address.bufferDeviceAddress;
+
+        case Vulkanic::DeviceFeature::timeline_semaphores:
+            return this->timeline_semaphores.timelineSemaphore;
+
+        case Vulkanic::DeviceFeature::dynamic_rendering:
+            return this->dynamic_rendering.dynamicRendering;
+
+        case Vulkanic::DeviceFeature::synchronization2:
+            return this->synchronization2.synchronization2;
+
+        case Vulkanic::DeviceFeature::storage_8bit:
+            return this->storage_8bit.storageBuffer8BitAccess && this->storage_8bit.uniformAndStorageBuffer8BitAccess;
+
+        case Vulkanic::DeviceFeature::storage_16bit:
+            return this->storage_16bit.storageBuffer16BitAccess && this->storage_16bit.uniformAndStorageBuffer16BitAccess;
+
+        case Vulkanic::DeviceFeature::multi_draw_indirect:
+            return this->features2.features.multiDrawIndirect && this->features2.features.drawIndirectFirstInstance;
+
+        case Vulkanic::DeviceFeature::draw_indirect_count:
+            // Supported if the extension is, which is_available() already checked
+            return true;
+
+        case Vulkanic::DeviceFeature::pipeline_statistics:
+            return this->features2.features.pipelineStatisticsQuery;
+
+        case Vulkanic::DeviceFeature::memory_budget:
+            // Supported if the extension is, which is_available() already checked
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+
+/* Returns whether the given feature can only be queried through vkGetPhysicalDeviceFeatures2(). */
+bool FeatureChain::needs_features2(Vulkanic::DeviceFeature feature) {
+    switch(feature) {
+        case Vulkanic::DeviceFeature::anisotropy:
+        case Vulkanic::DeviceFeature::multi_draw_indirect:
+        case Vulkanic::DeviceFeature::draw_indirect_count:
+        case Vulkanic::DeviceFeature::pipeline_statistics:
+        case Vulkanic::DeviceFeature::memory_budget:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+/* Returns whether the given feature can be queried or enabled on a device. */
+bool FeatureChain::is_available(Vulkanic::DeviceFeature feature, uint32_t api_version, const Tools::Array<VkExtensionProperties>& device_extensions) {
+    if (feature == Vulkanic::DeviceFeature::undefined) { return false; }
+    const FeatureSource& source = feature_sources[(int) feature];
+
+    // Either it's core...
+    if (api_version >= source.core_version) { return true; }
+    // ...or we can use its extension
+    if (source.extension == nullptr || api_version < source.extension_version) { return false; }
+    if (!has_extension(device_extensions, source.extension)) { return false; }
+    return source.dependency == nullptr || api_version >= VK_API_VERSION_1_1 || has_extension(device_extensions, source.dependency);
+}
+
+/* Adds the device extensions needed to enable the given feature on a device with the given version to the list. */
+void FeatureChain::add_extensions(Tools::Array<const char*>& extensions, Vulkanic::DeviceFeature feature, uint32_t api_version) {
+    if (feature == Vulkanic::DeviceFeature::undefined) { return; }
+    const FeatureSource& source = feature_sources[(int) feature];
+
+    // Nothing to do if it's core
+    if (api_version >= source.core_version || source.extension == nullptr) { return; }
+    add_unique(extensions, source.extension);
+    if (source.dependency != nullptr && api_version < VK_API_VERSION_1_1) { add_unique(extensions, source.dependency); }
+}
@@ -0,0 +1,209 @@
+/* FRAME RING.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 19:04:31
+ * Last edited:
+ *   19/10/2021, 19:04:31
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the FrameRing class, which hands out short-lived uniform and
+ *   storage data from one persistently mapped buffer, split in a region
+ *   per frame in flight. Allocating is a bump of a pointer, and shaders
+ *   find the data through dynamic offsets, so per-object constants need
+ *   neither their own buffers nor descriptor updates.
+**/
+
+#include <limits>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/FrameRing.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** HELPER FUNCTIONS *****/
+/* Rounds the given size up to the given alignment.
+ * @param size The size to round.
+ * @param alignment The alignment to round to.
+ * @returns The rounded size. */
+static inline VkDeviceSize align_up(VkDeviceSize size, VkDeviceSize alignment) {
+    return ((size + alignment - 1) / alignment) * alignment;
+}
+
+/* Returns the index of the first memory type that is allowed by the given filter and that has at least the given properties.
+ * @param memory_properties The memory properties of the physical device.
+ * @param type_filter Bitmask of memory types that are allowed.
+ * @param properties The memory properties that the memory type should at least have.
+ * @returns The index of the memory type, or std::numeric_limits<uint32_t>::max() if there is none. */
+static uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, uint32_t type_filter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return std::numeric_limits<uint32_t>::max();
+}
+
+
+
+
+
+/***** FRAMERING CLASS *****/
+/* Constructor for the FrameRing class. */
+FrameRing::FrameRing(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, MemoryBudget& memory_budget, uint32_t n_frames, const DebugMarkup& debug_markup, VkDeviceSize frame_size) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    memory_budget(memory_budget),
+
+    vk_buffer(nullptr),
+    vk_memory(nullptr),
+    memory_type(0),
+    memory_size(0),
+    map(nullptr),
+    _device_local(false),
+
+    _n_frames(n_frames),
+    _current_frame(0),
+    head(0),
+    overflowed(false),
+
+    n_allocations(0),
+    n_overflows(0),
+    _statistics({ 0, 0, 0, 0, 0 })
+{
+    // Dynamic offsets have to satisfy the alignment of both kinds of descriptor
+    const VkPhysicalDeviceLimits& limits = physical_device.properties().limits;
+    this->_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    this->_frame_size = align_up(frame_size, this->_alignment);
+    this->_max_range = std::min(FrameRing::default_max_range, limits.maxUniformBufferRange);
+
+    // A descriptor may read up to its range past the last offset, so leave that much room after the last region
+    VkDeviceSize buffer_size = this->_n_frames * this->_frame_size + this->_max_range;
+    if (buffer_size > std::numeric_limits<uint32_t>::max()) {
+        logger.fatalc(FrameRing::channel, "Cannot address a ring of ", buffer_size, " bytes with dynamic offsets.");
+    }
+
+    // Create the buffer
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = buffer_size;
+    buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(this->vk_device, &buffer_info, nullptr, &this->vk_buffer)) != VK_SUCCESS) {
+        logger.fatalc(FrameRing::channel, "Could not create ring buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    debug_markup.name(this->vk_buffer, "FrameRing");
+
+    // Prefer memory that is both device-local and host-visible, so the GPU doesn't read over the bus; fall back to plain host memory
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(this->vk_device, this->vk_buffer, &requirements);
+    uint32_t memory_type = find_memory_type(physical_device.memory_properties(), requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    this->_device_local = memory_type != std::numeric_limits<uint32_t>::max();
+    if (!this->_device_local) {
+        memory_type = find_memory_type(physical_device.memory_properties(), requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        if (memory_type == std::numeric_limits<uint32_t>::max()) {
+            logger.fatalc(FrameRing::channel, "Could not find host-visible memory for the ring.");
+        }
+    }
+
+    // Allocate and bind it
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = memory_type;
+    if ((vk_result = this->memory_budget.allocate(allocate_info, this->vk_memory)) != VK_SUCCESS) {
+        logger.fatalc(FrameRing::channel, "Could not allocate ring memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->memory_type = memory_type;
+    this->memory_size = requirements.size;
+    if ((vk_result = vkBindBufferMemory(this->vk_device, this->vk_buffer, this->vk_memory, 0)) != VK_SUCCESS) {
+        logger.fatalc(FrameRing::channel, "Could not bind ring memory to ring buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Map it once; it stays mapped for the lifetime of the ring
+    void* mapped;
+    if ((vk_result = this->dispatch.vkMapMemory(this->vk_device, this->vk_memory, 0, buffer_size, 0, &mapped)) != VK_SUCCESS) {
+        logger.fatalc(FrameRing::channel, "Could not map ring memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->map = (uint8_t*) mapped;
+
+    // Done
+    logger.logc(Verbosity::details, FrameRing::channel, "Initialized with ", this->_n_frames, " regions of ", this->_frame_size, " bytes in ", this->_device_local ? "device-local" : "host", " memory, aligned to ", this->_alignment, " bytes.");
+}
+
+/* Destructor for the FrameRing class. Assumes the device is idle. */
+FrameRing::~FrameRing() {
+    // Report the statistics
+    if (this->_statistics.n_allocations > 0) {
+        logger.logc(Verbosity::details, FrameRing::channel, "Handed out ", this->_statistics.n_allocations, " allocations over ", this->_statistics.n_frames, " frames (", this->_statistics.bytes_per_frame(), " bytes per frame on average, at most ", this->_statistics.high_water, " of ", this->_frame_size, "), of which ", this->_statistics.n_overflows, " overflowed.");
+    }
+
+    if (this->vk_memory != nullptr) {
+        this->dispatch.vkUnmapMemory(this->vk_device, this->vk_memory);
+        this->memory_budget.free(this->vk_memory, this->memory_type, this->memory_size);
+    }
+    if (this->vk_buffer != nullptr) {
+        vkDestroyBuffer(this->vk_device, this->vk_buffer, nullptr);
+    }
+}
+
+
+
+/* Allocates the given number of bytes in the current frame's region. */
+FrameAllocation FrameRing::allocate(uint32_t size) {
+    // Bump the head by the aligned size; since every size is aligned, so is every offset
+    VkDeviceSize aligned_size = align_up(std::max(size, 1U), this->_alignment);
+    VkDeviceSize offset = this->head.fetch_add(aligned_size);
+    if (offset + aligned_size > this->_frame_size) {
+        // It doesn't fit; warn once per frame so the region can be made larger
+        ++this->n_overflows;
+        if (!this->overflowed.exchange(true)) {
+            logger.warningc(FrameRing::channel, "Region of frame ", this->_current_frame, " overflowed (", this->_frame_size, " bytes); consider a larger frame size.");
+        }
+        return FrameAllocation{ nullptr, 0, 0 };
+    }
+    ++this->n_allocations;
+
+    // Return where it lives in the buffer
+    VkDeviceSize buffer_offset = this->_current_frame * this->_frame_size + offset;
+    return FrameAllocation{ (void*) (this->map + buffer_offset), static_cast<uint32_t>(buffer_offset), size };
+}
+
+/* Moves to the given frame, making its whole region available again. */
+void FrameRing::begin_frame(uint32_t frame) {
+    // Fold the frame that was recorded last into the statistics
+    VkDeviceSize used = this->size();
+    if (used > 0 || this->n_allocations.load() > 0 || this->n_overflows.load() > 0) {
+        ++this->_statistics.n_frames;
+        this->_statistics.n_allocations += this->n_allocations.exchange(0);
+        this->_statistics.n_overflows += this->n_overflows.exchange(0);
+        this->_statistics.total_bytes += used;
+        if (used > this->_statistics.high_water) { this->_statistics.high_water = used; }
+    }
+
+    // The fence of the given frame has been signalled, so the GPU is done reading its region
+    #ifndef NDEBUG
+    if (frame >= this->_n_frames) { logger.fatalc(FrameRing::channel, "Frame ", frame, " is out of range for a ring with ", this->_n_frames, " frames."); }
+    #endif
+    this->_current_frame = frame;
+    this->head.store(0);
+    this->overflowed.store(false);
+}
+
+
+
+/* Returns the buffer info for a dynamic uniform or storage buffer descriptor into the ring. */
+VkDescriptorBufferInfo FrameRing::descriptor_info(uint32_t range) const {
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = this->vk_buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = std::min(range, this->_max_range);
+    return buffer_info;
+}
@@ -0,0 +1,684 @@
+/* GEOMETRY POOL.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 16:20:52
+ * Last edited:
+ *   19/10/2021, 16:20:52
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the GeometryPool class, which sub-allocates the vertex and
+ *   index data of all meshes of a Device from a few large device-local
+ *   buffers. Meshes are addressed by their vertexOffset and firstIndex
+ *   in those buffers, so drawing thousands of them only takes one bind
+ *   per block.
+**/
+
+#include <algorithm>
+#include <limits>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/GeometryPool.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkBufferCreateInfo struct.
+ * @param buffer_info The VkBufferCreateInfo struct to populate.
+ * @param size The size of the buffer, in bytes.
+ * @param usage The usage of the buffer.
+ * @param queue_families The unique queue families that share the buffer. */
+static void populate_buffer_info(VkBufferCreateInfo& buffer_info, VkDeviceSize size, VkBufferUsageFlags usage, const Tools::Array<uint32_t>& queue_families) {
+    // Set the meta info first
+    buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+    // Set the size and the usage
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+
+    // Share it between all families, so uploads, compactions and draws never need to transfer ownership
+    if (queue_families.size() > 1) {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = queue_families.size();
+        buffer_info.pQueueFamilyIndices = queue_families.rdata();
+    } else {
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+}
+
+
+
+
+
+/***** GEOMETRYPOOL CLASS *****/
+/* Constructor for the GeometryPool class. */
+GeometryPool::GeometryPool(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, SubmitCoalescer& submitter, DeletionQueue& deletion_queue, MemoryBudget& memory_budget, const DebugMarkup& debug_markup) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    memory_properties(physical_device.memory_properties()),
+    submitter(submitter),
+    deletion_queue(deletion_queue),
+    memory_budget(memory_budget),
+    debug_markup(debug_markup),
+
+    vk_command_pool(nullptr),
+
+    _generation(0),
+    _statistics({ 0, 0, 0, 0, 0, 0, 0, 0, 0 })
+{
+    // Collect the unique families that may touch the buffers
+    for (uint32_t i = 0; i < queue_families.size(); i++) {
+        bool unique = true;
+        for (uint32_t j = 0; j < this->queue_families.size(); j++) {
+            if (this->queue_families[j] == queue_families[i]) { unique = false; break; }
+        }
+        if (unique) { this->queue_families.push_back(queue_families[i]); }
+    }
+
+    // Compactions are recorded on the memory queue
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = queue_families[(uint32_t) Vulkanic::QueueType::memory];
+    VkResult vk_result;
+    if ((vk_result = vkCreateCommandPool(this->vk_device, &pool_info, nullptr, &this->vk_command_pool)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not create command pool: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+}
+
+/* Destructor for the GeometryPool class. Assumes the device is idle. */
+GeometryPool::~GeometryPool() {
+    // Report the statistics
+    if (this->_statistics.peak_meshes > 0) {
+        logger.logc(Verbosity::details, GeometryPool::channel, "Held at most ", this->_statistics.peak_meshes, " meshes in ", this->blocks.size(), " blocks (", this->_statistics.vertex_capacity + this->_statistics.index_capacity, " bytes), and compacted ", this->_statistics.n_compactions, " blocks and relocated ", this->_statistics.n_relocations, " ranges by moving ", this->_statistics.bytes_moved, " bytes.");
+    }
+
+    // Destroy the blocks
+    for (uint32_t i = 0; i < this->blocks.size(); i++) {
+        GeometryPool::destroy_block(this->vk_device, this->memory_budget, this->blocks[i]);
+    }
+
+    // The command buffers are freed with their pool
+    if (this->vk_command_pool != nullptr) {
+        vkDestroyCommandPool(this->vk_device, this->vk_command_pool, nullptr);
+    }
+}
+
+
+
+/* Takes a range of the given size and alignment from the given free list, using the first one that fits. */
+bool GeometryPool::take_range(Tools::Array<FreeRange>& free_list, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    // Empty ranges don't need any room
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+
+    for (uint32_t i = 0; i < free_list.size(); i++) {
+        FreeRange& range = free_list[i];
+
+        // Check if the aligned range fits in this one
+        VkDeviceSize aligned = ((range.offset + alignment - 1) / alignment) * alignment;
+        if (aligned + size > range.offset + range.size) { continue; }
+
+        // It does; keep what's left before and after it
+        VkDeviceSize front = aligned - range.offset;
+        VkDeviceSize back = range.offset + range.size - (aligned + size);
+        if (front > 0 && back > 0) {
+            range.size = front;
+            free_list.insert(i + 1, FreeRange{ aligned + size, back });
+        } else if (front > 0) {
+            range.size = front;
+        } else if (back > 0) {
+            range.offset = aligned + size;
+            range.size = back;
+        } else {
+            free_list.erase(i);
+        }
+        offset = aligned;
+        return true;
+    }
+
+    // Nothing fits
+    return false;
+}
+
+/* Returns the given range to the given free list, merging it with its neighbours. */
+void GeometryPool::return_range(Tools::Array<FreeRange>& free_list, VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) { return; }
+
+    // Find the first range after this one
+    uint32_t i = 0;
+    while (i < free_list.size() && free_list[i].offset < offset) { ++i; }
+
+    // Merge with the one before and/or after if they touch
+    bool merge_front = i > 0 && free_list[i - 1].offset + free_list[i - 1].size == offset;
+    bool merge_back = i < free_list.size() && offset + size == free_list[i].offset;
+    if (merge_front && merge_back) {
+        free_list[i - 1].size += size + free_list[i].size;
+        free_list.erase(i);
+    } else if (merge_front) {
+        free_list[i - 1].size += size;
+    } else if (merge_back) {
+        free_list[i].offset = offset;
+        free_list[i].size += size;
+    } else {
+        free_list.insert(i, FreeRange{ offset, size });
+    }
+}
+
+/* Returns the fraction of free space of the given free list that is not in its largest range. */
+double GeometryPool::fragmentation(const Tools::Array<FreeRange>& free_list) {
+    VkDeviceSize total = 0, largest = 0;
+    for (uint32_t i = 0; i < free_list.size(); i++) {
+        total += free_list[i].size;
+        if (free_list[i].size > largest) { largest = free_list[i].size; }
+    }
+    return total > 0 ? 1.0 - static_cast<double>(largest) / total : 0.0;
+}
+
+
+
+/* Creates the buffers of a new, empty block. */
+void GeometryPool::create_block(Block& block) {
+    // Create the buffers; they can be copied from and to for uploads and compactions, and read as storage buffers for vertex pulling and GPU culling
+    this->create_buffer(GeometryPool::vertex_block_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, block.vk_vertex_buffer, block.vertex_memory);
+    this->create_buffer(GeometryPool::index_block_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, block.vk_index_buffer, block.index_memory);
+
+    // Everything is free
+    block.free_vertices.clear();
+    block.free_vertices.push_back(FreeRange{ 0, GeometryPool::vertex_block_size });
+    block.free_indices.clear();
+    block.free_indices.push_back(FreeRange{ 0, GeometryPool::index_block_size });
+}
+
+/* Names the buffers of the given block. */
+void GeometryPool::name_block(const Block& block, const std::string& name) const {
+    this->debug_markup.name(block.vk_vertex_buffer, name + " vertices");
+    this->debug_markup.name(block.vk_index_buffer, name + " indices");
+}
+
+/* Creates a buffer with memory of its own. */
+void GeometryPool::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& vk_buffer, Allocation& memory) {
+    // Create the buffer
+    VkBufferCreateInfo buffer_info;
+    populate_buffer_info(buffer_info, size, usage, this->queue_families);
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(this->vk_device, &buffer_info, nullptr, &vk_buffer)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not create buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Find device-local memory for it
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(this->vk_device, vk_buffer, &requirements);
+    uint32_t memory_type = std::numeric_limits<uint32_t>::max();
+    for (uint32_t i = 0; i < this->memory_properties.memoryTypeCount; i++) {
+        if (requirements.memoryTypeBits & (1 << i) && (this->memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+            memory_type = i;
+            break;
+        }
+    }
+    if (memory_type == std::numeric_limits<uint32_t>::max()) {
+        logger.fatalc(GeometryPool::channel, "Could not find device-local memory for geometry buffer.");
+    }
+
+    // Allocate it through the budget, which evicts other resources if the heap is full, and bind it
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = memory_type;
+    if ((vk_result = this->memory_budget.allocate(allocate_info, memory.vk_memory)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not allocate ", requirements.size, " bytes of geometry memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    memory.memory_type = memory_type;
+    memory.size = requirements.size;
+    if ((vk_result = vkBindBufferMemory(this->vk_device, vk_buffer, memory.vk_memory, 0)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not bind memory to geometry buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+}
+
+/* Destroys the buffers of the given block. */
+void GeometryPool::destroy_block(VkDevice vk_device, MemoryBudget& memory_budget, const Block& block) {
+    vkDestroyBuffer(vk_device, block.vk_vertex_buffer, nullptr);
+    memory_budget.free(block.vertex_memory.vk_memory, block.vertex_memory.memory_type, block.vertex_memory.size);
+    vkDestroyBuffer(vk_device, block.vk_index_buffer, nullptr);
+    memory_budget.free(block.index_memory.vk_memory, block.index_memory.memory_type, block.index_memory.size);
+}
+
+/* Allocates and begins a command buffer for copies on the memory queue. Assumes the lock is taken. */
+VkCommandBuffer GeometryPool::begin_copies(const char* label) {
+    // Allocate it from our own pool
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = this->vk_command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+    VkCommandBuffer vk_command_buffer;
+    VkResult vk_result;
+    if ((vk_result = this->dispatch.vkAllocateCommandBuffers(this->vk_device, &allocate_info, &vk_command_buffer)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not allocate copy command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Begin it; it's only submitted once
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if ((vk_result = this->dispatch.vkBeginCommandBuffer(vk_command_buffer, &begin_info)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not begin copy command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->debug_markup.begin_label(vk_command_buffer, label);
+
+    // Earlier compactions on this queue may still be writing to the ranges we're about to read or overwrite, so wait for their copies first
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    this->dispatch.vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    return vk_command_buffer;
+}
+
+/* Ends a command buffer started with begin_copies(). */
+void GeometryPool::end_copies(VkCommandBuffer vk_command_buffer) {
+    this->debug_markup.end_label(vk_command_buffer);
+    VkResult vk_result;
+    if ((vk_result = this->dispatch.vkEndCommandBuffer(vk_command_buffer)) != VK_SUCCESS) {
+        logger.fatalc(GeometryPool::channel, "Could not end copy command buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+}
+
+/* Frees the command buffers of compactions that are done. Assumes the lock is taken. */
+void GeometryPool::recycle_compactions() {
+    uint32_t n_done = 0;
+    while (n_done < this->compactions.size() && this->compactions[n_done].done.is_complete()) {
+        this->dispatch.vkFreeCommandBuffers(this->vk_device, this->vk_command_pool, 1, &this->compactions[n_done].vk_command_buffer);
+        ++n_done;
+    }
+    if (n_done > 0) { this->compactions.erase(0, n_done - 1); }
+}
+
+
+
+/* Reserves room for a mesh in the pool. */
+GeometryHandle GeometryPool::allocate(uint32_t vertex_count, uint32_t vertex_stride, uint32_t index_count) {
+    VkDeviceSize vertex_size = static_cast<VkDeviceSize>(vertex_count) * vertex_stride;
+    VkDeviceSize index_size = static_cast<VkDeviceSize>(index_count) * sizeof(uint32_t);
+    if (vertex_stride == 0) {
+        logger.fatalc(GeometryPool::channel, "Cannot allocate a mesh with a vertex stride of 0.");
+    }
+    if (vertex_size > GeometryPool::vertex_block_size || index_size > GeometryPool::index_block_size) {
+        logger.fatalc(GeometryPool::channel, "Cannot allocate a mesh of ", vertex_size, " vertex bytes and ", index_size, " index bytes in blocks of ", GeometryPool::vertex_block_size, " and ", GeometryPool::index_block_size, " bytes.");
+    }
+
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Find a block with room for both the vertices and the indices, keeping vertices aligned to their stride so they can be addressed with vertexOffset
+    uint32_t block = 0;
+    VkDeviceSize vertex_offset, index_offset;
+    for (; block < this->blocks.size(); block++) {
+        Block& candidate = this->blocks[block];
+        if (!GeometryPool::take_range(candidate.free_vertices, vertex_size, vertex_stride, vertex_offset)) { continue; }
+        if (!GeometryPool::take_range(candidate.free_indices, index_size, sizeof(uint32_t), index_offset)) {
+            GeometryPool::return_range(candidate.free_vertices, vertex_offset, vertex_size);
+            continue;
+        }
+        break;
+    }
+    if (block == this->blocks.size()) {
+        // None of them has room, so add a new one; its memory is allocated without the lock, since the MemoryBudget may free meshes to make room
+        local_lock.unlock();
+        Block new_block{ nullptr, {}, nullptr, {}, {}, {}, 0 };
+        this->create_block(new_block);
+        local_lock.lock();
+
+        block = this->blocks.size();
+        this->blocks.push_back(std::move(new_block));
+        this->name_block(this->blocks[block], "GeometryPool block " + std::to_string(block));
+        this->_statistics.vertex_capacity += GeometryPool::vertex_block_size;
+        this->_statistics.index_capacity += GeometryPool::index_block_size;
+        GeometryPool::take_range(this->blocks[block].free_vertices, vertex_size, vertex_stride, vertex_offset);
+        GeometryPool::take_range(this->blocks[block].free_indices, index_size, sizeof(uint32_t), index_offset);
+        logger.logc(Verbosity::details, GeometryPool::channel, "Added block ", block, " to the pool.");
+    }
+
+    // Take a mesh slot
+    uint32_t index;
+    if (!this->free_meshes.empty()) {
+        index = this->free_meshes.last();
+        this->free_meshes.pop_back();
+    } else {
+        index = this->meshes.size();
+        this->meshes.push_back(Mesh{ 1, false, {} });
+    }
+    Mesh& mesh = this->meshes[index];
+    mesh.live = true;
+    mesh.range = GeometryRange{ block, vertex_stride, vertex_count, index_count, static_cast<int32_t>(vertex_offset / vertex_stride), static_cast<uint32_t>(index_offset / sizeof(uint32_t)) };
+
+    // Update the statistics
+    ++this->_statistics.n_meshes;
+    if (this->_statistics.n_meshes > this->_statistics.peak_meshes) { this->_statistics.peak_meshes = this->_statistics.n_meshes; }
+    this->_statistics.vertex_used += vertex_size;
+    this->_statistics.index_used += index_size;
+
+    // Done
+    return GeometryHandle{ index, mesh.generation };
+}
+
+/* Removes the mesh with the given handle from the pool. */
+void GeometryPool::free(const GeometryHandle& handle) {
+    uint32_t block, block_generation;
+    VkDeviceSize vertex_offset, vertex_size, index_offset, index_size;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        if (!handle.valid() || handle.index >= this->meshes.size() || this->meshes[handle.index].generation != handle.generation || !this->meshes[handle.index].live) {
+            logger.warningc(GeometryPool::channel, "Cannot free stale or unknown geometry handle ", handle.index, '.');
+            return;
+        }
+
+        // Mark the slot as free and its handle as stale, skipping zero since that's the null handle
+        Mesh& mesh = this->meshes[handle.index];
+        mesh.live = false;
+        if (++mesh.generation == 0) { mesh.generation = 1; }
+        this->free_meshes.push_back(handle.index);
+
+        // Remember where it was
+        block = mesh.range.block;
+        block_generation = this->blocks[block].generation;
+        vertex_offset = mesh.range.vertex_byte_offset();
+        vertex_size = static_cast<VkDeviceSize>(mesh.range.vertex_count) * mesh.range.vertex_stride;
+        index_offset = mesh.range.index_byte_offset();
+        index_size = static_cast<VkDeviceSize>(mesh.range.index_count) * sizeof(uint32_t);
+        --this->_statistics.n_meshes;
+        this->_statistics.vertex_used -= vertex_size;
+        this->_statistics.index_used -= index_size;
+    }
+
+    // Frames in flight may still draw it, so only give its room back once they're done. If the block is compacted in the meantime, the room isn't in the new buffers anyway
+    this->deletion_queue.retire([this, block, block_generation, vertex_offset, vertex_size, index_offset, index_size]() {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        Block& old_block = this->blocks[block];
+        if (old_block.generation != block_generation) { return; }
+        GeometryPool::return_range(old_block.free_vertices, vertex_offset, vertex_size);
+        GeometryPool::return_range(old_block.free_indices, index_offset, index_size);
+    });
+}
+
+/* Returns whether the given handle still refers to a mesh in the pool. */
+bool GeometryPool::is_live(const GeometryHandle& handle) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    return handle.valid() && handle.index < this->meshes.size() && this->meshes[handle.index].generation == handle.generation && this->meshes[handle.index].live;
+}
+
+/* Returns where the mesh with the given handle lives. */
+GeometryRange GeometryPool::range(const GeometryHandle& handle) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (!handle.valid() || handle.index >= this->meshes.size() || this->meshes[handle.index].generation != handle.generation || !this->meshes[handle.index].live) {
+        logger.fatalc(GeometryPool::channel, "Cannot get range of stale or unknown geometry handle ", handle.index, '.');
+    }
+    return this->meshes[handle.index].range;
+}
+
+
+
+/* Moves the meshes of every block whose free space is fragmented more than the given threshold into fresh, tightly packed buffers. */
+SyncPoint GeometryPool::compact(double threshold) {
+    // First pick the blocks to compact
+    Tools::Array<uint32_t> candidates;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->recycle_compactions();
+        for (uint32_t b = 0; b < this->blocks.size(); b++) {
+            double block_fragmentation = std::max(GeometryPool::fragmentation(this->blocks[b].free_vertices), GeometryPool::fragmentation(this->blocks[b].free_indices));
+            if (block_fragmentation > 0.0 && block_fragmentation >= threshold) { candidates.push_back(b); }
+        }
+    }
+    if (candidates.empty()) { return null_sync_point; }
+
+    // Create their new buffers without the lock, since the MemoryBudget may free meshes to make room
+    Tools::Array<Block> new_blocks(candidates.size());
+    for (uint32_t i = 0; i < candidates.size(); i++) {
+        new_blocks.push_back(Block{ nullptr, {}, nullptr, {}, {}, {}, 0 });
+        this->create_block(new_blocks[i]);
+    }
+
+    // The old buffers are only retired once we let go of the lock, since collecting the DeletionQueue takes it too
+    Tools::Array<Block> old_blocks;
+    VkCommandBuffer vk_command_buffer = nullptr;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+
+        for (uint32_t c = 0; c < candidates.size(); c++) {
+            uint32_t b = candidates[c];
+            Block& block = this->blocks[b];
+            double block_fragmentation = std::max(GeometryPool::fragmentation(block.free_vertices), GeometryPool::fragmentation(block.free_indices));
+
+            // Start recording the copies if this is the first block
+            if (vk_command_buffer == nullptr) { vk_command_buffer = this->begin_copies("GeometryPool compaction"); }
+
+            // Swap in the new buffers, keeping the old ones around to copy from
+            old_blocks.push_back(Block{ block.vk_vertex_buffer, block.vertex_memory, block.vk_index_buffer, block.index_memory, {}, {}, block.generation });
+            new_blocks[c].generation = block.generation + 1;
+            block = std::move(new_blocks[c]);
+            this->name_block(block, "GeometryPool block " + std::to_string(b) + " (compacted)");
+
+            // Pack the live meshes of the block at the front of the new buffers
+            Tools::Array<VkBufferCopy> vertex_copies, index_copies;
+            for (uint32_t i = 0; i < this->meshes.size(); i++) {
+                Mesh& mesh = this->meshes[i];
+                if (!mesh.live || mesh.range.block != b) { continue; }
+
+                VkDeviceSize vertex_size = static_cast<VkDeviceSize>(mesh.range.vertex_count) * mesh.range.vertex_stride;
+                VkDeviceSize index_size = static_cast<VkDeviceSize>(mesh.range.index_count) * sizeof(uint32_t);
+                VkDeviceSize vertex_offset, index_offset;
+                GeometryPool::take_range(block.free_vertices, vertex_size, mesh.range.vertex_stride, vertex_offset);
+                GeometryPool::take_range(block.free_indices, index_size, sizeof(uint32_t), index_offset);
+                if (vertex_size > 0) { vertex_copies.push_back(VkBufferCopy{ mesh.range.vertex_byte_offset(), vertex_offset, vertex_size }); }
+                if (index_size > 0) { index_copies.push_back(VkBufferCopy{ mesh.range.index_byte_offset(), index_offset, index_size }); }
+
+                mesh.range.vertex_offset = static_cast<int32_t>(vertex_offset / mesh.range.vertex_stride);
+                mesh.range.first_index = static_cast<uint32_t>(index_offset / sizeof(uint32_t));
+                this->_statistics.bytes_moved += vertex_size + index_size;
+            }
+
+            // Record the copies
+            if (!vertex_copies.empty()) {
+                this->dispatch.vkCmdCopyBuffer(vk_command_buffer, old_blocks.last().vk_vertex_buffer, block.vk_vertex_buffer, vertex_copies.size(), vertex_copies.rdata());
+            }
+            if (!index_copies.empty()) {
+                this->dispatch.vkCmdCopyBuffer(vk_command_buffer, old_blocks.last().vk_index_buffer, block.vk_index_buffer, index_copies.size(), index_copies.rdata());
+            }
+            ++this->_statistics.n_compactions;
+            logger.logc(Verbosity::details, GeometryPool::channel, "Compacted block ", b, " (", static_cast<uint32_t>(block_fragmentation * 100.0), "% fragmented).");
+        }
+
+        ++this->_generation;
+
+        // Finish the copies
+        this->end_copies(vk_command_buffer);
+    }
+
+    // Submit them on the memory queue; users of the new ranges wait for the returned point instead of the whole queue
+    this->submitter.enqueue(vk_command_buffer);
+    SyncPoint done = this->submitter.flush();
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->compactions.push_back(Compaction{ vk_command_buffer, done });
+    }
+
+    // The old buffers may still be read by frames in flight and by the copies, so retire them behind all of that work
+    VkDevice vk_device = this->vk_device;
+    MemoryBudget* memory_budget = &this->memory_budget;
+    for (uint32_t i = 0; i < old_blocks.size(); i++) {
+        Block old_block = old_blocks[i];
+        this->deletion_queue.retire([vk_device, memory_budget, old_block]() {
+            GeometryPool::destroy_block(vk_device, *memory_budget, old_block);
+        });
+    }
+
+    // Done
+    return done;
+}
+
+/* Moves a bounded number of vertex and index ranges into free room closer to the front of their buffers. */
+SyncPoint GeometryPool::defragment(VkDeviceSize max_bytes) {
+    // A vertex or index range that may be moved
+    struct Candidate {
+        /* The mesh the range belongs to. */
+        uint32_t mesh;
+        /* Whether it's the mesh's vertices (true) or indices (false). */
+        bool vertices;
+        /* The current offset of the range. */
+        VkDeviceSize offset;
+        /* The size of the range. */
+        VkDeviceSize size;
+    };
+    // A range that was moved, whose old room is given back once the GPU is done with it
+    struct Relocation {
+        /* The block of the range. */
+        uint32_t block;
+        /* The generation of the block when the range was moved. */
+        uint32_t block_generation;
+        /* Whether the range is in the vertex buffer (true) or the index buffer (false). */
+        bool vertices;
+        /* The old offset of the range. */
+        VkDeviceSize offset;
+        /* The size of the range. */
+        VkDeviceSize size;
+    };
+
+    Tools::Array<Relocation> relocations;
+    VkCommandBuffer vk_command_buffer = nullptr;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->recycle_compactions();
+
+        // Collect the ranges in buffers whose free space is split up, since only those have room in front of them
+        Tools::Array<Candidate> candidates;
+        for (uint32_t i = 0; i < this->meshes.size(); i++) {
+            const Mesh& mesh = this->meshes[i];
+            if (!mesh.live) { continue; }
+            const Block& block = this->blocks[mesh.range.block];
+
+            VkDeviceSize vertex_size = static_cast<VkDeviceSize>(mesh.range.vertex_count) * mesh.range.vertex_stride;
+            VkDeviceSize index_size = static_cast<VkDeviceSize>(mesh.range.index_count) * sizeof(uint32_t);
+            if (vertex_size > 0 && GeometryPool::fragmentation(block.free_vertices) > 0.0) { candidates.push_back(Candidate{ i, true, mesh.range.vertex_byte_offset(), vertex_size }); }
+            if (index_size > 0 && GeometryPool::fragmentation(block.free_indices) > 0.0) { candidates.push_back(Candidate{ i, false, mesh.range.index_byte_offset(), index_size }); }
+        }
+        if (candidates.empty()) { return null_sync_point; }
+
+        // Move the ranges furthest back first, since they leave the holes that matter least once they're gone
+        std::sort(candidates.wdata(), candidates.wdata() + candidates.size(), [](const Candidate& c1, const Candidate& c2) { return c1.offset > c2.offset; });
+        Tools::Array<Tools::Array<VkBufferCopy>> vertex_copies({}, this->blocks.size());
+        Tools::Array<Tools::Array<VkBufferCopy>> index_copies({}, this->blocks.size());
+        VkDeviceSize moved = 0;
+        for (uint32_t c = 0; c < candidates.size() && moved < max_bytes; c++) {
+            const Candidate& candidate = candidates[c];
+            if (candidate.size > max_bytes - moved) { continue; }
+            Mesh& mesh = this->meshes[candidate.mesh];
+            Block& block = this->blocks[mesh.range.block];
+
+            // Take the first range that fits, but only keep it if it's in front of the current one
+            Tools::Array<FreeRange>& free_list = candidate.vertices ? block.free_vertices : block.free_indices;
+            VkDeviceSize alignment = candidate.vertices ? mesh.range.vertex_stride : sizeof(uint32_t);
+            VkDeviceSize offset;
+            if (!GeometryPool::take_range(free_list, candidate.size, alignment, offset)) { continue; }
+            if (offset >= candidate.offset) {
+                GeometryPool::return_range(free_list, offset, candidate.size);
+                continue;
+            }
+
+            // Copy it over and point the mesh at it; the old range stays intact until frames in flight are done with it
+            if (candidate.vertices) {
+                vertex_copies[mesh.range.block].push_back(VkBufferCopy{ candidate.offset, offset, candidate.size });
+                mesh.range.vertex_offset = static_cast<int32_t>(offset / mesh.range.vertex_stride);
+            } else {
+                index_copies[mesh.range.block].push_back(VkBufferCopy{ candidate.offset, offset, candidate.size });
+                mesh.range.first_index = static_cast<uint32_t>(offset / sizeof(uint32_t));
+            }
+            relocations.push_back(Relocation{ mesh.range.block, block.generation, candidate.vertices, candidate.offset, candidate.size });
+            moved += candidate.size;
+        }
+        if (relocations.empty()) { return null_sync_point; }
+
+        // Record the copies; the old and new ranges never overlap, so they can be copied within the same buffer
+        vk_command_buffer = this->begin_copies("GeometryPool defragmentation");
+        for (uint32_t b = 0; b < this->blocks.size(); b++) {
+            if (!vertex_copies[b].empty()) {
+                this->dispatch.vkCmdCopyBuffer(vk_command_buffer, this->blocks[b].vk_vertex_buffer, this->blocks[b].vk_vertex_buffer, vertex_copies[b].size(), vertex_copies[b].rdata());
+            }
+            if (!index_copies[b].empty()) {
+                this->dispatch.vkCmdCopyBuffer(vk_command_buffer, this->blocks[b].vk_index_buffer, this->blocks[b].vk_index_buffer, index_copies[b].size(), index_copies[b].rdata());
+            }
+        }
+        this->end_copies(vk_command_buffer);
+
+        // Update the statistics
+        ++this->_generation;
+        this->_statistics.n_relocations += relocations.size();
+        this->_statistics.bytes_moved += moved;
+        logger.logc(Verbosity::debug, GeometryPool::channel, "Relocated ", relocations.size(), " ranges (", moved, " bytes).");
+    }
+
+    // Submit them on the memory queue; users of the new ranges wait for the returned point instead of the whole queue
+    this->submitter.enqueue(vk_command_buffer);
+    SyncPoint done = this->submitter.flush();
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->compactions.push_back(Compaction{ vk_command_buffer, done });
+    }
+
+    // The old ranges may still be read by frames in flight and by the copies, so only give them back behind all of that work. If their block is compacted in the meantime, the room isn't in the new buffers anyway
+    this->deletion_queue.retire([this, relocations]() {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        for (uint32_t i = 0; i < relocations.size(); i++) {
+            const Relocation& relocation = relocations[i];
+            Block& block = this->blocks[relocation.block];
+            if (block.generation != relocation.block_generation) { continue; }
+            GeometryPool::return_range(relocation.vertices ? block.free_vertices : block.free_indices, relocation.offset, relocation.size);
+        }
+    });
+
+    // Done
+    return done;
+}
+
+
+
+/* Binds the vertex and index buffer of the given block to the given command buffer. */
+void GeometryPool::bind(VkCommandBuffer vk_command_buffer, uint32_t block, uint32_t binding) const {
+    VkDeviceSize offset = 0;
+    this->dispatch.vkCmdBindVertexBuffers(vk_command_buffer, binding, 1, &this->blocks[block].vk_vertex_buffer, &offset);
+    this->dispatch.vkCmdBindIndexBuffer(vk_command_buffer, this->blocks[block].vk_index_buffer, 0, GeometryPool::index_type);
+}
+
+
+
+/* Returns the fraction of the given block's free space that can't be used for a single allocation. */
+double GeometryPool::fragmentation(uint32_t block) const {
+    return std::max(GeometryPool::fragmentation(this->blocks[block].free_vertices), GeometryPool::fragmentation(this->blocks[block].free_indices));
+}
+
+/* Returns the fraction of the pool's free space that can't be used for a single allocation in its block. */
+double GeometryPool::fragmentation() const {
+    // Per buffer, everything but the largest free range is lost to fragmentation
+    VkDeviceSize total = 0, lost = 0;
+    for (uint32_t b = 0; b < this->blocks.size(); b++) {
+        const Tools::Array<FreeRange>* free_lists[] = { &this->blocks[b].free_vertices, &this->blocks[b].free_indices };
+        for (uint32_t l = 0; l < 2; l++) {
+            VkDeviceSize available = 0, largest = 0;
+            for (uint32_t i = 0; i < free_lists[l]->size(); i++) {
+                available += (*free_lists[l])[i].size;
+                if ((*free_lists[l])[i].size > largest) { largest = (*free_lists[l])[i].size; }
+            }
+            total += available;
+            lost += available - largest;
+        }
+    }
+    return total > 0 ? static_cast<double>(lost) / total : 0.0;
+}
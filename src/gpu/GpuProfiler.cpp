@@ -0,0 +1,292 @@
+/* GPU PROFILER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 20:44:21
+ * Last edited:
+ *   18/10/2021, 20:44:21
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the GpuProfiler class, which measures labeled scopes of
+ *   command buffers on the graphics and compute queues with timestamp
+ *   and pipeline statistics queries. The results of a frame are read
+ *   back once that frame's slot comes around again, so profiling never
+ *   stalls the GPU.
+**/
+
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/GpuProfiler.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* The queue type of each profiled slot. */
+static constexpr const Vulkanic::QueueType profiled_types[] = { Vulkanic::QueueType::graphics, Vulkanic::QueueType::compute };
+/* The pipeline statistics that only graphics-capable queue families may count. */
+static constexpr const VkQueryPipelineStatisticFlags graphics_statistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkQueryPoolCreateInfo struct.
+ * @param pool_info The VkQueryPoolCreateInfo struct to populate.
+ * @param query_type The type of the queries in the pool.
+ * @param query_count The number of queries in the pool.
+ * @param statistics The pipeline statistics the queries count, if they are pipeline statistics queries. */
+static void populate_pool_info(VkQueryPoolCreateInfo& pool_info, VkQueryType query_type, uint32_t query_count, VkQueryPipelineStatisticFlags statistics) {
+    // Set to default
+    pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+
+    // Set the queries
+    pool_info.queryType = query_type;
+    pool_info.queryCount = query_count;
+    pool_info.pipelineStatistics = statistics;
+}
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Writes the given string as a JSON string to the given stream. */
+static void write_json_string(std::ostream& os, const std::string& str) {
+    os << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') { os << '\\' << c; }
+        else if (c == '\n') { os << "\\n"; }
+        else { os << c; }
+    }
+    os << '"';
+}
+
+
+
+
+
+/***** GPUPROFILER CLASS *****/
+/* Constructor for the GpuProfiler class. */
+GpuProfiler::GpuProfiler(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, const Tools::StackArray<uint32_t, Vulkanic::n_queue_types>& queue_families, uint32_t n_frames, bool pipeline_statistics, uint32_t max_scopes) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    timestamp_period(physical_device.properties().limits.timestampPeriod),
+    _max_scopes(max_scopes),
+    _n_frames(n_frames),
+    _current_frame(0),
+
+    pools(n_frames * GpuProfiler::n_profiled_types),
+
+    _tracing(false)
+{
+    // Find out what each queue type's family can measure
+    for (uint32_t i = 0; i < GpuProfiler::n_profiled_types; i++) {
+        const VkQueueFamilyProperties& family = physical_device.queue_families()[queue_families[(uint32_t) profiled_types[i]]];
+        TypeInfo& info = this->types[i];
+        info.enabled = family.timestampValidBits > 0;
+        info.timestamp_mask = family.timestampValidBits >= 64 ? std::numeric_limits<uint64_t>::max() : (1ULL << family.timestampValidBits) - 1;
+        info.statistics = 0;
+        if (pipeline_statistics) {
+            info.statistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+            if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) { info.statistics |= graphics_statistics; }
+        }
+        if (!info.enabled) {
+            logger.warningc(GpuProfiler::channel, "Queue family ", queue_families[(uint32_t) profiled_types[i]], " of the ", Vulkanic::queue_type_names[(int) profiled_types[i]], " queue doesn't support timestamps; it won't be profiled.");
+        }
+    }
+
+    // Create the pools of each frame
+    for (uint32_t f = 0; f < n_frames; f++) {
+        for (uint32_t i = 0; i < GpuProfiler::n_profiled_types; i++) {
+            QueryPools* frame_pools = new QueryPools();
+            frame_pools->vk_timestamps = nullptr;
+            frame_pools->vk_statistics = nullptr;
+            frame_pools->n_scopes = 0;
+            frame_pools->names.resize(max_scopes);
+            this->pools.push_back(frame_pools);
+            if (!this->types[i].enabled) { continue; }
+
+            VkQueryPoolCreateInfo pool_info;
+            populate_pool_info(pool_info, VK_QUERY_TYPE_TIMESTAMP, 2 * max_scopes, 0);
+            VkResult vk_result;
+            if ((vk_result = vkCreateQueryPool(this->vk_device, &pool_info, nullptr, &frame_pools->vk_timestamps)) != VK_SUCCESS) {
+                logger.fatalc(GpuProfiler::channel, "Could not create timestamp query pool: ", Vulkanic::vk_error_map.at(vk_result));
+            }
+            if (this->types[i].statistics != 0) {
+                populate_pool_info(pool_info, VK_QUERY_TYPE_PIPELINE_STATISTICS, max_scopes, this->types[i].statistics);
+                if ((vk_result = vkCreateQueryPool(this->vk_device, &pool_info, nullptr, &frame_pools->vk_statistics)) != VK_SUCCESS) {
+                    logger.fatalc(GpuProfiler::channel, "Could not create pipeline statistics query pool: ", Vulkanic::vk_error_map.at(vk_result));
+                }
+            }
+        }
+    }
+
+    // Done
+    logger.logc(Verbosity::details, GpuProfiler::channel, "Initialized with ", max_scopes, " scopes per queue per frame", pipeline_statistics ? " and pipeline statistics" : "", ".");
+}
+
+/* Destructor for the GpuProfiler class. */
+GpuProfiler::~GpuProfiler() {
+    for (uint32_t i = 0; i < this->pools.size(); i++) {
+        if (this->pools[i]->vk_statistics != nullptr) {
+            vkDestroyQueryPool(this->vk_device, this->pools[i]->vk_statistics, nullptr);
+        }
+        if (this->pools[i]->vk_timestamps != nullptr) {
+            vkDestroyQueryPool(this->vk_device, this->pools[i]->vk_timestamps, nullptr);
+        }
+        delete this->pools[i];
+    }
+}
+
+
+
+/* Returns the index of the given queue type among the profiled types. */
+uint32_t GpuProfiler::get_slot(Vulkanic::QueueType queue_type) {
+    for (uint32_t i = 0; i < GpuProfiler::n_profiled_types; i++) {
+        if (profiled_types[i] == queue_type) { return i; }
+    }
+    return GpuProfiler::n_profiled_types;
+}
+
+/* Reads back the scopes of the given pools into the results, and empties them. */
+void GpuProfiler::read_back(QueryPools& pools, uint32_t slot) {
+    uint32_t n_scopes = std::min(pools.n_scopes.load(), this->_max_scopes);
+    pools.n_scopes = 0;
+    if (n_scopes == 0) { return; }
+    const TypeInfo& info = this->types[slot];
+
+    // Fetch the timestamps, each with its availability. Never wait; the frame should be done by now, and scopes that weren't submitted are skipped
+    Tools::Array<uint64_t> timestamps(4 * n_scopes);
+    VkResult vk_result = this->dispatch.vkGetQueryPoolResults(this->vk_device, pools.vk_timestamps, 0, 2 * n_scopes, 4 * n_scopes * sizeof(uint64_t), timestamps.wdata(4 * n_scopes), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (vk_result != VK_SUCCESS && vk_result != VK_NOT_READY) {
+        logger.fatalc(GpuProfiler::channel, "Could not read back timestamps: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Fetch the statistics in the same way
+    uint32_t n_statistics = 0;
+    for (uint32_t i = 0; i < n_pipeline_statistics; i++) {
+        if (info.statistics & pipeline_statistics[i]) { ++n_statistics; }
+    }
+    Tools::Array<uint64_t> statistics;
+    if (pools.vk_statistics != nullptr) {
+        uint32_t stride = n_statistics + 1;
+        statistics.reserve(stride * n_scopes);
+        vk_result = this->dispatch.vkGetQueryPoolResults(this->vk_device, pools.vk_statistics, 0, n_scopes, stride * n_scopes * sizeof(uint64_t), statistics.wdata(stride * n_scopes), stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (vk_result != VK_SUCCESS && vk_result != VK_NOT_READY) {
+            logger.fatalc(GpuProfiler::channel, "Could not read back pipeline statistics: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+
+    // Turn them into scopes
+    for (uint32_t i = 0; i < n_scopes; i++) {
+        if (timestamps[4 * i + 1] == 0 || timestamps[4 * i + 3] == 0) { continue; }
+
+        GpuScope scope = {};
+        scope.name = pools.names[i];
+        scope.queue_type = profiled_types[slot];
+        scope.begin = (timestamps[4 * i] & info.timestamp_mask) * this->timestamp_period;
+        scope.end = (timestamps[4 * i + 2] & info.timestamp_mask) * this->timestamp_period;
+
+        // The statistics come in bit order, so spread them over the ones this queue counts
+        if (pools.vk_statistics != nullptr && statistics[i * (n_statistics + 1) + n_statistics] != 0) {
+            scope.has_statistics = true;
+            uint32_t s = 0;
+            for (uint32_t j = 0; j < n_pipeline_statistics; j++) {
+                if (info.statistics & pipeline_statistics[j]) { scope.statistics[j] = statistics[i * (n_statistics + 1) + s++]; }
+            }
+        }
+
+        this->_results.push_back(scope);
+        if (this->_tracing) { this->trace.push_back(scope); }
+    }
+}
+
+
+
+/* Begins measuring a scope on the given command buffer. */
+gpu_scope_t GpuProfiler::begin_scope(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, const std::string& name) {
+    uint32_t slot = get_slot(queue_type);
+    if (slot >= GpuProfiler::n_profiled_types || !this->types[slot].enabled) { return null_gpu_scope; }
+
+    // Claim a scope in this frame's pools
+    QueryPools& pools = *this->pools[this->_current_frame * GpuProfiler::n_profiled_types + slot];
+    uint32_t scope = pools.n_scopes.fetch_add(1);
+    if (scope >= this->_max_scopes) { return null_gpu_scope; }
+    pools.names[scope] = name;
+
+    // Reset only our own queries, so the order in which command buffers are submitted doesn't matter
+    this->dispatch.vkCmdResetQueryPool(vk_command_buffer, pools.vk_timestamps, 2 * scope, 2);
+    if (pools.vk_statistics != nullptr) { this->dispatch.vkCmdResetQueryPool(vk_command_buffer, pools.vk_statistics, scope, 1); }
+
+    // Start measuring
+    this->dispatch.vkCmdWriteTimestamp(vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pools.vk_timestamps, 2 * scope);
+    if (pools.vk_statistics != nullptr) { this->dispatch.vkCmdBeginQuery(vk_command_buffer, pools.vk_statistics, scope, 0); }
+    return scope;
+}
+
+/* Ends measuring a scope on the given command buffer. */
+void GpuProfiler::end_scope(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, gpu_scope_t scope) {
+    if (scope == null_gpu_scope) { return; }
+    QueryPools& pools = *this->pools[this->_current_frame * GpuProfiler::n_profiled_types + get_slot(queue_type)];
+
+    if (pools.vk_statistics != nullptr) { this->dispatch.vkCmdEndQuery(vk_command_buffer, pools.vk_statistics, scope); }
+    this->dispatch.vkCmdWriteTimestamp(vk_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pools.vk_timestamps, 2 * scope + 1);
+}
+
+/* Moves to the given frame, reading back the scopes that were measured the last time it was recorded. */
+void GpuProfiler::begin_frame(uint32_t frame) {
+    #ifndef NDEBUG
+    if (frame >= this->_n_frames) { logger.fatalc(GpuProfiler::channel, "Frame index ", frame, " is out of bounds for profiler with ", this->_n_frames, " frames."); }
+    #endif
+    this->_current_frame = frame;
+
+    // The frame is done on the GPU, so its queries are ready
+    this->_results.clear();
+    for (uint32_t i = 0; i < GpuProfiler::n_profiled_types; i++) {
+        if (!this->types[i].enabled) { continue; }
+        this->read_back(*this->pools[frame * GpuProfiler::n_profiled_types + i], i);
+    }
+}
+
+
+
+/* Writes the scopes collected since the last call as a trace in the Chrome trace event format. */
+void GpuProfiler::write_trace(std::ostream& os) {
+    // Start the trace at the earliest scope, since the device clock has an arbitrary origin
+    double origin = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < this->trace.size(); i++) {
+        origin = std::min(origin, this->trace[i].begin);
+    }
+
+    // Write each scope as a complete event, in microseconds
+    os << "{\"traceEvents\":[";
+    for (uint32_t i = 0; i < this->trace.size(); i++) {
+        const GpuScope& scope = this->trace[i];
+        if (i > 0) { os << ','; }
+        os << "{\"name\":";
+        write_json_string(os, scope.name);
+        os << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":\"GPU\",\"tid\":\"" << Vulkanic::queue_type_names[(int) scope.queue_type] << "\",\"ts\":" << (scope.begin - origin) / 1000.0 << ",\"dur\":" << scope.duration() / 1000.0;
+        if (scope.has_statistics) {
+            os << ",\"args\":{";
+            for (uint32_t j = 0; j < n_pipeline_statistics; j++) {
+                if (j > 0) { os << ','; }
+                os << '"' << pipeline_statistic_names[j] << "\":" << scope.statistics[j];
+            }
+            os << '}';
+        }
+        os << '}';
+    }
+    os << "],\"displayTimeUnit\":\"ns\"}";
+
+    // Forget them
+    this->trace.clear();
+}
@@ -0,0 +1,254 @@
+/* MEMORY BUDGET.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   19/10/2021, 20:12:53
+ * Last edited:
+ *   19/10/2021, 20:12:53
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the MemoryBudget class, which keeps track of how much of each
+ *   memory heap of a Device is in use and how much it may use. It reports
+ *   when usage crosses thresholds, and asks registered evictors to give
+ *   memory back before an allocation would run out of device memory.
+**/
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/MemoryBudget.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** MEMORYBUDGET CLASS *****/
+/* Constructor for the MemoryBudget class. */
+MemoryBudget::MemoryBudget(VkDevice vk_device, const DeviceDispatch& dispatch, const PhysicalDevice& physical_device, PFN_vkGetPhysicalDeviceMemoryProperties2 get_memory_properties2, DeletionQueue& deletion_queue) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    vk_physical_device(physical_device.vk()),
+    vk_get_memory_properties2(get_memory_properties2),
+    deletion_queue(deletion_queue),
+    memory_properties(physical_device.memory_properties()),
+
+    next_id(0),
+    _statistics({ 0, 0, 0, 0, 0 })
+{
+    // Prepare the heaps with the fallback budget, which update() refines if the device can report its own
+    for (uint32_t i = 0; i < this->memory_properties.memoryHeapCount; i++) {
+        const VkMemoryHeap& heap = this->memory_properties.memoryHeaps[i];
+        this->heaps.push_back(HeapBudget{ heap.size, static_cast<VkDeviceSize>(heap.size * MemoryBudget::fallback_budget), 0, 0, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 });
+    }
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++) {
+        this->tracked[i].store(0);
+        this->tracked_at_update[i] = 0;
+    }
+    this->update();
+
+    // Done
+    logger.logc(Verbosity::details, MemoryBudget::channel, "Initialized for ", this->heaps.size(), " heaps, with budgets ", this->from_device() ? "reported by the device" : "estimated from the heap sizes", '.');
+}
+
+/* Destructor for the MemoryBudget class. */
+MemoryBudget::~MemoryBudget() {
+    // Report the statistics
+    if (logger.get_verbosity() >= Verbosity::details) {
+        for (uint32_t i = 0; i < this->heaps.size(); i++) {
+            if (this->heaps[i].high_water == 0) { continue; }
+            logger.logc(Verbosity::details, MemoryBudget::channel, "Heap ", i, " used at most ", this->heaps[i].high_water, " of ", this->heaps[i].budget, " budgeted bytes.");
+        }
+        if (this->_statistics.n_evictions > 0 || this->_statistics.n_failures > 0) {
+            logger.logc(Verbosity::details, MemoryBudget::channel, "Evicted ", this->_statistics.bytes_evicted, " bytes over ", this->_statistics.n_evictions, " evictions, and ran out of memory ", this->_statistics.n_failures, " times.");
+        }
+    }
+}
+
+
+
+/* Returns the estimated usage of the given heap. Assumes the lock is taken. */
+VkDeviceSize MemoryBudget::estimate(uint32_t heap) const {
+    // Allocations may have been freed since, so the difference can be negative
+    VkDeviceSize tracked = this->tracked[heap].load();
+    if (tracked >= this->tracked_at_update[heap]) {
+        return this->heaps[heap].usage + (tracked - this->tracked_at_update[heap]);
+    }
+    VkDeviceSize released = this->tracked_at_update[heap] - tracked;
+    return released < this->heaps[heap].usage ? this->heaps[heap].usage - released : 0;
+}
+
+/* Asks the evictors to give back the given number of bytes from the given heap. Assumes the lock is taken. */
+VkDeviceSize MemoryBudget::evict(uint32_t heap, VkDeviceSize bytes) {
+    VkDeviceSize released = 0;
+    for (uint32_t i = 0; i < this->evictors.size() && released < bytes; i++) {
+        released += this->evictors[i].evict(heap, bytes - released);
+    }
+    ++this->_statistics.n_evictions;
+    this->_statistics.bytes_evicted += released;
+    logger.logc(Verbosity::details, MemoryBudget::channel, "Evicted ", released, " of ", bytes, " requested bytes from heap ", heap, '.');
+    return released;
+}
+
+
+
+/* Refreshes the usage and budget of each heap, and calls the callbacks of the thresholds that were crossed. */
+void MemoryBudget::update() {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Get the new usage, either from the device or from what we allocated ourselves
+    if (this->vk_get_memory_properties2 != nullptr) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+        budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memory_properties2 = {};
+        memory_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memory_properties2.pNext = &budget_properties;
+        this->vk_get_memory_properties2(this->vk_physical_device, &memory_properties2);
+
+        for (uint32_t i = 0; i < this->heaps.size(); i++) {
+            this->heaps[i].budget = budget_properties.heapBudget[i];
+            this->heaps[i].usage = budget_properties.heapUsage[i];
+            this->tracked_at_update[i] = this->tracked[i].load();
+        }
+    } else {
+        for (uint32_t i = 0; i < this->heaps.size(); i++) {
+            this->heaps[i].usage = this->tracked[i].load();
+            this->tracked_at_update[i] = this->heaps[i].usage;
+        }
+    }
+    ++this->_statistics.n_updates;
+
+    // Update the high-water marks and see which thresholds were crossed
+    for (uint32_t i = 0; i < this->heaps.size(); i++) {
+        HeapBudget& heap = this->heaps[i];
+        if (heap.usage > heap.high_water) { heap.high_water = heap.usage; }
+
+        double pressure = heap.pressure();
+        for (uint32_t j = 0; j < this->thresholds.size(); j++) {
+            Threshold& threshold = this->thresholds[j];
+            bool above = pressure >= threshold.fraction;
+            if (above == threshold.above[i]) { continue; }
+
+            threshold.above[i] = above;
+            if (above) { ++this->_statistics.n_crossings; }
+            threshold.callback(i, heap, threshold.fraction, above);
+        }
+    }
+}
+
+
+
+/* Registers a function that is called from update() when the usage of any heap crosses the given fraction of its budget. */
+MemoryBudget::callback_id_t MemoryBudget::add_threshold(double fraction, threshold_callback_t&& callback) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Keep them sorted, so lower thresholds are reported first
+    uint32_t i = 0;
+    while (i < this->thresholds.size() && this->thresholds[i].fraction <= fraction) { ++i; }
+    callback_id_t id = this->next_id++;
+    this->thresholds.insert(i, Threshold{ id, fraction, std::move(callback), Tools::Array<bool>(false, this->heaps.size()) });
+    return id;
+}
+
+/* Removes the threshold with the given identifier. */
+void MemoryBudget::remove_threshold(callback_id_t id) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    for (uint32_t i = 0; i < this->thresholds.size(); i++) {
+        if (this->thresholds[i].id == id) {
+            this->thresholds.erase(i);
+            return;
+        }
+    }
+    logger.warningc(MemoryBudget::channel, "Cannot remove unknown threshold ", id, '.');
+}
+
+/* Registers a function that is asked to give memory back when a heap runs over its budget. */
+MemoryBudget::callback_id_t MemoryBudget::add_evictor(evictor_t&& evictor) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    callback_id_t id = this->next_id++;
+    this->evictors.push_back(Evictor{ id, std::move(evictor) });
+    return id;
+}
+
+/* Removes the evictor with the given identifier. */
+void MemoryBudget::remove_evictor(callback_id_t id) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    for (uint32_t i = 0; i < this->evictors.size(); i++) {
+        if (this->evictors[i].id == id) {
+            this->evictors.erase(i);
+            return;
+        }
+    }
+    logger.warningc(MemoryBudget::channel, "Cannot remove unknown evictor ", id, '.');
+}
+
+
+
+/* Makes sure the given number of bytes fits in the budget of the heap of the given memory type, evicting if it doesn't. */
+bool MemoryBudget::reserve(uint32_t memory_type, VkDeviceSize size) {
+    uint32_t heap = this->heap_of(memory_type);
+    bool fits;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+
+        // Nothing to do if it fits already
+        VkDeviceSize usage = this->estimate(heap);
+        VkDeviceSize budget = this->heaps[heap].budget;
+        if (usage + size <= budget) { return true; }
+
+        // Otherwise, ask for what doesn't fit
+        VkDeviceSize needed = usage + size - budget;
+        fits = this->evict(heap, needed) >= needed;
+    }
+
+    // Give back whatever was retired and is already done with
+    this->deletion_queue.collect();
+    return fits;
+}
+
+/* Allocates memory through the budget, evicting first if it doesn't fit. */
+VkResult MemoryBudget::allocate(const VkMemoryAllocateInfo& allocate_info, VkDeviceMemory& vk_memory) {
+    uint32_t heap = this->heap_of(allocate_info.memoryTypeIndex);
+
+    // Make room in the budget first
+    if (!this->reserve(allocate_info.memoryTypeIndex, allocate_info.allocationSize)) {
+        logger.warningc(MemoryBudget::channel, "Allocating ", allocate_info.allocationSize, " bytes over the budget of heap ", heap, '.');
+    }
+
+    // Try to allocate; if the device disagrees with the budget, evict once more and retry
+    VkResult vk_result = this->dispatch.vkAllocateMemory(this->vk_device, &allocate_info, nullptr, &vk_memory);
+    if (vk_result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+        {
+            std::unique_lock<std::mutex> local_lock(this->lock);
+            this->evict(heap, allocate_info.allocationSize);
+        }
+        this->deletion_queue.collect();
+        vk_result = this->dispatch.vkAllocateMemory(this->vk_device, &allocate_info, nullptr, &vk_memory);
+    }
+    if (vk_result != VK_SUCCESS) {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        ++this->_statistics.n_failures;
+        return vk_result;
+    }
+
+    // Count it
+    this->tracked[heap] += allocate_info.allocationSize;
+    return VK_SUCCESS;
+}
+
+/* Frees memory that was allocated with allocate(). */
+void MemoryBudget::free(VkDeviceMemory vk_memory, uint32_t memory_type, VkDeviceSize size) {
+    this->dispatch.vkFreeMemory(this->vk_device, vk_memory, nullptr);
+    this->tracked[this->heap_of(memory_type)] -= size;
+}
+
+
+
+/* Returns the budget of the given heap, with its usage estimated from the last update() and the allocations made through this class since. */
+HeapBudget MemoryBudget::heap(uint32_t heap) const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    HeapBudget result = this->heaps[heap];
+    result.usage = this->estimate(heap);
+    return result;
+}
@@ -13,8 +13,12 @@
  *   supported GPU that is registered in the Vulkan instance.
 **/
 
+#include <cstring>
+#include <algorithm>
+
 #include "tools/Logger.hpp"
 
+#include "gpu/FeatureChain.hpp"
 #include "gpu/PhysicalDevice.hpp"
 
 using namespace std;
@@ -22,91 +26,87 @@ using namespace Makma3D;
 
 
 /***** HELPER FUNCTIONS *****/
-/* Returns whether or not the given physical device supports the required list of device extensions.
- * @param vk_physical_device The VkPhysicalDevice which we want to check.
- * @param vk_device_extensions The list of Vulkan device extensions which the device should support at the least.
- * @returns Whether or not the given device supports the extensions (true) or not (false). */
-static bool gpu_supports_extensions(const VkPhysicalDevice& vk_physical_device, const Tools::Array<const char*>& vk_device_extensions) {
-    VkResult vk_result;
-
-    // Get the physical device properties for debugging
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(vk_physical_device, &properties);
-
-    // Get a list of all extensions supported on this device
-    uint32_t n_supported_extensions = 0;
-    if ((vk_result = vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &n_supported_extensions, nullptr)) != VK_SUCCESS) {
-        logger.warningc(PhysicalDevice::channel, "Could not get the number of supported extensions on physical device '", properties.deviceName, "'; assuming nothing supported.");
-        return vk_device_extensions.empty();
-    }
-    Tools::Array<VkExtensionProperties> supported_extensions(n_supported_extensions);
-    if ((vk_result = vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &n_supported_extensions, supported_extensions.wdata(n_supported_extensions))) != VK_SUCCESS) {
-        logger.warningc(PhysicalDevice::channel, "Could not get the supported extensions on physical device '", properties.deviceName, "'; assuming nothing supported.");
-        return vk_device_extensions.empty();
-    }
-
-    // Now simply make sure that all extensions in the list appear in the retrieved list
-    for (uint32_t i = 0; i < vk_device_extensions.size(); i++) {
-        const char* extension = vk_device_extensions[i];
-
-        // Try to find it in the list of supported extensions
-        bool found = false;
-        for (uint32_t j = 0; j < supported_extensions.size(); j++) {
-            if (strcmp(extension, supported_extensions[j].extensionName) == 0) {
-                // Dope, continue
-                found = true;
-                break;
-            }
+/* Queries which Makma3D DeviceFeatures the given physical device supports, using a single vkGetPhysicalDeviceFeatures2() call.
+ * @param vk_physical_device The physical device to query.
+ * @param info The info struct to store the supported features in. Its version, features and extensions should be queried already.
+ * @param get_features2 The vkGetPhysicalDeviceFeatures2 function, or nullptr to only look at the Vulkan 1.0 features. */
+static void query_features(VkPhysicalDevice vk_physical_device, PhysicalDeviceInfo* info, PFN_vkGetPhysicalDeviceFeatures2 get_features2) {
+    // Only query what the device can tell us about
+    Tools::Array<Vulkanic::DeviceFeature> available;
+    for (uint32_t i = 1; i < Vulkanic::n_device_features; i++) {
+        if (FeatureChain::is_available((Vulkanic::DeviceFeature) i, info->api_version, info->extensions)) {
+            available.push_back((Vulkanic::DeviceFeature) i);
         }
-        if (!found) { return false; }
     }
 
-    // However, if all extensions passed the test, we're done
-    return true;
-}
-
-/* Returns whether or not the given physical device supports the required list of device features.
- * @param vk_physical_device The VkPhysicalDevice which we want to check.
- * @param vk_device_features List of Vulkan features that we'd like to have supported.
- * @returns Whether or not the device supports the given features (true) or not (false). */
-static bool gpu_supports_features(const VkPhysicalDevice& vk_physical_device, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) {
-    // Get the device features
-    VkPhysicalDeviceFeatures supported_features;
-    vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_features);
-
-    // Now loop through the features to find if they are supported
-    for (uint32_t i = 0; i < vk_device_features.size(); i++) {
-        switch(vk_device_features[i]) {
-        case Vulkanic::DeviceFeature::anisotropy:
-            if (!supported_features.samplerAnisotropy) { return false; }
-            break;
-        
-        default:
-            logger.warningc(PhysicalDevice::channel, "Encountered unsupported device feature '", Vulkanic::device_feature_names[(int) vk_device_features[i]], "'.");
+    // Query them all at once
+    FeatureChain chain;
+    if (get_features2 != nullptr) {
+        chain.link(available);
+        get_features2(vk_physical_device, &chain.head());
+    } else {
+        chain.head().features = info->features;
+    }
 
+    // Keep those that are actually supported
+    for (uint32_t i = 0; i < available.size(); i++) {
+        if ((!FeatureChain::needs_features2(available[i]) || get_features2 != nullptr) && chain.supports(available[i])) {
+            info->supported_features.push_back(available[i]);
         }
     }
-
-    // If we made it through, everything's supported
-    return true;
 }
 
+/* Queries everything we'd like to know about the given physical device.
+ * @param vk_physical_device The physical device to query.
+ * @param instance_version The Vulkan version of the instance.
+ * @param get_features2 The vkGetPhysicalDeviceFeatures2 function, or nullptr if it's unavailable.
+ * @returns A new PhysicalDeviceInfo struct with the results. */
+static PhysicalDeviceInfo* query_info(VkPhysicalDevice vk_physical_device, uint32_t instance_version, PFN_vkGetPhysicalDeviceFeatures2 get_features2) {
+    PhysicalDeviceInfo* info = new PhysicalDeviceInfo();
+
+    // Get the properties, features and memory properties
+    vkGetPhysicalDeviceProperties(vk_physical_device, &info->properties);
+    vkGetPhysicalDeviceFeatures(vk_physical_device, &info->features);
+    vkGetPhysicalDeviceMemoryProperties(vk_physical_device, &info->memory_properties);
+    // We cannot use anything newer than both the instance and the device know
+    info->api_version = std::min(instance_version, info->properties.apiVersion);
+
+    // Get the queue families
+    uint32_t n_families;
+    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &n_families, nullptr);
+    info->queue_families.reserve(n_families);
+    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &n_families, info->queue_families.wdata(n_families));
 
+    // Get the supported extensions
+    VkResult vk_result;
+    uint32_t n_extensions = 0;
+    if ((vk_result = vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &n_extensions, nullptr)) != VK_SUCCESS) {
+        logger.warningc(PhysicalDevice::channel, "Could not get the number of supported extensions on physical device '", info->properties.deviceName, "'; assuming nothing supported.");
+        query_features(vk_physical_device, info, get_features2);
+        return info;
+    }
+    info->extensions.reserve(n_extensions);
+    if ((vk_result = vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &n_extensions, info->extensions.wdata(n_extensions))) != VK_SUCCESS) {
+        logger.warningc(PhysicalDevice::channel, "Could not get the supported extensions on physical device '", info->properties.deviceName, "'; assuming nothing supported.");
+        info->extensions.clear();
+    }
 
+    // With the version and extensions known, see which features we can use
+    query_features(vk_physical_device, info, get_features2);
 
+    // Done
+    return info;
+}
 
 /***** PHYSICALDEVICE CLASS *****/
 /* Constructor for the PhysicalDevice class. */
-PhysicalDevice::PhysicalDevice(VkPhysicalDevice vk_physical_device, uint32_t index) :
+PhysicalDevice::PhysicalDevice(VkPhysicalDevice vk_physical_device, uint32_t index, uint32_t instance_version, PFN_vkGetPhysicalDeviceFeatures2 get_features2) :
     vk_physical_device(vk_physical_device),
+    _info(query_info(vk_physical_device, instance_version, get_features2)),
     _index(index)
 {
-    // Query the device for its properties
-    this->vk_physical_device_properties = new VkPhysicalDeviceProperties{};
-    vkGetPhysicalDeviceProperties(this->vk_physical_device, this->vk_physical_device_properties);
-
     // Select the proper type
-    switch(this->vk_physical_device_properties->deviceType) {
+    switch(this->_info->properties.deviceType) {
         case VK_PHYSICAL_DEVICE_TYPE_CPU:
             this->_type = PhysicalDeviceType::cpu;
             break;
@@ -136,47 +136,35 @@ PhysicalDevice::PhysicalDevice(VkPhysicalDevice vk_physical_device, uint32_t ind
 /* Copy constructor for the PhysicalDevice class. */
 PhysicalDevice::PhysicalDevice(const PhysicalDevice& other) :
     vk_physical_device(other.vk_physical_device),
+    _info(other._info),
     _index(other._index),
     _type(other._type)
-{
-    // Also copy the properties struct
-    this->vk_physical_device_properties = new VkPhysicalDeviceProperties(*other.vk_physical_device_properties);
-}
+{}
 
 /* Move constructor for the PhysicalDevice class. */
 PhysicalDevice::PhysicalDevice(PhysicalDevice&& other) :
     vk_physical_device(other.vk_physical_device),
-    vk_physical_device_properties(other.vk_physical_device_properties),
+    _info(std::move(other._info)),
     _index(other._index),
     _type(other._type)
-{
-    other.vk_physical_device_properties = nullptr;
-}
+{}
 
 /* Destructor for the PhysicalDevice class. */
-PhysicalDevice::~PhysicalDevice() {
-    if (this->vk_physical_device_properties != nullptr) {
-        delete this->vk_physical_device_properties;
-    }
-}
+PhysicalDevice::~PhysicalDevice() {}
 
 
 
-/* Static function that determines if the given physical device is supported. */
-bool PhysicalDevice::is_suitable(VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) {
+/* Determines if this physical device is supported, using the cached information wherever possible. */
+bool PhysicalDevice::is_suitable(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const {
     // First, check if the device supports all desired queues
-    // Get a list of all queue families
-    uint32_t n_families;
-    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &n_families, nullptr);
-    Tools::Array<VkQueueFamilyProperties> families(n_families);
-    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &n_families, families.wdata(n_families));
-
-    // Convert each of those to a QueueFamilyInfo struct
+    const Tools::Array<VkQueueFamilyProperties>& families = this->_info->queue_families;
     bool operations_supported[] = { false, false, false, false };
-    for (uint32_t i = 0; i < n_families; i++) {
-        // Check whether this queue can present
-        VkBool32 can_present;
-        vkGetPhysicalDeviceSurfaceSupportKHR(vk_physical_device, i, vk_surface, &can_present);
+    for (uint32_t i = 0; i < families.size(); i++) {
+        // Check whether this queue can present, unless we render headless. This is the only thing that depends on the surface, so it cannot be cached
+        VkBool32 can_present = VK_FALSE;
+        if (vk_surface != nullptr) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(this->vk_physical_device, i, vk_surface, &can_present);
+        }
 
         // Compute the flags for this queue type
         operations_supported[0] |= !!(families[i].queueFlags & VK_QUEUE_TRANSFER_BIT);
@@ -186,16 +174,40 @@ bool PhysicalDevice::is_suitable(VkPhysicalDevice vk_physical_device, VkSurfaceK
     }
 
     // If we're missing an operation type, this device is not suitable
-    if (!operations_supported[0] || !operations_supported[1] || !operations_supported[2] || !operations_supported[3]) { return false; }
+    if (!operations_supported[0] || !operations_supported[1] || !operations_supported[2]) { return false; }
+    // Presentation is only required if there's something to present to
+    if (vk_surface != nullptr && !operations_supported[3]) { return false; }
     // Otherwise, make sure it supports the required extensions as well
-    if (!gpu_supports_extensions(vk_physical_device, vk_device_extensions)) { return false; }
+    for (uint32_t i = 0; i < vk_device_extensions.size(); i++) {
+        if (!this->supports_extension(vk_device_extensions[i])) { return false; }
+    }
     // Finally, make sure the required features are supported too
-    if (!gpu_supports_features(vk_physical_device, vk_device_features)) { return false; }
+    for (uint32_t i = 0; i < vk_device_features.size(); i++) {
+        if (!this->supports_feature(vk_device_features[i])) { return false; }
+    }
 
     // It it is a suitable GPU!
     return true;
 }
 
+/* Returns whether the device supports the given device extension. */
+bool PhysicalDevice::supports_extension(const char* extension) const {
+    const Tools::Array<VkExtensionProperties>& extensions = this->_info->extensions;
+    for (uint32_t i = 0; i < extensions.size(); i++) {
+        if (strcmp(extension, extensions[i].extensionName) == 0) { return true; }
+    }
+    return false;
+}
+
+/* Returns whether the device supports the given Makma3D DeviceFeature. */
+bool PhysicalDevice::supports_feature(Vulkanic::DeviceFeature feature) const {
+    const Tools::Array<Vulkanic::DeviceFeature>& features = this->_info->supported_features;
+    for (uint32_t i = 0; i < features.size(); i++) {
+        if (features[i] == feature) { return true; }
+    }
+    return false;
+}
+
 
 
 /* Swap operator for the PhysicalDevice class. */
@@ -203,7 +215,7 @@ void Makma3D::swap(PhysicalDevice& pd1, PhysicalDevice& pd2) {
     using std::swap;
 
     swap(pd1.vk_physical_device, pd2.vk_physical_device);
-    swap(pd1.vk_physical_device_properties, pd2.vk_physical_device_properties);
+    swap(pd1._info, pd2._info);
 
     swap(pd1._index, pd2._index);
     swap(pd1._type, pd2._type);
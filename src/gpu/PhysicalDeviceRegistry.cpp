@@ -0,0 +1,176 @@
+/* PHYSICAL DEVICE REGISTRY.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 17:12:09
+ * Last edited:
+ *   16/10/2021, 17:12:09
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the PhysicalDeviceRegistry class, which enumerates the
+ *   physical devices of an instance once, caches them and scores them to
+ *   select the most suitable one.
+**/
+
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+
+#include "gpu/PhysicalDeviceRegistry.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* The score bonus for a device of the preferred type. Large enough to outweigh all other criteria. */
+static constexpr const double preferred_type_score = 1000000.0;
+/* The base score per device type, indexed by PhysicalDeviceType. */
+static constexpr const double type_scores[] = {
+    0.0,    // undefined
+    1000.0, // cpu
+    3000.0, // integrated
+    4000.0, // discrete
+    2000.0, // simulated
+    0.0     // other
+};
+/* The score per MiB of device-local memory. */
+static constexpr const double heap_score_per_mib = 1.0 / 16.0;
+/* The maximum score given for device-local memory (i.e., 32 GiB). */
+static constexpr const double max_heap_score = 2048.0;
+/* The score bonus for a dedicated transfer family, which allows uploads without blocking the graphics queue. */
+static constexpr const double dedicated_transfer_score = 500.0;
+/* The score bonus for a compute family without graphics, which allows asynchronous compute. */
+static constexpr const double async_compute_score = 500.0;
+/* The score per queue, up to a maximum number of queues. */
+static constexpr const double queue_score = 10.0;
+/* The maximum number of queues that are scored. */
+static constexpr const uint32_t max_scored_queues = 16;
+
+
+
+
+
+/***** PHYSICALDEVICEREGISTRY CLASS *****/
+/* Constructor for the PhysicalDeviceRegistry class, which initializes it to empty. */
+PhysicalDeviceRegistry::PhysicalDeviceRegistry() {}
+
+/* Move constructor for the PhysicalDeviceRegistry class. */
+PhysicalDeviceRegistry::PhysicalDeviceRegistry(PhysicalDeviceRegistry&& other) :
+    _devices(std::move(other._devices))
+{}
+
+/* Destructor for the PhysicalDeviceRegistry class. */
+PhysicalDeviceRegistry::~PhysicalDeviceRegistry() {}
+
+
+
+/* Enumerates the physical devices in the given instance and queries everything about them, replacing any previously cached devices. */
+void PhysicalDeviceRegistry::enumerate(VkInstance vk_instance, uint32_t instance_version, PFN_vkGetPhysicalDeviceFeatures2 get_features2) {
+    this->_devices.clear();
+
+    // Get the devices from Vulkan
+    uint32_t n_physical_devices;
+    vkEnumeratePhysicalDevices(vk_instance, &n_physical_devices, nullptr);
+    if (n_physical_devices == 0) { logger.warningc(PhysicalDeviceRegistry::channel, "No Vulkan-capable devices found."); return; }
+    Tools::Array<VkPhysicalDevice> physical_devices(n_physical_devices);
+    vkEnumeratePhysicalDevices(vk_instance, &n_physical_devices, physical_devices.wdata(n_physical_devices));
+
+    // Wrap each of them, which queries all of their information once
+    this->_devices.reserve(n_physical_devices);
+    for (uint32_t i = 0; i < n_physical_devices; i++) {
+        this->_devices.push_back(PhysicalDevice(physical_devices[i], i, instance_version, get_features2));
+        const PhysicalDevice& physical_device = this->_devices.last();
+        logger.logc(Verbosity::debug, PhysicalDeviceRegistry::channel, "Found ", physical_device_type_names[(int) physical_device.type()], " device '", physical_device.name(), "' (Vulkan ", VK_API_VERSION_MAJOR(physical_device.api_version()), ".", VK_API_VERSION_MINOR(physical_device.api_version()), ", ", physical_device.supported_features().size(), " Makma3D features).");
+    }
+}
+
+
+
+/* Returns the (cached) physical devices that are suitable for the Makma3D engine. */
+Tools::Array<PhysicalDevice> PhysicalDeviceRegistry::get_suitable(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const {
+    Tools::Array<PhysicalDevice> result(this->_devices.size());
+    for (uint32_t i = 0; i < this->_devices.size(); i++) {
+        if (this->_devices[i].is_suitable(vk_surface, vk_device_extensions, vk_device_features)) {
+            result.push_back(this->_devices[i]);
+        }
+    }
+    return result;
+}
+
+
+
+/* Scores the given physical device on its type, the size of its device-local memory, its queue topology and its limits. */
+double PhysicalDeviceRegistry::score(const PhysicalDevice& physical_device, PhysicalDeviceType preferred_type) {
+    // Start with the type
+    double result = type_scores[(int) physical_device.type()];
+    if (physical_device.type() == preferred_type) { result += preferred_type_score; }
+
+    // Add the size of the device-local memory
+    const VkPhysicalDeviceMemoryProperties& memory_properties = physical_device.memory_properties();
+    VkDeviceSize local_size = 0;
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            local_size += memory_properties.memoryHeaps[i].size;
+        }
+    }
+    result += std::min(static_cast<double>(local_size / (1024 * 1024)) * heap_score_per_mib, max_heap_score);
+
+    // Add the queue topology; families that take work off the graphics queue are especially nice
+    const Tools::Array<VkQueueFamilyProperties>& families = physical_device.queue_families();
+    bool dedicated_transfer = false, async_compute = false;
+    uint32_t n_queues = 0;
+    for (uint32_t i = 0; i < families.size(); i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        dedicated_transfer |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        async_compute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        n_queues += families[i].queueCount;
+    }
+    if (dedicated_transfer) { result += dedicated_transfer_score; }
+    if (async_compute) { result += async_compute_score; }
+    result += std::min(n_queues, max_scored_queues) * queue_score;
+
+    // Finally, add a couple of limits that say something about the device's size
+    const VkPhysicalDeviceLimits& limits = physical_device.properties().limits;
+    result += limits.maxImageDimension2D / 64.0;
+    result += std::min(limits.maxComputeSharedMemorySize / 1024U, 64U);
+    result += limits.maxSamplerAnisotropy;
+
+    // Done
+    return result;
+}
+
+/* Selects the physical device with the highest score from the given list. */
+const PhysicalDevice& PhysicalDeviceRegistry::select(const Tools::Array<PhysicalDevice>& candidates, PhysicalDeviceType preferred_type) {
+    #ifndef NDEBUG
+    if (candidates.empty()) { logger.fatalc(PhysicalDeviceRegistry::channel, "Cannot select a physical device from an empty list."); }
+    #endif
+
+    // Find the one with the highest score; on a tie, Vulkan's order decides
+    uint32_t best = 0;
+    double best_score = PhysicalDeviceRegistry::score(candidates[0], preferred_type);
+    logger.logc(Verbosity::debug, PhysicalDeviceRegistry::channel, "Device '", candidates[0].name(), "' scores ", best_score, ".");
+    for (uint32_t i = 1; i < candidates.size(); i++) {
+        double score = PhysicalDeviceRegistry::score(candidates[i], preferred_type);
+        logger.logc(Verbosity::debug, PhysicalDeviceRegistry::channel, "Device '", candidates[i].name(), "' scores ", score, ".");
+        if (score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    // Done
+    logger.logc(Verbosity::details, PhysicalDeviceRegistry::channel, "Selected ", physical_device_type_names[(int) candidates[best].type()], " device '", candidates[best].name(), "'.");
+    return candidates[best];
+}
+
+
+
+/* Swap operator for the PhysicalDeviceRegistry class. */
+void Makma3D::swap(PhysicalDeviceRegistry& pdr1, PhysicalDeviceRegistry& pdr2) {
+    using std::swap;
+
+    swap(pdr1._devices, pdr2._devices);
+}
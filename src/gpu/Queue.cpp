@@ -0,0 +1,68 @@
+/* QUEUE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 13:02:47
+ * Last edited:
+ *   17/10/2021, 13:02:47
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Queue class, which wraps a single VkQueue together with
+ *   the lock that guards submissions to it, and the QueueLease class,
+ *   which gives a thread exclusive access to a Queue for as long as it
+ *   lives.
+**/
+
+#include <thread>
+#include <functional>
+
+#include "gpu/Queue.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** QUEUE CLASS *****/
+/* Constructor for the Queue class. */
+Queue::Queue(VkQueue vk_queue, uint32_t family, uint32_t index, Timeline* timeline) :
+    vk_queue(vk_queue),
+    _family(family),
+    _index(index),
+    _timeline(timeline)
+{}
+
+/* Destructor for the Queue class. */
+Queue::~Queue() {
+    delete this->_timeline;
+}
+
+
+
+
+
+/***** QUEUELEASE CLASS *****/
+/* Leases one of the given queues, blocking until one is available. */
+QueueLease QueueLease::lease_any(const Tools::Array<Queue*>& candidates) {
+    // Start at a per-thread offset, so threads tend to stick to different queues
+    uint32_t offset = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()) % candidates.size());
+
+    // Take the first one that's free
+    for (uint32_t i = 0; i < candidates.size(); i++) {
+        QueueLease lease(*candidates[(offset + i) % candidates.size()], std::try_to_lock);
+        if (lease) { return lease; }
+    }
+
+    // Otherwise, wait for our own one
+    return QueueLease(*candidates[offset]);
+}
+
+/* Tries to lease one of the given queues without blocking. */
+QueueLease QueueLease::try_lease_any(const Tools::Array<Queue*>& candidates) {
+    for (uint32_t i = 0; i < candidates.size(); i++) {
+        QueueLease lease(*candidates[i], std::try_to_lock);
+        if (lease) { return lease; }
+    }
+    return QueueLease();
+}
@@ -0,0 +1,160 @@
+/* QUEUE PLANNER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 10:04:35
+ * Last edited:
+ *   17/10/2021, 10:04:35
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the QueuePlanner class, which decides which queue families
+ *   are used for which QueueType, how many queues to create of each
+ *   family and which of those queues each QueueType may submit to.
+**/
+
+#include <limits>
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+
+#include "gpu/QueuePlanner.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** HELPER FUNCTIONS *****/
+/* Maps the different kind of Device operations to queue families. Tries to select families which are least used and have the most specific capabilities.
+ * @param physical_device The PhysicalDevice who's queues we'd like to map.
+ * @param vk_surface The VkSurfaceKHR we'll use to check presentability of a queue family. If nullptr, the present operation is mapped to the graphics family without claiming it.
+ * @returns A static array with the queue family index for each of the queue types / queue operations. */
+static Tools::StackArray<uint32_t, Vulkanic::n_queue_types> map_queue_families(const PhysicalDevice& physical_device, VkSurfaceKHR vk_surface) {
+    // Prepare the result list
+    Tools::StackArray<uint32_t, Vulkanic::n_queue_types> result;
+
+    // Get the (cached) list of queue families
+    const Tools::Array<VkQueueFamilyProperties>& queue_families = physical_device.queue_families();
+
+    // Next, loop through all the family infos to count how many capabilities they have
+    Tools::Array<Tools::StackArray<bool, Vulkanic::n_queue_types>> capabilities(Tools::StackArray<bool, Vulkanic::n_queue_types>(false, Vulkanic::n_queue_types), queue_families.size());
+    Tools::Array<uint32_t> capabilities_count(0U, queue_families.size());
+    for (uint32_t i = 0; i < queue_families.size(); i++) {
+        // Check if the queue can present, unless we render headless
+        VkBool32 can_present = VK_FALSE;
+        if (vk_surface != nullptr) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, vk_surface, &can_present);
+        }
+
+        // Count the capabilities, immediately noting this queue's support in the capabilities list
+        capabilities_count[i] += (capabilities[i][0] = !!(queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT));
+        capabilities_count[i] += (capabilities[i][1] = !!(queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT));
+        capabilities_count[i] += (capabilities[i][2] = !!(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT));
+        capabilities_count[i] += (capabilities[i][3] = !!can_present);
+    }
+
+    // Finally, loop through all types to find a queue family for them
+    Tools::Array<uint32_t> used_count(0U, queue_families.size());
+    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+        // Without a surface there's nothing to present to, so simply alias the graphics family without creating extra queues for it
+        if (i == (uint32_t) Vulkanic::QueueType::present && vk_surface == nullptr) {
+            result.push_back(result[(uint32_t) Vulkanic::QueueType::graphics]);
+            continue;
+        }
+
+        // Loop through the queues to find the best one
+        uint32_t best_used_count = std::numeric_limits<uint32_t>::max(), best_capability_count = std::numeric_limits<uint32_t>::max(), best_queue_family;
+        for (uint32_t j = 0; j < queue_families.size(); j++) {
+            // If it doesn't support this capability, then we're immediately done with it
+            if (!capabilities[j][i]) { continue; }
+
+            // Otherwise, don't used this queue if it's used more than the current queue
+            if (used_count[j] > best_used_count) { continue; }
+            // Next, skip if this queue has more (or the same) capabilities than the best one
+            if (capabilities_count[j] >= best_capability_count) { continue; }
+
+            // Otherwise, it's better, so store it!
+            best_used_count = used_count[j];
+            best_capability_count = capabilities_count[j];
+            best_queue_family = j;
+        }
+
+        // If the best used count is still 'infinite', then we didn't find any that supported this operation
+        if (best_used_count == std::numeric_limits<uint32_t>::max()) {
+            logger.fatalc(QueuePlanner::channel, "Physical device '", physical_device.name(), "' doesn't support ", Vulkanic::queue_type_names[i], "-operations; cannot map it.");
+        }
+
+        // Mark the selected queue as the actually used one
+        ++used_count[best_queue_family];
+        result.push_back(best_queue_family);
+    }
+
+    // Done!
+    return result;
+}
+
+
+
+
+
+/***** QUEUEPLANNER CLASS *****/
+/* Constructor for the QueuePlanner class, which computes the plan. */
+QueuePlanner::QueuePlanner(const PhysicalDevice& physical_device, VkSurfaceKHR vk_surface) :
+    _type_families(map_queue_families(physical_device, vk_surface)),
+    _type_slots({}, Vulkanic::n_queue_types)
+{
+    // Collect the unique families, and how many queues all types mapped to them would like together
+    Tools::StackArray<uint32_t, Vulkanic::n_queue_types> family_slots(0U, Vulkanic::n_queue_types);
+    Tools::Array<uint32_t> wanted(Vulkanic::n_queue_types);
+    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+        // The aliased present type of a headless device doesn't want anything
+        bool aliased = i == (uint32_t) Vulkanic::QueueType::present && vk_surface == nullptr;
+
+        // Find the family in the list of unique ones, adding it if it's new
+        uint32_t j;
+        for (j = 0; j < this->_families.size(); j++) {
+            if (this->_families[j].first == this->_type_families[i]) { break; }
+        }
+        if (j == this->_families.size()) {
+            this->_families.push_back({ this->_type_families[i], 0 });
+            wanted.push_back(0);
+        }
+        family_slots[i] = j;
+        if (!aliased) { wanted[j] += QueuePlanner::desired_queues[i]; }
+    }
+
+    // Create as many queues as wanted, but no more than the family has
+    const Tools::Array<VkQueueFamilyProperties>& queue_families = physical_device.queue_families();
+    for (uint32_t j = 0; j < this->_families.size(); j++) {
+        this->_families[j].second = std::max(1U, std::min(wanted[j], queue_families[this->_families[j].first].queueCount));
+    }
+
+    // Hand out the queues of each family to the types that use it; if there are too few, types wrap around and share them
+    Tools::Array<uint32_t> next_index(0U, this->_families.size());
+    for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+        if (i == (uint32_t) Vulkanic::QueueType::present && vk_surface == nullptr) {
+            this->_type_slots[i].push_back(this->_type_slots[(uint32_t) Vulkanic::QueueType::graphics][0]);
+            continue;
+        }
+
+        uint32_t j = family_slots[i];
+        for (uint32_t q = 0; q < QueuePlanner::desired_queues[i]; q++) {
+            Slot slot = { this->_families[j].first, next_index[j]++ % this->_families[j].second };
+
+            // Don't add the same queue twice to one type
+            bool duplicate = false;
+            for (uint32_t k = 0; k < this->_type_slots[i].size(); k++) {
+                if (this->_type_slots[i][k].index == slot.index) { duplicate = true; break; }
+            }
+            if (!duplicate) { this->_type_slots[i].push_back(slot); }
+        }
+    }
+
+    // Done
+    if (logger.get_verbosity() >= Verbosity::debug) {
+        for (uint32_t i = 0; i < Vulkanic::n_queue_types; i++) {
+            logger.logc(Verbosity::debug, QueuePlanner::channel, "Mapped ", Vulkanic::queue_type_names[i], "-operations to ", this->_type_slots[i].size(), " queue(s) of family ", this->_type_families[i], ".");
+        }
+    }
+}
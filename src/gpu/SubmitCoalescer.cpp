@@ -0,0 +1,238 @@
+/* SUBMIT COALESCER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 13:20:22
+ * Last edited:
+ *   17/10/2021, 13:20:22
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the SubmitCoalescer class, which collects submissions from
+ *   any number of threads in a lock-free queue and submits them to the
+ *   GPU in a single vkQueueSubmit() call per flush.
+**/
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/SubmitCoalescer.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkSubmitInfo struct.
+ * @param submit_info The VkSubmitInfo struct to populate.
+ * @param wait_semaphores The semaphores to wait on before executing. Has to outlive the struct.
+ * @param wait_stages For each wait semaphore, the pipeline stage at which to wait for it. Has to outlive the struct.
+ * @param command_buffers The command buffers to execute. Has to outlive the struct.
+ * @param signal_semaphores The semaphores to signal once the command buffers are done. Has to outlive the struct.
+ * @param next The struct to chain to it (i.e., a VkTimelineSemaphoreSubmitInfo), or nullptr. */
+static void populate_submit_info(VkSubmitInfo& submit_info, const Tools::Array<VkSemaphore>& wait_semaphores, const Tools::Array<VkPipelineStageFlags>& wait_stages, const Tools::Array<VkCommandBuffer>& command_buffers, const Tools::Array<VkSemaphore>& signal_semaphores, const void* next) {
+    // Set the meta info first
+    submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = next;
+
+    // Set what to wait for
+    submit_info.waitSemaphoreCount = wait_semaphores.size();
+    submit_info.pWaitSemaphores = wait_semaphores.rdata();
+    submit_info.pWaitDstStageMask = wait_stages.rdata();
+
+    // Set what to execute
+    submit_info.commandBufferCount = command_buffers.size();
+    submit_info.pCommandBuffers = command_buffers.rdata();
+
+    // Set what to signal
+    submit_info.signalSemaphoreCount = signal_semaphores.size();
+    submit_info.pSignalSemaphores = signal_semaphores.rdata();
+}
+
+/* Populates the given VkTimelineSemaphoreSubmitInfo struct.
+ * @param timeline_info The VkTimelineSemaphoreSubmitInfo struct to populate.
+ * @param wait_values For each wait semaphore of the submission, the value to wait for. Ignored for binary semaphores. Has to outlive the struct.
+ * @param signal_values For each signal semaphore of the submission, the value to signal. Ignored for binary semaphores. Has to outlive the struct. */
+static void populate_timeline_info(VkTimelineSemaphoreSubmitInfoKHR& timeline_info, const Tools::Array<uint64_t>& wait_values, const Tools::Array<uint64_t>& signal_values) {
+    // Set the meta info first
+    timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+
+    // Set the values
+    timeline_info.waitSemaphoreValueCount = wait_values.size();
+    timeline_info.pWaitSemaphoreValues = wait_values.rdata();
+    timeline_info.signalSemaphoreValueCount = signal_values.size();
+    timeline_info.pSignalSemaphoreValues = signal_values.rdata();
+}
+
+
+
+
+
+/***** SUBMITCOALESCER CLASS *****/
+/* Constructor for the SubmitCoalescer class. */
+SubmitCoalescer::SubmitCoalescer(const DeviceDispatch& dispatch, Vulkanic::QueueType queue_type, const Tools::Array<Queue*>& queues) :
+    dispatch(dispatch),
+    queue_type(queue_type),
+    queues(queues),
+    head(nullptr),
+    _statistics({ 0, 0, 0 })
+{}
+
+/* Destructor for the SubmitCoalescer class. */
+SubmitCoalescer::~SubmitCoalescer() {
+    // Throw away anything that was never flushed
+    Node* node = this->head.exchange(nullptr);
+    if (node != nullptr) { logger.warningc(SubmitCoalescer::channel, "Discarding unflushed ", Vulkanic::queue_type_names[(uint32_t) this->queue_type], " submissions."); }
+    while (node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+
+    // Report the statistics
+    if (this->_statistics.n_flushes > 0) {
+        logger.logc(Verbosity::details, SubmitCoalescer::channel, "Submitted ", this->_statistics.n_submissions, " ", Vulkanic::queue_type_names[(uint32_t) this->queue_type], " submissions in ", this->_statistics.n_flushes, " frames, at ", this->_statistics.submits_per_frame(), " submits per frame and ", this->_statistics.submissions_per_submit(), " submissions per submit.");
+    }
+}
+
+
+
+/* Queues the given submission for the next flush. */
+void SubmitCoalescer::enqueue(const Submission& submission) {
+    this->enqueue(Submission(submission));
+}
+
+/* Queues the given submission for the next flush. */
+void SubmitCoalescer::enqueue(Submission&& submission) {
+    #ifndef NDEBUG
+    if (submission.wait_semaphores.size() != submission.wait_stages.size()) { logger.fatalc(SubmitCoalescer::channel, "Every wait semaphore needs exactly one wait stage."); }
+    if (submission.wait_points.size() != submission.wait_point_stages.size()) { logger.fatalc(SubmitCoalescer::channel, "Every wait point needs exactly one wait stage."); }
+    #endif
+
+    // Push it on the list; this is the only point of contention between producers
+    Node* node = new Node{ std::move(submission), this->head.load(std::memory_order_relaxed) };
+    while (!this->head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+/* Queues a single command buffer for the next flush, with optional semaphores. */
+void SubmitCoalescer::enqueue(VkCommandBuffer vk_command_buffer, VkSemaphore vk_wait_semaphore, VkPipelineStageFlags wait_stage, VkSemaphore vk_signal_semaphore) {
+    Submission submission;
+    submission.command_buffers.push_back(vk_command_buffer);
+    if (vk_wait_semaphore != nullptr) {
+        submission.wait_semaphores.push_back(vk_wait_semaphore);
+        submission.wait_stages.push_back(wait_stage);
+    }
+    if (vk_signal_semaphore != nullptr) {
+        submission.signal_semaphores.push_back(vk_signal_semaphore);
+    }
+    this->enqueue(std::move(submission));
+}
+
+
+
+/* Submits all pending submissions, in the order in which they were queued, with a single vkQueueSubmit() call. */
+SyncPoint SubmitCoalescer::flush(VkFence vk_fence) {
+    // Take the entire list at once, and reverse it so the oldest submission comes first
+    Node* node = this->head.exchange(nullptr, std::memory_order_acquire);
+    Node* first = nullptr;
+    uint32_t n_submissions = 0;
+    while (node != nullptr) {
+        Node* next = node->next;
+        node->next = first;
+        first = node;
+        node = next;
+        ++n_submissions;
+    }
+    ++this->_statistics.n_flushes;
+
+    // If there's nothing to do, we only submit if someone waits for the fence
+    if (n_submissions == 0 && vk_fence == nullptr) { return null_sync_point; }
+
+    // Lease the queue up front, since its timeline values have to be submitted in order
+    QueueLease queue = QueueLease::lease_any(this->queues);
+    Timeline& timeline = queue.timeline();
+
+    // Collect the submit infos, resolving the wait points to semaphores as we go. The arrays are sized up front so the inner ones don't move.
+    Tools::Array<Tools::Array<VkSemaphore>> wait_semaphores(n_submissions + 1);
+    Tools::Array<Tools::Array<VkPipelineStageFlags>> wait_stages(n_submissions + 1);
+    Tools::Array<Tools::Array<uint64_t>> wait_values(n_submissions + 1);
+    Tools::Array<VkTimelineSemaphoreSubmitInfoKHR> timeline_infos({}, n_submissions + 1);
+    Tools::Array<VkSubmitInfo> submit_infos({}, n_submissions + 1);
+    Tools::Array<VkSemaphore> consumed;
+    const Tools::Array<uint64_t> no_values;
+    const Tools::Array<VkSemaphore> no_semaphores;
+    const Tools::Array<VkPipelineStageFlags> no_stages;
+    const Tools::Array<VkCommandBuffer> no_command_buffers;
+    uint32_t i = 0;
+    for (node = first; node != nullptr; node = node->next) {
+        const Submission& submission = node->submission;
+        wait_semaphores.push_back(submission.wait_semaphores);
+        wait_stages.push_back(submission.wait_stages);
+        wait_values.push_back(Tools::Array<uint64_t>(submission.wait_semaphores.size() + submission.wait_points.size()));
+        wait_values[i].resize((uint64_t) 0, submission.wait_semaphores.size());
+
+        // Add the wait points that aren't reached yet
+        for (uint32_t j = 0; j < submission.wait_points.size(); j++) {
+            const SyncPoint& point = submission.wait_points[j];
+            if (point.timeline == nullptr) { continue; }
+
+            VkSemaphore vk_semaphore;
+            uint64_t wait_value;
+            if (point.timeline->prepare_wait(point.value, vk_semaphore, wait_value, consumed)) {
+                wait_semaphores[i].push_back(vk_semaphore);
+                wait_stages[i].push_back(submission.wait_point_stages[j]);
+                wait_values[i].push_back(wait_value);
+            }
+        }
+
+        // Only chain the timeline info if we have to
+        const void* next = nullptr;
+        if (timeline.is_timeline() && wait_semaphores[i].size() > submission.wait_semaphores.size()) {
+            populate_timeline_info(timeline_infos[i], wait_values[i], no_values);
+            next = &timeline_infos[i];
+        }
+        populate_submit_info(submit_infos[i], wait_semaphores[i], wait_stages[i], submission.command_buffers, submission.signal_semaphores, next);
+        ++i;
+    }
+
+    // Add one last, empty submission that signals the queue's timeline once everything before it is done
+    TimelineSignal signal = timeline.prepare_signal(consumed);
+    Tools::Array<VkSemaphore> signal_semaphores(1);
+    signal_semaphores.push_back(signal.vk_semaphore);
+    Tools::Array<uint64_t> signal_values(1);
+    signal_values.push_back(signal.value);
+    const void* next = nullptr;
+    if (timeline.is_timeline()) {
+        populate_timeline_info(timeline_infos[n_submissions], no_values, signal_values);
+        next = &timeline_infos[n_submissions];
+    }
+    populate_submit_info(submit_infos[n_submissions], no_semaphores, no_stages, no_command_buffers, signal_semaphores, next);
+
+    // Submit them all at once. The binary fallback needs its own fence, so if the user brings one as well we signal ours with a second, empty submit.
+    VkResult vk_result;
+    VkFence vk_submit_fence = vk_fence != nullptr ? vk_fence : signal.vk_fence;
+    if ((vk_result = this->dispatch.vkQueueSubmit(queue, n_submissions + 1, submit_infos.rdata(), vk_submit_fence)) != VK_SUCCESS) {
+        logger.fatalc(SubmitCoalescer::channel, "Could not submit ", n_submissions, " ", Vulkanic::queue_type_names[(uint32_t) this->queue_type], " submissions: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    ++this->_statistics.n_submits;
+    if (vk_submit_fence != signal.vk_fence && signal.vk_fence != nullptr) {
+        if ((vk_result = this->dispatch.vkQueueSubmit(queue, 0, nullptr, signal.vk_fence)) != VK_SUCCESS) {
+            logger.fatalc(SubmitCoalescer::channel, "Could not submit ", Vulkanic::queue_type_names[(uint32_t) this->queue_type], " timeline fence: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        ++this->_statistics.n_submits;
+    }
+    this->_statistics.n_submissions += n_submissions;
+
+    // Clean the nodes
+    while (first != nullptr) {
+        Node* next = first->next;
+        delete first;
+        first = next;
+    }
+
+    // Done
+    return SyncPoint{ &timeline, signal.value };
+}
@@ -0,0 +1,276 @@
+/* TIMELINE.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   17/10/2021, 15:11:44
+ * Last edited:
+ *   17/10/2021, 15:11:44
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Timeline class, which tracks the progress of a single
+ *   queue as an ever-increasing counter. Uses a timeline semaphore if the
+ *   device supports them, and falls back to fences and binary semaphores
+ *   otherwise.
+**/
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "gpu/Timeline.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkSemaphoreTypeCreateInfo struct.
+ * @param semaphore_type_info The VkSemaphoreTypeCreateInfo struct to populate. */
+static void populate_semaphore_type_info(VkSemaphoreTypeCreateInfoKHR& semaphore_type_info) {
+    // Set to default
+    semaphore_type_info = {};
+    semaphore_type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+
+    // Make it a timeline, starting at zero
+    semaphore_type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    semaphore_type_info.initialValue = 0;
+}
+
+/* Populates the given VkSemaphoreCreateInfo struct.
+ * @param semaphore_info The VkSemaphoreCreateInfo struct to populate.
+ * @param next The struct to chain to it, or nullptr. */
+static void populate_semaphore_info(VkSemaphoreCreateInfo& semaphore_info, const void* next) {
+    // Set to default
+    semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = next;
+}
+
+/* Populates the given VkFenceCreateInfo struct.
+ * @param fence_info The VkFenceCreateInfo struct to populate. */
+static void populate_fence_info(VkFenceCreateInfo& fence_info) {
+    // Set to default
+    fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+}
+
+/* Populates the given VkSemaphoreWaitInfo struct.
+ * @param wait_info The VkSemaphoreWaitInfo struct to populate.
+ * @param vk_semaphore The timeline semaphore to wait for. Has to outlive the struct.
+ * @param value The value to wait for. Has to outlive the struct. */
+static void populate_wait_info(VkSemaphoreWaitInfoKHR& wait_info, const VkSemaphore& vk_semaphore, const uint64_t& value) {
+    // Set to default
+    wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+
+    // Set the semaphore to wait for
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &vk_semaphore;
+    wait_info.pValues = &value;
+}
+
+
+
+
+
+/***** TIMELINE CLASS *****/
+/* Constructor for the Timeline class. */
+Timeline::Timeline(VkDevice vk_device, const DeviceDispatch& dispatch, bool is_timeline) :
+    vk_device(vk_device),
+    dispatch(dispatch),
+    _is_timeline(is_timeline),
+    vk_semaphore(nullptr),
+    _submitted(0),
+    _completed(0)
+{
+    // Only the timeline version needs something up front
+    if (this->_is_timeline) {
+        VkSemaphoreTypeCreateInfoKHR semaphore_type_info;
+        populate_semaphore_type_info(semaphore_type_info);
+        VkSemaphoreCreateInfo semaphore_info;
+        populate_semaphore_info(semaphore_info, &semaphore_type_info);
+
+        VkResult vk_result;
+        if ((vk_result = vkCreateSemaphore(this->vk_device, &semaphore_info, nullptr, &this->vk_semaphore)) != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not create timeline semaphore: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+}
+
+/* Destructor for the Timeline class. */
+Timeline::~Timeline() {
+    if (this->vk_semaphore != nullptr) {
+        vkDestroySemaphore(this->vk_device, this->vk_semaphore, nullptr);
+    }
+
+    // Destroy everything the fallback still holds
+    for (uint32_t i = 0; i < this->signals.size(); i++) {
+        vkDestroyFence(this->vk_device, this->signals[i].vk_fence, nullptr);
+        if (!this->signals[i].waited) { vkDestroySemaphore(this->vk_device, this->signals[i].vk_semaphore, nullptr); }
+        for (uint32_t j = 0; j < this->signals[i].consumed.size(); j++) {
+            vkDestroySemaphore(this->vk_device, this->signals[i].consumed[j], nullptr);
+        }
+    }
+    for (uint32_t i = 0; i < this->free_fences.size(); i++) {
+        vkDestroyFence(this->vk_device, this->free_fences[i], nullptr);
+    }
+    for (uint32_t i = 0; i < this->free_semaphores.size(); i++) {
+        vkDestroySemaphore(this->vk_device, this->free_semaphores[i], nullptr);
+    }
+}
+
+
+
+/* Retires the pending signals of the binary fallback that are done. Assumes the lock is taken. */
+void Timeline::retire_signals() {
+    // Signals fire in order, so we can stop at the first one that isn't done
+    uint32_t n_retired = 0;
+    while (n_retired < this->signals.size() && this->dispatch.vkGetFenceStatus(this->vk_device, this->signals[n_retired].vk_fence) == VK_SUCCESS) {
+        Signal& signal = this->signals[n_retired];
+
+        // The fence can be reused as soon as it's reset
+        this->dispatch.vkResetFences(this->vk_device, 1, &signal.vk_fence);
+        this->free_fences.push_back(signal.vk_fence);
+
+        // A semaphore that was waited on belongs to the waiter, which recycles it once its wait is over; one that nobody waited for is still signalled, and can thus only be thrown away
+        if (!signal.waited) { vkDestroySemaphore(this->vk_device, signal.vk_semaphore, nullptr); }
+
+        // The semaphores we waited on are ours, and unsignalled now that the wait is over
+        for (uint32_t i = 0; i < signal.consumed.size(); i++) {
+            this->free_semaphores.push_back(signal.consumed[i]);
+        }
+
+        this->_completed.store(signal.value);
+        ++n_retired;
+    }
+
+    // Remove the retired signals from the front of the list
+    if (n_retired > 0) { this->signals.erase(0, n_retired - 1); }
+}
+
+
+
+/* Reserves the next value on the timeline, and returns how a submission should signal it. */
+TimelineSignal Timeline::prepare_signal(const Tools::Array<VkSemaphore>& consumed) {
+    // The timeline version simply counts up
+    if (this->_is_timeline) {
+        return TimelineSignal{ this->vk_semaphore, ++this->_submitted, nullptr };
+    }
+
+    // Otherwise, get a fence and a semaphore, reusing old ones where possible
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    this->retire_signals();
+
+    VkResult vk_result;
+    VkFence vk_fence;
+    if (!this->free_fences.empty()) {
+        vk_fence = this->free_fences.last();
+        this->free_fences.pop_back();
+    } else {
+        VkFenceCreateInfo fence_info;
+        populate_fence_info(fence_info);
+        if ((vk_result = vkCreateFence(this->vk_device, &fence_info, nullptr, &vk_fence)) != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not create fence: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+    VkSemaphore vk_semaphore;
+    if (!this->free_semaphores.empty()) {
+        vk_semaphore = this->free_semaphores.last();
+        this->free_semaphores.pop_back();
+    } else {
+        VkSemaphoreCreateInfo semaphore_info;
+        populate_semaphore_info(semaphore_info, nullptr);
+        if ((vk_result = vkCreateSemaphore(this->vk_device, &semaphore_info, nullptr, &vk_semaphore)) != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not create semaphore: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+
+    // Store it as a pending signal
+    uint64_t value = ++this->_submitted;
+    this->signals.push_back(Signal{ value, vk_fence, vk_semaphore, false, consumed });
+    return TimelineSignal{ vk_semaphore, value, vk_fence };
+}
+
+/* Returns how a submission on another queue can wait until the given value is reached. */
+bool Timeline::prepare_wait(uint64_t value, VkSemaphore& vk_semaphore, uint64_t& wait_value, Tools::Array<VkSemaphore>& consumed) {
+    // The timeline version can be waited on as often as we like
+    if (this->_is_timeline) {
+        if (value <= this->_completed.load()) { return false; }
+        vk_semaphore = this->vk_semaphore;
+        wait_value = value;
+        return true;
+    }
+
+    // Otherwise, find the signal that reaches the value
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    this->retire_signals();
+    for (uint32_t i = 0; i < this->signals.size(); i++) {
+        Signal& signal = this->signals[i];
+        if (signal.value < value) { continue; }
+
+        // Only one submission can wait on a binary semaphore; anyone after that has to wait on the CPU
+        if (signal.waited) {
+            this->dispatch.vkWaitForFences(this->vk_device, 1, &signal.vk_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            return false;
+        }
+        // The waiter takes the semaphore over, so from now on only it recycles or destroys it
+        signal.waited = true;
+        vk_semaphore = signal.vk_semaphore;
+        wait_value = 0;
+        consumed.push_back(signal.vk_semaphore);
+        return true;
+    }
+
+    // No pending signal reaches it, so it's done already
+    return false;
+}
+
+
+
+/* Returns the value of the last submission that is known to be done. */
+uint64_t Timeline::completed() {
+    if (this->_is_timeline) {
+        uint64_t value;
+        VkResult vk_result;
+        if ((vk_result = this->dispatch.vkGetSemaphoreCounterValueKHR(this->vk_device, this->vk_semaphore, &value)) != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not get timeline semaphore value: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        this->_completed.store(value);
+        return value;
+    }
+
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    this->retire_signals();
+    return this->_completed.load();
+}
+
+/* Waits on the CPU until the given value is reached. */
+bool Timeline::wait(uint64_t value, uint64_t timeout) {
+    if (value <= this->_completed.load()) { return true; }
+
+    VkResult vk_result;
+    if (this->_is_timeline) {
+        VkSemaphoreWaitInfoKHR wait_info;
+        populate_wait_info(wait_info, this->vk_semaphore, value);
+        if ((vk_result = this->dispatch.vkWaitSemaphoresKHR(this->vk_device, &wait_info, timeout)) == VK_TIMEOUT) { return false; }
+        else if (vk_result != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not wait for timeline semaphore: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        return true;
+    }
+
+    // Wait for the fence of the first signal that reaches the value; the lock is kept so the fence isn't recycled in the meantime
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    for (uint32_t i = 0; i < this->signals.size(); i++) {
+        if (this->signals[i].value < value) { continue; }
+
+        if ((vk_result = this->dispatch.vkWaitForFences(this->vk_device, 1, &this->signals[i].vk_fence, VK_TRUE, timeout)) == VK_TIMEOUT) { return false; }
+        else if (vk_result != VK_SUCCESS) {
+            logger.fatalc(Timeline::channel, "Could not wait for fence: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        break;
+    }
+    this->retire_signals();
+    return true;
+}
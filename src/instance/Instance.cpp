@@ -13,6 +13,7 @@
  *   instance of the Makma3D library.
 **/
 
+#include <cstring>
 #include <glfw/glfw3.h>
 
 #include "tools/Logger.hpp"
@@ -24,12 +25,36 @@ using namespace std;
 using namespace Makma3D;
 
 
+/***** HELPER FUNCTIONS *****/
+/* Returns whether the Vulkan implementation supports the given instance extension.
+ * @param extension The name of the instance extension to look for.
+ * @returns Whether it's supported (true) or not (false). */
+static bool instance_supports_extension(const char* extension) {
+    // Get the list of supported extensions
+    uint32_t n_extensions = 0;
+    if (vkEnumerateInstanceExtensionProperties(nullptr, &n_extensions, nullptr) != VK_SUCCESS) { return false; }
+    Tools::Array<VkExtensionProperties> extensions(n_extensions);
+    if (vkEnumerateInstanceExtensionProperties(nullptr, &n_extensions, extensions.wdata(n_extensions)) != VK_SUCCESS) { return false; }
+
+    // Try to find the given one
+    for (uint32_t i = 0; i < extensions.size(); i++) {
+        if (strcmp(extensions[i].extensionName, extension) == 0) { return true; }
+    }
+    return false;
+}
+
+
+
+
+
 /***** INSTANCE CLASS *****/
 /* The version of the Makma3D engine. */
 const Version Instance::version(0, 1, 0);
 
 /* Constructor for the Instance class. */
-Instance::Instance(const std::string& application_name, const Version& application_version, const Tools::Array<Extension>& extensions) {
+Instance::Instance(const std::string& application_name, const Version& application_version, const Tools::Array<Extension>& extensions) :
+    _headless_surface(false)
+{
     logger.logc(Verbosity::important, Instance::channel, "Initializing Makma3D...");
 
     /* EXTENSION COLLECTION */
@@ -52,6 +77,16 @@ Instance::Instance(const std::string& application_name, const Version& applicati
             vk_extensions += { VK_EXT_DEBUG_UTILS_EXTENSION_NAME };
             vk_layers     += { "VK_LAYER_KHRONOS_validation" };
             break;
+
+        case Extension::headless:
+            // The headless surface is optional; without it, we can still render offscreen
+            if (instance_supports_extension(VK_KHR_SURFACE_EXTENSION_NAME) && instance_supports_extension(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME)) {
+                vk_extensions += { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+                this->_headless_surface = true;
+            } else {
+                logger.warningc(Instance::channel, "Vulkan implementation does not support '", VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME, "'; headless rendering is limited to offscreen images.");
+            }
+            break;
         
         default:
             logger.fatalc(Instance::channel, "Cannot enable unsupported extension '", extension_names[(int) extensions[i]], "'.");
@@ -65,15 +100,25 @@ Instance::Instance(const std::string& application_name, const Version& applicati
 
 
 
+    // Devices need the extended property queries for their optional features; they're only an extension before Vulkan 1.1
+    if (Vulkanic::Instance::negotiate_api_version() < VK_API_VERSION_1_1 && instance_supports_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        vk_extensions += { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME };
+    }
+
+
+
     /* BACKEND INITIALIZATION */
-    // Initialize GLFW first
-    this->glfw_instance.init();
+    // Initialize GLFW first, unless we run without a display
+    if (!this->headless()) {
+        this->glfw_instance.init();
+        vk_extensions += this->glfw_instance.get_vulkan_extensions();
+    }
     // Then do Vulkan
-    this->vk_instance.init(application_name.c_str(), application_version.vk(), Instance::version.vk(), vk_extensions + this->glfw_instance.get_vulkan_extensions(), vk_layers);
+    this->vk_instance.init(application_name.c_str(), application_version.vk(), Instance::version.vk(), vk_extensions, vk_layers);
 
     // Next, if given, enable the debug parts of the backend
     if (this->extension_enabled(Extension::debug)) {
-        this->glfw_instance.init_debug();
+        if (!this->headless()) { this->glfw_instance.init_debug(); }
         this->vk_instance.init_debug();
     }
 
@@ -87,7 +132,8 @@ Instance::Instance(const std::string& application_name, const Version& applicati
 Instance::Instance(Instance&& other) :
     extensions(std::move(other.extensions)),
     glfw_instance(std::move(other.glfw_instance)),
-    vk_instance(std::move(other.vk_instance))
+    vk_instance(std::move(other.vk_instance)),
+    _headless_surface(other._headless_surface)
 {}
 
 /* Destructor for the Instance class. */
@@ -106,9 +152,40 @@ Tools::Array<Extension> Instance::get_extensions() const {
     return result;
 }
 
+/* Creates a new VkSurfaceKHR that is not backed by any display. */
+VkSurfaceKHR Instance::create_headless_surface() const {
+    if (!this->_headless_surface) {
+        logger.fatalc(Instance::channel, "Cannot create headless surface without the '", extension_names[(int) Extension::headless], "' extension or driver support for '", VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME, "'.");
+    }
+    return this->vk_instance.create_headless_surface();
+}
+
+
+
+/* Returns the physical device that the library thinks is most suited for headless rendering. */
+PhysicalDevice Instance::get_preferred_headless_physical_device(PhysicalDeviceType preferred_type) const {
+    // Get the list of physical devices
+    Tools::Array<PhysicalDevice> physical_devices = this->get_headless_physical_devices();
+    if (physical_devices.empty()) {
+        logger.fatalc(Instance::channel, "No supported devices found for headless rendering.");
+    }
+
+    // Return the one that scores best
+    return PhysicalDeviceRegistry::select(physical_devices, preferred_type);
+}
+
+/* Returns the list of (supported) PhysicalDevices that can render without a display. */
+Tools::Array<PhysicalDevice> Instance::get_headless_physical_devices() const {
+    // Without a surface, presentation support is not checked
+    return this->vk_instance.get_physical_devices(nullptr, this->get_device_extensions(), this->get_device_features());
+}
+
+
+
 /* Returns a list of Vulkan device extensions, based on the enabled Makma3D extensions + the ones we always require. */
-Tools::Array<const char*> Instance::get_device_extensions() const {
+Tools::Array<const char*> Instance::get_device_extensions(bool present) const {
     Tools::Array<const char*> result = {};
+    if (present) { result.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME); }
     for (Extension ext : this->extensions) {
         /* None, as of yet */
     }
@@ -133,4 +210,5 @@ void Makma3D::swap(Instance& i1, Instance& i2) {
     swap(i1.extensions, i2.extensions);
     swap(i1.glfw_instance, i2.glfw_instance);
     swap(i1.vk_instance, i2.vk_instance);
+    swap(i1._headless_surface, i2._headless_surface);
 }
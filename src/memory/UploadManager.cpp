@@ -0,0 +1,582 @@
+/* UPLOAD MANAGER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   15/10/2021, 10:02:14
+ * Last edited:
+ *   15/10/2021, 10:02:14
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the UploadManager class, which uses a persistently mapped
+ *   staging ring buffer and the Device's memory queue to upload buffers
+ *   and images asynchronously to device-local memory.
+**/
+
+#include <cstring>
+#include <limits>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "memory/UploadManager.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkBufferCreateInfo struct for the staging buffer.
+ * @param buffer_info The VkBufferCreateInfo struct to populate.
+ * @param size The size of the staging buffer, in bytes. */
+static void populate_buffer_info(VkBufferCreateInfo& buffer_info, VkDeviceSize size) {
+    // Set the meta info first
+    buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+    // The buffer is only ever copied from, and only by the memory queue
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+}
+
+/* Populates the given VkCommandPoolCreateInfo struct.
+ * @param pool_info The VkCommandPoolCreateInfo struct to populate.
+ * @param queue_family The queue family for which the pool allocates command buffers. */
+static void populate_pool_info(VkCommandPoolCreateInfo& pool_info, uint32_t queue_family) {
+    // Set the meta info first
+    pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+
+    // We re-record the same buffers over and over, so allow them to be reset individually
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+}
+
+/* Populates the given VkBufferMemoryBarrier struct.
+ * @param barrier The VkBufferMemoryBarrier struct to populate.
+ * @param vk_buffer The buffer to which the barrier applies.
+ * @param offset The offset of the region in the buffer.
+ * @param size The size of the region in the buffer.
+ * @param src_access The access mask before the barrier.
+ * @param src_family The queue family that owns the buffer before the barrier.
+ * @param dst_family The queue family that owns the buffer after the barrier. */
+static void populate_buffer_barrier(VkBufferMemoryBarrier& barrier, VkBuffer vk_buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags src_access, uint32_t src_family, uint32_t dst_family) {
+    // Set the meta info first
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+
+    // Set the access masks; the destination one is only known when the barrier is recorded
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = 0;
+
+    // Set the queue families
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+
+    // Finally, set the region of the buffer
+    barrier.buffer = vk_buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+}
+
+/* Populates the given VkImageMemoryBarrier struct.
+ * @param barrier The VkImageMemoryBarrier struct to populate.
+ * @param vk_image The image to which the barrier applies.
+ * @param subresource The subresource of the image to which the barrier applies.
+ * @param old_layout The layout of the image before the barrier.
+ * @param new_layout The layout of the image after the barrier.
+ * @param src_access The access mask before the barrier.
+ * @param dst_access The access mask after the barrier.
+ * @param src_family The queue family that owns the image before the barrier.
+ * @param dst_family The queue family that owns the image after the barrier. */
+static void populate_image_barrier(VkImageMemoryBarrier& barrier, VkImage vk_image, const VkImageSubresourceLayers& subresource, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access, uint32_t src_family, uint32_t dst_family) {
+    // Set the meta info first
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+    // Set the access masks & the layouts
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+
+    // Set the queue families
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+
+    // Finally, set the part of the image
+    barrier.image = vk_image;
+    barrier.subresourceRange.aspectMask = subresource.aspectMask;
+    barrier.subresourceRange.baseMipLevel = subresource.mipLevel;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = subresource.baseArrayLayer;
+    barrier.subresourceRange.layerCount = subresource.layerCount;
+}
+
+
+
+
+
+/***** UPLOADMANAGER CLASS *****/
+/* Constructor for the UploadManager class. */
+UploadManager::UploadManager(const Makma3D::Device& device, VkDeviceSize ring_size) :
+    device(device),
+
+    vk_staging_buffer(nullptr),
+    vk_staging_memory(nullptr),
+    staging_memory_type(0),
+    staging_memory_size(0),
+    staging_map(nullptr),
+    ring_size(ring_size),
+    ring_tail(0),
+    ring_head(0),
+    ring_used(0),
+
+    vk_command_pool(nullptr),
+    batches({}, UploadManager::n_batches),
+    current_batch(0),
+    oldest_batch(0),
+    next_token(null_upload_token + 1),
+    completed_token(null_upload_token)
+{
+    // Create the staging buffer
+    VkBufferCreateInfo buffer_info;
+    populate_buffer_info(buffer_info, this->ring_size);
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(this->device, &buffer_info, nullptr, &this->vk_staging_buffer)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not create staging buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->device.get_debug_markup().name(this->vk_staging_buffer, "UploadManager staging ring");
+
+    // Allocate host-visible memory for it
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(this->device, this->vk_staging_buffer, &requirements);
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = this->device.get_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if ((vk_result = this->device.get_memory_budget().allocate(allocate_info, this->vk_staging_memory)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not allocate staging memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->staging_memory_type = allocate_info.memoryTypeIndex;
+    this->staging_memory_size = allocate_info.allocationSize;
+    if ((vk_result = vkBindBufferMemory(this->device, this->vk_staging_buffer, this->vk_staging_memory, 0)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not bind staging memory to staging buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Map it once; it stays mapped for the lifetime of the manager
+    void* map;
+    if ((vk_result = this->device.get_dispatch().vkMapMemory(this->device, this->vk_staging_memory, 0, this->ring_size, 0, &map)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not map staging memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->staging_map = (uint8_t*) map;
+
+    // Create the command pool on the memory queue's family
+    VkCommandPoolCreateInfo pool_info;
+    populate_pool_info(pool_info, this->device.get_queue_family(Vulkanic::QueueType::memory));
+    if ((vk_result = vkCreateCommandPool(this->device, &pool_info, nullptr, &this->vk_command_pool)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not create command pool: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Allocate a command buffer and a fence for each batch
+    VkCommandBufferAllocateInfo command_buffer_info = {};
+    command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_info.commandPool = this->vk_command_pool;
+    command_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_info.commandBufferCount = 1;
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    for (uint32_t i = 0; i < this->batches.size(); i++) {
+        if ((vk_result = this->device.get_dispatch().vkAllocateCommandBuffers(this->device, &command_buffer_info, &this->batches[i].vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatalc(UploadManager::channel, "Could not allocate command buffer for batch ", i, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        if ((vk_result = vkCreateFence(this->device, &fence_info, nullptr, &this->batches[i].vk_fence)) != VK_SUCCESS) {
+            logger.fatalc(UploadManager::channel, "Could not create fence for batch ", i, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+    }
+
+    // Done
+    logger.logc(Verbosity::details, UploadManager::channel, "Initialized with a staging ring of ", this->ring_size, " bytes.");
+}
+
+/* Move constructor for the UploadManager class. */
+UploadManager::UploadManager(UploadManager&& other) :
+    device(other.device),
+
+    vk_staging_buffer(other.vk_staging_buffer),
+    vk_staging_memory(other.vk_staging_memory),
+    staging_memory_type(other.staging_memory_type),
+    staging_memory_size(other.staging_memory_size),
+    staging_map(other.staging_map),
+    ring_size(other.ring_size),
+    ring_tail(other.ring_tail),
+    ring_head(other.ring_head),
+    ring_used(other.ring_used),
+
+    vk_command_pool(other.vk_command_pool),
+    batches(std::move(other.batches)),
+    current_batch(other.current_batch),
+    oldest_batch(other.oldest_batch),
+    next_token(other.next_token),
+    completed_token(other.completed_token),
+
+    releases(std::move(other.releases)),
+    acquires(std::move(other.acquires))
+{
+    other.vk_staging_buffer = nullptr;
+    other.vk_staging_memory = nullptr;
+    other.staging_map = nullptr;
+    other.vk_command_pool = nullptr;
+}
+
+/* Destructor for the UploadManager class. */
+UploadManager::~UploadManager() {
+    if (this->vk_command_pool != nullptr) {
+        // Submit whatever is left, and then wait until everything is done
+        this->flush();
+        while (this->batches[this->oldest_batch].in_flight) {
+            this->retire_batches(true);
+        }
+
+        // Destroy the batches and the pool
+        for (uint32_t i = 0; i < this->batches.size(); i++) {
+            vkDestroyFence(this->device, this->batches[i].vk_fence, nullptr);
+        }
+        vkDestroyCommandPool(this->device, this->vk_command_pool, nullptr);
+    }
+
+    if (this->vk_staging_memory != nullptr) {
+        this->device.get_dispatch().vkUnmapMemory(this->device, this->vk_staging_memory);
+        this->device.get_memory_budget().free(this->vk_staging_memory, this->staging_memory_type, this->staging_memory_size);
+    }
+    if (this->vk_staging_buffer != nullptr) {
+        vkDestroyBuffer(this->device, this->vk_staging_buffer, nullptr);
+    }
+}
+
+
+
+/* Allocates space in the staging ring, flushing and waiting for older batches if it's full. */
+VkDeviceSize UploadManager::allocate_staging(VkDeviceSize size) {
+    // We can never allocate more than the ring has
+    if (size > this->ring_size) {
+        logger.fatalc(UploadManager::channel, "Cannot upload ", size, " bytes at once with a staging ring of ", this->ring_size, " bytes.");
+    }
+
+    // Try to find a spot until we succeed
+    VkDeviceSize offset, bytes;
+    while (true) {
+        // If the ring is empty, simply start at the front again
+        if (this->ring_used == 0) {
+            this->ring_tail = 0;
+            this->ring_head = 0;
+        }
+
+        // Compute the aligned start of the next region
+        offset = (this->ring_head + UploadManager::staging_alignment - 1) & ~(UploadManager::staging_alignment - 1);
+        if (this->ring_head > this->ring_tail || this->ring_used == 0) {
+            // The free space is both behind the head and before the tail
+            if (offset + size <= this->ring_size) {
+                bytes = offset + size - this->ring_head;
+                break;
+            } else if (size <= this->ring_tail) {
+                // Wrap around to the front, wasting the end of the ring
+                bytes = this->ring_size - this->ring_head + size;
+                offset = 0;
+                break;
+            }
+        } else if (this->ring_head < this->ring_tail && offset + size <= this->ring_tail) {
+            // The free space is between the head and the tail
+            bytes = offset + size - this->ring_head;
+            break;
+        }
+
+        // There's no space; submit what we have and wait for the oldest batch to free up some space
+        logger.logc(Verbosity::details, UploadManager::channel, "Staging ring full (", this->ring_used, "/", this->ring_size, " bytes in use); waiting for older uploads.");
+        this->flush();
+        if (!this->batches[this->oldest_batch].in_flight) {
+            logger.fatalc(UploadManager::channel, "Staging ring is full but no batches are in flight.");
+        }
+        this->retire_batches(true);
+    }
+
+    // Claim the region, and add it to the current batch
+    this->ring_head = offset + size;
+    this->ring_used += bytes;
+    Batch& batch = this->begin_batch();
+    batch.ring_end = this->ring_head;
+    batch.ring_bytes += bytes;
+    return offset;
+}
+
+/* Makes sure the current batch is being recorded, beginning it if it isn't. */
+UploadManager::Batch& UploadManager::begin_batch() {
+    Batch& batch = this->batches[this->current_batch];
+    if (batch.recording) { return batch; }
+
+    // If the batch is still in flight, we have to wait until it's done (it's the oldest one)
+    while (batch.in_flight) {
+        this->retire_batches(true);
+    }
+
+    // Begin the command buffer
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult vk_result;
+    if ((vk_result = this->device.get_dispatch().vkBeginCommandBuffer(batch.vk_command_buffer, &begin_info)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not begin command buffer of batch ", this->current_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Mark it as recording with a fresh token
+    batch.token = this->next_token++;
+    batch.ring_end = this->ring_head;
+    batch.ring_bytes = 0;
+    batch.recording = true;
+    return batch;
+}
+
+/* Checks the oldest in-flight batches for completion, freeing their staging regions. */
+void UploadManager::retire_batches(bool wait) {
+    VkResult vk_result;
+    while (this->batches[this->oldest_batch].in_flight) {
+        Batch& batch = this->batches[this->oldest_batch];
+
+        // Check if the batch is done, blocking only for the first one if told to do so
+        if (wait) {
+            vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &batch.vk_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            wait = false;
+        } else {
+            vk_result = this->device.get_dispatch().vkGetFenceStatus(this->device, batch.vk_fence);
+        }
+        if (vk_result == VK_NOT_READY || vk_result == VK_TIMEOUT) { return; }
+        else if (vk_result != VK_SUCCESS) {
+            logger.fatalc(UploadManager::channel, "Could not wait for batch ", this->oldest_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // It's done, so free its part of the ring
+        if ((vk_result = this->device.get_dispatch().vkResetFences(this->device, 1, &batch.vk_fence)) != VK_SUCCESS) {
+            logger.fatalc(UploadManager::channel, "Could not reset fence of batch ", this->oldest_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        this->ring_tail = batch.ring_end;
+        this->ring_used -= batch.ring_bytes;
+        this->completed_token = batch.token;
+        batch.in_flight = false;
+
+        // Move to the next one
+        this->oldest_batch = (this->oldest_batch + 1) % this->batches.size();
+    }
+}
+
+
+
+/* Schedules a copy of the given data to the given (device-local) buffer. The copy is only submitted on the next flush(). */
+upload_token_t UploadManager::upload(VkBuffer vk_buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, Vulkanic::QueueType target_queue) {
+    // Copy the data to the staging ring
+    VkDeviceSize staging_offset = this->allocate_staging(size);
+    memcpy(this->staging_map + staging_offset, data, size);
+
+    // Record the copy
+    Batch& batch = this->batches[this->current_batch];
+    VkBufferCopy region = {};
+    region.srcOffset = staging_offset;
+    region.dstOffset = offset;
+    region.size = size;
+    this->device.get_dispatch().vkCmdCopyBuffer(batch.vk_command_buffer, this->vk_staging_buffer, vk_buffer, 1, &region);
+
+    // Prepare the ownership transfer (or, if the family is the same, only the visibility barrier)
+    uint32_t src_family = this->device.get_queue_family(Vulkanic::QueueType::memory);
+    uint32_t dst_family = this->device.get_queue_family(target_queue);
+    Tools::Array<Acquires>& acquires = this->acquires[batch.token];
+    if (acquires.empty()) { acquires.resize(Vulkanic::n_queue_types); }
+    VkBufferMemoryBarrier barrier;
+    if (src_family != dst_family) {
+        populate_buffer_barrier(barrier, vk_buffer, offset, size, VK_ACCESS_TRANSFER_WRITE_BIT, src_family, dst_family);
+        this->releases.buffers.push_back(barrier);
+        barrier.srcAccessMask = 0;
+    } else {
+        populate_buffer_barrier(barrier, vk_buffer, offset, size, VK_ACCESS_TRANSFER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    }
+    acquires[(uint32_t) target_queue].buffers.push_back(barrier);
+
+    // Done
+    return batch.token;
+}
+
+/* Schedules a copy of the given tightly-packed pixel data to the given (device-local) image. The copy is only submitted on the next flush(). */
+upload_token_t UploadManager::upload(VkImage vk_image, const VkImageSubresourceLayers& subresource, const VkExtent3D& extent, const void* data, VkDeviceSize size, VkImageLayout final_layout, Vulkanic::QueueType target_queue) {
+    // Copy the data to the staging ring
+    VkDeviceSize staging_offset = this->allocate_staging(size);
+    memcpy(this->staging_map + staging_offset, data, size);
+
+    // Transition the image to a layout we can copy to
+    Batch& batch = this->batches[this->current_batch];
+    VkImageMemoryBarrier barrier;
+    populate_image_barrier(barrier, vk_image, subresource, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    this->device.get_dispatch().vkCmdPipelineBarrier(batch.vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // Record the copy
+    VkBufferImageCopy region = {};
+    region.bufferOffset = staging_offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = subresource;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = extent;
+    this->device.get_dispatch().vkCmdCopyBufferToImage(batch.vk_command_buffer, this->vk_staging_buffer, vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // Prepare the transition to the final layout, which doubles as ownership transfer if the families differ
+    uint32_t src_family = this->device.get_queue_family(Vulkanic::QueueType::memory);
+    uint32_t dst_family = this->device.get_queue_family(target_queue);
+    Tools::Array<Acquires>& acquires = this->acquires[batch.token];
+    if (acquires.empty()) { acquires.resize(Vulkanic::n_queue_types); }
+    if (src_family != dst_family) {
+        populate_image_barrier(barrier, vk_image, subresource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_ACCESS_TRANSFER_WRITE_BIT, 0, src_family, dst_family);
+        this->releases.images.push_back(barrier);
+        barrier.srcAccessMask = 0;
+    } else {
+        populate_image_barrier(barrier, vk_image, subresource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+        this->releases.images.push_back(barrier);
+        barrier.oldLayout = final_layout;
+    }
+    acquires[(uint32_t) target_queue].images.push_back(barrier);
+
+    // Done
+    return batch.token;
+}
+
+/* Submits all scheduled copies to the memory queue. */
+upload_token_t UploadManager::flush() {
+    Batch& batch = this->batches[this->current_batch];
+    if (!batch.recording) { return this->next_token - 1; }
+
+    // Record the release barriers
+    if (!this->releases.buffers.empty() || !this->releases.images.empty()) {
+        this->device.get_dispatch().vkCmdPipelineBarrier(batch.vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, this->releases.buffers.size(), this->releases.buffers.rdata(), this->releases.images.size(), this->releases.images.rdata());
+        this->releases.buffers.clear();
+        this->releases.images.clear();
+    }
+
+    // Finish the command buffer
+    VkResult vk_result;
+    if ((vk_result = this->device.get_dispatch().vkEndCommandBuffer(batch.vk_command_buffer)) != VK_SUCCESS) {
+        logger.fatalc(UploadManager::channel, "Could not end command buffer of batch ", this->current_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Submit it to the memory queue, signalling the queue's timeline so anything that judges completion by it (e.g., the DeletionQueue) sees the upload
+    {
+        QueueLease queue = this->device.lease_queue(Vulkanic::QueueType::memory);
+        TimelineSignal signal = queue.timeline().prepare_signal();
+
+        VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &signal.value;
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = queue.timeline().is_timeline() ? &timeline_info : nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.vk_command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &signal.vk_semaphore;
+        if ((vk_result = this->device.get_dispatch().vkQueueSubmit(queue, 1, &submit_info, batch.vk_fence)) != VK_SUCCESS) {
+            logger.fatalc(UploadManager::channel, "Could not submit batch ", this->current_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // The binary fallback needs its own fence, which we signal with a second, empty submit
+        if (signal.vk_fence != nullptr) {
+            if ((vk_result = this->device.get_dispatch().vkQueueSubmit(queue, 0, nullptr, signal.vk_fence)) != VK_SUCCESS) {
+                logger.fatalc(UploadManager::channel, "Could not submit timeline fence of batch ", this->current_batch, ": ", Vulkanic::vk_error_map.at(vk_result));
+            }
+        }
+    }
+
+    // Mark it as in flight and move to the next batch
+    batch.recording = false;
+    batch.in_flight = true;
+    this->current_batch = (this->current_batch + 1) % this->batches.size();
+    return batch.token;
+}
+
+
+
+/* Returns whether the upload(s) with the given token are done. Does not block. */
+bool UploadManager::is_done(upload_token_t token) {
+    if (token <= this->completed_token) { return true; }
+    this->retire_batches(false);
+    return token <= this->completed_token;
+}
+
+/* Blocks until the upload(s) with the given token are done, flushing them first if they weren't submitted yet. */
+void UploadManager::wait(upload_token_t token) {
+    if (token <= this->completed_token) { return; }
+
+    // If the token is still being recorded, submit it first
+    const Batch& batch = this->batches[this->current_batch];
+    if (batch.recording && token >= batch.token) { this->flush(); }
+
+    // Wait until the token is done
+    while (token > this->completed_token) {
+        if (!this->batches[this->oldest_batch].in_flight) {
+            logger.fatalc(UploadManager::channel, "Cannot wait for unknown upload token ", token, ".");
+        }
+        this->retire_batches(true);
+    }
+}
+
+/* Records the acquire half of the ownership transfers of the given upload(s) on the given command buffer. */
+void UploadManager::acquire(VkCommandBuffer vk_command_buffer, upload_token_t token, Vulkanic::QueueType target_queue, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    // Get the barriers for this token, if any
+    std::unordered_map<upload_token_t, Tools::Array<Acquires>>::iterator iter = this->acquires.find(token);
+    if (iter == this->acquires.end()) { return; }
+    Acquires& acquires = iter->second[(uint32_t) target_queue];
+
+    // Record them with the given destination access
+    if (!acquires.buffers.empty() || !acquires.images.empty()) {
+        for (uint32_t i = 0; i < acquires.buffers.size(); i++) { acquires.buffers[i].dstAccessMask = dst_access; }
+        for (uint32_t i = 0; i < acquires.images.size(); i++) { acquires.images[i].dstAccessMask = dst_access; }
+        this->device.get_dispatch().vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, nullptr, acquires.buffers.size(), acquires.buffers.rdata(), acquires.images.size(), acquires.images.rdata());
+        acquires.buffers.clear();
+        acquires.images.clear();
+    }
+
+    // Remove the token once all of its queues have acquired
+    for (uint32_t i = 0; i < iter->second.size(); i++) {
+        if (!iter->second[i].buffers.empty() || !iter->second[i].images.empty()) { return; }
+    }
+    this->acquires.erase(iter);
+}
+
+
+
+/* Swap operator for the UploadManager class. */
+void Makma3D::swap(UploadManager& um1, UploadManager& um2) {
+    #ifndef NDEBUG
+    if (&um1.device != &um2.device) { logger.fatalc(UploadManager::channel, "Cannot swap upload managers with different devices."); }
+    #endif
+
+    using std::swap;
+
+    swap(um1.vk_staging_buffer, um2.vk_staging_buffer);
+    swap(um1.vk_staging_memory, um2.vk_staging_memory);
+    swap(um1.staging_memory_type, um2.staging_memory_type);
+    swap(um1.staging_memory_size, um2.staging_memory_size);
+    swap(um1.staging_map, um2.staging_map);
+    swap(um1.ring_size, um2.ring_size);
+    swap(um1.ring_tail, um2.ring_tail);
+    swap(um1.ring_head, um2.ring_head);
+    swap(um1.ring_used, um2.ring_used);
+
+    swap(um1.vk_command_pool, um2.vk_command_pool);
+    swap(um1.batches, um2.batches);
+    swap(um1.current_batch, um2.current_batch);
+    swap(um1.oldest_batch, um2.oldest_batch);
+    swap(um1.next_token, um2.next_token);
+    swap(um1.completed_token, um2.completed_token);
+
+    swap(um1.releases, um2.releases);
+    swap(um1.acquires, um2.acquires);
+}
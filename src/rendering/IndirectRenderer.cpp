@@ -0,0 +1,522 @@
+/* INDIRECT RENDERER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 17:31:52
+ * Last edited:
+ *   18/10/2021, 17:31:52
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the IndirectRenderer class, which keeps the objects of a
+ *   scene in a storage buffer and draws all of them that survive frustum
+ *   culling with a single indirect draw. The culling and compaction is
+ *   done by a compute shader if the device can read the draw count from
+ *   a buffer, and on the CPU otherwise.
+**/
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "rendering/IndirectRenderer.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkBufferCreateInfo struct.
+ * @param buffer_info The VkBufferCreateInfo struct to populate.
+ * @param size The size of the buffer. */
+static void populate_buffer_info(VkBufferCreateInfo& buffer_info, VkDeviceSize size) {
+    // Set to default
+    buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+    // The buffer is read and written by the culling shader, read by the indirect draws and its count is cleared with a fill
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+}
+
+/* Populates the given VkMemoryBarrier struct.
+ * @param barrier The VkMemoryBarrier struct to populate.
+ * @param src_access The writes to make available.
+ * @param dst_access The accesses to make them visible to. */
+static void populate_memory_barrier(VkMemoryBarrier& barrier, VkAccessFlags src_access, VkAccessFlags dst_access) {
+    // Set to default
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+    // Set the accesses
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+}
+
+/* Populates the given VkWriteDescriptorSet struct for a storage buffer.
+ * @param write The VkWriteDescriptorSet struct to populate.
+ * @param vk_descriptor_set The set to write to.
+ * @param binding The binding in the set to write to.
+ * @param buffer_info The buffer region to write. */
+static void populate_write(VkWriteDescriptorSet& write, VkDescriptorSet vk_descriptor_set, uint32_t binding, const VkDescriptorBufferInfo& buffer_info) {
+    // Set to default
+    write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+
+    // Set the target
+    write.dstSet = vk_descriptor_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = 0;
+
+    // Set the buffer
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+}
+
+
+
+
+
+/* Populates the given VkPipelineLayoutCreateInfo struct.
+ * @param layout_info The VkPipelineLayoutCreateInfo struct to populate.
+ * @param vk_descriptor_set_layout The layout of the set the shader uses.
+ * @param push_constant_range The range of the shader's push constants. */
+static void populate_pipeline_layout_info(VkPipelineLayoutCreateInfo& layout_info, const VkDescriptorSetLayout& vk_descriptor_set_layout, const VkPushConstantRange& push_constant_range) {
+    // Set to default
+    layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+    // A single set and the push constants
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &vk_descriptor_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+}
+
+/* Populates the given VkComputePipelineCreateInfo struct.
+ * @param pipeline_info The VkComputePipelineCreateInfo struct to populate.
+ * @param vk_module The module with the shader code.
+ * @param vk_pipeline_layout The layout of the pipeline. */
+static void populate_pipeline_info(VkComputePipelineCreateInfo& pipeline_info, VkShaderModule vk_module, VkPipelineLayout vk_pipeline_layout) {
+    // Set to default
+    pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+
+    // Set the shader stage
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = vk_module;
+    pipeline_info.stage.pName = "main";
+
+    // Set the layout
+    pipeline_info.layout = vk_pipeline_layout;
+}
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Rounds the given size up to the given alignment. */
+static inline VkDeviceSize align(VkDeviceSize size, VkDeviceSize alignment) {
+    return alignment > 1 ? ((size + alignment - 1) / alignment) * alignment : size;
+}
+
+
+
+
+
+/***** INDIRECTRENDERER CLASS *****/
+/* Constructor for the IndirectRenderer class. */
+IndirectRenderer::IndirectRenderer(const Makma3D::Device& device, uint32_t max_objects, uint32_t n_frames, const std::string& cull_shader) :
+    device(device),
+
+    vk_buffer(nullptr),
+    vk_memory(nullptr),
+    memory_type(0),
+    memory_size(0),
+    map(nullptr),
+    frames(n_frames),
+    current_frame(0),
+
+    objects(max_objects),
+    _max_objects(max_objects),
+    n_cpu_draws(0),
+    layout(nullptr),
+    vk_pipeline_layout(nullptr),
+    vk_pipeline(nullptr),
+    _gpu_culling(false),
+
+    _statistics({ 0, 0, 0, 0, 0 })
+{
+    // Lay out the regions of each frame, each at an offset the storage buffer descriptors accept
+    VkDeviceSize alignment = std::max((VkDeviceSize) 4, this->device.get_physical_device().properties().limits.minStorageBufferOffsetAlignment);
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < n_frames; i++) {
+        FrameRegions regions;
+        regions.objects = size;
+        size = align(size + max_objects * sizeof(IndirectObject), alignment);
+        regions.draws = size;
+        size = align(size + max_objects * sizeof(VkDrawIndexedIndirectCommand), alignment);
+        regions.count = size;
+        size = align(size + sizeof(uint32_t), alignment);
+        this->frames.push_back(regions);
+    }
+
+    // Create the buffer
+    VkBufferCreateInfo buffer_info;
+    populate_buffer_info(buffer_info, size);
+    VkResult vk_result;
+    if ((vk_result = vkCreateBuffer(this->device, &buffer_info, nullptr, &this->vk_buffer)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not create object buffer: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->device.get_debug_markup().name(this->vk_buffer, "IndirectRenderer objects");
+
+    // Back it with host-visible memory, so the CPU can write the objects and, if need be, the draws directly
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(this->device, this->vk_buffer, &requirements);
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = this->device.get_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if ((vk_result = this->device.get_memory_budget().allocate(allocate_info, this->vk_memory)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not allocate object buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->memory_type = allocate_info.memoryTypeIndex;
+    this->memory_size = allocate_info.allocationSize;
+    if ((vk_result = vkBindBufferMemory(this->device, this->vk_buffer, this->vk_memory, 0)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not bind object buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Map it once; it stays mapped for the lifetime of the renderer
+    void* mapped;
+    if ((vk_result = this->device.get_dispatch().vkMapMemory(this->device, this->vk_memory, 0, VK_WHOLE_SIZE, 0, &mapped)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not map object buffer memory: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->map = (uint8_t*) mapped;
+
+    // Fetch the layout for the culling shader
+    Tools::Array<VkDescriptorSetLayoutBinding> bindings(3);
+    for (uint32_t i = 0; i < 3; i++) {
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = i;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings.push_back(binding);
+    }
+    this->layout = &this->device.get_descriptor_allocator().get_layout(bindings);
+
+    // Cull on the GPU if we can draw a count the GPU decides; this also needs more than one draw per call
+    if (this->device.has_feature(Vulkanic::DeviceFeature::draw_indirect_count) && this->device.has_feature(Vulkanic::DeviceFeature::multi_draw_indirect)) {
+        this->_gpu_culling = this->device.get_dispatch().vkCmdDrawIndexedIndirectCountKHR != nullptr;
+        if (!this->_gpu_culling) {
+            logger.warningc(IndirectRenderer::channel, "Could not load vkCmdDrawIndexedIndirectCountKHR; falling back to culling on the CPU.");
+        }
+    }
+    if (this->_gpu_culling && cull_shader.empty()) {
+        this->_gpu_culling = false;
+    } else if (this->_gpu_culling && !this->create_pipeline(cull_shader)) {
+        logger.warningc(IndirectRenderer::channel, "Could not read culling shader '", cull_shader, "'; falling back to culling on the CPU.");
+        this->_gpu_culling = false;
+    }
+
+    // Done
+    logger.logc(Verbosity::details, IndirectRenderer::channel, "Initialized for ", max_objects, " objects over ", n_frames, " frames (", size, " bytes), culling on the ", this->gpu_culling() ? "GPU" : "CPU", ".");
+}
+
+/* Move constructor for the IndirectRenderer class. */
+IndirectRenderer::IndirectRenderer(IndirectRenderer&& other) :
+    device(other.device),
+
+    vk_buffer(other.vk_buffer),
+    vk_memory(other.vk_memory),
+    memory_type(other.memory_type),
+    memory_size(other.memory_size),
+    map(other.map),
+    frames(std::move(other.frames)),
+    current_frame(other.current_frame),
+
+    objects(std::move(other.objects)),
+    _max_objects(other._max_objects),
+    n_cpu_draws(other.n_cpu_draws),
+    layout(other.layout),
+    vk_pipeline_layout(other.vk_pipeline_layout),
+    vk_pipeline(other.vk_pipeline),
+    _gpu_culling(other._gpu_culling),
+
+    _statistics(other._statistics)
+{
+    other.vk_buffer = nullptr;
+    other.vk_memory = nullptr;
+    other.map = nullptr;
+    other.vk_pipeline_layout = nullptr;
+    other.vk_pipeline = nullptr;
+}
+
+/* Destructor for the IndirectRenderer class. */
+IndirectRenderer::~IndirectRenderer() {
+    if (this->vk_memory != nullptr) {
+        // Report the statistics
+        uint64_t n_frames = this->_statistics.n_gpu_frames + this->_statistics.n_cpu_frames;
+        if (n_frames > 0) {
+            logger.logc(Verbosity::details, IndirectRenderer::channel, "Culled ", this->_statistics.n_gpu_frames, " frames on the GPU and ", this->_statistics.n_cpu_frames, " on the CPU (", this->_statistics.n_cpu_visible, "/", this->_statistics.n_cpu_objects, " objects visible), using ", this->_statistics.n_draw_calls, " draw calls.");
+        }
+
+        this->device.get_memory_budget().free(this->vk_memory, this->memory_type, this->memory_size);
+    }
+    if (this->vk_buffer != nullptr) {
+        vkDestroyBuffer(this->device, this->vk_buffer, nullptr);
+    }
+    if (this->vk_pipeline != nullptr) {
+        vkDestroyPipeline(this->device, this->vk_pipeline, nullptr);
+    }
+    if (this->vk_pipeline_layout != nullptr) {
+        vkDestroyPipelineLayout(this->device, this->vk_pipeline_layout, nullptr);
+    }
+}
+
+
+
+/* Creates the culling pipeline from the SPIR-V file at the given path. */
+bool IndirectRenderer::create_pipeline(const std::string& cull_shader) {
+    // Read the code
+    std::ifstream h(cull_shader, std::ios::binary | std::ios::ate);
+    if (!h.is_open()) { return false; }
+    std::streamsize size = h.tellg();
+    if (size <= 0 || size % sizeof(uint32_t) != 0) { return false; }
+    uint32_t n_words = static_cast<uint32_t>(size / sizeof(uint32_t));
+    Tools::Array<uint32_t> code(n_words);
+    h.seekg(0);
+    if (!h.read((char*) code.wdata(n_words), size)) { return false; }
+    h.close();
+
+    // Wrap it in a module, which is only needed until the pipeline exists
+    VkShaderModuleCreateInfo module_info = {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = static_cast<size_t>(size);
+    module_info.pCode = code.rdata();
+    VkShaderModule vk_module;
+    VkResult vk_result;
+    if ((vk_result = vkCreateShaderModule(this->device, &module_info, nullptr, &vk_module)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not create culling shader module: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Create the layout, with the set at 0 and the constants as push constants
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullConstants);
+    VkPipelineLayoutCreateInfo layout_info;
+    populate_pipeline_layout_info(layout_info, this->layout->vk_descriptor_set_layout, push_constant_range);
+    if ((vk_result = vkCreatePipelineLayout(this->device, &layout_info, nullptr, &this->vk_pipeline_layout)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not create culling pipeline layout: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+
+    // Create the pipeline itself
+    VkComputePipelineCreateInfo pipeline_info;
+    populate_pipeline_info(pipeline_info, vk_module, this->vk_pipeline_layout);
+    if ((vk_result = vkCreateComputePipelines(this->device, nullptr, 1, &pipeline_info, nullptr, &this->vk_pipeline)) != VK_SUCCESS) {
+        logger.fatalc(IndirectRenderer::channel, "Could not create culling pipeline: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->device.get_debug_markup().name(this->vk_pipeline, "IndirectRenderer cull");
+    vkDestroyShaderModule(this->device, vk_module, nullptr);
+
+    // Done
+    return true;
+}
+
+
+
+/* Adds an object to the renderer. */
+uint32_t IndirectRenderer::add_object(const IndirectObject& object) {
+    if (this->objects.size() >= this->_max_objects) {
+        logger.fatalc(IndirectRenderer::channel, "Cannot add more than ", this->_max_objects, " objects.");
+    }
+    this->objects.push_back(object);
+    return this->objects.size() - 1;
+}
+
+/* Changes an object in the renderer. */
+void IndirectRenderer::set_object(uint32_t index, const IndirectObject& object) {
+    #ifndef NDEBUG
+    if (index >= this->objects.size()) { logger.fatalc(IndirectRenderer::channel, "Object index ", index, " is out of bounds for renderer with ", this->objects.size(), " objects."); }
+    #endif
+    this->objects[index] = object;
+}
+
+/* Removes all objects from the renderer. */
+void IndirectRenderer::clear() {
+    this->objects.clear();
+}
+
+
+
+/* Moves to the given frame, and copies the objects into its buffers. */
+void IndirectRenderer::begin_frame(uint32_t frame) {
+    #ifndef NDEBUG
+    if (frame >= this->frames.size()) { logger.fatalc(IndirectRenderer::channel, "Frame index ", frame, " is out of bounds for renderer with ", this->frames.size(), " frames."); }
+    #endif
+    this->current_frame = frame;
+    this->n_cpu_draws = 0;
+
+    // The frame is done on the GPU, so we can simply overwrite its objects
+    if (this->objects.size() > 0) {
+        memcpy(this->map + this->frames[frame].objects, this->objects.rdata(), this->objects.size() * sizeof(IndirectObject));
+    }
+}
+
+/* Culls the objects against the given frustum and writes the draws of the visible ones for the current frame. */
+void IndirectRenderer::cull(VkCommandBuffer vk_command_buffer, const glm::mat4& view_projection) {
+    const FrameRegions& regions = this->frames[this->current_frame];
+    CullConstants constants;
+    extract_frustum(view_projection, constants.planes);
+    constants.n_objects = this->objects.size();
+
+    if (!this->gpu_culling()) {
+        // Test every bounding sphere against the planes, and append a draw for those that are inside all of them
+        VkDrawIndexedIndirectCommand* draws = (VkDrawIndexedIndirectCommand*) (this->map + regions.draws);
+        bool first_instance = this->device.has_feature(Vulkanic::DeviceFeature::multi_draw_indirect);
+        uint32_t n_draws = 0;
+        for (uint32_t i = 0; i < this->objects.size(); i++) {
+            const IndirectObject& object = this->objects[i];
+            bool visible = true;
+            for (uint32_t p = 0; p < 6 && visible; p++) {
+                visible = glm::dot(glm::vec3(constants.planes[p]), object.center) + constants.planes[p].w >= -object.radius;
+            }
+            if (!visible) { continue; }
+
+            VkDrawIndexedIndirectCommand& draw = draws[n_draws++];
+            draw.indexCount = object.index_count;
+            draw.instanceCount = 1;
+            draw.firstIndex = object.first_index;
+            draw.vertexOffset = object.vertex_offset;
+            draw.firstInstance = first_instance ? i : 0;
+        }
+        this->n_cpu_draws = n_draws;
+
+        ++this->_statistics.n_cpu_frames;
+        this->_statistics.n_cpu_visible += n_draws;
+        this->_statistics.n_cpu_objects += this->objects.size();
+        return;
+    }
+
+    // Reset the count, and make sure the shader sees that
+    this->device.get_debug_markup().begin_label(vk_command_buffer, "IndirectRenderer cull");
+    this->device.get_dispatch().vkCmdFillBuffer(vk_command_buffer, this->vk_buffer, regions.count, sizeof(uint32_t), 0);
+    VkMemoryBarrier barrier;
+    populate_memory_barrier(barrier, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    this->device.get_dispatch().vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // Point a fresh descriptor set at this frame's regions
+    VkDescriptorSet vk_descriptor_set = this->device.get_descriptor_allocator().allocate(*this->layout);
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        { this->vk_buffer, regions.objects, std::max((VkDeviceSize) 1, (VkDeviceSize) this->_max_objects) * sizeof(IndirectObject) },
+        { this->vk_buffer, regions.draws, std::max((VkDeviceSize) 1, (VkDeviceSize) this->_max_objects) * sizeof(VkDrawIndexedIndirectCommand) },
+        { this->vk_buffer, regions.count, sizeof(uint32_t) }
+    };
+    VkWriteDescriptorSet writes[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        populate_write(writes[i], vk_descriptor_set, i, buffer_infos[i]);
+    }
+    this->device.get_dispatch().vkUpdateDescriptorSets(this->device, 3, writes, 0, nullptr);
+
+    // Run the culling shader
+    this->device.get_dispatch().vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->vk_pipeline);
+    this->device.get_dispatch().vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->vk_pipeline_layout, 0, 1, &vk_descriptor_set, 0, nullptr);
+    this->device.get_dispatch().vkCmdPushConstants(vk_command_buffer, this->vk_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+    if (constants.n_objects > 0) {
+        this->device.get_dispatch().vkCmdDispatch(vk_command_buffer, (constants.n_objects + IndirectRenderer::cull_group_size - 1) / IndirectRenderer::cull_group_size, 1, 1);
+    }
+
+    // Make the draws and the count visible to the indirect draw
+    populate_memory_barrier(barrier, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    this->device.get_dispatch().vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    this->device.get_debug_markup().end_label(vk_command_buffer);
+
+    ++this->_statistics.n_gpu_frames;
+}
+
+/* Draws the visible objects with the currently bound graphics pipeline, vertex buffers and index buffer. */
+void IndirectRenderer::draw(VkCommandBuffer vk_command_buffer) {
+    const FrameRegions& regions = this->frames[this->current_frame];
+    uint32_t max_draws = this->device.get_physical_device().properties().limits.maxDrawIndirectCount;
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    if (this->gpu_culling()) {
+        // One draw, of which the GPU decides the count
+        this->device.get_dispatch().vkCmdDrawIndexedIndirectCountKHR(vk_command_buffer, this->vk_buffer, regions.draws, this->vk_buffer, regions.count, std::min(this->_max_objects, max_draws), stride);
+        ++this->_statistics.n_draw_calls;
+    } else if (this->device.has_feature(Vulkanic::DeviceFeature::multi_draw_indirect)) {
+        // As few draws as the limit allows
+        for (uint32_t i = 0; i < this->n_cpu_draws; i += max_draws) {
+            this->device.get_dispatch().vkCmdDrawIndexedIndirect(vk_command_buffer, this->vk_buffer, regions.draws + i * stride, std::min(this->n_cpu_draws - i, max_draws), stride);
+            ++this->_statistics.n_draw_calls;
+        }
+    } else {
+        // Without multi-draw, each indirect draw can only do one object
+        for (uint32_t i = 0; i < this->n_cpu_draws; i++) {
+            this->device.get_dispatch().vkCmdDrawIndexedIndirect(vk_command_buffer, this->vk_buffer, regions.draws + i * stride, 1, stride);
+        }
+        this->_statistics.n_draw_calls += this->n_cpu_draws;
+    }
+}
+
+
+
+/* Extracts the six planes of the frustum from the given view-projection matrix. */
+void IndirectRenderer::extract_frustum(const glm::mat4& view_projection, glm::vec4 planes[6]) {
+    // glm is column-major, so collect the rows first
+    glm::vec4 rows[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    }
+
+    // Left, right, bottom, top, near (depth at 0) and far
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[2];
+    planes[5] = rows[3] - rows[2];
+
+    // Normalize them so that distances come out in world units
+    for (uint32_t i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+
+
+/* Swap operator for the IndirectRenderer class. */
+void Makma3D::swap(IndirectRenderer& ir1, IndirectRenderer& ir2) {
+    #ifndef NDEBUG
+    if (&ir1.device != &ir2.device) { logger.fatalc(IndirectRenderer::channel, "Cannot swap indirect renderers with different devices."); }
+    #endif
+
+    using std::swap;
+
+    swap(ir1.vk_buffer, ir2.vk_buffer);
+    swap(ir1.vk_memory, ir2.vk_memory);
+    swap(ir1.memory_type, ir2.memory_type);
+    swap(ir1.memory_size, ir2.memory_size);
+    swap(ir1.map, ir2.map);
+    swap(ir1.frames, ir2.frames);
+    swap(ir1.current_frame, ir2.current_frame);
+
+    swap(ir1.objects, ir2.objects);
+    swap(ir1._max_objects, ir2._max_objects);
+    swap(ir1.n_cpu_draws, ir2.n_cpu_draws);
+    swap(ir1.layout, ir2.layout);
+    swap(ir1.vk_pipeline_layout, ir2.vk_pipeline_layout);
+    swap(ir1.vk_pipeline, ir2.vk_pipeline);
+    swap(ir1._gpu_culling, ir2._gpu_culling);
+
+    swap(ir1._statistics, ir2._statistics);
+}
@@ -0,0 +1,191 @@
+/* PARALLEL RECORDER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 19:12:09
+ * Last edited:
+ *   18/10/2021, 19:12:09
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the ParallelRecorder class, which splits a list of draws
+ *   into fixed-size chunks, records each chunk into a secondary command
+ *   buffer on a pool of worker threads and executes them from the
+ *   primary command buffer in the order of the list.
+**/
+
+#include <algorithm>
+#include <chrono>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "rendering/ParallelRecorder.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkCommandBufferBeginInfo struct for a secondary command buffer.
+ * @param begin_info The VkCommandBufferBeginInfo struct to populate.
+ * @param inheritance What the command buffer inherits from the primary. Must always be given for secondary command buffers.
+ * @param in_render_pass Whether the command buffer is executed inside a render pass. */
+static void populate_begin_info(VkCommandBufferBeginInfo& begin_info, const VkCommandBufferInheritanceInfo* inheritance, bool in_render_pass) {
+    // Set to default
+    begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    // Each chunk is recorded for a single submission
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (in_render_pass) { begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT; }
+    begin_info.pInheritanceInfo = inheritance;
+}
+
+
+
+
+
+/***** PARALLELRECORDER CLASS *****/
+/* Constructor for the ParallelRecorder class. */
+ParallelRecorder::ParallelRecorder(const Makma3D::Device& device, uint32_t n_workers, uint32_t chunk_size) :
+    device(device),
+
+    _chunk_size(std::max(chunk_size, (uint32_t) 1)),
+    workers(n_workers),
+
+    job(),
+    job_active(false),
+    job_generation(0),
+    n_busy(0),
+    stop(false),
+
+    _statistics({ 0, 0, 0, 0 })
+{
+    // Start the workers, which immediately go to sleep until there's work
+    for (uint32_t i = 0; i < n_workers; i++) {
+        this->workers.push_back(std::thread(&ParallelRecorder::worker_main, this));
+        logger.set_thread_name(this->workers.last().get_id(), "recorder" + std::to_string(i));
+    }
+
+    // Done
+    logger.logc(Verbosity::details, ParallelRecorder::channel, "Initialized with ", n_workers, " worker threads and chunks of ", this->_chunk_size, " items.");
+}
+
+/* Destructor for the ParallelRecorder class. */
+ParallelRecorder::~ParallelRecorder() {
+    // Wake the workers up so they can see they have to stop
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+        this->stop = true;
+    }
+    this->job_cv.notify_all();
+    for (uint32_t i = 0; i < this->workers.size(); i++) {
+        logger.unset_thread_name(this->workers[i].get_id());
+        this->workers[i].join();
+    }
+
+    // Report the statistics
+    if (this->_statistics.n_records > 0) {
+        logger.logc(Verbosity::details, ParallelRecorder::channel, "Recorded ", this->_statistics.n_chunks, " chunks (", this->_statistics.n_worker_chunks, " on workers) in ", this->_statistics.n_records, " calls, taking ", this->_statistics.record_time / this->_statistics.n_records, "ns per call with ", this->workers.size(), " workers.");
+    }
+}
+
+
+
+/* Records chunks of the current job until there are none left. */
+uint32_t ParallelRecorder::record_chunks() {
+    CommandPoolManager& command_pool_manager = this->device.get_command_pool_manager();
+    uint32_t n_recorded = 0;
+    while (true) {
+        // Claim the next chunk, if there is any
+        uint32_t chunk = this->job.next_chunk.fetch_add(1);
+        if (chunk >= this->job.chunks.size()) { return n_recorded; }
+
+        // Record it in a command buffer from this thread's own pool
+        VkCommandBuffer vk_command_buffer = command_pool_manager.allocate(this->job.queue_type, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VkResult vk_result;
+        if ((vk_result = this->device.get_dispatch().vkBeginCommandBuffer(vk_command_buffer, &this->job.begin_info)) != VK_SUCCESS) {
+            logger.fatalc(ParallelRecorder::channel, "Could not begin command buffer of chunk ", chunk, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        uint32_t first = chunk * this->_chunk_size;
+        (*this->job.record_chunk)(vk_command_buffer, first, std::min(this->_chunk_size, this->job.n_items - first));
+        if ((vk_result = this->device.get_dispatch().vkEndCommandBuffer(vk_command_buffer)) != VK_SUCCESS) {
+            logger.fatalc(ParallelRecorder::channel, "Could not end command buffer of chunk ", chunk, ": ", Vulkanic::vk_error_map.at(vk_result));
+        }
+
+        // Store it in the chunk's own slot, so the order doesn't depend on who recorded what
+        this->job.chunks[chunk] = vk_command_buffer;
+        ++n_recorded;
+    }
+}
+
+/* The main loop of each worker thread. */
+void ParallelRecorder::worker_main() {
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(this->lock);
+    while (true) {
+        // Wait for a job we haven't seen yet
+        this->job_cv.wait(lock, [this, seen_generation]() { return this->stop || (this->job_active && this->job_generation != seen_generation); });
+        if (this->stop) { return; }
+        seen_generation = this->job_generation;
+        ++this->n_busy;
+
+        // Help out without holding the lock
+        lock.unlock();
+        this->job.worker_chunks += this->record_chunks();
+        lock.lock();
+
+        // Let the recording thread know if we were the last one out
+        if (--this->n_busy == 0) { this->done_cv.notify_all(); }
+    }
+}
+
+
+
+/* Records the given list of items in chunks on the workers and the calling thread, and then executes the chunks from the primary command buffer in order. */
+void ParallelRecorder::record(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type, const VkCommandBufferInheritanceInfo* inheritance, uint32_t n_items, const record_t& record_chunk) {
+    if (n_items == 0) { return; }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Secondary command buffers always need inheritance info, even if there's nothing to inherit
+    VkCommandBufferInheritanceInfo empty_inheritance = {};
+    empty_inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+    // Prepare the job, and open it to the workers if there's more than one chunk to share
+    uint32_t n_chunks = (n_items + this->_chunk_size - 1) / this->_chunk_size;
+    bool share = n_chunks > 1 && this->workers.size() > 0;
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+        this->job.record_chunk = &record_chunk;
+        this->job.queue_type = queue_type;
+        populate_begin_info(this->job.begin_info, inheritance != nullptr ? inheritance : &empty_inheritance, inheritance != nullptr);
+        this->job.n_items = n_items;
+        this->job.chunks.reserve(n_chunks);
+        this->job.chunks.wdata(n_chunks);
+        this->job.next_chunk = 0;
+        this->job.worker_chunks = 0;
+
+        this->job_active = share;
+        ++this->job_generation;
+    }
+    if (share) { this->job_cv.notify_all(); }
+
+    // Record along, and then wait until the workers that joined are done as well
+    this->record_chunks();
+    if (share) {
+        std::unique_lock<std::mutex> lock(this->lock);
+        this->job_active = false;
+        this->done_cv.wait(lock, [this]() { return this->n_busy == 0; });
+    }
+
+    // Execute them in the order of the list
+    this->device.get_dispatch().vkCmdExecuteCommands(vk_command_buffer, n_chunks, this->job.chunks.rdata());
+
+    // Update the statistics
+    ++this->_statistics.n_records;
+    this->_statistics.n_chunks += n_chunks;
+    this->_statistics.n_worker_chunks += this->job.worker_chunks;
+    this->_statistics.record_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
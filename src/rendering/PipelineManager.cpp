@@ -0,0 +1,277 @@
+/* PIPELINE MANAGER.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   20/10/2021, 10:21:42
+ * Last edited:
+ *   20/10/2021, 10:21:42
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the PipelineManager class, which compiles pipelines on
+ *   worker threads against a shared VkPipelineCache. Pipelines are known
+ *   by a key that describes their state, so asking twice for the same
+ *   pipeline compiles it only once, and a fallback pipeline can be drawn
+ *   with until the real one is ready.
+**/
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "rendering/PipelineManager.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkPipelineCacheCreateInfo struct.
+ * @param cache_info The VkPipelineCacheCreateInfo struct to populate.
+ * @param initial_data The data to warm the cache with, which may be empty. */
+static void populate_cache_info(VkPipelineCacheCreateInfo& cache_info, const Tools::Array<uint8_t>& initial_data) {
+    // Set the meta info first
+    cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    // The cache is used by all workers at once, which Vulkan synchronizes for us
+    cache_info.initialDataSize = initial_data.size();
+    cache_info.pInitialData = initial_data.empty() ? nullptr : initial_data.rdata();
+}
+
+
+
+
+
+/***** PIPELINEMANAGER CLASS *****/
+/* Constructor for the PipelineManager class. */
+PipelineManager::PipelineManager(const Makma3D::Device& device, uint32_t n_workers, const Tools::Array<uint8_t>& initial_data) :
+    device(device),
+
+    vk_pipeline_cache(nullptr),
+    workers(n_workers),
+
+    stop(false),
+
+    _statistics({ 0, 0, 0, 0, 0 })
+{
+    // Create the cache that all pipelines share
+    VkPipelineCacheCreateInfo cache_info;
+    populate_cache_info(cache_info, initial_data);
+    VkResult vk_result;
+    if ((vk_result = vkCreatePipelineCache(this->device, &cache_info, nullptr, &this->vk_pipeline_cache)) != VK_SUCCESS) {
+        logger.fatalc(PipelineManager::channel, "Could not create pipeline cache: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    this->device.get_debug_markup().name(this->vk_pipeline_cache, "PipelineManager cache");
+
+    // Start the workers, which immediately go to sleep until there's work
+    for (uint32_t i = 0; i < n_workers; i++) {
+        this->workers.push_back(std::thread(&PipelineManager::worker_main, this));
+        logger.set_thread_name(this->workers.last().get_id(), "compiler" + std::to_string(i));
+    }
+
+    // Done
+    logger.logc(Verbosity::details, PipelineManager::channel, "Initialized with ", n_workers, " worker threads and ", initial_data.size(), " bytes of cached pipeline data.");
+}
+
+/* Destructor for the PipelineManager class. */
+PipelineManager::~PipelineManager() {
+    // Wake the workers up so they can see they have to stop
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        this->stop = true;
+    }
+    this->work_cv.notify_all();
+    for (uint32_t i = 0; i < this->workers.size(); i++) {
+        logger.unset_thread_name(this->workers[i].get_id());
+        this->workers[i].join();
+    }
+
+    // Report the statistics
+    if (this->_statistics.n_compiled > 0) {
+        logger.logc(Verbosity::details, PipelineManager::channel, "Compiled ", this->_statistics.n_compiled, " pipelines (", this->_statistics.n_failed, " failed, ", this->_statistics.n_deduplicated, " duplicate requests skipped), taking ", this->_statistics.total_compile_time / this->_statistics.n_compiled, "ns on average and at most ", this->_statistics.max_compile_time, "ns.");
+    }
+
+    // Destroy the pipelines and the cache
+    for (uint32_t i = 0; i < this->entries.size(); i++) {
+        if (this->entries[i].vk_pipeline != nullptr) {
+            vkDestroyPipeline(this->device, this->entries[i].vk_pipeline, nullptr);
+        }
+    }
+    if (this->vk_pipeline_cache != nullptr) {
+        vkDestroyPipelineCache(this->device, this->vk_pipeline_cache, nullptr);
+    }
+}
+
+
+
+/* Creates the pipeline with the given identifier. Assumes the lock is taken, and releases it while the pipeline is created. */
+void PipelineManager::compile(pipeline_id_t id, std::unique_lock<std::mutex>& local_lock) {
+    // Claim it
+    Entry& entry = this->entries[id];
+    entry.state = State::compiling;
+    create_t create = std::move(entry.create);
+    entry.create = nullptr;
+    std::string name = entry.name;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    entry.statistics.queue_time = std::chrono::duration_cast<std::chrono::nanoseconds>(start - entry.requested).count();
+
+    // Create it without the lock; the entry may move while we do, so we only refer to it by identifier afterwards
+    local_lock.unlock();
+    VkPipeline vk_pipeline = create(this->device, this->vk_pipeline_cache);
+    uint64_t compile_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if (vk_pipeline != nullptr) {
+        this->device.get_debug_markup().name(vk_pipeline, name);
+        logger.logc(Verbosity::debug, PipelineManager::channel, "Compiled pipeline '", name, "' in ", compile_time / 1000, "us.");
+    } else {
+        logger.warningc(PipelineManager::channel, "Could not create pipeline '", name, "'; its fallback stays in use.");
+    }
+    local_lock.lock();
+
+    // Store the result
+    Entry& done = this->entries[id];
+    done.vk_pipeline = vk_pipeline;
+    done.state = vk_pipeline != nullptr ? State::ready : State::failed;
+    done.statistics.compile_time = compile_time;
+    if (vk_pipeline != nullptr) {
+        ++this->_statistics.n_compiled;
+        this->_statistics.total_compile_time += compile_time;
+        if (compile_time > this->_statistics.max_compile_time) { this->_statistics.max_compile_time = compile_time; }
+    } else {
+        ++this->_statistics.n_failed;
+    }
+    this->done_cv.notify_all();
+}
+
+/* The main loop of each worker thread. */
+void PipelineManager::worker_main() {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    while (true) {
+        // Wait for a request
+        this->work_cv.wait(local_lock, [this]() { return this->stop || !this->queue.empty(); });
+        if (this->stop) { return; }
+
+        // Take the oldest one; wait() may have claimed it already
+        pipeline_id_t id = this->queue[0];
+        this->queue.erase(0);
+        if (this->entries[id].state != State::pending) { continue; }
+        this->compile(id, local_lock);
+    }
+}
+
+
+
+/* Requests the pipeline with the given state. */
+pipeline_id_t PipelineManager::request(const PipelineKey& key, create_t&& create, pipeline_id_t fallback, const std::string& name) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // If we know the state already, hand out the pipeline we have (or are making)
+    std::unordered_map<PipelineKey, pipeline_id_t>::iterator iter = this->ids.find(key);
+    if (iter != this->ids.end()) {
+        ++this->entries[iter->second].statistics.n_requests;
+        ++this->_statistics.n_deduplicated;
+        return iter->second;
+    }
+
+    // Otherwise, queue it
+    pipeline_id_t id = this->entries.size();
+    this->entries.push_back(Entry{ name, std::move(create), fallback, State::pending, nullptr, std::chrono::steady_clock::now(), { 1, 0, 0, 0 } });
+    this->ids.insert({ key, id });
+    this->queue.push_back(id);
+    local_lock.unlock();
+
+    this->work_cv.notify_one();
+    return id;
+}
+
+/* Returns the pipeline with the given identifier if it's ready, or else the first fallback that is. */
+VkPipeline PipelineManager::get(pipeline_id_t id) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (id >= this->entries.size()) {
+        logger.fatalc(PipelineManager::channel, "Cannot get unknown pipeline ", id, '.');
+    }
+    Entry& entry = this->entries[id];
+    if (entry.state == State::ready) { return entry.vk_pipeline; }
+
+    // Walk the fallbacks until one is ready
+    ++entry.statistics.n_fallbacks;
+    pipeline_id_t fallback = entry.fallback;
+    for (uint32_t i = 0; i < PipelineManager::max_fallback_depth && fallback < this->entries.size(); i++) {
+        const Entry& candidate = this->entries[fallback];
+        if (candidate.state == State::ready) { return candidate.vk_pipeline; }
+        fallback = candidate.fallback;
+    }
+    return nullptr;
+}
+
+/* Returns whether the pipeline with the given identifier is done. */
+bool PipelineManager::is_done(pipeline_id_t id) const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (id >= this->entries.size()) {
+        logger.fatalc(PipelineManager::channel, "Cannot check unknown pipeline ", id, '.');
+    }
+    return this->entries[id].state == State::ready || this->entries[id].state == State::failed;
+}
+
+/* Blocks until the pipeline with the given identifier is done. */
+VkPipeline PipelineManager::wait(pipeline_id_t id) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (id >= this->entries.size()) {
+        logger.fatalc(PipelineManager::channel, "Cannot wait for unknown pipeline ", id, '.');
+    }
+
+    // Rather than waiting for a worker to get to it, make it ourselves (the worker skips it once it does)
+    if (this->entries[id].state == State::pending) {
+        this->compile(id, local_lock);
+    } else {
+        this->done_cv.wait(local_lock, [this, id]() { return this->entries[id].state == State::ready || this->entries[id].state == State::failed; });
+    }
+    return this->entries[id].vk_pipeline;
+}
+
+
+
+/* Returns the contents of the shared VkPipelineCache. */
+Tools::Array<uint8_t> PipelineManager::cache_data() const {
+    // Ask the size first, then the data
+    size_t size;
+    VkResult vk_result;
+    if ((vk_result = vkGetPipelineCacheData(this->device, this->vk_pipeline_cache, &size, nullptr)) != VK_SUCCESS) {
+        logger.fatalc(PipelineManager::channel, "Could not get pipeline cache size: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    Tools::Array<uint8_t> data(size);
+    if ((vk_result = vkGetPipelineCacheData(this->device, this->vk_pipeline_cache, &size, data.wdata())) != VK_SUCCESS) {
+        logger.fatalc(PipelineManager::channel, "Could not get pipeline cache data: ", Vulkanic::vk_error_map.at(vk_result));
+    }
+    data.wdata(size);
+    return data;
+}
+
+
+
+/* Returns the statistics of the pipeline with the given identifier. */
+PipelineStatistics PipelineManager::statistics(pipeline_id_t id) const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (id >= this->entries.size()) {
+        logger.fatalc(PipelineManager::channel, "Cannot get statistics of unknown pipeline ", id, '.');
+    }
+    return this->entries[id].statistics;
+}
+
+/* Returns the statistics of this manager. */
+PipelineManagerStatistics PipelineManager::statistics() const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    return this->_statistics;
+}
+
+/* Returns the number of requests that still wait for a worker. */
+uint32_t PipelineManager::pending() const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+
+    // Requests that wait() took over are still in the queue, so skip those
+    uint32_t n_pending = 0;
+    for (uint32_t i = 0; i < this->queue.size(); i++) {
+        if (this->entries[this->queue[i]].state == State::pending) { ++n_pending; }
+    }
+    return n_pending;
+}
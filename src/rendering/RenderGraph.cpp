@@ -0,0 +1,803 @@
+/* RENDER GRAPH.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   18/10/2021, 16:10:44
+ * Last edited:
+ *   18/10/2021, 16:10:44
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the RenderGraph class, which describes a frame as passes
+ *   that declare how they use images and buffers. Compiling the graph
+ *   culls unused passes, orders the rest, derives batched pipeline
+ *   barriers and layout transitions, and lets transient resources with
+ *   disjoint lifetimes share memory.
+**/
+
+#include <algorithm>
+#include <limits>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "vulkanic/auxillary/ImageLayouts.hpp"
+
+#include "rendering/RenderGraph.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* Describes what a ResourceUsage means for synchronization and resource creation. */
+struct UsageInfo {
+    /* The pipeline stages at which the resource is accessed. */
+    VkPipelineStageFlags stages;
+    /* The kinds of access. */
+    VkAccessFlags access;
+    /* The layout images have to be in, or VK_IMAGE_LAYOUT_UNDEFINED for buffer-only usages. */
+    VkImageLayout layout;
+    /* Whether the usage writes to the resource. */
+    bool write;
+    /* The image usage flag the usage requires, or 0 if images can't be used like this. */
+    VkImageUsageFlags image_usage;
+    /* The buffer usage flag the usage requires, or 0 if buffers can't be used like this. */
+    VkBufferUsageFlags buffer_usage;
+};
+
+/* The shader stages that can read uniform and storage buffers. */
+static constexpr const VkPipelineStageFlags shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+/* The stages that test against depth attachments. */
+static constexpr const VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+/* All access flags that write memory, which are the only ones that have to be made available by a barrier. */
+static constexpr const VkAccessFlags write_access = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+/* Maps each ResourceUsage to what it means. */
+static const UsageInfo usage_infos[] = {
+    { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 },                                // color_attachment
+    { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },                     // depth_attachment
+    { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },                                                                    // depth_read
+    { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },                                                                                    // fragment_sampled
+    { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },                                                                                     // compute_sampled
+    { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT, 0 },                                                                                                      // storage_read
+    { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, VK_IMAGE_USAGE_STORAGE_BIT, 0 },                                                                          // storage_write
+    { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT },                                                         // transfer_src
+    { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT },                                                         // transfer_dst
+    { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT },                                                                                     // vertex_buffer
+    { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT },                                                                                                  // index_buffer
+    { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT },                                                                                  // indirect_buffer
+    { shader_stages, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },                                                                                                                  // uniform_buffer
+    { shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },                                                                                                                   // buffer_read
+    { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }                                                                  // buffer_write
+};
+
+/* Marks a position in the execution order that no pass has. */
+static constexpr const uint32_t no_position = std::numeric_limits<uint32_t>::max();
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkImageCreateInfo struct.
+ * @param image_info The VkImageCreateInfo struct to populate.
+ * @param description What the image looks like.
+ * @param usage The usage flags of the image. */
+static void populate_image_info(VkImageCreateInfo& image_info, const ImageDescription& description, VkImageUsageFlags usage) {
+    // Set to default
+    image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+
+    // Set the shape of the image
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = description.format;
+    image_info.extent = { description.extent.width, description.extent.height, 1 };
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Set how it's used; it only ever lives on the graphics queue
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+/* Populates the given VkImageViewCreateInfo struct.
+ * @param view_info The VkImageViewCreateInfo struct to populate.
+ * @param vk_image The image to create a view for.
+ * @param format The format of the image.
+ * @param aspect The aspects of the image to view. */
+static void populate_image_view_info(VkImageViewCreateInfo& view_info, VkImage vk_image, VkFormat format, VkImageAspectFlags aspect) {
+    // Set to default
+    view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+
+    // View the whole image as-is
+    view_info.image = vk_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+}
+
+/* Populates the given VkBufferCreateInfo struct.
+ * @param buffer_info The VkBufferCreateInfo struct to populate.
+ * @param size The size of the buffer.
+ * @param usage The usage flags of the buffer. */
+static void populate_buffer_info(VkBufferCreateInfo& buffer_info, VkDeviceSize size, VkBufferUsageFlags usage) {
+    // Set to default
+    buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+    // Set the size and usage; it only ever lives on the graphics queue
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+}
+
+/* Populates the given VkMemoryAllocateInfo struct.
+ * @param allocate_info The VkMemoryAllocateInfo struct to populate.
+ * @param size The number of bytes to allocate.
+ * @param memory_type The index of the memory type to allocate from. */
+static void populate_allocate_info(VkMemoryAllocateInfo& allocate_info, VkDeviceSize size, uint32_t memory_type) {
+    // Set to default
+    allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+
+    // Set the size and type
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+}
+
+/* Populates the given VkImageMemoryBarrier struct.
+ * @param barrier The VkImageMemoryBarrier struct to populate.
+ * @param vk_image The image to transition, or nullptr if it's only known when executing.
+ * @param aspect The aspects of the image.
+ * @param old_layout The layout the image is in.
+ * @param new_layout The layout to move it to.
+ * @param src_access The writes to make available before the transition.
+ * @param dst_access The accesses to make the result visible to. */
+static void populate_image_barrier(VkImageMemoryBarrier& barrier, VkImage vk_image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access) {
+    // Set to default
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+    // Set the accesses and the transition
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+
+    // The graph lives on a single queue
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    // Transition the whole image
+    barrier.image = vk_image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+}
+
+/* Populates the given VkMemoryBarrier struct.
+ * @param barrier The VkMemoryBarrier struct to populate.
+ * @param src_access The writes to make available.
+ * @param dst_access The accesses to make them visible to. */
+static void populate_memory_barrier(VkMemoryBarrier& barrier, VkAccessFlags src_access, VkAccessFlags dst_access) {
+    // Set to default
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+    // Set the accesses
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+}
+
+
+
+
+
+/***** RENDERGRAPH CLASS *****/
+/* Constructor for the RenderGraph class. */
+RenderGraph::RenderGraph(const Makma3D::Device& device) :
+    device(device),
+    final_barriers({ 0, 0, 0, 0, {}, {} }),
+    compiled(false),
+    _statistics({ 0, 0, 0, 0, 0, 0 })
+{}
+
+/* Move constructor for the RenderGraph class. */
+RenderGraph::RenderGraph(RenderGraph&& other) :
+    device(other.device),
+
+    resources(std::move(other.resources)),
+    passes(std::move(other.passes)),
+    order(std::move(other.order)),
+    blocks(std::move(other.blocks)),
+    final_barriers(std::move(other.final_barriers)),
+    compiled(other.compiled),
+    _statistics(other._statistics)
+{
+    // The arrays are left empty, so the other doesn't destroy anything anymore
+}
+
+/* Destructor for the RenderGraph class. */
+RenderGraph::~RenderGraph() {
+    this->retire_transients();
+}
+
+
+
+/* Culls the passes that don't contribute to an output, and computes the dependencies of the others. */
+void RenderGraph::cull() {
+    // Walk back from the outputs: a pass is live if it writes something that's needed, and then everything it uses is needed too
+    Tools::Array<bool> needed(false, this->resources.size());
+    for (uint32_t i = 0; i < this->resources.size(); i++) {
+        needed[i] = this->resources[i].output;
+    }
+    for (uint32_t i = this->passes.size(); i-- > 0;) {
+        Pass& pass = this->passes[i];
+        pass.live = pass.side_effects;
+        for (uint32_t j = 0; j < pass.uses.size() && !pass.live; j++) {
+            const Use& use = pass.uses[j];
+            if (usage_infos[(uint32_t) use.usage].write && (needed[use.resource] || this->resources[use.resource].imported)) { pass.live = true; }
+        }
+        if (!pass.live) { continue; }
+
+        // We can't tell partial writes from full ones, so earlier writers of anything this pass touches stay alive as well
+        for (uint32_t j = 0; j < pass.uses.size(); j++) {
+            needed[pass.uses[j].resource] = true;
+        }
+    }
+
+    // Derive the dependencies between the live passes from the order in which they were added
+    Tools::Array<pass_t> last_writer(no_position, this->resources.size());
+    Tools::Array<Tools::Array<pass_t>> readers(Tools::Array<pass_t>(), this->resources.size());
+    for (uint32_t i = 0; i < this->passes.size(); i++) {
+        Pass& pass = this->passes[i];
+        pass.dependencies.clear();
+        if (!pass.live) { continue; }
+
+        for (uint32_t j = 0; j < pass.uses.size(); j++) {
+            const Use& use = pass.uses[j];
+
+            // Collect whom we have to wait for: the last writer always, and for writes also everyone that read since
+            Tools::Array<pass_t> waits_for;
+            if (last_writer[use.resource] != no_position) { waits_for.push_back(last_writer[use.resource]); }
+            if (usage_infos[(uint32_t) use.usage].write) { waits_for += readers[use.resource]; }
+            for (uint32_t k = 0; k < waits_for.size(); k++) {
+                if (waits_for[k] == i) { continue; }
+                bool known = false;
+                for (uint32_t l = 0; l < pass.dependencies.size() && !known; l++) { known = pass.dependencies[l] == waits_for[k]; }
+                if (!known) { pass.dependencies.push_back(waits_for[k]); }
+            }
+
+            // Update the resource's history
+            if (usage_infos[(uint32_t) use.usage].write) {
+                last_writer[use.resource] = i;
+                readers[use.resource].clear();
+            } else {
+                readers[use.resource].push_back(i);
+            }
+        }
+    }
+}
+
+/* Orders the live passes, preferring to put distance between passes and the passes they depend on. */
+void RenderGraph::schedule() {
+    // Count how many unscheduled dependencies each pass still has
+    Tools::Array<uint32_t> remaining(0U, this->passes.size());
+    Tools::Array<pass_t> ready;
+    for (uint32_t i = 0; i < this->passes.size(); i++) {
+        if (!this->passes[i].live) { continue; }
+        remaining[i] = this->passes[i].dependencies.size();
+        if (remaining[i] == 0) { ready.push_back(i); }
+    }
+
+    // Repeatedly pick a ready pass, preferring the oldest one that doesn't wait for the pass we just scheduled, since then the GPU can overlap them
+    this->order.clear();
+    while (!ready.empty()) {
+        uint32_t best = 0;
+        bool best_waits = true;
+        for (uint32_t i = 0; i < ready.size(); i++) {
+            bool waits = false;
+            if (!this->order.empty()) {
+                const Tools::Array<pass_t>& dependencies = this->passes[ready[i]].dependencies;
+                for (uint32_t j = 0; j < dependencies.size() && !waits; j++) { waits = dependencies[j] == this->order.last(); }
+            }
+            if ((best_waits && !waits) || (best_waits == waits && ready[i] < ready[best])) {
+                best = i;
+                best_waits = waits;
+            }
+        }
+        pass_t pass = ready[best];
+        ready.erase(best);
+        this->order.push_back(pass);
+
+        // Unlock the passes that waited for it
+        for (uint32_t i = 0; i < this->passes.size(); i++) {
+            if (!this->passes[i].live || remaining[i] == 0) { continue; }
+            const Tools::Array<pass_t>& dependencies = this->passes[i].dependencies;
+            for (uint32_t j = 0; j < dependencies.size(); j++) {
+                if (dependencies[j] == pass && --remaining[i] == 0) { ready.push_back(i); }
+            }
+        }
+    }
+}
+
+/* Creates the transient resources, sharing memory between those whose lifetimes don't overlap. */
+void RenderGraph::allocate_transients() {
+    this->retire_transients();
+    this->_statistics.transient_size = 0;
+    this->_statistics.allocated_size = 0;
+
+    // Derive the lifetime and the usage flags of each resource from the order
+    for (uint32_t i = 0; i < this->resources.size(); i++) {
+        Resource& resource = this->resources[i];
+        resource.first_use = no_position;
+        resource.last_use = 0;
+        resource.image_usage = 0;
+        resource.buffer_usage = 0;
+    }
+    for (uint32_t i = 0; i < this->order.size(); i++) {
+        const Pass& pass = this->passes[this->order[i]];
+        for (uint32_t j = 0; j < pass.uses.size(); j++) {
+            Resource& resource = this->resources[pass.uses[j].resource];
+            if (resource.first_use == no_position) { resource.first_use = i; }
+            resource.last_use = i;
+            resource.image_usage |= usage_infos[(uint32_t) pass.uses[j].usage].image_usage;
+            resource.buffer_usage |= usage_infos[(uint32_t) pass.uses[j].usage].buffer_usage;
+        }
+    }
+
+    // Create the transient resources that are used, and collect what memory they need
+    VkResult vk_result;
+    Tools::Array<VkMemoryRequirements> requirements({}, this->resources.size());
+    Tools::Array<resource_t> transients;
+    for (uint32_t i = 0; i < this->resources.size(); i++) {
+        Resource& resource = this->resources[i];
+        if (resource.imported || resource.first_use == no_position) { continue; }
+
+        if (resource.is_image) {
+            VkImageCreateInfo image_info;
+            populate_image_info(image_info, resource.description, resource.image_usage);
+            if ((vk_result = vkCreateImage(this->device, &image_info, nullptr, &resource.vk_image)) != VK_SUCCESS) {
+                logger.fatalc(RenderGraph::channel, "Could not create transient image '", resource.name, "': ", Vulkanic::vk_error_map.at(vk_result));
+            }
+            this->device.get_debug_markup().name(resource.vk_image, resource.name);
+            vkGetImageMemoryRequirements(this->device, resource.vk_image, &requirements[i]);
+        } else {
+            VkBufferCreateInfo buffer_info;
+            populate_buffer_info(buffer_info, resource.size, resource.buffer_usage);
+            if ((vk_result = vkCreateBuffer(this->device, &buffer_info, nullptr, &resource.vk_buffer)) != VK_SUCCESS) {
+                logger.fatalc(RenderGraph::channel, "Could not create transient buffer '", resource.name, "': ", Vulkanic::vk_error_map.at(vk_result));
+            }
+            this->device.get_debug_markup().name(resource.vk_buffer, resource.name);
+            vkGetBufferMemoryRequirements(this->device, resource.vk_buffer, &requirements[i]);
+        }
+        transients.push_back(i);
+        this->_statistics.transient_size += requirements[i].size;
+    }
+
+    // Place the largest resources first, each in the first block of its kind whose residents are all dead before it starts or born after it ends
+    resource_t* data = transients.wdata();
+    std::sort(data, data + transients.size(), [&requirements](resource_t r1, resource_t r2) { return requirements[r1].size > requirements[r2].size; });
+    for (uint32_t i = 0; i < transients.size(); i++) {
+        Resource& resource = this->resources[transients[i]];
+        const VkMemoryRequirements& requirement = requirements[transients[i]];
+
+        uint32_t b;
+        for (b = 0; b < this->blocks.size(); b++) {
+            MemoryBlock& block = this->blocks[b];
+            if ((block.type_bits & requirement.memoryTypeBits) == 0 || this->resources[block.resources[0]].is_image != resource.is_image) { continue; }
+            bool overlaps = false;
+            for (uint32_t j = 0; j < block.resources.size() && !overlaps; j++) {
+                const Resource& other = this->resources[block.resources[j]];
+                overlaps = resource.first_use <= other.last_use && other.first_use <= resource.last_use;
+            }
+            if (!overlaps) { break; }
+        }
+        if (b == this->blocks.size()) {
+            this->blocks.push_back(MemoryBlock{ nullptr, 0, 0, requirement.memoryTypeBits, Tools::Array<resource_t>() });
+        }
+
+        // Grow the block to fit
+        MemoryBlock& block = this->blocks[b];
+        block.size = std::max(block.size, requirement.size);
+        block.type_bits &= requirement.memoryTypeBits;
+        block.resources.push_back(transients[i]);
+        resource.block = b;
+    }
+
+    // Allocate the blocks and bind their residents at the start of them
+    for (uint32_t b = 0; b < this->blocks.size(); b++) {
+        MemoryBlock& block = this->blocks[b];
+        block.memory_type = this->device.get_memory_type(block.type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkMemoryAllocateInfo allocate_info;
+        populate_allocate_info(allocate_info, block.size, block.memory_type);
+        if ((vk_result = this->device.get_memory_budget().allocate(allocate_info, block.vk_memory)) != VK_SUCCESS) {
+            logger.fatalc(RenderGraph::channel, "Could not allocate ", block.size, " bytes of transient memory: ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        this->device.get_debug_markup().name(block.vk_memory, "transient block " + std::to_string(b));
+        this->_statistics.allocated_size += block.size;
+
+        for (uint32_t i = 0; i < block.resources.size(); i++) {
+            Resource& resource = this->resources[block.resources[i]];
+            if (resource.is_image) {
+                if ((vk_result = vkBindImageMemory(this->device, resource.vk_image, block.vk_memory, 0)) != VK_SUCCESS) {
+                    logger.fatalc(RenderGraph::channel, "Could not bind memory to transient image '", resource.name, "': ", Vulkanic::vk_error_map.at(vk_result));
+                }
+
+                VkImageViewCreateInfo view_info;
+                populate_image_view_info(view_info, resource.vk_image, resource.description.format, resource.aspect);
+                if ((vk_result = vkCreateImageView(this->device, &view_info, nullptr, &resource.vk_image_view)) != VK_SUCCESS) {
+                    logger.fatalc(RenderGraph::channel, "Could not create view for transient image '", resource.name, "': ", Vulkanic::vk_error_map.at(vk_result));
+                }
+                this->device.get_debug_markup().name(resource.vk_image_view, resource.name);
+            } else {
+                if ((vk_result = vkBindBufferMemory(this->device, resource.vk_buffer, block.vk_memory, 0)) != VK_SUCCESS) {
+                    logger.fatalc(RenderGraph::channel, "Could not bind memory to transient buffer '", resource.name, "': ", Vulkanic::vk_error_map.at(vk_result));
+                }
+            }
+        }
+    }
+}
+
+/* Derives the barriers of every pass by simulating the state of each resource through the order. */
+void RenderGraph::derive_barriers() {
+    /* The synchronization state of a single resource. */
+    struct State {
+        /* The layout the image is in. */
+        VkImageLayout layout;
+        /* The stages of the last write (or transition). */
+        VkPipelineStageFlags write_stages;
+        /* The access of the last write, which still has to be made available. */
+        VkAccessFlags write_access;
+        /* The stages that read the resource since the last write. */
+        VkPipelineStageFlags read_stages;
+        /* The stages the last write has been made visible to. */
+        VkPipelineStageFlags visible_stages;
+        /* The accesses the last write has been made visible to. */
+        VkAccessFlags visible_access;
+        /* Whether a pass has used the resource yet. */
+        bool started;
+    };
+
+    // For each memory block, the stages and writes of whatever last used it. Transients live on across frames in flight, so the first use in a frame has to wait for the last use in the frame before; we thus simulate the order once to find those, and then again to derive the barriers
+    Tools::Array<std::pair<VkPipelineStageFlags, VkAccessFlags>> block_states({ 0, 0 }, this->blocks.size());
+    Tools::Array<State> states(this->resources.size());
+    for (uint32_t round = 0; round < 2; round++) {
+        bool record = round == 1;
+
+        // Start each resource where the outside world leaves it
+        states.clear();
+        for (uint32_t i = 0; i < this->resources.size(); i++) {
+            const Resource& resource = this->resources[i];
+            if (resource.imported) { states.push_back(State{ resource.initial_layout, resource.wait_stages, 0, 0, 0, 0, false }); }
+            else { states.push_back(State{ VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0, 0, false }); }
+        }
+
+        this->_statistics.n_barriers = 0;
+        this->_statistics.n_transitions = 0;
+        for (uint32_t i = 0; i < this->order.size(); i++) {
+            Pass& pass = this->passes[this->order[i]];
+            Barriers& barriers = pass.barriers;
+            barriers = Barriers{ 0, 0, 0, 0, {}, {} };
+
+            for (uint32_t j = 0; j < pass.uses.size(); j++) {
+                const Use& use = pass.uses[j];
+                const UsageInfo& info = usage_infos[(uint32_t) use.usage];
+                const Resource& resource = this->resources[use.resource];
+                State& state = states[use.resource];
+
+                // A transient that shares memory has to wait until the previous resident (of this frame or, for the first, of the last) is done with it
+                if (!state.started && !resource.imported) {
+                    state.write_stages = block_states[resource.block].first;
+                    state.write_access = block_states[resource.block].second;
+                }
+                state.started = true;
+
+                bool transition = resource.is_image && info.layout != state.layout;
+                if (info.write || transition) {
+                    // Wait for everything before us; reads only need an execution dependency
+                    VkPipelineStageFlags src_stages = state.write_stages | state.read_stages;
+                    if (transition) {
+                        VkImageMemoryBarrier barrier;
+                        populate_image_barrier(barrier, resource.vk_image, resource.aspect, state.layout, info.layout, state.write_access, info.access);
+                        barriers.images.push_back(barrier);
+                        barriers.image_resources.push_back(use.resource);
+                        barriers.src_stages |= src_stages != 0 ? src_stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+                        barriers.dst_stages |= info.stages;
+                        ++this->_statistics.n_transitions;
+                        if (record) { logger.logc(Verbosity::debug, RenderGraph::channel, "Pass '", pass.name, "' transitions '", resource.name, "' from ", Vulkanic::vk_image_layout_map.at(state.layout), " to ", Vulkanic::vk_image_layout_map.at(info.layout), "."); }
+                    } else if (src_stages != 0) {
+                        barriers.src_stages |= src_stages;
+                        barriers.dst_stages |= info.stages;
+                        barriers.src_access |= state.write_access;
+                        barriers.dst_access |= info.access;
+                    }
+
+                    // A write makes everything stale, while a transition counts as a write that's visible to our own stages
+                    if (resource.is_image) { state.layout = info.layout; }
+                    state.write_stages = info.stages;
+                    state.write_access = info.write ? info.access & write_access : 0;
+                    state.read_stages = info.write ? 0 : info.stages;
+                    state.visible_stages = info.write ? 0 : info.stages;
+                    state.visible_access = info.write ? 0 : info.access;
+                } else {
+                    // A read only waits if the last write isn't visible to it yet
+                    if (state.write_stages != 0 && ((info.stages & ~state.visible_stages) != 0 || (info.access & ~state.visible_access) != 0)) {
+                        barriers.src_stages |= state.write_stages;
+                        barriers.dst_stages |= info.stages;
+                        barriers.src_access |= state.write_access;
+                        barriers.dst_access |= info.access;
+                        state.visible_stages |= info.stages;
+                        state.visible_access |= info.access;
+                    }
+                    state.read_stages |= info.stages;
+                }
+
+                // Remember who used the memory last
+                if (!resource.imported) { block_states[resource.block] = { state.write_stages | state.read_stages, state.write_access }; }
+            }
+
+            if (barriers.dst_stages != 0) { ++this->_statistics.n_barriers; }
+        }
+    }
+
+    // Finally, move the imported images to the layouts the outside world expects
+    this->final_barriers = Barriers{ 0, 0, 0, 0, {}, {} };
+    for (uint32_t i = 0; i < this->resources.size(); i++) {
+        const Resource& resource = this->resources[i];
+        const State& state = states[i];
+        if (!resource.imported || !resource.is_image || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || resource.final_layout == state.layout) { continue; }
+
+        VkImageMemoryBarrier barrier;
+        populate_image_barrier(barrier, resource.vk_image, resource.aspect, state.layout, resource.final_layout, state.write_access, 0);
+        this->final_barriers.images.push_back(barrier);
+        this->final_barriers.image_resources.push_back(i);
+        this->final_barriers.src_stages |= (state.write_stages | state.read_stages) != 0 ? state.write_stages | state.read_stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        this->final_barriers.dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        ++this->_statistics.n_transitions;
+    }
+    if (this->final_barriers.dst_stages != 0) { ++this->_statistics.n_barriers; }
+}
+
+/* Retires the transient resources and their memory in the Device's DeletionQueue, since frames in flight may still use them. */
+void RenderGraph::retire_transients() {
+    Tools::Array<VkImageView> vk_image_views;
+    Tools::Array<VkImage> vk_images;
+    Tools::Array<VkBuffer> vk_buffers;
+    for (uint32_t i = 0; i < this->resources.size(); i++) {
+        Resource& resource = this->resources[i];
+        if (resource.imported) { continue; }
+
+        if (resource.vk_image_view != nullptr) {
+            vk_image_views.push_back(resource.vk_image_view);
+            resource.vk_image_view = nullptr;
+        }
+        if (resource.vk_image != nullptr) {
+            vk_images.push_back(resource.vk_image);
+            resource.vk_image = nullptr;
+        }
+        if (resource.vk_buffer != nullptr) {
+            vk_buffers.push_back(resource.vk_buffer);
+            resource.vk_buffer = nullptr;
+        }
+    }
+    Tools::Array<MemoryBlock> blocks(this->blocks);
+    this->blocks.clear();
+    if (vk_images.empty() && vk_buffers.empty() && blocks.empty()) { return; }
+
+    // Destroy them in one go once the GPU is done
+    VkDevice vk_device = this->device;
+    MemoryBudget* memory_budget = &this->device.get_memory_budget();
+    this->device.get_deletion_queue().retire([vk_device, memory_budget, vk_image_views, vk_images, vk_buffers, blocks]() {
+        for (uint32_t i = 0; i < vk_image_views.size(); i++) { vkDestroyImageView(vk_device, vk_image_views[i], nullptr); }
+        for (uint32_t i = 0; i < vk_images.size(); i++) { vkDestroyImage(vk_device, vk_images[i], nullptr); }
+        for (uint32_t i = 0; i < vk_buffers.size(); i++) { vkDestroyBuffer(vk_device, vk_buffers[i], nullptr); }
+        for (uint32_t i = 0; i < blocks.size(); i++) { memory_budget->free(blocks[i].vk_memory, blocks[i].memory_type, blocks[i].size); }
+    });
+}
+
+/* Records the given batch of barriers, if it isn't empty. */
+void RenderGraph::record_barriers(VkCommandBuffer vk_command_buffer, const Barriers& barriers) const {
+    if (barriers.dst_stages == 0) { return; }
+
+    #ifndef NDEBUG
+    for (uint32_t i = 0; i < barriers.images.size(); i++) {
+        if (barriers.images[i].image == nullptr) { logger.fatalc(RenderGraph::channel, "Imported image '", this->resources[barriers.image_resources[i]].name, "' is not bound."); }
+    }
+    #endif
+
+    // Everything that's not a layout transition goes in one global memory barrier
+    VkMemoryBarrier memory_barrier;
+    populate_memory_barrier(memory_barrier, barriers.src_access, barriers.dst_access);
+    uint32_t n_memory_barriers = barriers.src_access != 0 ? 1 : 0;
+    this->device.get_dispatch().vkCmdPipelineBarrier(vk_command_buffer, barriers.src_stages, barriers.dst_stages, 0, n_memory_barriers, &memory_barrier, 0, nullptr, barriers.images.size(), barriers.images.rdata());
+}
+
+
+
+/* Adds a transient image to the graph. */
+resource_t RenderGraph::create_image(const std::string& name, const ImageDescription& description) {
+    Resource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.description = description;
+    resource.aspect = description.aspect;
+    resource.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    this->resources.push_back(resource);
+    this->compiled = false;
+    return this->resources.size() - 1;
+}
+
+/* Adds an image that lives outside the graph, like a swapchain image. */
+resource_t RenderGraph::import_image(const std::string& name, VkImageAspectFlags aspect, VkImageLayout initial_layout, VkImageLayout final_layout, VkPipelineStageFlags wait_stages) {
+    Resource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.imported = true;
+    resource.aspect = aspect;
+    resource.initial_layout = initial_layout;
+    resource.final_layout = final_layout;
+    resource.wait_stages = wait_stages;
+    this->resources.push_back(resource);
+    this->compiled = false;
+    return this->resources.size() - 1;
+}
+
+/* Adds a transient buffer to the graph. */
+resource_t RenderGraph::create_buffer(const std::string& name, VkDeviceSize size) {
+    Resource resource = {};
+    resource.name = name;
+    resource.size = size;
+    this->resources.push_back(resource);
+    this->compiled = false;
+    return this->resources.size() - 1;
+}
+
+/* Adds a buffer that lives outside the graph. */
+resource_t RenderGraph::import_buffer(const std::string& name, VkPipelineStageFlags wait_stages) {
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.wait_stages = wait_stages;
+    this->resources.push_back(resource);
+    this->compiled = false;
+    return this->resources.size() - 1;
+}
+
+/* Marks the given resource as a result of the frame. */
+void RenderGraph::mark_output(resource_t resource) {
+    this->resources[resource].output = true;
+    this->compiled = false;
+}
+
+
+
+/* Adds a pass to the graph. */
+pass_t RenderGraph::add_pass(const std::string& name, const execute_t& execute, bool side_effects) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.side_effects = side_effects;
+    pass.live = false;
+    pass.barriers = Barriers{ 0, 0, 0, 0, {}, {} };
+    this->passes.push_back(pass);
+    this->compiled = false;
+    return this->passes.size() - 1;
+}
+
+/* Declares that the given pass uses the given resource in the given way. */
+void RenderGraph::use(pass_t pass, resource_t resource, ResourceUsage usage) {
+    const UsageInfo& info = usage_infos[(uint32_t) usage];
+    const Resource& res = this->resources[resource];
+    if (res.is_image && info.image_usage == 0) { logger.fatalc(RenderGraph::channel, "Pass '", this->passes[pass].name, "' cannot use image '", res.name, "' as ", resource_usage_names[(uint32_t) usage], "."); }
+    if (!res.is_image && info.buffer_usage == 0) { logger.fatalc(RenderGraph::channel, "Pass '", this->passes[pass].name, "' cannot use buffer '", res.name, "' as ", resource_usage_names[(uint32_t) usage], "."); }
+
+    // An image can only be in one layout during a pass
+    Tools::Array<Use>& uses = this->passes[pass].uses;
+    for (uint32_t i = 0; i < uses.size(); i++) {
+        if (res.is_image && uses[i].resource == resource && usage_infos[(uint32_t) uses[i].usage].layout != info.layout) {
+            logger.fatalc(RenderGraph::channel, "Pass '", this->passes[pass].name, "' uses image '", res.name, "' as both ", resource_usage_names[(uint32_t) uses[i].usage], " and ", resource_usage_names[(uint32_t) usage], ", which need different layouts.");
+        }
+    }
+
+    uses.push_back(Use{ resource, usage });
+    this->compiled = false;
+}
+
+
+
+/* Compiles the graph. */
+void RenderGraph::compile() {
+    this->cull();
+    this->schedule();
+    this->allocate_transients();
+    this->derive_barriers();
+    this->compiled = true;
+
+    this->_statistics.n_passes = this->order.size();
+    this->_statistics.n_culled = this->passes.size() - this->order.size();
+    logger.logc(Verbosity::details, RenderGraph::channel, "Compiled ", this->_statistics.n_passes, " passes (", this->_statistics.n_culled, " culled) with ", this->_statistics.n_barriers, " barriers and ", this->_statistics.n_transitions, " layout transitions; ", this->_statistics.transient_size, " bytes of transients fit in ", this->_statistics.allocated_size, " bytes.");
+}
+
+/* Records the whole graph on the given command buffer. */
+void RenderGraph::execute(VkCommandBuffer vk_command_buffer, Vulkanic::QueueType queue_type) const {
+    #ifndef NDEBUG
+    if (!this->compiled) { logger.fatalc(RenderGraph::channel, "Cannot execute a graph that has changed since it was last compiled."); }
+    #endif
+
+    GpuProfiler& profiler = this->device.get_profiler();
+    const DebugMarkup& debug_markup = this->device.get_debug_markup();
+    for (uint32_t i = 0; i < this->order.size(); i++) {
+        const Pass& pass = this->passes[this->order[i]];
+        this->record_barriers(vk_command_buffer, pass.barriers);
+
+        // Time and label each pass on its own
+        gpu_scope_t scope = profiler.begin_scope(vk_command_buffer, queue_type, pass.name);
+        debug_markup.begin_label(vk_command_buffer, pass.name);
+        pass.execute(vk_command_buffer, *this);
+        debug_markup.end_label(vk_command_buffer);
+        profiler.end_scope(vk_command_buffer, queue_type, scope);
+    }
+    this->record_barriers(vk_command_buffer, this->final_barriers);
+}
+
+
+
+/* Sets the actual image of an imported image. */
+void RenderGraph::bind_image(resource_t resource, VkImage vk_image, VkImageView vk_image_view) {
+    #ifndef NDEBUG
+    if (!this->resources[resource].imported || !this->resources[resource].is_image) { logger.fatalc(RenderGraph::channel, "Only imported images can be bound."); }
+    #endif
+    this->resources[resource].vk_image = vk_image;
+    this->resources[resource].vk_image_view = vk_image_view;
+
+    // Patch the barriers that transition it
+    for (uint32_t i = 0; i < this->order.size(); i++) {
+        Barriers& barriers = this->passes[this->order[i]].barriers;
+        for (uint32_t j = 0; j < barriers.images.size(); j++) {
+            if (barriers.image_resources[j] == resource) { barriers.images[j].image = vk_image; }
+        }
+    }
+    for (uint32_t j = 0; j < this->final_barriers.images.size(); j++) {
+        if (this->final_barriers.image_resources[j] == resource) { this->final_barriers.images[j].image = vk_image; }
+    }
+}
+
+/* Sets the actual buffer of an imported buffer. */
+void RenderGraph::bind_buffer(resource_t resource, VkBuffer vk_buffer) {
+    #ifndef NDEBUG
+    if (!this->resources[resource].imported || this->resources[resource].is_image) { logger.fatalc(RenderGraph::channel, "Only imported buffers can be bound."); }
+    #endif
+    this->resources[resource].vk_buffer = vk_buffer;
+}
+
+
+
+/* Swap operator for the RenderGraph class. */
+void Makma3D::swap(RenderGraph& rg1, RenderGraph& rg2) {
+    #ifndef NDEBUG
+    if (&rg1.device != &rg2.device) { logger.fatalc(RenderGraph::channel, "Cannot swap render graphs with different devices."); }
+    #endif
+
+    using std::swap;
+
+    swap(rg1.resources, rg2.resources);
+    swap(rg1.passes, rg2.passes);
+    swap(rg1.order, rg2.order);
+    swap(rg1.blocks, rg2.blocks);
+    swap(rg1.final_barriers, rg2.final_barriers);
+    swap(rg1.compiled, rg2.compiled);
+    swap(rg1._statistics, rg2._statistics);
+}
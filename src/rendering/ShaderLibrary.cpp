@@ -0,0 +1,488 @@
+/* SHADER LIBRARY.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   20/10/2021, 14:47:09
+ * Last edited:
+ *   20/10/2021, 14:47:09
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the ShaderLibrary class, which maps compiled SPIR-V files
+ *   into memory, shares one VkShaderModule between files with the same
+ *   contents and expresses shader variants as specialization constants.
+ *   A manifest lists the variants that are used, so they can all be
+ *   compiled through the PipelineManager before the first frame.
+**/
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "rendering/ShaderLibrary.hpp"
+
+using namespace std;
+using namespace Makma3D;
+
+
+/***** CONSTANTS *****/
+/* The magic number that every SPIR-V module starts with. */
+static constexpr const uint32_t spirv_magic = 0x07230203;
+
+/* Maps the names of stages in a manifest to their Vulkan counterparts. */
+static const std::unordered_map<std::string, VkShaderStageFlagBits> stage_names = {
+    { "vertex", VK_SHADER_STAGE_VERTEX_BIT },
+    { "tessellation_control", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT },
+    { "tessellation_evaluation", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT },
+    { "geometry", VK_SHADER_STAGE_GEOMETRY_BIT },
+    { "fragment", VK_SHADER_STAGE_FRAGMENT_BIT },
+    { "compute", VK_SHADER_STAGE_COMPUTE_BIT }
+};
+
+
+
+
+
+/***** HELPER STRUCTS *****/
+/* A file that is mapped into memory. */
+struct MappedFile {
+    /* The contents of the file. */
+    const uint32_t* code;
+    /* The size of the file, in bytes. */
+    size_t size;
+};
+
+
+
+
+
+/***** HELPER FUNCTIONS *****/
+/* Maps the file at the given path into memory, read-only.
+ * @param path The path of the file.
+ * @param file Will be set to the mapped file.
+ * @returns Whether the file could be mapped. */
+static bool map_file(const std::string& path, MappedFile& file) {
+    #ifdef _WIN32
+    /* For Windows machiens */
+
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) { return false; }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    // The view keeps the mapping alive, so we can close both handles right away
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL) { return false; }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) { return false; }
+
+    file.code = (const uint32_t*) view;
+    file.size = static_cast<size_t>(size.QuadPart);
+    return true;
+
+    #else
+    /* For Linux machiens */
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the file is closed
+    void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) { return false; }
+
+    file.code = (const uint32_t*) view;
+    file.size = static_cast<size_t>(info.st_size);
+    return true;
+
+    #endif
+}
+
+/* Unmaps a file that was mapped with map_file().
+ * @param file The file to unmap. */
+static void unmap_file(const MappedFile& file) {
+    #ifdef _WIN32
+    UnmapViewOfFile((LPCVOID) file.code);
+    #else
+    munmap((void*) file.code, file.size);
+    #endif
+}
+
+/* Computes the FNV-1a hash of the given bytes.
+ * @param bytes The bytes to hash.
+ * @param size The number of bytes.
+ * @returns The hash. */
+static uint64_t hash_bytes(const uint8_t* bytes, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * 1099511628211ULL; }
+    return hash;
+}
+
+/* Parses the value of a specialization constant in a manifest into its bits.
+ * @param value The value to parse; it's a float if it has a '.' in it, and an integer otherwise.
+ * @param bits Will be set to the bits of the value.
+ * @returns Whether the value could be parsed. */
+static bool parse_constant(const std::string& value, uint32_t& bits) {
+    try {
+        size_t parsed;
+        if (value.find('.') != std::string::npos) {
+            float f = std::stof(value, &parsed);
+            std::memcpy(&bits, &f, sizeof(uint32_t));
+        } else if (!value.empty() && value[0] == '-') {
+            int32_t i = static_cast<int32_t>(std::stol(value, &parsed, 0));
+            std::memcpy(&bits, &i, sizeof(uint32_t));
+        } else {
+            bits = static_cast<uint32_t>(std::stoul(value, &parsed, 0));
+        }
+        return parsed == value.size();
+    } catch (std::exception&) {
+        return false;
+    }
+}
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkShaderModuleCreateInfo struct.
+ * @param module_info The VkShaderModuleCreateInfo struct to populate.
+ * @param file The mapped SPIR-V file with the code for the module. */
+static void populate_module_info(VkShaderModuleCreateInfo& module_info, const MappedFile& file) {
+    // Set to default
+    module_info = {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+
+    // The driver copies the code, so the file can be unmapped afterwards
+    module_info.codeSize = file.size;
+    module_info.pCode = file.code;
+}
+
+/* Populates the given VkPipelineShaderStageCreateInfo struct.
+ * @param stage_info The VkPipelineShaderStageCreateInfo struct to populate.
+ * @param stage The stage to describe.
+ * @param specialization The specialization info for the stage, or nullptr if it has no constants. */
+static void populate_stage_info(VkPipelineShaderStageCreateInfo& stage_info, const ShaderStage& stage, const VkSpecializationInfo* specialization) {
+    // Set to default
+    stage_info = {};
+    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+
+    // Set the code and where it starts
+    stage_info.stage = stage.stage;
+    stage_info.module = stage.vk_module;
+    stage_info.pName = stage.entry_point.c_str();
+
+    // Set the constants of the variant
+    stage_info.pSpecializationInfo = specialization;
+}
+
+
+
+
+
+/***** SPECIALIZATIONCONSTANTS CLASS *****/
+/* Sets the constant with the given identifier to the given raw bits. */
+SpecializationConstants& SpecializationConstants::set_bits(uint32_t constant_id, uint32_t bits) {
+    // Overwrite it if it's set already
+    for (uint32_t i = 0; i < this->entries.size(); i++) {
+        if (this->entries[i].constantID == constant_id) {
+            this->data[i] = bits;
+            return *this;
+        }
+    }
+
+    // Otherwise, add it at the end of the data
+    this->entries.push_back(VkSpecializationMapEntry{ constant_id, static_cast<uint32_t>(this->data.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+    this->data.push_back(bits);
+    return *this;
+}
+
+/* Adds the constants to the given PipelineKey. */
+void SpecializationConstants::add_to(PipelineKey& key) const {
+    // The order in which constants were set doesn't change the variant, so add them by identifier
+    Tools::Array<uint32_t> order(this->entries.size());
+    for (uint32_t i = 0; i < this->entries.size(); i++) {
+        uint32_t j = 0;
+        while (j < order.size() && this->entries[order[j]].constantID < this->entries[i].constantID) { ++j; }
+        order.insert(j, i);
+    }
+
+    key.add(this->entries.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        key.add(this->entries[order[i]].constantID).add(this->data[order[i]]);
+    }
+}
+
+/* Returns a VkSpecializationInfo that refers to the constants. */
+VkSpecializationInfo SpecializationConstants::info() const {
+    VkSpecializationInfo specialization_info = {};
+    specialization_info.mapEntryCount = this->entries.size();
+    specialization_info.pMapEntries = this->entries.rdata();
+    specialization_info.dataSize = this->data.size() * sizeof(uint32_t);
+    specialization_info.pData = this->data.rdata();
+    return specialization_info;
+}
+
+
+
+
+
+/***** SHADERLIBRARY CLASS *****/
+/* Constructor for the ShaderLibrary class. */
+ShaderLibrary::ShaderLibrary(const Makma3D::Device& device, PipelineManager& pipeline_manager, const std::string& shader_dir) :
+    device(device),
+
+    pipeline_manager(pipeline_manager),
+    shader_dir(shader_dir),
+
+    _statistics({ 0, 0, 0, 0, 0 })
+{
+    logger.logc(Verbosity::details, ShaderLibrary::channel, "Initialized with shaders from '", this->shader_dir, "'.");
+}
+
+/* Destructor for the ShaderLibrary class. */
+ShaderLibrary::~ShaderLibrary() {
+    // Report the statistics
+    if (this->_statistics.n_files > 0) {
+        logger.logc(Verbosity::details, ShaderLibrary::channel, "Mapped ", this->_statistics.n_files, " files (", this->_statistics.bytes_mapped, " bytes) into ", this->_statistics.n_modules, " modules (", this->_statistics.n_deduplicated, " duplicates shared), used by ", this->_statistics.n_variants, " variants.");
+    }
+
+    // Destroy the modules; each is in the map only once, however many paths refer to it
+    for (std::unordered_map<PipelineKey, Tools::Array<Module>>::iterator iter = this->modules.begin(); iter != this->modules.end(); ++iter) {
+        for (uint32_t i = 0; i < iter->second.size(); i++) {
+            vkDestroyShaderModule(this->device, iter->second[i].vk_module, nullptr);
+        }
+    }
+}
+
+
+
+/* Returns the VkShaderModule with the code of the given SPIR-V file. */
+VkShaderModule ShaderLibrary::load(const std::string& path) {
+    // If we loaded the file before, we're done
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        std::unordered_map<std::string, VkShaderModule>::iterator iter = this->paths.find(path);
+        if (iter != this->paths.end()) { return iter->second; }
+    }
+
+    // Map the file and check that it's SPIR-V
+    std::string full_path = this->shader_dir + "/" + path;
+    MappedFile file;
+    if (!map_file(full_path, file)) {
+        logger.fatalc(ShaderLibrary::channel, "Could not map shader file '", full_path, "'.");
+    }
+    if (file.size % sizeof(uint32_t) != 0 || file.code[0] != spirv_magic) {
+        unmap_file(file);
+        logger.fatalc(ShaderLibrary::channel, "Shader file '", full_path, "' is not a SPIR-V module.");
+    }
+
+    // Hash the contents outside of the lock; the size goes in as well, so only files of equal length can collide
+    PipelineKey key;
+    key.add(hash_bytes((const uint8_t*) file.code, file.size)).add(file.size);
+
+    // Share the module with any file that has the same contents, or else create it. The hash only narrows the search down; the code itself decides
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    ++this->_statistics.n_files;
+    this->_statistics.bytes_mapped += file.size;
+    VkShaderModule vk_module = nullptr;
+    Tools::Array<Module>& bucket = this->modules[key];
+    for (uint32_t i = 0; i < bucket.size(); i++) {
+        if (memcmp(bucket[i].code.rdata(), file.code, file.size) == 0) {
+            vk_module = bucket[i].vk_module;
+            break;
+        }
+    }
+    if (vk_module != nullptr) {
+        ++this->_statistics.n_deduplicated;
+        logger.logc(Verbosity::debug, ShaderLibrary::channel, "Shader file '", path, "' shares its module with an earlier file.");
+    } else {
+        if (!bucket.empty()) {
+            logger.logc(Verbosity::debug, ShaderLibrary::channel, "Shader file '", path, "' has the same hash as an earlier file, but different contents.");
+        }
+        VkShaderModuleCreateInfo module_info;
+        populate_module_info(module_info, file);
+        VkResult vk_result;
+        if ((vk_result = vkCreateShaderModule(this->device, &module_info, nullptr, &vk_module)) != VK_SUCCESS) {
+            unmap_file(file);
+            logger.fatalc(ShaderLibrary::channel, "Could not create shader module for '", full_path, "': ", Vulkanic::vk_error_map.at(vk_result));
+        }
+        this->device.get_debug_markup().name(vk_module, path);
+        bucket.push_back(Module{ Tools::Array<uint32_t>(file.code, static_cast<uint32_t>(file.size / sizeof(uint32_t))), vk_module });
+        ++this->_statistics.n_modules;
+    }
+    unmap_file(file);
+
+    // Done
+    this->paths.insert({ path, vk_module });
+    return vk_module;
+}
+
+
+
+/* Registers a function that builds pipelines for the variants that name it in a manifest. */
+void ShaderLibrary::add_builder(const std::string& name, const PipelineKey& key, builder_t&& builder) {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    if (this->builders.find(name) != this->builders.end()) {
+        logger.fatalc(ShaderLibrary::channel, "Builder '", name, "' is already registered.");
+    }
+    this->builders.insert({ name, Builder{ std::move(builder), key } });
+}
+
+/* Requests the pipeline of a single shader variant from the PipelineManager. */
+pipeline_id_t ShaderLibrary::add_variant(const std::string& name, const std::string& builder, const Tools::Array<ShaderStage>& stages, const SpecializationConstants& constants) {
+    // Find the builder
+    builder_t build;
+    PipelineKey key;
+    {
+        std::unique_lock<std::mutex> local_lock(this->lock);
+        std::unordered_map<std::string, Builder>::iterator iter = this->builders.find(builder);
+        if (iter == this->builders.end()) {
+            logger.fatalc(ShaderLibrary::channel, "Unknown builder '", builder, "' for variant '", name, "'.");
+        }
+        build = iter->second.build;
+        key = iter->second.key;
+    }
+
+    // Describe the variant on top of what the builder describes
+    key.add(builder).add(stages.size());
+    for (uint32_t i = 0; i < stages.size(); i++) {
+        key.add(stages[i].stage).add(stages[i].vk_module).add(stages[i].entry_point);
+    }
+    constants.add_to(key);
+
+    // Request it; the stages only point into the copies the function holds, so they are built on the worker
+    pipeline_id_t id = this->pipeline_manager.request(key, [build, stages, constants](VkDevice vk_device, VkPipelineCache vk_pipeline_cache) -> VkPipeline {
+        VkSpecializationInfo specialization = constants.info();
+        Tools::Array<VkPipelineShaderStageCreateInfo> stage_infos(stages.size());
+        for (uint32_t i = 0; i < stages.size(); i++) {
+            VkPipelineShaderStageCreateInfo stage_info;
+            populate_stage_info(stage_info, stages[i], constants.empty() ? nullptr : &specialization);
+            stage_infos.push_back(stage_info);
+        }
+        return build(vk_device, vk_pipeline_cache, stage_infos);
+    }, null_pipeline_id, name);
+
+    // Remember it by name
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    std::unordered_map<std::string, pipeline_id_t>::iterator iter = this->variants.find(name);
+    if (iter != this->variants.end()) {
+        if (iter->second != id) { logger.warningc(ShaderLibrary::channel, "Variant '", name, "' is redefined with a different pipeline."); }
+        iter->second = id;
+    } else {
+        this->variants.insert({ name, id });
+    }
+    ++this->_statistics.n_variants;
+    return id;
+}
+
+/* Loads the manifest at the given path, and compiles all of the variants in it before returning. */
+uint32_t ShaderLibrary::load_manifest(const std::string& path) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Open the manifest
+    std::string full_path = this->shader_dir + "/" + path;
+    std::ifstream manifest(full_path);
+    if (!manifest.is_open()) {
+        logger.fatalc(ShaderLibrary::channel, "Could not open shader manifest '", full_path, "'.");
+    }
+
+    // Request each variant, so the workers can start while we're still reading
+    Tools::Array<pipeline_id_t> ids;
+    std::string line;
+    for (uint32_t l = 1; std::getline(manifest, line); l++) {
+        // Get the name and the builder, skipping empty lines and comments
+        std::istringstream tokens(line);
+        std::string name, builder;
+        if (!(tokens >> name) || name[0] == '#') { continue; }
+        if (!(tokens >> builder)) {
+            logger.fatalc(ShaderLibrary::channel, full_path, ':', l, ": Variant '", name, "' has no builder.");
+        }
+
+        // Parse the stages and constants
+        Tools::Array<ShaderStage> stages;
+        SpecializationConstants constants;
+        std::string token;
+        while (tokens >> token) {
+            size_t equals = token.find('=');
+            if (equals != std::string::npos) {
+                // It's a constant
+                uint32_t constant_id, bits;
+                if (!parse_constant(token.substr(0, equals), constant_id) || !parse_constant(token.substr(equals + 1), bits)) {
+                    logger.fatalc(ShaderLibrary::channel, full_path, ':', l, ": Invalid specialization constant '", token, "'.");
+                }
+                constants.set_bits(constant_id, bits);
+                continue;
+            }
+
+            // Otherwise, it's a stage
+            size_t colon = token.find(':');
+            if (colon == std::string::npos) {
+                logger.fatalc(ShaderLibrary::channel, full_path, ':', l, ": Expected '<stage>:<file>' or '<constant id>=<value>', got '", token, "'.");
+            }
+            std::unordered_map<std::string, VkShaderStageFlagBits>::const_iterator stage = stage_names.find(token.substr(0, colon));
+            if (stage == stage_names.end()) {
+                logger.fatalc(ShaderLibrary::channel, full_path, ':', l, ": Unknown shader stage '", token.substr(0, colon), "'.");
+            }
+            std::string file = token.substr(colon + 1);
+            std::string entry_point = "main";
+            size_t entry_colon = file.find(':');
+            if (entry_colon != std::string::npos) {
+                entry_point = file.substr(entry_colon + 1);
+                file = file.substr(0, entry_colon);
+            }
+            stages.push_back(ShaderStage{ stage->second, this->load(file), entry_point });
+        }
+        if (stages.empty()) {
+            logger.fatalc(ShaderLibrary::channel, full_path, ':', l, ": Variant '", name, "' has no stages.");
+        }
+
+        ids.push_back(this->add_variant(name, builder, stages, constants));
+    }
+
+    // Wait until they're all done, lending a hand to the workers with the ones they haven't started yet
+    uint32_t n_failed = 0;
+    for (uint32_t i = 0; i < ids.size(); i++) {
+        if (this->pipeline_manager.wait(ids[i]) == nullptr) { ++n_failed; }
+    }
+    if (n_failed > 0) {
+        logger.warningc(ShaderLibrary::channel, n_failed, " of ", ids.size(), " variants in manifest '", path, "' could not be compiled.");
+    }
+
+    // Done
+    uint64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    logger.logc(Verbosity::details, ShaderLibrary::channel, "Precompiled ", ids.size(), " variants from manifest '", path, "' in ", time, "ms.");
+    return ids.size();
+}
+
+
+
+/* Returns the pipeline of the variant with the given name. */
+pipeline_id_t ShaderLibrary::find(const std::string& name) const {
+    std::unique_lock<std::mutex> local_lock(this->lock);
+    std::unordered_map<std::string, pipeline_id_t>::const_iterator iter = this->variants.find(name);
+    return iter != this->variants.end() ? iter->second : null_pipeline_id;
+}
@@ -14,6 +14,7 @@
 **/
 
 #include <cstring>
+#include <algorithm>
 
 #include "tools/Logger.hpp"
 
@@ -73,7 +74,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL vk_callback(VkDebugUtilsMessageSeverityFla
 
 /***** POPULATE FUNCTIONS *****/
 /* Populates a VkApplicationInfo struct with the application info we hardcoded here. */
-static void populate_application_info(VkApplicationInfo& app_info, const char* application_name, uint32_t application_version, uint32_t makma_version) {
+static void populate_application_info(VkApplicationInfo& app_info, const char* application_name, uint32_t application_version, uint32_t makma_version, uint32_t api_version) {
     // Set the struct to 0 and set its type
     app_info = {};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -86,8 +87,8 @@ static void populate_application_info(VkApplicationInfo& app_info, const char* a
     app_info.pEngineName = "Makma3D";
     app_info.engineVersion = makma_version;
 
-    // Finally, define the minimum API level to use
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    // Finally, define the (negotiated) API level to use
+    app_info.apiVersion = api_version;
 }
 
 /* Populates a VkInstanceCreateInfo struct with the given list of extensions and layers. If you don't want to enable either of those, pass empty lists. */
@@ -127,13 +128,27 @@ static void populate_debug_info(VkDebugUtilsMessengerCreateInfoEXT& debug_info)
 
 
 
+/* Populates the given VkHeadlessSurfaceCreateInfoEXT struct.
+ * @param surface_info The VkHeadlessSurfaceCreateInfoEXT struct to populate. */
+static void populate_headless_surface_info(VkHeadlessSurfaceCreateInfoEXT& surface_info) {
+    // Only set the meta info; there's nothing else to configure
+    surface_info = {};
+    surface_info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+}
+
+
+
+
+
 /***** DYNAMIC LOADER FUNCTIONS *****/
-/* Loads a given method ('s address) from the given instance. */
-static PFN_vkVoidFunction load_instance_method(VkInstance vk_instance, const char* method_name) {
+/* Loads a given method ('s address) from the given instance. If it isn't required, returns nullptr instead of throwing errors if it's missing. */
+static PFN_vkVoidFunction load_instance_method(VkInstance vk_instance, const char* method_name, bool required = true) {
     // Fetch the function pointer
     PFN_vkVoidFunction to_return = vkGetInstanceProcAddr(vk_instance, method_name);
     if (to_return == nullptr) {
-        logger.fatalc(Instance::channel, "Could not load function '", method_name, "'.");
+        if (required) { logger.fatalc(Instance::channel, "Could not load function '", method_name, "'."); }
+        logger.logc(Tools::Verbosity::debug, Instance::channel, "Function '", method_name, "' is not available.");
+        return nullptr;
     }
 
     // Otherwise, log success and return
@@ -149,16 +164,26 @@ static PFN_vkVoidFunction load_instance_method(VkInstance vk_instance, const cha
 /* Constructor for the Instance class. */
 Instance::Instance() :
     vk_instance(nullptr),
+    _api_version(VK_API_VERSION_1_0),
+    vk_get_physical_device_features2_method(nullptr),
+    dispatch_functions({}),
     vk_debugger(nullptr),
-    vk_destroy_debug_utils_messenger_method(nullptr)
+    vk_destroy_debug_utils_messenger_method(nullptr),
+    debug_utils_functions({ nullptr, nullptr, nullptr, nullptr })
 {}
 
 /* Move constructor for the Instance class. */
 Instance::Instance(Instance&& other) :
     vk_instance(other.vk_instance),
+    _api_version(other._api_version),
+    vk_get_physical_device_features2_method(other.vk_get_physical_device_features2_method),
+    dispatch_functions(other.dispatch_functions),
 
     vk_debugger(other.vk_debugger),
-    vk_destroy_debug_utils_messenger_method(other.vk_destroy_debug_utils_messenger_method)
+    vk_destroy_debug_utils_messenger_method(other.vk_destroy_debug_utils_messenger_method),
+    debug_utils_functions(other.debug_utils_functions),
+
+    physical_device_registry(std::move(other.physical_device_registry))
 {
     // Set everything to nullptrs in the other function to avoid deallocation
     other.vk_instance = nullptr;
@@ -180,13 +205,28 @@ Instance::~Instance() {
 
 
 
+/* Returns the highest Vulkan version that both the loader and the engine support. */
+uint32_t Instance::negotiate_api_version() {
+    // Loaders for Vulkan 1.0 don't have this function at all
+    PFN_vkEnumerateInstanceVersion enumerate_instance_version = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (enumerate_instance_version == nullptr) { return VK_API_VERSION_1_0; }
+
+    uint32_t loader_version;
+    if (enumerate_instance_version(&loader_version) != VK_SUCCESS) { return VK_API_VERSION_1_0; }
+    return std::min(loader_version, Instance::max_api_version);
+}
+
 /* Initializes the instance. */
 void Instance::init(const char* application_name, uint32_t application_version, uint32_t makma_version, const Tools::Array<const char*>& extensions, const Tools::Array<const char*>& layers) {
     logger.logc(Verbosity::details, Instance::channel, "Initializing Vulkan...");
 
+    // Ask for the highest version we can get
+    this->_api_version = Instance::negotiate_api_version();
+    logger.logc(Verbosity::details, Instance::channel, "Using Vulkan ", VK_API_VERSION_MAJOR(this->_api_version), ".", VK_API_VERSION_MINOR(this->_api_version), ".", VK_API_VERSION_PATCH(this->_api_version), ".");
+
     // Defining the app & engine description
     VkApplicationInfo app_info;
-    populate_application_info(app_info, application_name, application_version, makma_version);
+    populate_application_info(app_info, application_name, application_version, makma_version, this->_api_version);
 
     // Setup the list of extensions
     VkInstanceCreateInfo instance_info;
@@ -207,6 +247,26 @@ void Instance::init(const char* application_name, uint32_t application_version,
             logger.logc(Verbosity::debug, Instance::channel, "Enabled Vulkan layer '", layers[i], "'.");
         }
     }
+
+    // Get the function to query extension features with, either from the core or from the extension
+    if (this->_api_version >= VK_API_VERSION_1_1) {
+        this->vk_get_physical_device_features2_method = (PFN_vkGetPhysicalDeviceFeatures2) vkGetInstanceProcAddr(this->vk_instance, "vkGetPhysicalDeviceFeatures2");
+    } else {
+        for (uint32_t i = 0; i < extensions.size(); i++) {
+            if (strcmp(extensions[i], VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+                this->vk_get_physical_device_features2_method = (PFN_vkGetPhysicalDeviceFeatures2) vkGetInstanceProcAddr(this->vk_instance, "vkGetPhysicalDeviceFeatures2KHR");
+                break;
+            }
+        }
+    }
+
+    // Load the functions we call directly once, so they skip the loader's trampoline
+    #define MAKMA3D_LOAD_FUNCTION(NAME, REQUIRED) this->dispatch_functions.NAME = (PFN_##NAME) load_instance_method(this->vk_instance, #NAME, REQUIRED);
+    MAKMA3D_INSTANCE_FUNCTIONS(MAKMA3D_LOAD_FUNCTION)
+    #undef MAKMA3D_LOAD_FUNCTION
+
+    // Enumerate the physical devices once, so we don't have to re-query them every time we look for one
+    this->physical_device_registry.enumerate(this->vk_instance, this->_api_version, this->vk_get_physical_device_features2_method);
 }
 
 /* Initializes the debugging part of the instance. */
@@ -226,29 +286,37 @@ void Instance::init_debug() {
     if ((vk_result = vk_create_debug_utils_messenger_method(this->vk_instance, &debug_info, nullptr, &this->vk_debugger)) != VK_SUCCESS) {
         logger.fatalc(Instance::channel, "Could not create the logger: ", vk_error_map[vk_result]);
     }
+
+    // Finally, load the functions with which devices can name their objects and label their command buffers
+    this->debug_utils_functions.set_object_name = (PFN_vkSetDebugUtilsObjectNameEXT) load_instance_method(this->vk_instance, "vkSetDebugUtilsObjectNameEXT");
+    this->debug_utils_functions.cmd_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT) load_instance_method(this->vk_instance, "vkCmdBeginDebugUtilsLabelEXT");
+    this->debug_utils_functions.cmd_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT) load_instance_method(this->vk_instance, "vkCmdEndDebugUtilsLabelEXT");
+    this->debug_utils_functions.cmd_insert_label = (PFN_vkCmdInsertDebugUtilsLabelEXT) load_instance_method(this->vk_instance, "vkCmdInsertDebugUtilsLabelEXT");
 }
 
 
 
 /* Returns the list of (supported) PhysicalDevices that are currently registered to the Vulkan backend. */
 Tools::Array<PhysicalDevice> Instance::get_physical_devices(VkSurfaceKHR vk_surface, const Tools::Array<const char*>& vk_device_extensions, const Tools::Array<Vulkanic::DeviceFeature>& vk_device_features) const {
-    // Get the devices from Vulkan
-    uint32_t n_physical_devices;
-    vkEnumeratePhysicalDevices(this->vk_instance, &n_physical_devices, nullptr);
-    if (n_physical_devices == 0) { logger.warningc(Instance::channel, "No Vulkan-capable devices found."); return {}; }
-    Tools::Array<VkPhysicalDevice> physical_devices(n_physical_devices);
-    vkEnumeratePhysicalDevices(this->vk_instance, &n_physical_devices, physical_devices.wdata(n_physical_devices));
-
-    // For each of them, check if they are compatible, and add them to the list as a PhysicalDevice if they are
-    Tools::Array<PhysicalDevice> result(n_physical_devices);
-    for (uint32_t i = 0; i < n_physical_devices; i++) {
-        if (PhysicalDevice::is_suitable(physical_devices[i], vk_surface, vk_device_extensions, vk_device_features)) {
-            result.push_back(PhysicalDevice(physical_devices[i], i));
-        }
-    }
+    return this->physical_device_registry.get_suitable(vk_surface, vk_device_extensions, vk_device_features);
+}
+
+/* Creates a new VkSurfaceKHR that is not backed by any display, using VK_EXT_headless_surface. */
+VkSurfaceKHR Instance::create_headless_surface() const {
+    // Load the extension function
+    PFN_vkCreateHeadlessSurfaceEXT vk_create_headless_surface_method = (PFN_vkCreateHeadlessSurfaceEXT) load_instance_method(this->vk_instance, "vkCreateHeadlessSurfaceEXT");
+
+    // Define the surface
+    VkHeadlessSurfaceCreateInfoEXT surface_info;
+    populate_headless_surface_info(surface_info);
 
-    // Done, return
-    return result;
+    // Create it
+    VkResult vk_result;
+    VkSurfaceKHR vk_surface;
+    if ((vk_result = vk_create_headless_surface_method(this->vk_instance, &surface_info, nullptr, &vk_surface)) != VK_SUCCESS) {
+        logger.fatalc(Instance::channel, "Could not create headless surface: ", vk_error_map[vk_result]);
+    }
+    return vk_surface;
 }
 
 
@@ -258,7 +326,13 @@ void Vulkanic::swap(Instance& i1, Instance& i2) {
     using std::swap;
 
     swap(i1.vk_instance, i2.vk_instance);
+    swap(i1._api_version, i2._api_version);
+    swap(i1.vk_get_physical_device_features2_method, i2.vk_get_physical_device_features2_method);
+    swap(i1.dispatch_functions, i2.dispatch_functions);
 
     swap(i1.vk_debugger, i2.vk_debugger);
     swap(i1.vk_destroy_debug_utils_messenger_method, i2.vk_destroy_debug_utils_messenger_method);
+    swap(i1.debug_utils_functions, i2.debug_utils_functions);
+
+    swap(i1.physical_device_registry, i2.physical_device_registry);
 }
@@ -37,8 +37,8 @@ Surface::Surface(Surface&& other) :
     vk_surface(other.vk_surface),
     _extent(other._extent)
 {
-    // Mark the swapchain as non-present anymore
-    this->vk_surface = nullptr;
+    // Mark the surface as non-present anymore
+    other.vk_surface = nullptr;
 }
 
 /* Destructor for the Surface class. */
@@ -51,9 +51,16 @@ Surface::~Surface() {
 
 
 
-/* "Re-creates" the Surface by destroying the internal one and replacing it with the given VkSurfaceKHR. The extent is the new size of the surface. */
-void Surface::recreate(const VkSurfaceKHR& vk_surface, const VkExtent2D& extent) {
-    vkDestroySurfaceKHR(this->instance, this->vk_surface, nullptr);
+/* "Re-creates" the Surface by destroying the internal one and replacing it with the given VkSurfaceKHR. */
+void Surface::recreate(const VkSurfaceKHR& vk_surface, const VkExtent2D& extent, DeletionQueue* deletion_queue) {
+    // Swapchains that were retired may still present to the old surface, so it has to wait for them if there are any
+    if (deletion_queue != nullptr) {
+        VkInstance vk_instance = this->instance;
+        VkSurfaceKHR vk_old_surface = this->vk_surface;
+        deletion_queue->retire([vk_instance, vk_old_surface]() { vkDestroySurfaceKHR(vk_instance, vk_old_surface, nullptr); });
+    } else {
+        vkDestroySurfaceKHR(this->instance, this->vk_surface, nullptr);
+    }
     this->vk_surface = vk_surface;
     this->_extent = extent;
 }
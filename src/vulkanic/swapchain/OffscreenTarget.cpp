@@ -0,0 +1,289 @@
+/* OFFSCREEN TARGET.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 15:40:15
+ * Last edited:
+ *   16/10/2021, 15:40:15
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the OffscreenTarget class, which replaces the Swapchain when
+ *   rendering headless by rendering the frames in flight to images that
+ *   are never presented.
+**/
+
+#include <limits>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+
+#include "vulkanic/swapchain/OffscreenTarget.hpp"
+
+using namespace std;
+using namespace Makma3D;
+using namespace Makma3D::Vulkanic;
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkImageCreateInfo struct for an offscreen image.
+ * @param image_info The VkImageCreateInfo struct to populate.
+ * @param extent The size of the image.
+ * @param format The format of the image. */
+static void populate_image_info(VkImageCreateInfo& image_info, const VkExtent2D& extent, VkFormat format) {
+    // Set the meta info first
+    image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+
+    // Set the shape of the image
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = { extent.width, extent.height, 1 };
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+
+    // It's rendered to like a swapchain image, but can also be copied or sampled to inspect the result
+    image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+/* Populates the given VkMemoryAllocateInfo struct.
+ * @param allocate_info The VkMemoryAllocateInfo struct to populate.
+ * @param size The number of bytes to allocate.
+ * @param memory_type The index of the memory type to allocate from. */
+static void populate_allocate_info(VkMemoryAllocateInfo& allocate_info, VkDeviceSize size, uint32_t memory_type) {
+    // Set the meta info first
+    allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+
+    // Set the size and the type
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+}
+
+/* Populates the given VkImageViewCreateInfo struct for an offscreen image.
+ * @param view_info The VkImageViewCreateInfo struct to populate.
+ * @param vk_image The image to create a view for.
+ * @param format The format of the image. */
+static void populate_view_info(VkImageViewCreateInfo& view_info, VkImage vk_image, VkFormat format) {
+    // Set the meta info first
+    view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+
+    // Set the image and how to look at it
+    view_info.image = vk_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+
+    // Set the part of the image we view (all of it)
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+}
+
+
+
+
+
+/***** OFFSCREENTARGET CLASS *****/
+/* Constructor for the OffscreenTarget class. */
+OffscreenTarget::OffscreenTarget(const Makma3D::Device& device, const VkExtent2D& extent, VkFormat format) :
+    device(device),
+
+    vk_format(format),
+    vk_extent(extent),
+
+    frames({}, Device::max_frames_in_flight),
+    _current_frame(0),
+
+    _statistics({ VK_PRESENT_MODE_IMMEDIATE_KHR, 0, 0.0, 0.0 })
+{
+    // Create the fences for each frame. They start signalled, since no frame is running yet
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkResult vk_result;
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        if ((vk_result = vkCreateFence(this->device, &fence_info, nullptr, &this->frames[i].vk_in_flight)) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not create in-flight fence for frame ", i, ": ", vk_error_map.at(vk_result));
+        }
+    }
+
+    // Create the images to render to
+    this->create_images();
+
+    // Done
+    logger.logc(Verbosity::important, OffscreenTarget::channel, "Initialized offscreen target with ", this->frames.size(), " images of ", this->vk_extent, ".");
+}
+
+/* Move constructor for the OffscreenTarget class. */
+OffscreenTarget::OffscreenTarget(OffscreenTarget&& other) :
+    device(other.device),
+
+    vk_format(other.vk_format),
+    vk_extent(other.vk_extent),
+
+    frames(std::move(other.frames)),
+    vk_images(std::move(other.vk_images)),
+    vk_views(std::move(other.vk_views)),
+    _current_frame(other._current_frame),
+
+    _statistics(other._statistics),
+    last_present(other.last_present)
+{
+    other._statistics.n_frames = 0;
+}
+
+/* Destructor for the OffscreenTarget class. */
+OffscreenTarget::~OffscreenTarget() {
+    // Make sure nothing renders to the images anymore
+    this->wait_frames();
+    this->flush_statistics();
+
+    // Destroy the images and the fences
+    this->destroy_images();
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        vkDestroyFence(this->device, this->frames[i].vk_in_flight, nullptr);
+    }
+}
+
+
+
+/* Creates the images, their memory and their views for all frames. */
+void OffscreenTarget::create_images() {
+    this->vk_images.resize(this->frames.size());
+    this->vk_views.resize(this->frames.size());
+
+    VkResult vk_result;
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        Frame& frame = this->frames[i];
+
+        // Create the image
+        VkImageCreateInfo image_info;
+        populate_image_info(image_info, this->vk_extent, this->vk_format);
+        if ((vk_result = vkCreateImage(this->device, &image_info, nullptr, &frame.vk_image)) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not create offscreen image ", i, ": ", vk_error_map.at(vk_result));
+        }
+        this->device.get_debug_markup().name(frame.vk_image, "offscreen image " + std::to_string(i));
+
+        // Back it with device-local memory
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(this->device, frame.vk_image, &requirements);
+        VkMemoryAllocateInfo allocate_info;
+        populate_allocate_info(allocate_info, requirements.size, this->device.get_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        if ((vk_result = this->device.get_memory_budget().allocate(allocate_info, frame.vk_memory)) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not allocate memory for offscreen image ", i, ": ", vk_error_map.at(vk_result));
+        }
+        frame.memory_type = allocate_info.memoryTypeIndex;
+        frame.memory_size = allocate_info.allocationSize;
+        if ((vk_result = vkBindImageMemory(this->device, frame.vk_image, frame.vk_memory, 0)) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not bind memory to offscreen image ", i, ": ", vk_error_map.at(vk_result));
+        }
+
+        // Create its view
+        VkImageViewCreateInfo view_info;
+        populate_view_info(view_info, frame.vk_image, this->vk_format);
+        if ((vk_result = vkCreateImageView(this->device, &view_info, nullptr, &frame.vk_view)) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not create view for offscreen image ", i, ": ", vk_error_map.at(vk_result));
+        }
+        this->device.get_debug_markup().name(frame.vk_view, "offscreen image " + std::to_string(i));
+
+        this->vk_images[i] = frame.vk_image;
+        this->vk_views[i] = frame.vk_view;
+    }
+}
+
+/* Destroys the images, their memory and their views for all frames. */
+void OffscreenTarget::destroy_images() {
+    for (uint32_t i = 0; i < this->vk_images.size(); i++) {
+        vkDestroyImageView(this->device, this->frames[i].vk_view, nullptr);
+        vkDestroyImage(this->device, this->frames[i].vk_image, nullptr);
+        this->device.get_memory_budget().free(this->frames[i].vk_memory, this->frames[i].memory_type, this->frames[i].memory_size);
+    }
+    this->vk_images.clear();
+    this->vk_views.clear();
+}
+
+/* Waits until all frames in flight are done. */
+void OffscreenTarget::wait_frames() {
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        VkResult vk_result;
+        if ((vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &this->frames[i].vk_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max())) != VK_SUCCESS) {
+            logger.fatalc(OffscreenTarget::channel, "Could not wait for frame ", i, ": ", vk_error_map.at(vk_result));
+        }
+    }
+}
+
+/* Logs the statistics and resets them. */
+void OffscreenTarget::flush_statistics() {
+    if (this->_statistics.n_frames > 0) {
+        logger.logc(Verbosity::details, OffscreenTarget::channel, "Rendered ", this->_statistics.n_frames, " offscreen frames at ", this->_statistics.fps(), " FPS, with an average acquire latency of ", this->_statistics.acquire_latency() * 1000.0, " ms.");
+    }
+    this->_statistics.n_frames = 0;
+    this->_statistics.total_frame_time = 0.0;
+    this->_statistics.total_acquire_time = 0.0;
+}
+
+
+
+/* Waits until the current frame in flight is available and prepares it for rendering. */
+bool OffscreenTarget::acquire(uint32_t& image_index) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Wait until the frame's previous submission is done; after that, its image is free as well
+    Frame& frame = this->frames[this->_current_frame];
+    VkResult vk_result;
+    if ((vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &frame.vk_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max())) != VK_SUCCESS) {
+        logger.fatalc(OffscreenTarget::channel, "Could not wait for frame ", this->_current_frame, ": ", vk_error_map.at(vk_result));
+    }
+    // Destroy whatever the device retired that the GPU is done with
+    this->device.get_deletion_queue().collect();
+
+    // We commit to rendering this frame, so reset its fence, its command buffers, its descriptor sets and its ring region, and read back its timings
+    if ((vk_result = this->device.get_dispatch().vkResetFences(this->device, 1, &frame.vk_in_flight)) != VK_SUCCESS) {
+        logger.fatalc(OffscreenTarget::channel, "Could not reset fence of frame ", this->_current_frame, ": ", vk_error_map.at(vk_result));
+    }
+    this->device.get_command_pool_manager().begin_frame(this->_current_frame);
+    this->device.get_descriptor_allocator().begin_frame(this->_current_frame);
+    this->device.get_frame_ring().begin_frame(this->_current_frame);
+    this->device.get_profiler().begin_frame(this->_current_frame);
+    this->device.get_memory_budget().update();
+
+    // Done
+    image_index = this->_current_frame;
+    this->_statistics.total_acquire_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+/* Finishes the current frame and moves to the next frame in flight. */
+bool OffscreenTarget::present(uint32_t image_index) {
+    #ifndef NDEBUG
+    if (image_index != this->_current_frame) { logger.fatalc(OffscreenTarget::channel, "Cannot present image ", image_index, " during frame ", this->_current_frame, "."); }
+    #endif
+
+    // Update the frame counter and the statistics
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (this->_statistics.n_frames > 0) {
+        this->_statistics.total_frame_time += std::chrono::duration<double>(now - this->last_present).count();
+    }
+    ++this->_statistics.n_frames;
+    this->last_present = now;
+    this->_current_frame = (this->_current_frame + 1) % this->frames.size();
+    return true;
+}
+
+/* Resizes the images, waiting until all frames in flight are done first. */
+void OffscreenTarget::resize(const VkExtent2D& extent) {
+    this->wait_frames();
+    this->destroy_images();
+    this->vk_extent = extent;
+    this->create_images();
+    logger.logc(Verbosity::details, OffscreenTarget::channel, "Resized offscreen target to ", this->vk_extent, ".");
+}
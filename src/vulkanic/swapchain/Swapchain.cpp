@@ -0,0 +1,528 @@
+/* SWAPCHAIN.cpp
+ *   by Lut99
+ *
+ * Created:
+ *   16/10/2021, 11:02:44
+ * Last edited:
+ *   16/10/2021, 11:02:44
+ * Auto updated?
+ *   Yes
+ *
+ * Description:
+ *   Contains the Swapchain class, which wraps a VkSwapchainKHR for a given
+ *   Surface and manages the synchronization of the frames in flight.
+**/
+
+#include <limits>
+#include <algorithm>
+
+#include "tools/Logger.hpp"
+#include "vulkanic/auxillary/ErrorCodes.hpp"
+#include "vulkanic/auxillary/PresentModes.hpp"
+
+#include "vulkanic/swapchain/Swapchain.hpp"
+
+using namespace std;
+using namespace Makma3D;
+using namespace Makma3D::Vulkanic;
+
+
+/***** HELPER FUNCTIONS *****/
+/* Chooses the format of the swapchain images. Prefers 8-bit sRGB BGRA, but falls back to whatever comes first.
+ * @param dispatch The functions of the instance, with which we query the surface.
+ * @param vk_physical_device The physical device that will render to the swapchain.
+ * @param vk_surface The surface to which the swapchain presents.
+ * @returns The chosen VkSurfaceFormatKHR. */
+static VkSurfaceFormatKHR choose_format(const InstanceDispatch& dispatch, VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface) {
+    // Get the supported formats
+    uint32_t n_formats;
+    dispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(vk_physical_device, vk_surface, &n_formats, nullptr);
+    if (n_formats == 0) { logger.fatalc(Swapchain::channel, "Surface does not support any formats."); }
+    Tools::Array<VkSurfaceFormatKHR> formats(n_formats);
+    dispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(vk_physical_device, vk_surface, &n_formats, formats.wdata(n_formats));
+
+    // Try to find our preferred one
+    for (uint32_t i = 0; i < formats.size(); i++) {
+        if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return formats[i];
+        }
+    }
+
+    // Otherwise, just return the first
+    return formats[0];
+}
+
+/* Chooses the present mode of the swapchain.
+ * @param dispatch The functions of the instance, with which we query the surface.
+ * @param vk_physical_device The physical device that will render to the swapchain.
+ * @param vk_surface The surface to which the swapchain presents.
+ * @param vsync If true, always uses FIFO. Otherwise, prefers mailbox, then immediate, then FIFO relaxed, and finally FIFO.
+ * @returns The chosen VkPresentModeKHR. */
+static VkPresentModeKHR choose_present_mode(const InstanceDispatch& dispatch, VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface, bool vsync) {
+    // FIFO is always supported, so if we want vsync we're done
+    if (vsync) { return VK_PRESENT_MODE_FIFO_KHR; }
+
+    // Otherwise, get the supported present modes
+    uint32_t n_modes;
+    dispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(vk_physical_device, vk_surface, &n_modes, nullptr);
+    Tools::Array<VkPresentModeKHR> modes(n_modes);
+    dispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(vk_physical_device, vk_surface, &n_modes, modes.wdata(n_modes));
+
+    // Pick the one with the lowest latency
+    static const VkPresentModeKHR preferred[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+    for (uint32_t p = 0; p < sizeof(preferred) / sizeof(VkPresentModeKHR); p++) {
+        for (uint32_t i = 0; i < modes.size(); i++) {
+            if (modes[i] == preferred[p]) { return modes[i]; }
+        }
+    }
+
+    // Fall back to the one that's always there
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+/* Chooses the size of the swapchain images.
+ * @param capabilities The capabilities of the surface.
+ * @param surface_extent The framebuffer size as reported by the window library.
+ * @returns The chosen VkExtent2D. */
+static VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR& capabilities, const VkExtent2D& surface_extent) {
+    // If the surface dictates the size, use that
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) { return capabilities.currentExtent; }
+
+    // Otherwise, clamp the window's size to the supported range
+    VkExtent2D result;
+    result.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, surface_extent.width));
+    result.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, surface_extent.height));
+    return result;
+}
+
+
+
+
+
+/***** POPULATE FUNCTIONS *****/
+/* Populates the given VkSwapchainCreateInfoKHR struct.
+ * @param swapchain_info The VkSwapchainCreateInfoKHR struct to populate.
+ * @param vk_surface The surface to present to.
+ * @param capabilities The capabilities of the surface.
+ * @param format The format of the swapchain images.
+ * @param extent The size of the swapchain images.
+ * @param present_mode The present mode of the swapchain.
+ * @param queue_families The queue families that access the images (the graphics and the present one). If they're the same, the images are used exclusively.
+ * @param vk_old_swapchain The swapchain that is replaced, or nullptr if there is none. */
+static void populate_swapchain_info(VkSwapchainCreateInfoKHR& swapchain_info, VkSurfaceKHR vk_surface, const VkSurfaceCapabilitiesKHR& capabilities, const VkSurfaceFormatKHR& format, const VkExtent2D& extent, VkPresentModeKHR present_mode, const uint32_t queue_families[2], VkSwapchainKHR vk_old_swapchain) {
+    // Set the meta info first
+    swapchain_info = {};
+    swapchain_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+
+    // Set the surface and the number of images; one more than the minimum so we never wait on the driver
+    swapchain_info.surface = vk_surface;
+    swapchain_info.minImageCount = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0 && swapchain_info.minImageCount > capabilities.maxImageCount) {
+        swapchain_info.minImageCount = capabilities.maxImageCount;
+    }
+
+    // Set the image properties
+    swapchain_info.imageFormat = format.format;
+    swapchain_info.imageColorSpace = format.colorSpace;
+    swapchain_info.imageExtent = extent;
+    swapchain_info.imageArrayLayers = 1;
+    swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    // Share the images only if the graphics and present families differ
+    if (queue_families[0] != queue_families[1]) {
+        swapchain_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        swapchain_info.queueFamilyIndexCount = 2;
+        swapchain_info.pQueueFamilyIndices = queue_families;
+    } else {
+        swapchain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    // Set the presentation properties
+    swapchain_info.preTransform = capabilities.currentTransform;
+    swapchain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchain_info.presentMode = present_mode;
+    swapchain_info.clipped = VK_TRUE;
+
+    // Finally, hand over the old swapchain so it can keep presenting while we switch
+    swapchain_info.oldSwapchain = vk_old_swapchain;
+}
+
+/* Populates the given VkImageViewCreateInfo struct for a swapchain image.
+ * @param view_info The VkImageViewCreateInfo struct to populate.
+ * @param vk_image The swapchain image to create a view for.
+ * @param format The format of the image. */
+static void populate_view_info(VkImageViewCreateInfo& view_info, VkImage vk_image, VkFormat format) {
+    // Set the meta info first
+    view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+
+    // Set the image and how to look at it
+    view_info.image = vk_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+
+    // Set the part of the image we view (all of it)
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+}
+
+
+
+
+
+/***** SWAPCHAIN CLASS *****/
+/* Constructor for the Swapchain class. */
+Swapchain::Swapchain(const Makma3D::Device& device, const Vulkanic::Surface& surface, bool vsync) :
+    device(device),
+    surface(surface),
+
+    vk_swapchain(nullptr),
+    vk_present_mode(VK_PRESENT_MODE_FIFO_KHR),
+    _vsync(vsync),
+    _suboptimal(false),
+    _out_of_date(false),
+
+    frames({}, Device::max_frames_in_flight),
+    _current_frame(0),
+    frame_counter(0),
+
+    _statistics({ VK_PRESENT_MODE_FIFO_KHR, 0, 0.0, 0.0 })
+{
+    // A headless device has nothing to present with
+    if (!this->device.can_present()) {
+        logger.fatalc(Swapchain::channel, "Cannot create a swapchain for a headless device; use an OffscreenTarget instead.");
+    }
+
+    // Create the synchronization primitives for each frame. The fences start signalled, since no frame is running yet
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkResult vk_result;
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        if ((vk_result = vkCreateSemaphore(this->device, &semaphore_info, nullptr, &this->frames[i].vk_image_available)) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not create image-available semaphore for frame ", i, ": ", vk_error_map.at(vk_result));
+        }
+        if ((vk_result = vkCreateFence(this->device, &fence_info, nullptr, &this->frames[i].vk_in_flight)) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not create in-flight fence for frame ", i, ": ", vk_error_map.at(vk_result));
+        }
+    }
+
+    // Create the swapchain itself
+    this->create_swapchain();
+
+    // Done
+    logger.logc(Verbosity::important, Swapchain::channel, "Initialized swapchain with ", this->vk_images.size(), " images of ", this->vk_extent, " in ", vk_present_mode_map.at(this->vk_present_mode), " mode.");
+}
+
+/* Move constructor for the Swapchain class. */
+Swapchain::Swapchain(Swapchain&& other) :
+    device(other.device),
+    surface(other.surface),
+
+    vk_swapchain(other.vk_swapchain),
+    vk_format(other.vk_format),
+    vk_extent(other.vk_extent),
+    vk_present_mode(other.vk_present_mode),
+    _vsync(other._vsync),
+    _suboptimal(other._suboptimal),
+    _out_of_date(other._out_of_date),
+
+    vk_images(std::move(other.vk_images)),
+    vk_views(std::move(other.vk_views)),
+    vk_render_finished(std::move(other.vk_render_finished)),
+    vk_image_fences(std::move(other.vk_image_fences)),
+
+    frames(std::move(other.frames)),
+    _current_frame(other._current_frame),
+    frame_counter(other.frame_counter),
+    retired(std::move(other.retired)),
+
+    _statistics(other._statistics),
+    last_present(other.last_present)
+{
+    other.vk_swapchain = nullptr;
+    other._statistics.n_frames = 0;
+}
+
+/* Destructor for the Swapchain class. */
+Swapchain::~Swapchain() {
+    // Wait until all frames in flight are done, since the surface doesn't outlive us
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        VkResult vk_result;
+        if ((vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &this->frames[i].vk_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max())) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not wait for frame ", i, ": ", vk_error_map.at(vk_result));
+        }
+    }
+
+    // Destroy the swapchain itself and any old ones first
+    if (this->vk_swapchain != nullptr) {
+        this->retired.push_back({ this->vk_swapchain, std::move(this->vk_views), std::move(this->vk_render_finished), 0 });
+    }
+    for (uint32_t i = 0; i < this->retired.size(); i++) {
+        Swapchain::destroy(this->device, this->retired[i]);
+    }
+    this->flush_statistics();
+
+    // Destroy the frames
+    for (uint32_t i = 0; i < this->frames.size(); i++) {
+        vkDestroyFence(this->device, this->frames[i].vk_in_flight, nullptr);
+        vkDestroySemaphore(this->device, this->frames[i].vk_image_available, nullptr);
+    }
+}
+
+
+
+/* Creates a new VkSwapchainKHR, handing over the current one (if any) as the old swapchain. */
+void Swapchain::create_swapchain() {
+    // Get the surface's properties
+    VkSurfaceCapabilitiesKHR capabilities;
+    this->device.instance.dispatch().vkGetPhysicalDeviceSurfaceCapabilitiesKHR(this->device.get_physical_device(), this->surface, &capabilities);
+    VkSurfaceFormatKHR format = choose_format(this->device.instance.dispatch(), this->device.get_physical_device(), this->surface);
+    VkPresentModeKHR present_mode = choose_present_mode(this->device.instance.dispatch(), this->device.get_physical_device(), this->surface, this->_vsync);
+    VkExtent2D extent = choose_extent(capabilities, this->surface.extent());
+
+    // If the present mode changes, log the statistics of the old one
+    if (present_mode != this->_statistics.present_mode) {
+        this->flush_statistics();
+        this->_statistics.present_mode = present_mode;
+    }
+
+    // Retire the current swapchain; it will be destroyed once its frames are done
+    VkSwapchainKHR vk_old_swapchain = this->vk_swapchain;
+    if (vk_old_swapchain != nullptr) {
+        this->retired.push_back({ vk_old_swapchain, std::move(this->vk_views), std::move(this->vk_render_finished), this->frame_counter + this->frames.size() });
+        this->vk_swapchain = nullptr;
+        this->vk_views.clear();
+        this->vk_render_finished.clear();
+    }
+    this->vk_images.clear();
+    this->vk_image_fences.clear();
+    this->_suboptimal = false;
+    this->_out_of_date = false;
+
+    // A minimized window has no area, so we can't create a swapchain for it until it's restored
+    if (extent.width == 0 || extent.height == 0) {
+        logger.logc(Verbosity::details, Swapchain::channel, "Surface has no area; postponing swapchain creation.");
+        return;
+    }
+
+    // Create the new swapchain
+    uint32_t queue_families[2] = { this->device.get_queue_family(QueueType::graphics), this->device.get_queue_family(QueueType::present) };
+    VkSwapchainCreateInfoKHR swapchain_info;
+    populate_swapchain_info(swapchain_info, this->surface, capabilities, format, extent, present_mode, queue_families, vk_old_swapchain);
+    VkResult vk_result;
+    if ((vk_result = vkCreateSwapchainKHR(this->device, &swapchain_info, nullptr, &this->vk_swapchain)) != VK_SUCCESS) {
+        logger.fatalc(Swapchain::channel, "Could not create swapchain: ", vk_error_map.at(vk_result));
+    }
+    this->vk_format = format;
+    this->vk_extent = extent;
+    this->vk_present_mode = present_mode;
+
+    // Get its images
+    uint32_t n_images;
+    this->device.get_dispatch().vkGetSwapchainImagesKHR(this->device, this->vk_swapchain, &n_images, nullptr);
+    this->device.get_dispatch().vkGetSwapchainImagesKHR(this->device, this->vk_swapchain, &n_images, this->vk_images.wdata(n_images));
+
+    // Create a view and a render-finished semaphore per image
+    this->vk_views.resize(n_images);
+    this->vk_render_finished.resize(n_images);
+    this->vk_image_fences.resize(nullptr, n_images);
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (uint32_t i = 0; i < n_images; i++) {
+        VkImageViewCreateInfo view_info;
+        populate_view_info(view_info, this->vk_images[i], this->vk_format.format);
+        if ((vk_result = vkCreateImageView(this->device, &view_info, nullptr, &this->vk_views[i])) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not create view for swapchain image ", i, ": ", vk_error_map.at(vk_result));
+        }
+        if ((vk_result = vkCreateSemaphore(this->device, &semaphore_info, nullptr, &this->vk_render_finished[i])) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not create render-finished semaphore for swapchain image ", i, ": ", vk_error_map.at(vk_result));
+        }
+    }
+}
+
+/* Returns whether the surface still accepts images of the swapchain's extent. */
+bool Swapchain::extent_usable() const {
+    VkSurfaceCapabilitiesKHR capabilities;
+    this->device.instance.dispatch().vkGetPhysicalDeviceSurfaceCapabilitiesKHR(this->device.get_physical_device(), this->surface, &capabilities);
+    return this->vk_extent.width >= capabilities.minImageExtent.width && this->vk_extent.width <= capabilities.maxImageExtent.width &&
+           this->vk_extent.height >= capabilities.minImageExtent.height && this->vk_extent.height <= capabilities.maxImageExtent.height;
+}
+
+/* Destroys the given old swapchain and the views and semaphores that come with it. */
+void Swapchain::destroy(VkDevice vk_device, const Retired& old) {
+    for (uint32_t i = 0; i < old.vk_views.size(); i++) {
+        vkDestroyImageView(vk_device, old.vk_views[i], nullptr);
+        vkDestroySemaphore(vk_device, old.vk_render_finished[i], nullptr);
+    }
+    vkDestroySwapchainKHR(vk_device, old.vk_swapchain, nullptr);
+}
+
+/* Destroys the old swapchains whose frames are all done. */
+void Swapchain::destroy_retired() {
+    for (uint32_t i = 0; i < this->retired.size(); ) {
+        if (this->retired[i].frame > this->frame_counter) { ++i; continue; }
+
+        // All frames that could have used it are done, so destroy it
+        Swapchain::destroy(this->device, this->retired[i]);
+        this->retired.erase(i);
+    }
+}
+
+/* Logs the statistics of the current present mode and resets them. */
+void Swapchain::flush_statistics() {
+    if (this->_statistics.n_frames > 0) {
+        logger.logc(Verbosity::details, Swapchain::channel, "Presented ", this->_statistics.n_frames, " frames in ", vk_present_mode_map.at(this->_statistics.present_mode), " mode at ", this->_statistics.fps(), " FPS, with an average acquire latency of ", this->_statistics.acquire_latency() * 1000.0, " ms.");
+    }
+    this->_statistics.n_frames = 0;
+    this->_statistics.total_frame_time = 0.0;
+    this->_statistics.total_acquire_time = 0.0;
+}
+
+
+
+/* Waits until the current frame in flight is available, and then acquires the next swapchain image for it. */
+bool Swapchain::acquire(uint32_t& image_index) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // If we postponed the swapchain, try again
+    if (this->vk_swapchain == nullptr) {
+        this->create_swapchain();
+        if (this->vk_swapchain == nullptr) { return false; }
+    }
+    // If it's out-of-date, skip frames until the owner recreates it
+    if (this->_out_of_date) { return false; }
+
+    // Wait until the frame's previous submission is done
+    Frame& frame = this->frames[this->_current_frame];
+    VkResult vk_result;
+    if ((vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &frame.vk_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max())) != VK_SUCCESS) {
+        logger.fatalc(Swapchain::channel, "Could not wait for frame ", this->_current_frame, ": ", vk_error_map.at(vk_result));
+    }
+    // Everything up to this frame's previous use is done, so clean what we can
+    this->destroy_retired();
+    this->device.get_deletion_queue().collect();
+
+    // Acquire the next image
+    vk_result = this->device.get_dispatch().vkAcquireNextImageKHR(this->device, this->vk_swapchain, std::numeric_limits<uint64_t>::max(), frame.vk_image_available, nullptr, &image_index);
+    if (vk_result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Leave the recreate to the owner so it's debounced with the resize events, unless the surface can't take our images anymore
+        this->_out_of_date = true;
+        if (!this->extent_usable()) { this->recreate(); }
+        return false;
+    } else if (vk_result == VK_SUBOPTIMAL_KHR) {
+        this->_suboptimal = true;
+    } else if (vk_result != VK_SUCCESS) {
+        logger.fatalc(Swapchain::channel, "Could not acquire swapchain image: ", vk_error_map.at(vk_result));
+    }
+
+    // If another frame is still rendering to this image, wait for it too
+    if (this->vk_image_fences[image_index] != nullptr && this->vk_image_fences[image_index] != frame.vk_in_flight) {
+        if ((vk_result = this->device.get_dispatch().vkWaitForFences(this->device, 1, &this->vk_image_fences[image_index], VK_TRUE, std::numeric_limits<uint64_t>::max())) != VK_SUCCESS) {
+            logger.fatalc(Swapchain::channel, "Could not wait for swapchain image ", image_index, ": ", vk_error_map.at(vk_result));
+        }
+    }
+    this->vk_image_fences[image_index] = frame.vk_in_flight;
+
+    // We commit to rendering this frame, so reset its fence, its command buffers, its descriptor sets and its ring region, and read back its timings
+    if ((vk_result = this->device.get_dispatch().vkResetFences(this->device, 1, &frame.vk_in_flight)) != VK_SUCCESS) {
+        logger.fatalc(Swapchain::channel, "Could not reset fence of frame ", this->_current_frame, ": ", vk_error_map.at(vk_result));
+    }
+    this->device.get_command_pool_manager().begin_frame(this->_current_frame);
+    this->device.get_descriptor_allocator().begin_frame(this->_current_frame);
+    this->device.get_frame_ring().begin_frame(this->_current_frame);
+    this->device.get_profiler().begin_frame(this->_current_frame);
+    this->device.get_memory_budget().update();
+
+    // Done
+    this->_statistics.total_acquire_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+/* Presents the given image on the present queue, waiting for its render_finished() semaphore, and moves to the next frame in flight. */
+bool Swapchain::present(uint32_t image_index) {
+    // Present the image
+    VkPresentInfoKHR present_info = {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &this->vk_render_finished[image_index];
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &this->vk_swapchain;
+    present_info.pImageIndices = &image_index;
+    VkResult vk_result;
+    {
+        QueueLease queue = this->device.lease_queue(QueueType::present);
+        vk_result = this->device.get_dispatch().vkQueuePresentKHR(queue, &present_info);
+    }
+
+    // Update the frame counters and the statistics
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (this->_statistics.n_frames > 0) {
+        this->_statistics.total_frame_time += std::chrono::duration<double>(now - this->last_present).count();
+    }
+    ++this->_statistics.n_frames;
+    this->last_present = now;
+    this->_current_frame = (this->_current_frame + 1) % this->frames.size();
+    ++this->frame_counter;
+
+    // Check if we need to recreate. We leave that to the owner, so it happens once the surface has stopped changing, unless the surface can't take our images anymore
+    if (vk_result == VK_ERROR_OUT_OF_DATE_KHR) {
+        this->_out_of_date = true;
+        if (!this->extent_usable()) { this->recreate(); }
+        return false;
+    } else if (vk_result == VK_SUBOPTIMAL_KHR) {
+        this->_suboptimal = true;
+    } else if (vk_result != VK_SUCCESS) {
+        logger.fatalc(Swapchain::channel, "Could not present swapchain image ", image_index, ": ", vk_error_map.at(vk_result));
+    }
+    return true;
+}
+
+/* Recreates the swapchain, e.g. after a resize. */
+void Swapchain::recreate() {
+    this->create_swapchain();
+    if (this->vk_swapchain != nullptr) {
+        logger.logc(Verbosity::details, Swapchain::channel, "Recreated swapchain with ", this->vk_images.size(), " images of ", this->vk_extent, " in ", vk_present_mode_map.at(this->vk_present_mode), " mode.");
+    }
+}
+
+/* Destroys the swapchain without recreating it, for when the underlying surface is about to be replaced. */
+void Swapchain::reset() {
+    // Retire the current swapchain with the old ones
+    if (this->vk_swapchain != nullptr) {
+        this->retired.push_back({ this->vk_swapchain, std::move(this->vk_views), std::move(this->vk_render_finished), 0 });
+        this->vk_swapchain = nullptr;
+        this->vk_views.clear();
+        this->vk_render_finished.clear();
+    }
+    this->vk_images.clear();
+    this->vk_image_fences.clear();
+
+    // Frames in flight may still use them, so let the device destroy them once its queues are done instead of waiting here
+    VkDevice vk_device = this->device;
+    DeletionQueue& deletion_queue = this->device.get_deletion_queue();
+    for (uint32_t i = 0; i < this->retired.size(); i++) {
+        Retired old = std::move(this->retired[i]);
+        deletion_queue.retire([vk_device, old]() { Swapchain::destroy(vk_device, old); });
+    }
+    this->retired.clear();
+}
+
+
+
+/* Changes whether the swapchain should sync with the vertical blank. Recreates it if the present mode changes. */
+void Swapchain::set_vsync(bool vsync) {
+    if (this->_vsync == vsync) { return; }
+    this->_vsync = vsync;
+
+    // Only recreate if that actually results in another mode
+    if (choose_present_mode(this->device.instance.dispatch(), this->device.get_physical_device(), this->surface, this->_vsync) != this->vk_present_mode) {
+        this->recreate();
+    }
+}
@@ -45,7 +45,9 @@ void glfw_error_callback(int code, const char* message) {
 
 /***** INSTANCE CLASS *****/
 /* Constructor for the Instance class. */
-Instance::Instance() {}
+Instance::Instance() :
+    _primary(nullptr)
+{}
 
 /* Move constructor for the Instance class. */
 Instance::Instance(Instance&& other) :
@@ -32,8 +32,19 @@ Window::Window(const Makma3D::Instance& instance, const Monitor* monitor, const
 
     _title(title),
     _extent(extent),
-    _mode(mode)
+    _mode(mode),
+
+    _swapchain(nullptr),
+
+    resize_pending(false),
+    n_resize_events(0),
+    n_resizes(0)
 {
+    // Without a display, there's no window to create
+    if (this->instance.headless()) {
+        logger.fatalc(Window::channel, "Cannot create a window for a headless instance.");
+    }
+
     // Set whether this Window is resizeable or not
     glfwWindowHint(GLFW_RESIZABLE, mode == WindowMode::windowed_resizeable);
 
@@ -92,6 +103,10 @@ Window::Window(const Makma3D::Instance& instance, const Monitor* monitor, const
     // With that, create the Surface object and set it internally
     this->_surface = new Vulkanic::Surface(this->instance, vk_surface, { static_cast<uint32_t>(fw), static_cast<uint32_t>(fh) });
 
+    // Listen for framebuffer resizes, so that we can resize the swapchain when they settle
+    glfwSetWindowUserPointer(this->glfw_window, (void*) this);
+    glfwSetFramebufferSizeCallback(this->glfw_window, Window::_framebuffer_size_callback);
+
     // Do a success print
     if (logger.get_verbosity() >= Verbosity::debug) {
         switch(this->_mode) {
@@ -133,15 +148,28 @@ Window::Window(Window&& other) :
     _extent(other._extent),
     _mode(other._mode),
 
-    _surface(other._surface)
+    _surface(other._surface),
+    _swapchain(other._swapchain),
+
+    resize_pending(other.resize_pending),
+    last_resize(other.last_resize),
+    n_resize_events(other.n_resize_events),
+    n_resizes(other.n_resizes)
 {
+    // Let the callbacks find us instead of the old object
+    if (this->glfw_window != nullptr) { glfwSetWindowUserPointer(this->glfw_window, (void*) this); }
+
     other.glfw_window = nullptr;
     other._surface = nullptr;
+    other._swapchain = nullptr;
 }
 
 /* Destructor for the Window class. */
 Window::~Window() {
     // Delete the swapchain
+    if (this->_swapchain != nullptr) {
+        delete this->_swapchain;
+    }
 
     // Delete the surface
     if (this->_surface != nullptr) {
@@ -153,6 +181,11 @@ Window::~Window() {
         glfwDestroyWindow(this->glfw_window);
     }
 
+    // Report how well we debounced resizes
+    if (this->n_resize_events > 0) {
+        logger.logc(Verbosity::details, Window::channel, "Received ", this->n_resize_events, " framebuffer resize events, for which the swapchain was resized ", this->n_resizes, " times.");
+    }
+
     // Do some nice debug print
     logger.logc(Verbosity::important, Window::channel, "Destroyed Window.");
 }
@@ -191,37 +224,73 @@ const Monitor* Window::_find_nearest_monitor() const {
     return monitors[best_monitor];
 }
 
-/* Reconstruct the internal Surface from the internal Window. */
-void Window::_reconstruct_surface() {
-    // Re-create the VkSurfaceKHR first
-    VkResult vk_result;
-    VkSurfaceKHR vk_surface;
-    if((vk_result = glfwCreateWindowSurface(this->_surface->instance, this->glfw_window, nullptr, &vk_surface)) != VK_SUCCESS) {
-        logger.fatalc(Window::channel, "Could not re-create window surface: ", Vulkanic::vk_error_map[vk_result]);
-    }
+/* Resizes the Surface to the current framebuffer size and recreates the Swapchain (if there is any) for it. */
+void Window::_resize_swapchain() {
+    // Any pending resize is covered by this one
+    this->resize_pending = false;
 
-    // Get its framebuffer size
+    // Update the surface with the framebuffer's size; the VkSurfaceKHR itself survives resizes
     int fw, fh;
     glfwGetFramebufferSize(this->glfw_window, &fw, &fh);
+    this->_surface->resize({ static_cast<uint32_t>(fw), static_cast<uint32_t>(fh) });
 
-    // Re-create the internal Surface too
-    this->_surface->recreate(vk_surface, { static_cast<uint32_t>(fw), static_cast<uint32_t>(fh) });
+    // Recreate the swapchain with the old one as its predecessor, so that frames in flight can still present to it
+    if (this->_swapchain != nullptr) {
+        this->_swapchain->recreate();
+        ++this->n_resizes;
+    }
 }
 
 
 
-// /* Uses the given GPU to create the internal swapchain. Must be called before the window can be rendered to, obviously. */
-// void Window::bind(const Vulkanic::GPU& gpu) {
+/* Uses the given Device to create the internal swapchain. Must be called before the window can be rendered to, obviously. */
+void Window::bind(const Makma3D::Device& device, bool vsync) {
+    // Get rid of any old swapchain first
+    if (this->_swapchain != nullptr) {
+        delete this->_swapchain;
+    }
 
-// }
+    // Create the new one
+    this->_swapchain = new Vulkanic::Swapchain(device, *this->_surface, vsync);
+}
+
+
+
+/* GLFW callback that records that the framebuffer of the given window was resized. */
+void Window::_framebuffer_size_callback(GLFWwindow* glfw_window, int width, int height) {
+    (void) width;
+    (void) height;
 
+    // Only remember when it happened; the size is read again once it has settled
+    Window* window = (Window*) glfwGetWindowUserPointer(glfw_window);
+    window->resize_pending = true;
+    window->last_resize = std::chrono::steady_clock::now();
+    ++window->n_resize_events;
 
+    // Keep the window size in sync if the user resized it
+    if (window->_mode == WindowMode::windowed_resizeable) {
+        int ww, wh;
+        glfwGetWindowSize(glfw_window, &ww, &wh);
+        window->_extent = { static_cast<uint32_t>(ww), static_cast<uint32_t>(wh) };
+    }
+}
 
 /* Does a single pass of the window events for this window. Returns whether the window should stay open (true) or not (false). */
-bool Window::loop() const {
+bool Window::loop() {
     // First, poll the GLFW events
     glfwPollEvents();
 
+    // If the surface changed without telling the window (e.g., it was rotated), the swapchain tells us instead; debounce that like any other resize
+    if (!this->resize_pending && this->_swapchain != nullptr && (this->_swapchain->out_of_date() || this->_swapchain->suboptimal())) {
+        this->resize_pending = true;
+        this->last_resize = std::chrono::steady_clock::now();
+    }
+
+    // Resize the swapchain once the surface stopped changing. Until then, the old swapchain keeps presenting (stretched or clipped), or skips frames if it's out-of-date
+    if (this->resize_pending && std::chrono::steady_clock::now() - this->last_resize >= std::chrono::milliseconds(Window::resize_delay)) {
+        this->_resize_swapchain();
+    }
+
     // Next, return if the Window should close
     return !glfwWindowShouldClose(this->glfw_window);
 }
@@ -257,9 +326,8 @@ void Window::set_monitor(const Monitor* new_monitor, const VkExtent2D& new_exten
         refresh_rate
     );
 
-    // We now have to rebuild the surface & swapchain
-    this->_reconstruct_surface();
-    /* TBD */
+    // The surface stays the same, but the swapchain has to match its new size
+    this->_resize_swapchain();
 
     // Done
     logger.logc(Verbosity::important, Window::channel, "Moved window to monitor ", this->_monitor->index(), " (", this->_monitor->name(), ", ", this->_monitor->resolution(), ").");
@@ -281,9 +349,8 @@ void Window::set_extent(const VkExtent2D& new_extent) {
     this->_extent = new_extent;
     // Also update GLFW's knowledge of this
     glfwSetWindowSize(this->glfw_window, static_cast<int>(this->_extent.width), static_cast<int>(this->_extent.height));
-    // We now have to rebuild the surface & swapchain
-    this->_reconstruct_surface();
-    /* TBD */
+    // The surface stays the same, but the swapchain has to match its new size
+    this->_resize_swapchain();
     // Done
     logger.logc(Verbosity::important, Window::channel, "Resized window to ", this->_extent, '.');
 }
@@ -375,9 +442,8 @@ void Window::set_mode(WindowMode new_mode, const VkExtent2D new_extent, const Mo
     // Finally, don't forget to update the mode
     this->_mode = new_mode;
 
-    // With the mode changed, reconstruct the surface and the swapchain
-    this->_reconstruct_surface();
-    /* TBD */
+    // With the mode changed, resize the swapchain to the new framebuffer (the surface belongs to the window, and thus survives the mode change)
+    this->_resize_swapchain();
 
     // Show the ending log
     switch(new_mode) {
@@ -415,21 +481,14 @@ PhysicalDevice Window::get_preferred_physical_device(PhysicalDeviceType preferre
         logger.fatalc(Window::channel, "No supported devices found for Window '", this->_title, "'.");
     }
 
-    // Go through it to find one with the preferred type
-    for (uint32_t i = 0; i < physical_devices.size(); i++) {
-        if (physical_devices[i].type() == preferred_type) {
-            return physical_devices[i];
-        }
-    }
-
-    // Otherwise, no such device found; return the first
-    return physical_devices.first();
+    // Return the one that scores best
+    return PhysicalDeviceRegistry::select(physical_devices, preferred_type);
 }
 
 /* Returns the list of (supported) PhysicalDevices that can render to this Window. */
 Tools::Array<PhysicalDevice> Window::get_physical_devices() const {
     // First, compile a list of device extensions & features to enable based on the enabled Makma3D extensions
-    Tools::Array<const char*> vk_device_extensions           = this->instance.get_device_extensions();
+    Tools::Array<const char*> vk_device_extensions           = this->instance.get_device_extensions(true);
     Tools::Array<Vulkanic::DeviceFeature> vk_device_features = this->instance.get_device_features();
 
     // Call the Vulkan instance's version of this function
@@ -451,4 +510,14 @@ void Makma3D::swap(Window& w1, Window& w2) {
     swap(w1._mode, w2._mode);
     
     swap(w1._surface, w2._surface);
+    swap(w1._swapchain, w2._swapchain);
+
+    swap(w1.resize_pending, w2.resize_pending);
+    swap(w1.last_resize, w2.last_resize);
+    swap(w1.n_resize_events, w2.n_resize_events);
+    swap(w1.n_resizes, w2.n_resizes);
+
+    // Let the callbacks find the right objects again
+    if (w1.glfw_window != nullptr) { glfwSetWindowUserPointer(w1.glfw_window, (void*) &w1); }
+    if (w2.glfw_window != nullptr) { glfwSetWindowUserPointer(w2.glfw_window, (void*) &w2); }
 }